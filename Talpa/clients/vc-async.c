@@ -0,0 +1,524 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+
+#include "vc-async.h"
+
+
+struct vc_loop
+{
+    int                 handle;
+    int                 epfd;
+    int                 evfd;
+    int                 armed;      /* Handle is in the epoll set and not yet fired */
+    int                 busy;       /* Job handed out and not completed */
+    volatile int        completed;
+    volatile int        stop;
+    int                 response;
+    vc_job_callback     callback;
+    void*               data;
+    size_t              bufsize;
+    struct vc_job       job;
+    /* Job buffer follows */
+};
+
+static int arm(struct vc_loop* loop)
+{
+    struct epoll_event ev;
+
+
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = loop->handle;
+
+    if ( epoll_ctl(loop->epfd, EPOLL_CTL_MOD, loop->handle, &ev) < 0 )
+    {
+        return -1;
+    }
+
+    loop->armed = 1;
+
+    return 0;
+}
+
+struct vc_loop* vc_loop_new(unsigned int group, size_t bufsize, vc_job_callback callback, void* data)
+{
+    struct vc_loop* loop;
+    struct epoll_event ev;
+    int flags;
+
+
+    if ( bufsize < sizeof(struct TalpaPacket_VettingDetails) )
+    {
+        bufsize = VC_JOB_DEFAULT_SIZE;
+    }
+
+    loop = (struct vc_loop *)malloc(sizeof(struct vc_loop) + bufsize);
+    if ( !loop )
+    {
+        return NULL;
+    }
+
+    memset(loop, 0, sizeof(struct vc_loop));
+    loop->epfd = loop->evfd = -1;
+    loop->callback = callback;
+    loop->data = data;
+    loop->bufsize = bufsize;
+    loop->job.loop = loop;
+    loop->job.packet = (struct TalpaPacket_VettingDetails *)(loop + 1);
+
+    /* Registration ties the handle to this thread */
+    loop->handle = vc_init(group, 0);
+    if ( loop->handle < 0 )
+    {
+        free(loop);
+        return NULL;
+    }
+    loop->job.handle = loop->handle;
+
+    /* Set once, instead of around every wait */
+    flags = fcntl(loop->handle, F_GETFL);
+    if ( (flags < 0) || (fcntl(loop->handle, F_SETFL, flags | O_NONBLOCK) < 0) )
+    {
+        goto fail;
+    }
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ( (loop->epfd < 0) || (loop->evfd < 0) )
+    {
+        goto fail;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = loop->evfd;
+    if ( epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->evfd, &ev) < 0 )
+    {
+        goto fail;
+    }
+
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = loop->handle;
+    if ( epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->handle, &ev) < 0 )
+    {
+        goto fail;
+    }
+    loop->armed = 1;
+
+    return loop;
+
+fail:
+    vc_loop_delete(loop);
+    return NULL;
+}
+
+void vc_loop_delete(struct vc_loop* loop)
+{
+    if ( !loop )
+    {
+        return;
+    }
+
+    /* A job still pending is failed by the kernel on deregistration */
+    vc_exit(loop->handle);
+    if ( loop->epfd >= 0 )
+    {
+        close(loop->epfd);
+    }
+    if ( loop->evfd >= 0 )
+    {
+        close(loop->evfd);
+    }
+    free(loop);
+
+    return;
+}
+
+int vc_loop_fd(const struct vc_loop* loop)
+{
+    return loop->epfd;
+}
+
+void vc_loop_stop(struct vc_loop* loop)
+{
+    uint64_t one = 1;
+    ssize_t rc;
+
+
+    loop->stop = 1;
+
+    /* EAGAIN only means the counter is full, which wakes the loop anyway */
+    do
+    {
+        rc = write(loop->evfd, &one, sizeof(one));
+    } while ( (rc < 0) && (errno == EINTR) );
+
+    return;
+}
+
+int vc_job_complete(struct vc_job* job, ETalpaProtocolResponse response)
+{
+    struct vc_loop* loop = job->loop;
+    uint64_t one = 1;
+
+
+    loop->response = response;
+    __sync_synchronize();
+    loop->completed = 1;
+
+    if ( write(loop->evfd, &one, sizeof(one)) < 0 )
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Reads one job with a single read(2) into the preallocated buffer.
+ * Returns 1 if a job was read, 0 if none was waiting and -1 on error.
+ */
+static int readJob(struct vc_loop* loop)
+{
+    struct vc_job* job = &loop->job;
+    char scratch[4096];
+    unsigned int total;
+    ssize_t rc;
+
+
+    do
+    {
+        rc = read(loop->handle, job->packet, loop->bufsize);
+    } while ( (rc < 0) && (errno == EINTR) );
+
+    if ( rc < 0 )
+    {
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+    }
+
+    if ( (size_t)rc < sizeof(struct TalpaPacket_VettingDetails) )
+    {
+        errno = EPROTO;
+        return -1;
+    }
+
+    job->length = rc;
+    job->truncated = 0;
+    total = sizeof(struct TalpaProtocolHeader) + job->packet->header.payloadLength;
+
+    /* The kernel will not hand out another job until this one has been
+       read in full, so drain whatever did not fit. */
+    while ( total > job->length )
+    {
+        rc = read(loop->handle, scratch, sizeof(scratch));
+        if ( rc <= 0 )
+        {
+            if ( (rc < 0) && (errno == EINTR) )
+            {
+                continue;
+            }
+            return -1;
+        }
+        total -= rc;
+        job->truncated = 1;
+    }
+
+    return 1;
+}
+
+static int respond(struct vc_loop* loop, int response)
+{
+    loop->busy = 0;
+
+    if ( vc_respond(loop->handle, loop->job.packet, (ETalpaProtocolResponse)response) < 0 )
+    {
+        return -1;
+    }
+
+    return 1;
+}
+
+/*
+ * Takes jobs for as long as they are available and answered straight
+ * away, without going back to epoll in between.
+ */
+static int pump(struct vc_loop* loop)
+{
+    int done = 0;
+    int verdict;
+    int rc;
+
+
+    while ( !loop->busy && !loop->stop )
+    {
+        rc = readJob(loop);
+        if ( rc < 0 )
+        {
+            return -1;
+        }
+        else if ( rc == 0 )
+        {
+            if ( !loop->armed && (arm(loop) < 0) )
+            {
+                return -1;
+            }
+            break;
+        }
+
+        verdict = loop->callback(&loop->job, loop->data);
+
+        if ( !vc_job_needs_response(&loop->job) )
+        {
+            done++;
+        }
+        else if ( verdict == VC_JOB_PENDING )
+        {
+            loop->busy = 1;
+        }
+        else if ( respond(loop, verdict) > 0 )
+        {
+            done++;
+        }
+    }
+
+    return done;
+}
+
+int vc_loop_dispatch(struct vc_loop* loop, int ms)
+{
+    struct epoll_event events[2];
+    uint64_t count;
+    ssize_t drained;
+    int done = 0;
+    int rc;
+    int i;
+
+
+    rc = epoll_wait(loop->epfd, events, 2, ms);
+    if ( rc < 0 )
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for ( i = 0; i < rc; i++ )
+    {
+        if ( events[i].data.fd == loop->evfd )
+        {
+            /* Only drains the wakeups, EAGAIN means there were none left */
+            do
+            {
+                drained = read(loop->evfd, &count, sizeof(count));
+            } while ( (drained < 0) && (errno == EINTR) );
+        }
+        else
+        {
+            loop->armed = 0;
+        }
+    }
+
+    if ( loop->completed )
+    {
+        loop->completed = 0;
+        __sync_synchronize();
+        if ( loop->busy && (respond(loop, loop->response) > 0) )
+        {
+            done++;
+        }
+    }
+
+    if ( loop->stop )
+    {
+        return done;
+    }
+
+    rc = pump(loop);
+    if ( rc < 0 )
+    {
+        return -1;
+    }
+
+    return done + rc;
+}
+
+int vc_loop_run(struct vc_loop* loop)
+{
+    while ( !loop->stop )
+    {
+        if ( vc_loop_dispatch(loop, -1) < 0 )
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Worker thread pool, one loop per thread.
+ */
+
+struct vc_worker
+{
+    pthread_t           pt;
+    struct vc_pool*     pool;
+    struct vc_loop*     loop;
+    int                 started;
+};
+
+struct vc_pool
+{
+    unsigned int        group;
+    unsigned int        count;
+    size_t              bufsize;
+    vc_job_callback     callback;
+    void*               data;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    struct vc_worker    workers[0];
+};
+
+static void* worker(void* param)
+{
+    struct vc_worker* w = (struct vc_worker *)param;
+    struct vc_pool* pool = w->pool;
+    struct vc_loop* loop;
+
+
+    loop = vc_loop_new(pool->group, pool->bufsize, pool->callback, pool->data);
+
+    pthread_mutex_lock(&pool->lock);
+    w->loop = loop;
+    w->started = loop ? 1 : -1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    if ( !loop )
+    {
+        return NULL;
+    }
+
+    if ( vc_loop_run(loop) < 0 )
+    {
+        fprintf(stderr, "Vetting loop failed (%d)!\n", errno);
+    }
+
+    vc_loop_delete(loop);
+
+    return NULL;
+}
+
+struct vc_pool* vc_pool_new(unsigned int group, unsigned int threads, size_t bufsize, vc_job_callback callback, void* data)
+{
+    struct vc_pool* pool;
+    unsigned int t;
+    int failed = 0;
+
+
+    pool = (struct vc_pool *)calloc(1, sizeof(struct vc_pool) + threads * sizeof(struct vc_worker));
+    if ( !pool )
+    {
+        return NULL;
+    }
+
+    pool->group = group;
+    pool->bufsize = bufsize;
+    pool->callback = callback;
+    pool->data = data;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for ( t = 0; t < threads; t++ )
+    {
+        pool->workers[t].pool = pool;
+        if ( pthread_create(&pool->workers[t].pt, NULL, worker, &pool->workers[t]) )
+        {
+            failed = 1;
+            break;
+        }
+        pool->count++;
+    }
+
+    /* Wait until every worker has registered, or failed to */
+    pthread_mutex_lock(&pool->lock);
+    for ( t = 0; t < pool->count; t++ )
+    {
+        while ( !pool->workers[t].started )
+        {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        if ( pool->workers[t].started < 0 )
+        {
+            failed = 1;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if ( failed )
+    {
+        vc_pool_delete(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void vc_pool_delete(struct vc_pool* pool)
+{
+    unsigned int t;
+
+
+    if ( !pool )
+    {
+        return;
+    }
+
+    for ( t = 0; t < pool->count; t++ )
+    {
+        if ( pool->workers[t].loop )
+        {
+            vc_loop_stop(pool->workers[t].loop);
+        }
+    }
+
+    for ( t = 0; t < pool->count; t++ )
+    {
+        pthread_join(pool->workers[t].pt, NULL);
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+
+    return;
+}
+
+unsigned int vc_pool_threads(const struct vc_pool* pool)
+{
+    return pool->count;
+}
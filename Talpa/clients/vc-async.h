@@ -0,0 +1,86 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_VCASYNC
+#define H_VCASYNC
+
+/* Asynchronous vetting client "library"
+ *
+ * The kernel lets a vetting handle hold one job at a time and only from
+ * the thread which registered it, so concurrency comes from many handles.
+ * A loop owns one handle and one preallocated job buffer and is driven by
+ * epoll, either from an application's own event loop or from a pool of
+ * worker threads which each run one. Nothing is allocated per job.
+ *
+ * Verdicts are given by returning them from the job callback, or later
+ * from any thread with vc_job_complete() when the callback returns
+ * VC_JOB_PENDING. The loop does not take a new job until the current one
+ * has been completed.
+ */
+
+#include <pthread.h>
+
+#include "vc.h"
+
+#define VC_JOB_PENDING          (-1)
+
+#define VC_JOB_DEFAULT_SIZE     VC_PACKET_SIZE
+
+struct vc_loop;
+
+struct vc_job
+{
+    struct vc_loop*                     loop;
+    int                                 handle;     /* For stream operations from the callback */
+    unsigned int                        length;     /* Bytes of packet in the buffer */
+    unsigned int                        truncated;  /* Packet was bigger than the buffer */
+    struct TalpaPacket_VettingDetails*  packet;
+    void*                               data;       /* Free for the application to use */
+};
+
+/* Called for every job, including notifications which need no response.
+   Returns an ETalpaProtocolResponse or VC_JOB_PENDING. */
+typedef int (*vc_job_callback)(struct vc_job* job, void* data);
+
+/* Must be called from the thread which will dispatch the loop. */
+struct vc_loop* vc_loop_new(unsigned int group, size_t bufsize, vc_job_callback callback, void* data);
+void vc_loop_delete(struct vc_loop* loop);
+
+/* Descriptor to add to the application's epoll set or poll for POLLIN. */
+int vc_loop_fd(const struct vc_loop* loop);
+
+/* Handles whatever is ready, waiting up to ms milliseconds (-1 for ever).
+   Returns the number of jobs completed or -1 on error. */
+int vc_loop_dispatch(struct vc_loop* loop, int ms);
+
+/* Runs until vc_loop_stop() is called. */
+int vc_loop_run(struct vc_loop* loop);
+void vc_loop_stop(struct vc_loop* loop);
+
+/* Safe to call from any thread, once per pending job. */
+int vc_job_complete(struct vc_job* job, ETalpaProtocolResponse response);
+
+struct vc_pool;
+
+struct vc_pool* vc_pool_new(unsigned int group, unsigned int threads, size_t bufsize, vc_job_callback callback, void* data);
+void vc_pool_delete(struct vc_pool* pool);
+unsigned int vc_pool_threads(const struct vc_pool* pool);
+
+#define vc_job_needs_response(job) ((job)->packet->responseReqd)
+
+#endif
@@ -0,0 +1,516 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Mock vetting daemon
+ *
+ * Allows everything after a synthetic service time, as a stand-in for a
+ * real scanner when benchmarking. Every interval it prints the throughput,
+ * the queue depth of each group it serves and the verdict latency, which
+ * is the time from a job being read to its verdict being given.
+ *
+ *  -t<threads>     vetting threads, spread over the groups (default 1)
+ *  -g<groups>      comma separated groups to register to (default 0)
+ *  -s<usecs>       mean service time in microseconds (default 0)
+ *  -d<dist>        service time distribution, const, exp or pareto (default const)
+ *  -a<shape>       pareto shape, above 1 (default 1.5)
+ *  -k<bytes>       read this much of each file through the stream protocol first
+ *  -i<secs>        reporting interval, 0 for a summary only (default 1)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "vc-async.h"
+#include "bench-hist.h"
+
+
+#define MAX_GROUPS      (8)
+
+#define STREAM_CHUNK    (65536)
+
+enum dist
+{
+    D_CONST,
+    D_EXP,
+    D_PARETO
+};
+
+static const char* dist_names[] = { "constant", "exponential", "pareto" };
+
+struct stats
+{
+    unsigned long long  jobs;
+    unsigned long long  streamed;
+    unsigned long long  sum;
+    unsigned long long  max;
+    unsigned long long  hist[HIST_BUCKETS];
+};
+
+struct bench
+{
+    enum dist           dist;
+    double              service;    /* Mean, in microseconds */
+    double              shape;
+    double              scale;      /* Pareto minimum giving the wanted mean */
+    size_t              stream;
+    struct stats        total;      /* Updated by every thread */
+};
+
+int run = 1;
+
+void sigint(int val)
+{
+    (void)val;
+#ifndef NDEBUG
+    printf("Interrupted!\n");
+#endif
+    run = 0;
+}
+
+static unsigned long long percentile(const struct stats* s, double q)
+{
+    return hist_percentile(s->hist, s->jobs, s->max, q);
+}
+
+/* The difference between two snapshots of the running totals */
+static void stats_diff(struct stats* d, const struct stats* now, const struct stats* then)
+{
+    unsigned int b;
+
+
+    d->jobs = now->jobs - then->jobs;
+    d->streamed = now->streamed - then->streamed;
+    d->sum = now->sum - then->sum;
+    d->max = now->max;
+    for ( b = 0; b < HIST_BUCKETS; b++ )
+    {
+        d->hist[b] = now->hist[b] - then->hist[b];
+    }
+}
+
+static void stats_snapshot(struct stats* s, struct stats* total)
+{
+    unsigned int b;
+
+
+    s->jobs = __sync_fetch_and_add(&total->jobs, 0);
+    s->streamed = __sync_fetch_and_add(&total->streamed, 0);
+    s->sum = __sync_fetch_and_add(&total->sum, 0);
+    s->max = __sync_fetch_and_add(&total->max, 0);
+    for ( b = 0; b < HIST_BUCKETS; b++ )
+    {
+        s->hist[b] = __sync_fetch_and_add(&total->hist[b], 0);
+    }
+}
+
+static double service_time(const struct bench* b)
+{
+    static __thread unsigned int seed;
+    double u;
+
+
+    if ( b->dist == D_CONST )
+    {
+        return b->service;
+    }
+
+    if ( !seed )
+    {
+        seed = (unsigned int)pthread_self() ^ (unsigned int)getpid();
+    }
+
+    /* Uniform in (0,1] so the log and the power are finite */
+    u = ((double)rand_r(&seed) + 1.0) / ((double)RAND_MAX + 1.0);
+
+    if ( b->dist == D_EXP )
+    {
+        return -b->service * log(u);
+    }
+
+    return b->scale / pow(u, 1.0 / b->shape);
+}
+
+static void serve(double usecs)
+{
+    struct timespec ts;
+
+
+    if ( usecs < 1.0 )
+    {
+        return;
+    }
+
+    ts.tv_sec = (time_t)(usecs / 1000000.0);
+    ts.tv_nsec = (long)((usecs - ts.tv_sec * 1000000.0) * 1000.0);
+
+    while ( nanosleep(&ts, &ts) < 0 && errno == EINTR )
+    {
+    }
+}
+
+static size_t stream(int handle, size_t want)
+{
+    static __thread char* buf;
+    size_t total = 0;
+    int rc;
+
+
+    if ( !buf )
+    {
+        buf = (char *)malloc(STREAM_CHUNK);
+        if ( !buf )
+        {
+            return 0;
+        }
+    }
+
+    while ( total < want )
+    {
+        rc = vc_stream_read(handle, buf, (want - total) < STREAM_CHUNK ? (want - total) : STREAM_CHUNK);
+        if ( rc <= 0 )
+        {
+            break;
+        }
+        total += rc;
+    }
+
+    return total;
+}
+
+int job(struct vc_job* job, void* data)
+{
+    struct bench* b = (struct bench *)data;
+    unsigned long long start;
+    unsigned long long ns;
+    unsigned long long max;
+    size_t streamed = 0;
+
+
+    if ( !vc_job_needs_response(job) )
+    {
+        return TALPA_ALLOW;
+    }
+
+    start = now_ns();
+
+    if ( b->stream && (job->packet->header.type == TALPA_PKT_FILEDETAIL) )
+    {
+        streamed = stream(job->handle, b->stream);
+    }
+
+    serve(service_time(b));
+
+    ns = now_ns() - start;
+
+    __sync_fetch_and_add(&b->total.jobs, 1);
+    __sync_fetch_and_add(&b->total.streamed, streamed);
+    __sync_fetch_and_add(&b->total.sum, ns);
+    __sync_fetch_and_add(&b->total.hist[hist_bucket(ns)], 1);
+    max = b->total.max;
+    while ( (ns > max) && !__sync_bool_compare_and_swap(&b->total.max, max, ns) )
+    {
+        max = b->total.max;
+    }
+
+    return TALPA_ALLOW;
+}
+
+/*
+ * Queue depths from the VettingController "groups" item, whose second
+ * line has the number of jobs waiting in each group.
+ */
+static int queue_depths(unsigned int* depth)
+{
+    static const char* paths[] =
+    {
+        "/sys/kernel/security/talpa/intercept-filters/VettingController/groups",
+        "/proc/sys/talpa/intercept-filters/VettingController/groups",
+        NULL
+    };
+    char line[256];
+    unsigned int g;
+    int rc = -1;
+    FILE* f = NULL;
+    char* p;
+    char* end;
+    int i;
+
+
+    for ( i = 0; paths[i] && !f; i++ )
+    {
+        f = fopen(paths[i], "r");
+    }
+
+    if ( !f )
+    {
+        return -1;
+    }
+
+    if ( fgets(line, sizeof(line), f) && fgets(line, sizeof(line), f) )
+    {
+        p = line;
+        for ( g = 0; g < MAX_GROUPS; g++ )
+        {
+            depth[g] = strtoul(p, &end, 10);
+            if ( end == p )
+            {
+                break;
+            }
+            p = end;
+        }
+        rc = g;
+    }
+
+    fclose(f);
+
+    return rc;
+}
+
+static void report(const char* label, double secs, const struct stats* s, const unsigned int* groups, unsigned int nr_groups, int queues)
+{
+    unsigned int depth[MAX_GROUPS];
+    unsigned int g;
+    int nr;
+
+
+    printf("%s %8.0f jobs/s", label, secs > 0 ? s->jobs / secs : 0.0);
+    printf(" latency mean %.1fus p50 %.1fus p99 %.1fus p99.9 %.1fus",
+           s->jobs ? s->sum / 1000.0 / s->jobs : 0.0,
+           percentile(s, 0.5) / 1000.0, percentile(s, 0.99) / 1000.0, percentile(s, 0.999) / 1000.0);
+
+    if ( s->streamed )
+    {
+        printf(" streamed %.1fMB/s", secs > 0 ? s->streamed / secs / 1048576.0 : 0.0);
+    }
+
+    if ( queues )
+    {
+        nr = queue_depths(depth);
+        printf(" queue");
+        for ( g = 0; g < nr_groups; g++ )
+        {
+            if ( (int)groups[g] < nr )
+            {
+                printf(" %u:%u", groups[g], depth[groups[g]]);
+            }
+            else
+            {
+                printf(" %u:-", groups[g]);
+            }
+        }
+    }
+
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction intact;
+    sigset_t intset;
+    struct bench b;
+    unsigned int threads = 1;
+    unsigned int groups[MAX_GROUPS] = { 0 };
+    unsigned int nr_groups = 1;
+    unsigned int interval = 1;
+    struct vc_pool* pools[MAX_GROUPS];
+    struct stats then, now, delta;
+    unsigned long long begin, last, t;
+    char label[32];
+    unsigned int registered = 0;
+    unsigned int share;
+    unsigned int g;
+    char *arg;
+    char *end;
+    unsigned int pos = 1;
+
+
+    memset(&b, 0, sizeof(b));
+    b.dist = D_CONST;
+    b.shape = 1.5;
+
+    for ( ; argc > 1 ; pos++, argc-- )
+    {
+        arg = argv[pos];
+        if ( !strncmp(arg, "-t", 2) )
+        {
+            threads = atoi(arg + 2);
+        }
+        else if ( !strncmp(arg, "-g", 2) )
+        {
+            arg += 2;
+            for ( nr_groups = 0; *arg && (nr_groups < MAX_GROUPS); nr_groups++ )
+            {
+                groups[nr_groups] = strtoul(arg, &end, 10);
+                if ( (end == arg) || (groups[nr_groups] >= MAX_GROUPS) )
+                {
+                    fprintf(stderr, "Bad group list %s!\n", argv[pos] + 2);
+                    return 1;
+                }
+                arg = (*end == ',') ? end + 1 : end;
+            }
+        }
+        else if ( !strncmp(arg, "-s", 2) )
+        {
+            b.service = atof(arg + 2);
+        }
+        else if ( !strncmp(arg, "-a", 2) )
+        {
+            b.shape = atof(arg + 2);
+        }
+        else if ( !strncmp(arg, "-k", 2) )
+        {
+            b.stream = strtoul(arg + 2, NULL, 10);
+        }
+        else if ( !strncmp(arg, "-i", 2) )
+        {
+            interval = atoi(arg + 2);
+        }
+        else if ( !strncmp(arg, "-d", 2) )
+        {
+            arg += 2;
+            if ( !strcmp(arg, "const") )
+            {
+                b.dist = D_CONST;
+            }
+            else if ( !strcmp(arg, "exp") )
+            {
+                b.dist = D_EXP;
+            }
+            else if ( !strcmp(arg, "pareto") )
+            {
+                b.dist = D_PARETO;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown distribution %s!\n", arg);
+                return 1;
+            }
+        }
+    }
+
+    if ( !nr_groups || !threads )
+    {
+        fprintf(stderr, "Nothing to do!\n");
+        return 1;
+    }
+
+    if ( b.shape <= 1.0 )
+    {
+        fprintf(stderr, "Pareto shape must be above 1 for the mean to exist!\n");
+        return 1;
+    }
+    b.scale = b.service * (b.shape - 1.0) / b.shape;
+
+    sigemptyset(&intset);
+    sigaddset(&intset, SIGINT);
+    intact.sa_handler = sigint;
+    intact.sa_mask = intset;
+    intact.sa_flags = 0;
+    sigaction(SIGINT, &intact, NULL);
+
+    /* Workers inherit the mask, so only the main thread sees SIGINT */
+    pthread_sigmask(SIG_BLOCK, &intset, NULL);
+    memset(pools, 0, sizeof(pools));
+    for ( g = 0; g < nr_groups; g++ )
+    {
+        share = threads / nr_groups + (g < threads % nr_groups ? 1 : 0);
+        if ( !share )
+        {
+            continue;
+        }
+        pools[g] = vc_pool_new(groups[g], share, 0, job, &b);
+        if ( !pools[g] )
+        {
+            break;
+        }
+        registered += vc_pool_threads(pools[g]);
+    }
+    pthread_sigmask(SIG_UNBLOCK, &intset, NULL);
+
+    if ( g < nr_groups )
+    {
+        fprintf(stderr, "Failed to initialize group %u!\n", groups[g]);
+        while ( g-- )
+        {
+            vc_pool_delete(pools[g]);
+        }
+        return 1;
+    }
+
+    printf("Registered %u threads to %u group%s, service time %.1fus %s",
+           registered, nr_groups, nr_groups > 1 ? "s" : "", b.service, dist_names[b.dist]);
+    if ( b.dist == D_PARETO )
+    {
+        printf(" shape %.2f", b.shape);
+    }
+    if ( b.stream )
+    {
+        printf(", streaming %lu bytes", (unsigned long)b.stream);
+    }
+    printf(".\n");
+    fflush(stdout);
+
+    memset(&then, 0, sizeof(then));
+    begin = last = now_ns();
+
+    while ( run )
+    {
+        if ( interval )
+        {
+            sleep(interval);
+            if ( !run )
+            {
+                break;
+            }
+            t = now_ns();
+            stats_snapshot(&now, &b.total);
+            stats_diff(&delta, &now, &then);
+            snprintf(label, sizeof(label), "%7.1fs", (t - begin) / 1e9);
+            report(label, (t - last) / 1e9, &delta, groups, nr_groups, 1);
+            then = now;
+            last = t;
+        }
+        else
+        {
+            pause();
+        }
+    }
+
+    for ( g = 0; g < nr_groups; g++ )
+    {
+        vc_pool_delete(pools[g]);
+    }
+
+    t = now_ns();
+    stats_snapshot(&now, &b.total);
+    printf("Jobs: %llu\n", now.jobs);
+    report("Total:", (t - begin) / 1e9, &now, groups, nr_groups, 0);
+
+    return 0;
+}
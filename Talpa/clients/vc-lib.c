@@ -88,41 +88,63 @@ int vc_exit(int handle)
     return close(handle);
 }
 
-struct TalpaPacket_VettingDetails* vc_get(int handle)
+/*
+ * The device hands over a whole job when the buffer is big enough for it,
+ * so only oversized jobs need a second read for the remainder.
+ */
+static struct TalpaPacket_VettingDetails* vc_read(int handle)
 {
-    struct TalpaProtocolHeader head;
     struct TalpaPacket_VettingDetails *packet;
-    int rc;
+    struct TalpaPacket_VettingDetails *grown;
+    unsigned int total;
+    ssize_t rc;
 
-    rc = read(handle, &head, sizeof(head));
-    if ( rc < 0 )
-    {
-        return NULL;
-    }
-
-    packet = (struct TalpaPacket_VettingDetails *)malloc(sizeof(head) + head.payloadLength);
+    packet = (struct TalpaPacket_VettingDetails *)malloc(VC_PACKET_SIZE);
 
     if ( !packet )
     {
         return NULL;
     }
 
-    rc = read(handle, ((char *)packet) + sizeof(head), head.payloadLength);
+    rc = read(handle, packet, VC_PACKET_SIZE);
 
-    if ( rc < 0 )
+    if ( rc < (ssize_t)sizeof(struct TalpaProtocolHeader) )
     {
         free(packet);
         return NULL;
     }
 
-    memcpy(packet, &head, sizeof(head));
+    total = sizeof(struct TalpaProtocolHeader) + packet->header.payloadLength;
+
+    if ( total > rc )
+    {
+        grown = (struct TalpaPacket_VettingDetails *)realloc(packet, total);
+
+        if ( !grown )
+        {
+            free(packet);
+            return NULL;
+        }
+
+        packet = grown;
+
+        if ( read(handle, ((char *)packet) + rc, total - rc) != (ssize_t)(total - rc) )
+        {
+            free(packet);
+            return NULL;
+        }
+    }
 
     return packet;
 }
 
+struct TalpaPacket_VettingDetails* vc_get(int handle)
+{
+    return vc_read(handle);
+}
+
 struct TalpaPacket_VettingDetails* vc_poll(int handle, unsigned int ms)
 {
-    struct TalpaProtocolHeader head;
     struct TalpaPacket_VettingDetails *packet = NULL;
     int rc;
     struct pollfd pfd;
@@ -143,29 +165,7 @@ struct TalpaPacket_VettingDetails* vc_poll(int handle, unsigned int ms)
         goto out;
     }
 
-    rc = read(handle, &head, sizeof(head));
-    if ( rc < 0 )
-    {
-        goto out;
-    }
-
-    packet = (struct TalpaPacket_VettingDetails *)malloc(sizeof(head) + head.payloadLength);
-
-    if ( !packet )
-    {
-        goto out;
-    }
-
-    rc = read(handle, ((char *)packet) + sizeof(head), head.payloadLength);
-
-    if ( rc < 0 )
-    {
-        free(packet);
-        packet = NULL;
-        goto out;
-    }
-
-    memcpy(packet, &head, sizeof(head));
+    packet = vc_read(handle);
 
     out:
     fcntl(handle, F_SETFL, oldflags);
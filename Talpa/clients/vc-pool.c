@@ -0,0 +1,111 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "vc-async.h"
+
+
+int run = 1;
+unsigned long scanned;
+unsigned long truncated;
+
+void sigint(int val)
+{
+#ifndef NDEBUG
+    printf("Interrupted!\n");
+#endif
+    run = 0;
+}
+
+int allow(struct vc_job* job, void* data)
+{
+    if ( job->truncated )
+    {
+        __sync_fetch_and_add(&truncated, 1);
+    }
+
+    if ( vc_job_needs_response(job) )
+    {
+        __sync_fetch_and_add(&scanned, 1);
+    }
+
+    return TALPA_ALLOW;
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction intact;
+    sigset_t intset;
+    unsigned int threads = 4;
+    unsigned int group = 0;
+    struct vc_pool* pool;
+
+
+    if ( argc >= 2 )
+    {
+        threads = atoi(argv[1]);
+    }
+
+    if ( argc >= 3 )
+    {
+        group = atoi(argv[2]);
+    }
+
+    sigemptyset(&intset);
+    sigaddset(&intset, SIGINT);
+    intact.sa_handler = sigint;
+    intact.sa_mask = intset;
+    intact.sa_flags = 0;
+    sigaction(SIGINT, &intact, NULL);
+
+    /* Workers inherit the mask, so only the main thread sees SIGINT */
+    pthread_sigmask(SIG_BLOCK, &intset, NULL);
+    pool = vc_pool_new(group, threads, 0, allow, NULL);
+    pthread_sigmask(SIG_UNBLOCK, &intset, NULL);
+
+    if ( !pool )
+    {
+        fprintf(stderr, "Failed to initialize!\n");
+        return -1;
+    }
+
+    printf("Registered %u threads to group %u.\n\n", vc_pool_threads(pool), group);
+    printf("Files scanned: 1234567890");
+
+    while ( run )
+    {
+        printf("\b\b\b\b\b\b\b\b\b\b%10lu", scanned);
+        fflush(stdout);
+        sleep(1);
+    }
+
+    vc_pool_delete(pool);
+
+    printf("\nFiles scanned: %lu, truncated: %lu\n", scanned, truncated);
+
+    return 0;
+}
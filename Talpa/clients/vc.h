@@ -21,8 +21,14 @@
 
 /* Vetting client "library" */
 
+#include <limits.h>
+
 #include "../include/talpa-vettingclient.h"
 
+/* Enough for the fixed part of the details, a file name and a root directory,
+   so that most jobs are read with a single read(2). */
+#define VC_PACKET_SIZE  (4096 + 2 * PATH_MAX)
+
 int vc_init(unsigned int group, unsigned int timeout_ms);
 int vc_exit(int handle);
 struct TalpaPacket_VettingDetails* vc_get(int handle);
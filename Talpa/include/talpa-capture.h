@@ -0,0 +1,93 @@
+/*
+ * talpa-capture.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#ifndef H_TALPACAPTURE
+#define H_TALPACAPTURE
+
+#ifndef __KERNEL__
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Intercept capture records.
+ *
+ * While capture is enabled every cache operation done on behalf of an
+ * intercept is recorded, and the records are read back in whole from
+ * /dev/talpa-capture. Each CPU has its own ring so records from different
+ * CPUs are not ordered with respect to each other; sort on the timestamp.
+ */
+
+#define TALPA_CAPTURE_DEVICE    "/dev/talpa-capture"
+
+typedef enum
+{
+    TALPA_CAPTURE_HIT = 1,      /* Lookup found the inode */
+    TALPA_CAPTURE_MISS,         /* Lookup did not find the inode */
+    TALPA_CAPTURE_ADD,          /* Vetted and allowed, now cached */
+    TALPA_CAPTURE_CLEAR,        /* Opened for writing or denied */
+    TALPA_CAPTURE_PURGE         /* Filesystem unmounted, inode is zero */
+} ETalpaCaptureEvent;
+
+struct TalpaCaptureRecord
+{
+    uint64_t    timestamp;      /* Nanoseconds, monotonic */
+    uint32_t    device;
+    uint32_t    inode;
+    uint32_t    pid;
+    uint32_t    flags;          /* Open flags where known */
+    uint32_t    pathHash;       /* FNV-1a of the path, zero if not resolved yet */
+    uint8_t     operation;      /* 1 open, 2 close, 3 exec, 5 umount */
+    uint8_t     event;          /* ETalpaCaptureEvent */
+    uint16_t    reserved;
+} __attribute__ ((packed));
+
+/*
+ * FNV-1a, the same as used for the filesystem exclusion path sets.
+ */
+static inline uint32_t talpa_capture_hash(const char* path)
+{
+    uint32_t hash = 2166136261U;
+
+
+    if ( !path )
+    {
+        return 0;
+    }
+
+    while ( *path )
+    {
+        hash = (hash ^ (unsigned char)*path++) * 16777619U;
+    }
+
+    return hash;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+ * End of talpa-capture.h
+ */
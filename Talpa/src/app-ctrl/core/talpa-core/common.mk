@@ -12,6 +12,7 @@ talpaCoreSOURCES    =  src/app-ctrl/core/talpa-core/talpa_core_module.c \
                        src/components/core/intercept_filters_impl/proc_excl/process_exclusion.c \
                        src/components/core/intercept_filters_impl/degraded_mode/degraded_mode.c \
                        src/components/core/cache_impl/cache.c \
+                       src/components/core/path_set_impl/path_set.c \
                        src/components/core/intercept_filters_impl/cache/cache_eval.c \
                        src/components/core/intercept_filters_impl/cache/cache_allow.c \
                        src/components/core/intercept_filters_impl/cache/cache_deny.c
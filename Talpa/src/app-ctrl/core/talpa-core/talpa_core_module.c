@@ -57,6 +57,7 @@
 static IInterceptProcessor* interceptProcessor(void);
 static IVettingServer*      vettingServer(void);
 static IProcessExcluder*    processExcluder(void);
+static ICache*              cache(void);
 
 #ifdef TALPA_ID
 const char talpa_id[] = "$TALPA_ID:" TALPA_ID;
@@ -93,7 +94,8 @@ static ICoreApplicationControl GL_talpa_core =
     {
         interceptProcessor,
         vettingServer,
-        processExcluder
+        processExcluder,
+        cache
     };
 
 const ICoreApplicationControl* TALPA_Core(void)
@@ -116,6 +118,11 @@ static IProcessExcluder* processExcluder(void)
     return &mProcExcl->i_IProcessExcluder;
 }
 
+static ICache* cache(void)
+{
+    return &mCache->i_ICache;
+}
+
 static void deleteGlobals(void)
 {
     if ( mDegrMode )
@@ -2,6 +2,13 @@
 talpaLinuxSOURCES    =  src/app-ctrl/core/talpa-linux/talpa_linux_module.c \
                         src/platforms/linux/glue.c \
                         src/platforms/linux/vfs_mount.c \
+                        src/platforms/linux/fstype.c \
+                        src/platforms/linux/latency.c \
+                        src/platforms/linux/capture.c \
+                        src/platforms/linux/lock_stats.c \
+                        src/platforms/linux/verdict.c \
+                        src/platforms/linux/baseline.c \
+                        src/platforms/linux/trace.c \
                         src/components/services/linux_filesystem_impl/linux_systemroot.c \
                         src/components/services/linux_filesystem_impl/linux_filesystem_factoryimpl.c \
                         src/components/services/linux_filesystem_impl/linux_file.c \
@@ -47,6 +47,13 @@
 #include "components/services/linux_processandthread_impl/linux_processandthread_factoryimpl.h"
 
 #include "app_ctrl/iportability_app_ctrl.h"
+#include "platform/fstype.h"
+#include "platform/latency.h"
+#include "platform/capture.h"
+#include "platform/locking.h"
+#include "platform/verdict.h"
+#include "platform/baseline.h"
+#include "platform/trace.h"
 
 /*
  * Forward declarations.
@@ -147,6 +154,9 @@ static int __init talpa_linux_init(void)
         return -ENOMEM;
     }
 
+    /* Capture is only for diagnostics, carry on without it */
+    talpa_capture_init();
+
     /*
      * Register for intermodule communication on 2.4 kernels.
      */
@@ -168,6 +178,7 @@ static void __exit talpa_linux_exit(void)
     inter_module_unregister("TALPA_Portability");
 #endif
 
+    talpa_capture_exit();
     mSystemRoot->delete(mSystemRoot);
     mConfig->delete(mConfig);
 
@@ -199,8 +210,67 @@ MODULE_PARM_DESC(noprocfs, "Do not register procfs configurator");
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
 EXPORT_SYMBOL(TALPA_Portability);
+EXPORT_SYMBOL(talpa_fstype_intern);
+EXPORT_SYMBOL(talpa_fstype_find);
+EXPORT_SYMBOL(talpa_fstype_id);
+EXPORT_SYMBOL(talpa_fstype_name);
+EXPORT_SYMBOL(talpa_latency_enabled);
+EXPORT_SYMBOL(talpa_latency_record);
+EXPORT_SYMBOL(talpa_latency_read);
+EXPORT_SYMBOL(talpa_latency_reset);
+EXPORT_SYMBOL(talpa_latency_enable);
+EXPORT_SYMBOL(talpa_capture_enabled);
+EXPORT_SYMBOL(talpa_capture_add);
+EXPORT_SYMBOL(talpa_capture_enable);
+EXPORT_SYMBOL(talpa_capture_lost);
+EXPORT_SYMBOL(talpa_verdict_generation);
+EXPORT_SYMBOL(talpa_baseline_record);
+EXPORT_SYMBOL(talpa_baseline_unchanged);
+  #ifdef TALPA_LOCK_STATS
+EXPORT_SYMBOL(talpa_lock_stats_create);
+EXPORT_SYMBOL(talpa_lock_stats_delete);
+EXPORT_SYMBOL(talpa_lock_stats_format);
+EXPORT_SYMBOL(talpa_lock_stats_reset);
+  #endif
+  #ifdef TALPA_HAS_TRACEPOINTS
+EXPORT_TRACEPOINT_SYMBOL(talpa_intercept_enter);
+EXPORT_TRACEPOINT_SYMBOL(talpa_intercept_exit);
+EXPORT_TRACEPOINT_SYMBOL(talpa_cache_hit);
+EXPORT_TRACEPOINT_SYMBOL(talpa_cache_miss);
+EXPORT_TRACEPOINT_SYMBOL(talpa_cache_add);
+EXPORT_TRACEPOINT_SYMBOL(talpa_cache_clear);
+EXPORT_TRACEPOINT_SYMBOL(talpa_cache_purge);
+EXPORT_TRACEPOINT_SYMBOL(talpa_filter_inode);
+EXPORT_TRACEPOINT_SYMBOL(talpa_filter_file);
+EXPORT_TRACEPOINT_SYMBOL(talpa_vetting_enqueue);
+EXPORT_TRACEPOINT_SYMBOL(talpa_vetting_dequeue);
+EXPORT_TRACEPOINT_SYMBOL(talpa_vetting_timeout);
+EXPORT_TRACEPOINT_SYMBOL(talpa_vetting_response);
+  #endif
 #else
 EXPORT_SYMBOL_NOVERS(TALPA_Portability);
+EXPORT_SYMBOL_NOVERS(talpa_fstype_intern);
+EXPORT_SYMBOL_NOVERS(talpa_fstype_find);
+EXPORT_SYMBOL_NOVERS(talpa_fstype_id);
+EXPORT_SYMBOL_NOVERS(talpa_fstype_name);
+EXPORT_SYMBOL_NOVERS(talpa_latency_enabled);
+EXPORT_SYMBOL_NOVERS(talpa_latency_record);
+EXPORT_SYMBOL_NOVERS(talpa_latency_read);
+EXPORT_SYMBOL_NOVERS(talpa_latency_reset);
+EXPORT_SYMBOL_NOVERS(talpa_latency_enable);
+EXPORT_SYMBOL_NOVERS(talpa_capture_enabled);
+EXPORT_SYMBOL_NOVERS(talpa_capture_add);
+EXPORT_SYMBOL_NOVERS(talpa_capture_enable);
+EXPORT_SYMBOL_NOVERS(talpa_capture_lost);
+EXPORT_SYMBOL_NOVERS(talpa_verdict_generation);
+EXPORT_SYMBOL_NOVERS(talpa_baseline_record);
+EXPORT_SYMBOL_NOVERS(talpa_baseline_unchanged);
+  #ifdef TALPA_LOCK_STATS
+EXPORT_SYMBOL_NOVERS(talpa_lock_stats_create);
+EXPORT_SYMBOL_NOVERS(talpa_lock_stats_delete);
+EXPORT_SYMBOL_NOVERS(talpa_lock_stats_format);
+EXPORT_SYMBOL_NOVERS(talpa_lock_stats_reset);
+  #endif
 #endif
 
 module_init(talpa_linux_init);
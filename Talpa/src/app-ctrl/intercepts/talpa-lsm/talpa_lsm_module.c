@@ -69,6 +69,11 @@ static int __init talpa_lsm_init(void)
     }
     mIntercept->i_IInterceptor.addInterceptProcessor(mIntercept, target);
 
+    /*
+     * The cache is consulted directly when stamping executables.
+     */
+    mIntercept->setCache(mIntercept, TALPA_Core()->cache());
+
     /*
      * Expose the Interceptor's configuration.
      */
@@ -80,6 +80,11 @@ static int __init talpa_vfshook_init(void)
         return ret;
     }
 
+    /*
+     * The cache is cleared directly for files copied up by their open.
+     */
+    mIntercept->setCache(mIntercept, TALPA_Core()->cache());
+
     mIntercept->i_IInterceptor.addInterceptProcessor(mIntercept, target);
 
     dbg("Ready");
@@ -25,6 +25,8 @@
 #include "cache.h"
 
 #include "platform/alloc.h"
+#include "platform/trace.h"
+#include "platform/verdict.h"
 
 #define TALPA_CACHE_UNLOCKED(lockname)     TALPA_RW_UNLOCKED(lockname)
 #define talpa_cache_lock_init    talpa_rw_init
@@ -37,7 +39,7 @@
  * Forward declare implementation methods.
  */
 static int find(const void* self, const uint32_t keyH, const uint32_t keyL);
-static void add(void *self, const char* class, const uint32_t keyH, const uint32_t keyL);
+static bool add(void *self, unsigned int fstype, const char* fsname, const uint32_t keyH, const uint32_t keyL);
 static void clear(void *self, const uint32_t keyH, const uint32_t keyL);
 static void purge(void *self, const uint32_t keyH);
 
@@ -56,8 +58,8 @@ static CacheConfigObject* findObject(const void* self, talpa_list_head* list, co
 static void freeObject(CacheConfigObject* obj);
 static void deleteObject(void *self, CacheConfigObject* obj);
 
-static int allocateCache(void* self, unsigned int entries);
-static void freeCache(void* self);
+static void dropDevices(void* self);
+static int calculateCacheParams(unsigned int* entries, unsigned int* hash, unsigned int* setsize);
 
 
 /*
@@ -101,8 +103,9 @@ static Cache template_Cache =
         deleteCache,
         false,
         TALPA_CACHE_UNLOCKED(talpa_cache_lock),
+        { },
+        0,
         0,
-        NULL,
         2,
         24989,
         12491,
@@ -114,6 +117,7 @@ static Cache template_Cache =
         TALPA_MUTEX_INIT,
         { },
         NULL,
+        { { 0 } },
         {
             {NULL, NULL, CACHE_CFGDATASIZE, true, true },
             {NULL, NULL, CACHE_STATDATASIZE, false, true },
@@ -155,22 +159,17 @@ Cache* newCache(void)
         object->mConfig[3].name  = object->mParamsConfigData.name;
         object->mConfig[3].value = object->mParamsConfigData.value;
 
-        if ( !allocateCache(object, object->mEntries) )
-        {
-            talpa_free(object);
-            return NULL;
-        }
-
-        for ( i = 0; i < object->mEntries; i++ )
+        for ( i = 0; i < CACHE_DEVICE_BUCKETS; i++ )
         {
-            object->mCache[i].device = -1;
-            object->mCache[i].inode = 0;
+            TALPA_INIT_LIST_HEAD(&object->mDevices[i]);
         }
 
         sprintf(object->mParamsConfigData.value, "%u,%u,%u", object->mEntries, object->mPrime, object->mSetSize);
 
         talpa_cache_lock_init(&object->mCacheLock);
+        talpa_lock_stats_name(&object->mCacheLock, "cache");
         talpa_rcu_lock_init(&object->mConfigLock);
+        talpa_lock_stats_name(&object->mConfigLock, "cache-config");
         talpa_mutex_init(&object->mConfigSerialize);
         TALPA_INIT_LIST_HEAD(&object->mFilesystems);
 
@@ -178,49 +177,133 @@ Cache* newCache(void)
     return object;
 }
 
-static int allocateCache(void* self, unsigned int entries)
+static uint32_t* allocateTable(unsigned int entries)
 {
     unsigned int size;
-    void* cache;
+    uint32_t* table;
 
-    size = entries * sizeof(struct CacheEntry);
+    size = entries * sizeof(uint32_t);
 
     if ( size > (128*1024) )
     {
-        cache = talpa_large_alloc(size);
-        dbg("Vallocation of %u bytes returned 0x%p", size, cache);
+        table = talpa_large_alloc(size);
+        dbg("Vallocation of %u bytes returned 0x%p", size, table);
     }
     else
     {
-        cache = talpa_alloc(size);
-        dbg("Kallocation of %u bytes returned 0x%p", size, cache);
+        table = talpa_alloc(size);
+        dbg("Kallocation of %u bytes returned 0x%p", size, table);
     }
 
-    if ( !cache )
+    if ( !table )
     {
-        size = 0;
         err("Cache allocation failed!");
+        return NULL;
     }
 
-    this->mCacheBytes = size;
-    this->mCache = (struct CacheEntry *)cache;
+    memset(table, 0, size);
 
-    return size;
+    return table;
 }
 
-static void freeCache(void* self)
+static void freeTable(uint32_t* table, unsigned int entries)
 {
-    if ( this->mCacheBytes > (128*1024) )
+    if ( entries * sizeof(uint32_t) > (128*1024) )
     {
-        talpa_large_free(this->mCache);
+        talpa_large_free(table);
     }
     else
     {
-        talpa_free(this->mCache);
+        talpa_free(table);
+    }
+
+    return;
+}
+
+static struct CacheDevice* newDevice(const uint32_t device, unsigned int entries, unsigned int prime)
+{
+    struct CacheDevice* dev;
+
+
+    dev = talpa_alloc(sizeof(struct CacheDevice));
+    if ( !dev )
+    {
+        return NULL;
+    }
+
+    dev->inodes = allocateTable(entries);
+    if ( !dev->inodes )
+    {
+        talpa_free(dev);
+        return NULL;
+    }
+
+    dev->device = device;
+    dev->entries = entries;
+    dev->prime = prime;
+    dev->fill = dev->replacement = dev->evictions = 0;
+    dev->zero = false;
+
+    return dev;
+}
+
+static void freeDevice(struct CacheDevice* dev)
+{
+    freeTable(dev->inodes, dev->entries);
+    talpa_free(dev);
+
+    return;
+}
+
+static inline talpa_list_head* deviceBucket(const void* self, const uint32_t device)
+{
+    return (talpa_list_head *)&this->mDevices[(device * 2654435761U) >> (32 - CACHE_DEVICE_BITS)];
+}
+
+/* Called with the cache lock held. */
+static struct CacheDevice* findDevice(const void* self, const uint32_t device)
+{
+    struct CacheDevice* dev;
+
+    talpa_list_for_each_entry(dev, deviceBucket(this, device), head)
+    {
+        if ( dev->device == device )
+        {
+            return dev;
+        }
     }
 
-    this->mCache = NULL;
-    this->mCacheBytes = 0;
+    return NULL;
+}
+
+/* Takes every table out of the cache and frees them. */
+static void dropDevices(void* self)
+{
+    talpa_list_head dropped;
+    struct CacheDevice *dev, *tmp;
+    unsigned int i;
+
+
+    TALPA_INIT_LIST_HEAD(&dropped);
+
+    talpa_cache_write_lock(&this->mCacheLock);
+    for ( i = 0; i < CACHE_DEVICE_BUCKETS; i++ )
+    {
+        talpa_list_for_each_entry_safe(dev, tmp, &this->mDevices[i], head)
+        {
+            talpa_list_move(&dev->head, &dropped);
+        }
+    }
+    this->mDeviceCount = this->mAllocated = this->mFill = 0;
+    talpa_cache_write_unlock(&this->mCacheLock);
+
+    talpa_verdict_invalidate();
+
+    talpa_list_for_each_entry_safe(dev, tmp, &dropped, head)
+    {
+        talpa_list_del(&dev->head);
+        freeDevice(dev);
+    }
 
     return;
 }
@@ -240,7 +323,9 @@ static void deleteCache(struct tag_Cache* object)
     talpa_free(object->mFilesystemsSet);
     talpa_rcu_write_unlock(&object->mConfigLock);
 
-    freeCache(object);
+    dropDevices(object);
+    talpa_lock_stats_release(&object->mCacheLock);
+    talpa_lock_stats_release(&object->mConfigLock);
     talpa_free(object);
 
     return;
@@ -250,19 +335,27 @@ static void deleteCache(struct tag_Cache* object)
  * IInterceptFilter.
  */
 
-/* Returns 1 if the filesystem is on the list */
-static inline int checkFilesystem(const void* self, const char* fstype)
+/*
+ * Returns 1 if the filesystem is on the list. Types which could not be
+ * registered can not be in the bitmap either and are matched by name.
+ */
+static inline int checkFilesystem(const void* self, unsigned int fstype, const char* fsname)
 {
-    if ( likely(fstype != NULL) )
+    if ( likely(fstype != TALPA_FSTYPE_NONE) )
+    {
+        return talpa_fstype_set_test(&this->mFilesystemIds, fstype);
+    }
+
+    if ( likely(fsname != NULL) )
     {
         CacheConfigObject *obj;
         unsigned int len;
 
-        len = strlen(fstype);
+        len = strlen(fsname);
         talpa_rcu_read_lock(&this->mConfigLock);
         talpa_list_for_each_entry_rcu(obj, &this->mFilesystems, head)
         {
-            if ( (len == obj->len) && !strcmp(fstype, obj->string) )
+            if ( (len == obj->len) && !strcmp(fsname, obj->string) )
             {
                 talpa_rcu_read_unlock(&this->mConfigLock);
                 return 1;
@@ -274,46 +367,71 @@ static inline int checkFilesystem(const void* self, const char* fstype)
     return 0;
 }
 
+/*
+ * Within a device only the inode is hashed; the probe sequence otherwise
+ * works as for the shared table described in cache.h.
+ */
+static inline unsigned int deviceFirst(const struct CacheDevice* dev, const uint32_t keyL)
+{
+    return keyL % dev->entries;
+}
+
+static inline unsigned int deviceStride(const struct CacheDevice* dev, const uint32_t keyL)
+{
+    return keyL % dev->prime + 1;
+}
+
 static int find(const void* self, const uint32_t keyH, const uint32_t keyL)
 {
     /* See if we have a entry in the cache? */
 
-    int entries;
-    int set;
-    int prime;
-    int pass;
-    int first;
-    int modulo;
-    int index;
-    struct CacheEntry* cache;
+    struct CacheDevice* dev;
+    bool found = false;
+    unsigned int set;
+    unsigned int pass;
+    unsigned int index;
+    unsigned int modulo;
 
     talpa_cache_read_lock(&this->mCacheLock);
 
-    entries = this->mEntries;
-    set = this->mSetSize;
-    prime = this->mPrime;
-    cache = this->mCache;
-
-    first = (( keyH % entries ) * ( keyL % entries )) % entries;
-    pass = 0;
-    modulo = (( keyH % prime ) * ( keyL % prime )) % prime + 1;
-    index = first;
+    dev = findDevice(this, keyH);
 
-    while ( pass < set )
+    if ( unlikely(dev == NULL) )
     {
-        if ( (cache[index].device == keyH) && (cache[index].inode == keyL) )
+        /* Nothing cached for this device */
+    }
+    else if ( unlikely(keyL == 0) )
+    {
+        found = dev->zero;
+    }
+    else
+    {
+        set = this->mSetSize;
+        index = deviceFirst(dev, keyL);
+        modulo = deviceStride(dev, keyL);
+
+        for ( pass = 0; pass < set; pass++ )
         {
-            /* We have a hit! */
-            this->mHits++;
-            if ( !this->mHits )
+            if ( dev->inodes[index] == keyL )
             {
-                this->mMisses = 0;
+                found = true;
+                break;
             }
-            talpa_cache_read_unlock(&this->mCacheLock);
-            return 1;
+            index = ( index + modulo ) % dev->entries;
         }
-        index = ( index + modulo ) % entries;
-        pass++;
+    }
+
+    if ( found )
+    {
+        /* We have a hit! */
+        this->mHits++;
+        if ( !this->mHits )
+        {
+            this->mMisses = 0;
+        }
+        talpa_cache_read_unlock(&this->mCacheLock);
+        trace_talpa_cache_hit(keyH, keyL);
+        return 1;
     }
 
     /* Since we didn't find the file in the cache, let
@@ -326,50 +444,48 @@ static int find(const void* self, const uint32_t keyH, const uint32_t keyL)
 
     talpa_cache_read_unlock(&this->mCacheLock);
 
+    trace_talpa_cache_miss(keyH, keyL);
+
     return 0;
 }
 
-static void add(void *self, const char* class, const uint32_t keyH, const uint32_t keyL)
+/* Called with the cache lock held for writing. Returns true if something
+   had to be replaced to make room. */
+static bool insert(void* self, struct CacheDevice* dev, const uint32_t keyL)
 {
-    int entries;
-    int set;
-    int prime;
-    int pass;
-    int first;
-    int modulo;
-    int index;
-    struct CacheEntry* cache;
-
-    /* Check whether we should try to cache this fs */
-    if ( !checkFilesystem(this, class) )
+    unsigned int set;
+    unsigned int pass;
+    unsigned int first;
+    unsigned int index;
+    unsigned int modulo;
+
+    /* Zero marks a free slot so it is kept aside */
+    if ( unlikely(keyL == 0) )
     {
-        return;
+        if ( !dev->zero )
+        {
+            dev->zero = true;
+            dev->fill++;
+            this->mFill++;
+        }
+        return false;
     }
 
-    talpa_cache_write_lock(&this->mCacheLock);
-
-    entries = this->mEntries;
     set = this->mSetSize;
-    prime = this->mPrime;
-    cache = this->mCache;
-
-    first = (( keyH % entries ) * ( keyL % entries )) % entries;
-    modulo = (( keyH % prime ) * ( keyL % prime )) % prime + 1;
-
-    pass = 0;
+    first = deviceFirst(dev, keyL);
+    modulo = deviceStride(dev, keyL);
     index = first;
 
-    while ( pass < set )
+    for ( pass = 0; pass < set; pass++ )
     {
-        if ( (cache[index].device == -1) && (cache[index].inode == 0) )
+        if ( dev->inodes[index] == 0 )
         {
-            cache[index].device = keyH;
-            cache[index].inode = keyL;
+            dev->inodes[index] = keyL;
+            dev->fill++;
             this->mFill++;
-            talpa_cache_write_unlock(&this->mCacheLock);
-            return;
+            return false;
         }
-        else if ( (cache[index].device == keyH) && (cache[index].inode == keyL) )
+        else if ( dev->inodes[index] == keyL )
         {
             /* Multiple concurrent scan can happen and they will be serialised
                by the cache lock. Therefore adding the same entry for the second
@@ -377,96 +493,321 @@ static void add(void *self, const char* class, const uint32_t keyH, const uint32
                except it's not the most optimal scenario. But it would be even
                worse for performance to introduce something smarter for that
                exceptional event. */
-            talpa_cache_write_unlock(&this->mCacheLock);
             dbg("Duplicate add attempted!");
-            return;
+            return false;
         }
-        index = ( index + modulo ) % entries;
-        pass++;
+        index = ( index + modulo ) % dev->entries;
+    }
+
+    index = ( first + ( dev->replacement % set ) * modulo ) % dev->entries;
+    dev->replacement++;
+    this->mReplacement++;
+    dev->inodes[index] = keyL;
+
+    return true;
+}
+
+/*
+ * Replaces the table of a device which keeps overflowing with one
+ * CACHE_DEVICE_GROWTH times the size, if that fits the configured total.
+ * The new table is allocated without the lock held so the device is looked
+ * up again afterwards; if it was purged or grown meanwhile nothing is done.
+ */
+static void growDevice(void* self, const uint32_t keyH, unsigned int entries)
+{
+    struct CacheDevice* dev;
+    uint32_t* inodes;
+    uint32_t* old;
+    unsigned int newEntries = entries * CACHE_DEVICE_GROWTH;
+    unsigned int prime = 0;
+    unsigned int set = this->mSetSize;
+    unsigned int i;
+
+
+    if ( !calculateCacheParams(&newEntries, &prime, &set) )
+    {
+        return;
     }
 
-    if ( pass >= set )
+    inodes = allocateTable(newEntries);
+    if ( !inodes )
     {
-      index = ( first + ( this->mReplacement % set ) * modulo ) % entries;
-      this->mReplacement++;
-      cache[index].device = keyH;
-      cache[index].inode = keyL;
+        return;
+    }
+
+    talpa_cache_write_lock(&this->mCacheLock);
+
+    dev = findDevice(this, keyH);
+    if ( !dev || (dev->entries != entries) || (this->mAllocated - entries + newEntries > this->mEntries) )
+    {
+        talpa_cache_write_unlock(&this->mCacheLock);
+        freeTable(inodes, newEntries);
+        return;
+    }
+
+    old = dev->inodes;
+    dev->inodes = inodes;
+    dev->entries = newEntries;
+    dev->prime = prime;
+    this->mFill -= dev->fill;
+    dev->fill = dev->zero ? 1 : 0;
+    this->mFill += dev->fill;
+    dev->replacement = dev->evictions = 0;
+    this->mAllocated += newEntries - entries;
+
+    for ( i = 0; i < entries; i++ )
+    {
+        if ( old[i] )
+        {
+            insert(this, dev, old[i]);
+        }
     }
 
     talpa_cache_write_unlock(&this->mCacheLock);
 
+    dbg("Cache for device %x grown to %u entries", keyH, newEntries);
+
+    freeTable(old, entries);
+
     return;
 }
 
-static void clear(void *self, const uint32_t keyH, const uint32_t keyL)
+/*
+ * Called with the cache lock held for writing. Unlinks the device table
+ * holding the fewest entries, to make room for a new device, and returns
+ * it for freeing once the lock is dropped.
+ */
+static struct CacheDevice* evictDevice(void* self)
+{
+    struct CacheDevice* dev;
+    struct CacheDevice* victim = NULL;
+    unsigned int i;
+
+
+    for ( i = 0; i < CACHE_DEVICE_BUCKETS; i++ )
+    {
+        talpa_list_for_each_entry(dev, &this->mDevices[i], head)
+        {
+            if ( !victim || dev->fill < victim->fill )
+            {
+                victim = dev;
+            }
+        }
+    }
+
+    if ( victim )
+    {
+        talpa_list_del(&victim->head);
+        this->mFill -= victim->fill;
+        this->mAllocated -= victim->entries;
+        this->mDeviceCount--;
+    }
+
+    return victim;
+}
+
+/* Frees the tables evictDevice() gave up, after the cache lock is dropped */
+static void freeEvicted(talpa_list_head* evicted)
+{
+    struct CacheDevice *dev, *tmp;
+
+
+    if ( talpa_list_empty(evicted) )
+    {
+        return;
+    }
+
+    /* Whoever remembered those inodes as allowed must ask again */
+    talpa_verdict_invalidate();
+
+    talpa_list_for_each_entry_safe(dev, tmp, evicted, head)
+    {
+        talpa_list_del(&dev->head);
+        freeDevice(dev);
+    }
+
+    return;
+}
+
+/* Returns true if the entry was added */
+static bool add(void *self, unsigned int fstype, const char* fsname, const uint32_t keyH, const uint32_t keyL)
 {
-    int entries;
-    int set;
-    int prime;
-    int pass;
-    int first;
-    int modulo;
-    int index;
-    struct CacheEntry* cache;
+    struct CacheDevice* dev;
+    struct CacheDevice* newdev = NULL;
+    struct CacheDevice* victim;
+    talpa_list_head evicted;
+    unsigned int entries = CACHE_DEVICE_ENTRIES;
+    unsigned int prime = 0;
+    unsigned int set;
+    unsigned int grow = 0;
+
+    /* Check whether we should try to cache this fs */
+    if ( !checkFilesystem(this, fstype, fsname) )
+    {
+        return false;
+    }
+
+    TALPA_INIT_LIST_HEAD(&evicted);
 
     talpa_cache_write_lock(&this->mCacheLock);
 
-    entries = this->mEntries;
-    set = this->mSetSize;
-    prime = this->mPrime;
-    cache = this->mCache;
+    dev = findDevice(this, keyH);
+    if ( !dev )
+    {
+        talpa_cache_write_unlock(&this->mCacheLock);
 
-    first = (( keyH % entries ) * ( keyL % entries )) % entries;
-    pass = 0;
-    modulo = (( keyH % prime ) * ( keyL % prime )) % prime + 1;
-    index = first;
+        set = this->mSetSize;
+        if ( calculateCacheParams(&entries, &prime, &set) )
+        {
+            newdev = newDevice(keyH, entries, prime);
+        }
+        if ( !newdev )
+        {
+            return false;
+        }
 
-    while ( pass < set )
+        talpa_cache_write_lock(&this->mCacheLock);
+
+        dev = findDevice(this, keyH);
+        if ( !dev )
+        {
+            /* Stay within the configured size, giving up the emptiest tables first */
+            while ( newdev->entries <= this->mEntries && this->mAllocated + newdev->entries > this->mEntries )
+            {
+                victim = evictDevice(this);
+                if ( !victim )
+                {
+                    break;
+                }
+                talpa_list_add(&victim->head, &evicted);
+            }
+
+            if ( this->mAllocated + newdev->entries <= this->mEntries )
+            {
+                talpa_list_add(&newdev->head, deviceBucket(this, keyH));
+                this->mAllocated += newdev->entries;
+                this->mDeviceCount++;
+                dev = newdev;
+                newdev = NULL;
+            }
+        }
+
+        if ( !dev )
+        {
+            talpa_cache_write_unlock(&this->mCacheLock);
+            freeEvicted(&evicted);
+            freeDevice(newdev);
+            return false;
+        }
+    }
+
+    if ( insert(this, dev, keyL) )
     {
-        if ( (cache[index].device == keyH) && (cache[index].inode == keyL) )
+        if ( ++dev->evictions >= dev->entries
+             && this->mAllocated + dev->entries * (CACHE_DEVICE_GROWTH - 1) <= this->mEntries )
         {
-            /* Delete the entry from the cache */
-            cache[index].device = -1;
-            cache[index].inode = 0;
-            this->mFill--;
-            break;
+            grow = dev->entries;
         }
-        index = ( index + modulo ) % entries;
-        pass++;
     }
 
     talpa_cache_write_unlock(&this->mCacheLock);
 
-    return;
+    freeEvicted(&evicted);
+
+    if ( newdev )
+    {
+        freeDevice(newdev);
+    }
+
+    if ( grow )
+    {
+        growDevice(this, keyH, grow);
+    }
+
+    trace_talpa_cache_add(keyH, keyL);
+
+    return true;
 }
 
-static void purge(void *self, const uint32_t keyH)
+static void clear(void *self, const uint32_t keyH, const uint32_t keyL)
 {
-    unsigned int entry;
-    unsigned int entries;
-    unsigned int fill;
-    struct CacheEntry* cache;
+    struct CacheDevice* dev;
+    unsigned int set;
+    unsigned int pass;
+    unsigned int index;
+    unsigned int modulo;
+    bool removed = false;
 
     talpa_cache_write_lock(&this->mCacheLock);
 
-    entries = this->mEntries;
-    fill = this->mFill;
-    cache = this->mCache;
+    dev = findDevice(this, keyH);
 
-    for ( entry = 0; entry < entries; entry++ )
+    if ( dev && !keyL && dev->zero )
     {
-        if ( cache[entry].device == keyH )
+        dev->zero = false;
+        dev->fill--;
+        this->mFill--;
+        removed = true;
+    }
+    else if ( dev && keyL )
+    {
+        set = this->mSetSize;
+        index = deviceFirst(dev, keyL);
+        modulo = deviceStride(dev, keyL);
+
+        for ( pass = 0; pass < set; pass++ )
         {
-            cache[entry].device = -1;
-            cache[entry].inode = 0;
-            fill--;
+            if ( dev->inodes[index] == keyL )
+            {
+                /* Delete the entry from the cache */
+                dev->inodes[index] = 0;
+                dev->fill--;
+                this->mFill--;
+                removed = true;
+                break;
+            }
+            index = ( index + modulo ) % dev->entries;
         }
     }
 
-    this->mFill = fill;
+    talpa_cache_write_unlock(&this->mCacheLock);
+
+    /* Whoever remembered this inode as allowed must ask again */
+    if ( removed )
+    {
+        talpa_verdict_invalidate();
+    }
+
+    trace_talpa_cache_clear(keyH, keyL);
+
+    return;
+}
+
+static void purge(void *self, const uint32_t keyH)
+{
+    struct CacheDevice* dev;
+
+    talpa_cache_write_lock(&this->mCacheLock);
+
+    dev = findDevice(this, keyH);
+    if ( dev )
+    {
+        talpa_list_del(&dev->head);
+        this->mFill -= dev->fill;
+        this->mAllocated -= dev->entries;
+        this->mDeviceCount--;
+    }
 
     talpa_cache_write_unlock(&this->mCacheLock);
 
+    if ( dev )
+    {
+        freeDevice(dev);
+        talpa_verdict_invalidate();
+    }
+
+    trace_talpa_cache_purge(keyH);
+
     return;
 }
 
@@ -638,6 +979,27 @@ static bool removeObject(void *self, talpa_list_head* list, const char* value)
     return false;
 }
 
+/* Called with mConfigSerialize held. */
+static void compileFilesystems(void* self)
+{
+    CacheConfigObject *obj;
+    talpa_fstype_set_t ids;
+
+
+    talpa_fstype_set_zero(&ids);
+
+    talpa_rcu_read_lock(&this->mConfigLock);
+    talpa_list_for_each_entry_rcu(obj, &this->mFilesystems, head)
+    {
+        talpa_fstype_set_add(&ids, talpa_fstype_intern(obj->string));
+    }
+    talpa_rcu_read_unlock(&this->mConfigLock);
+
+    talpa_fstype_set_copy(&this->mFilesystemIds, &ids);
+
+    return;
+}
+
 static void doActionString(void* self, talpa_list_head* list, char** set, const char* value)
 {
     if ( strlen(value) < 2 )
@@ -713,6 +1075,12 @@ static int findPrime(int inval)
     int retval = inval;
     int max = int_sqrt_approx(inval);
 
+    /* Nothing to try dividing by below four, and the loop would never end */
+    if ( max < 2 )
+    {
+        return (inval > 1) ? inval : 0;
+    }
+
     while( max <= retval )
     {
         i = 2;
@@ -844,15 +1212,12 @@ static void configureCache(void* self, const char *string)
     entries = simple_strtoul(entries_string, &res, 10);
     if ( calculateCacheParams(&entries, &prime, &set) )
     {
-        freeCache(this);
-        if ( allocateCache(this, entries) )
-        {
-            this->mEntries = entries;
-            this->mPrime = prime;
-            this->mSetSize = set;
-            sprintf(this->mParamsConfigData.value, "%u,%u,%u", this->mEntries, this->mPrime, this->mSetSize);
-            notice("Cache now has %u entries, %u-way associated, 2nd hash prime is %u", entries, set, prime);
-        }
+        dropDevices(this);
+        this->mEntries = entries;
+        this->mPrime = prime;
+        this->mSetSize = set;
+        sprintf(this->mParamsConfigData.value, "%u,%u,%u", this->mEntries, this->mPrime, this->mSetSize);
+        notice("Cache now has up to %u entries, %u-way associated", entries, set);
     }
 
     return;
@@ -860,15 +1225,9 @@ static void configureCache(void* self, const char *string)
 
 static bool enable(void* self)
 {
-    if ( !this->mEnabled && this->mCache )
+    if ( !this->mEnabled )
     {
-        unsigned int i;
-
-        for ( i = 0; i < this->mEntries; i++ )
-        {
-            this->mCache[i].device = -1;
-            this->mCache[i].inode = 0;
-        }
+        dropDevices(this);
 
         this->mHits = this->mMisses = this->mReplacement = this->mFill = 0;
 
@@ -885,6 +1244,7 @@ static void disable(void* self)
     {
         this->mHits = this->mMisses = this->mReplacement = this->mFill = 0;
         this->mEnabled = false;
+        talpa_verdict_invalidate();
         strcpy(this->mStateConfigData.value, CFG_VALUE_DISABLED);
         info("Disabled");
     }
@@ -937,11 +1297,11 @@ static const char* config(const void* self, const char* name)
 
         if ( !strcmp(cfgElement->name, CFG_STAT) )
         {
-            /* 5 unsigned ints + 53 text chars = 5*10 + 53 = 103 characters.
+            /* 6 unsigned ints + 64 text chars = 6*10 + 64 = 124 characters.
                Although cache size (total, fill) can't be as big as UINT_MAX,
                we will assume it can. Check CACHE_STATDATASIZE if you modify
                something here. */
-            sprintf(cfgElement->value, "Hits: %u, Misses: %u\nUsed: %u, Replacements: %u, Total: %u", this->mHits, this->mMisses, this->mFill, this->mReplacement, this->mEntries);
+            sprintf(cfgElement->value, "Hits: %u, Misses: %u\nUsed: %u, Replacements: %u, Total: %u, Devices: %u", this->mHits, this->mMisses, this->mFill, this->mReplacement, this->mAllocated, this->mDeviceCount);
         }
         else if ( !strcmp(cfgElement->name, CFG_FSTYPES) )
         {
@@ -1003,6 +1363,7 @@ static void  setConfig(void* self, const char* name, const char* value)
     else if ( !strcmp(name, CFG_FSTYPES) )
     {
         doActionString(this, &this->mFilesystems, &(this->mFilesystemsSet), value);
+        compileFilesystems(this);
     }
     else if ( !strcmp(cfgElement->name, CFG_PARAMS) )
     {
@@ -24,6 +24,7 @@
 #include "common/list.h"
 #include "cache/icache.h"
 #include "configurator/iconfigurable.h"
+#include "platform/fstype.h"
 
 /*
  * Configuration structures
@@ -62,12 +63,46 @@ typedef struct
     unsigned int    len;
 } CacheConfigObject;
 
-struct CacheEntry
+/*
+ * Each device, and so each mounted superblock, has a table of its own which
+ * starts small and grows while its sets keep overflowing, as long as all
+ * tables together stay within the number of entries configured. Unmounting
+ * drops the device's table whole.
+ */
+#define CACHE_DEVICE_BITS       (6)
+#define CACHE_DEVICE_BUCKETS    (1 << CACHE_DEVICE_BITS)
+#define CACHE_DEVICE_ENTRIES    (127)   /* First table of a device */
+#define CACHE_DEVICE_GROWTH     (4)
+
+struct CacheDevice
 {
-    int32_t    device;
-    int32_t    inode;
+    talpa_list_head     head;
+    uint32_t            device;
+    unsigned int        entries;
+    unsigned int        prime;
+    unsigned int        fill;
+    unsigned int        replacement;    /* Round robin position */
+    unsigned int        evictions;      /* Since the table was last grown */
+    bool                zero;           /* Inode zero is cached */
+    uint32_t*           inodes;         /* Zero is a free slot */
 };
 
+/*
+ * An entry may live in any of the set size slots of its probe sequence,
+ * which starts at cacheFirst() and steps cacheStride() slots at a time.
+ * The capture replay tool simulates a single table shared by all devices
+ * with these.
+ */
+static inline int cacheFirst(const uint32_t keyH, const uint32_t keyL, int entries)
+{
+    return (( keyH % entries ) * ( keyL % entries )) % entries;
+}
+
+static inline int cacheStride(const uint32_t keyH, const uint32_t keyL, int prime)
+{
+    return (( keyH % prime ) * ( keyL % prime )) % prime + 1;
+}
+
 typedef talpa_rw_lock_t talpa_cache_lock_t;
 
 typedef struct tag_Cache
@@ -78,10 +113,11 @@ typedef struct tag_Cache
     bool                    mEnabled;
 
     talpa_cache_lock_t      mCacheLock;
-    unsigned int            mCacheBytes;
-    struct CacheEntry*      mCache;
+    talpa_list_head         mDevices[CACHE_DEVICE_BUCKETS];
+    unsigned int            mDeviceCount;
+    unsigned int            mAllocated;     /* Entries in all device tables */
     unsigned int            mSetSize;
-    unsigned int            mEntries;
+    unsigned int            mEntries;       /* Limit on mAllocated */
     unsigned int            mPrime;
     unsigned int            mReplacement;
     unsigned int            mHits;
@@ -92,6 +128,7 @@ typedef struct tag_Cache
     talpa_mutex_t           mConfigSerialize;
     talpa_list_head         mFilesystems;
     char*                   mFilesystemsSet;
+    talpa_fstype_set_t      mFilesystemIds;
 
     PODConfigurationElement mConfig[5];
     CacheConfigData         mStateConfigData;
@@ -24,6 +24,7 @@
 #include "cache_allow.h"
 
 #include "platform/alloc.h"
+#include "platform/capture.h"
 
 /*
  * Forward declare implementation methods.
@@ -92,6 +93,7 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
     if ( ( info->operation(info) == EFS_Open ) && info->isWritable(info) )
     {
         this->mCache->clear(this->mCache->object, info->device(info), info->inode(info));
+        talpa_capture(TALPA_CAPTURE_CLEAR, EFS_Open, info->flags(info), info->device(info), info->inode(info), info->filename(info));
         return;
     }
 
@@ -100,7 +102,10 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
     if ( report->hasBeenExternallyVetted(report) &&
             ( (info->isWritableAnywhere(info) == 0) || ((info->isWritableAnywhere(info) == 1) && info->isWritable(info)) ) )
     {
-        this->mCache->add(this->mCache->object, info->fsType(info), info->device(info), info->inode(info));
+        if ( this->mCache->add(this->mCache->object, info->fsTypeId(info), info->fsType(info), info->device(info), info->inode(info)) )
+        {
+            talpa_capture(TALPA_CAPTURE_ADD, info->operation(info), info->flags(info), info->device(info), info->inode(info), info->filename(info));
+        }
     }
 
     return;
@@ -112,6 +117,7 @@ static EInterceptAction examineInode(const void* self, const EFilesystemOperatio
     if ( writable && (op == EFS_Open) )
     {
         this->mCache->clear(this->mCache->object, device, inode);
+        talpa_capture(TALPA_CAPTURE_CLEAR, op, flags, device, inode, NULL);
     }
 
     return EIA_Next;
@@ -125,6 +131,7 @@ static void examineFilesystem(const void* self, IEvaluationReport* report,
     if ( info->operation(info) == EFS_Umount )
     {
         this->mCache->purge(this->mCache->object, info->device(info));
+        talpa_capture(TALPA_CAPTURE_PURGE, EFS_Umount, 0, info->device(info), 0, info->mountPoint(info));
     }
 
     return;
@@ -24,6 +24,7 @@
 #include "cache_deny.h"
 
 #include "platform/alloc.h"
+#include "platform/capture.h"
 
 /*
  * Forward declare implementation methods.
@@ -92,6 +93,7 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
     if ( likely(report->hasBeenExternallyVetted(report) == true) )
     {
         this->mCache->clear(this->mCache->object, info->device(info), info->inode(info));
+        talpa_capture(TALPA_CAPTURE_CLEAR, info->operation(info), info->flags(info), info->device(info), info->inode(info), info->filename(info));
     }
 
     return;
@@ -105,6 +107,7 @@ static void examineFilesystem(const void* self, IEvaluationReport* report,
     if ( info->operation(info) == EFS_Umount )
     {
         this->mCache->purge(this->mCache->object, info->device(info));
+        talpa_capture(TALPA_CAPTURE_PURGE, EFS_Umount, 0, info->device(info), 0, info->mountPoint(info));
     }
 
     return;
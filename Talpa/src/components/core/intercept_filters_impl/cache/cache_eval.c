@@ -24,6 +24,7 @@
 #include "cache_eval.h"
 
 #include "platform/alloc.h"
+#include "platform/capture.h"
 
 /*
  * Forward declare implementation methods.
@@ -95,10 +96,13 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
 
     if ( this->mCache->find(this->mCache->object, info->device(info), info->inode(info)) > 0 )
     {
+        talpa_capture(TALPA_CAPTURE_HIT, info->operation(info), info->flags(info), info->device(info), info->inode(info), info->filename(info));
         report->setRecommendedAction(report, EIA_Allow);
         return;
     }
 
+    talpa_capture(TALPA_CAPTURE_MISS, info->operation(info), info->flags(info), info->device(info), info->inode(info), info->filename(info));
+
     return;
 }
 
@@ -112,9 +116,12 @@ static EInterceptAction examineInode(const void* self, const EFilesystemOperatio
 
     if ( this->mCache->find(this->mCache->object, device, inode) > 0 )
     {
+        talpa_capture(TALPA_CAPTURE_HIT, op, flags, device, inode, NULL);
         return EIA_Allow;
     }
 
+    talpa_capture(TALPA_CAPTURE_MISS, op, flags, device, inode, NULL);
+
     return EIA_Next;
 }
 
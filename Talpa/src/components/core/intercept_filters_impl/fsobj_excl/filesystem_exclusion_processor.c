@@ -44,7 +44,9 @@ static FSEPObject* findObject(const void* self, talpa_list_head* list, const cha
 static void freeObject(FSEPObject* obj);
 static void deleteObject(void *self, FSEPObject* obj);
 static void constructSpecialSet(void* self);
-static void doActionString(void* self, talpa_list_head* list, char** set, const char* value);
+static void doActionString(void* self, talpa_list_head* list, char** set, PathSet** match, const char* value);
+static bool matchString(talpa_list_head* list, const PathSet* match, const char* string);
+static bool matchPath(talpa_list_head* list, const PathSet* match, const char* path);
 
 /*
  * Constants
@@ -118,7 +120,12 @@ static FilesystemExclusionProcessor template_FilesystemExclusionProcessor =
         NULL,
         NULL,
         NULL,
-        NULL
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        { { 0 } }
     };
 #define this    ((FilesystemExclusionProcessor*)self)
 
@@ -152,6 +159,7 @@ FilesystemExclusionProcessor* newFilesystemExclusionProcessor(void)
         object->mConfig[5].value = object->mMountFSConfigData.value;
 
         talpa_rcu_lock_init(&object->mConfigLock);
+        talpa_lock_stats_name(&object->mConfigLock, "fsobj-excl-config");
         talpa_mutex_init(&object->mConfigSerialize);
         TALPA_INIT_LIST_HEAD(&object->mPaths);
         TALPA_INIT_LIST_HEAD(&object->mFilesystems);
@@ -167,6 +175,7 @@ static void deleteFilesystemExclusionProcessor(struct tag_FilesystemExclusionPro
     FSEPObject *obj, *tmp;
 
     talpa_rcu_synchronize();
+    talpa_rcu_barrier();
 
     talpa_list_for_each_entry_safe(obj, tmp, &object->mPaths, head)
     {
@@ -197,6 +206,12 @@ static void deleteFilesystemExclusionProcessor(struct tag_FilesystemExclusionPro
     talpa_large_free(object->mMountPathsSet);
     talpa_large_free(object->mMountFilesystemsSet);
 
+    deletePathSet(object->mPathsMatch);
+    deletePathSet(object->mFilesystemsMatch);
+    deletePathSet(object->mMountPathsMatch);
+    deletePathSet(object->mMountFilesystemsMatch);
+
+    talpa_lock_stats_release(&object->mConfigLock);
     talpa_free(object);
 
     return;
@@ -207,11 +222,10 @@ static void deleteFilesystemExclusionProcessor(struct tag_FilesystemExclusionPro
  */
 static void examineFile(const void* self, IEvaluationReport* report, const IPersonality* userInfo, const IFileInfo* info, IFile* file)
 {
-    const char*  checkString = info->fsType(info);
+    const char*  checkString;
+    unsigned int fstype = info->fsTypeId(info);
     mode_t mode = info->mode(info);
     unsigned int mask = this->mSpecialsMask;
-    FSEPObject*  obj;
-    unsigned int checkLen;
 
 
     /*
@@ -229,20 +243,27 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
     }
 
     /*
-     * Check the filesystem type.
+     * Check the filesystem type. Types which could not be registered
+     * can not be in the bitmap either and are matched by name.
      */
-    talpa_rcu_read_lock(&this->mConfigLock);
-    if ( likely(checkString != NULL) )
+    if ( likely(fstype != TALPA_FSTYPE_NONE) )
     {
-        checkLen = strlen(checkString);
-        talpa_list_for_each_entry_rcu(obj, &this->mFilesystems, head)
+        if ( talpa_fstype_set_test(&this->mFilesystemIds, fstype) )
         {
-            if ( (checkLen == obj->len) && (strcmp(checkString, obj->value) == 0) )
-            {
-                talpa_rcu_read_unlock(&this->mConfigLock);
-                report->setRecommendedAction(report, EIA_Allow);
-                return;
-            }
+            report->setRecommendedAction(report, EIA_Allow);
+            return;
+        }
+        talpa_rcu_read_lock(&this->mConfigLock);
+    }
+    else
+    {
+        checkString = info->fsType(info);
+        talpa_rcu_read_lock(&this->mConfigLock);
+        if ( likely(checkString != NULL) && matchString(&this->mFilesystems, talpa_rcu_dereference(this->mFilesystemsMatch), checkString) )
+        {
+            talpa_rcu_read_unlock(&this->mConfigLock);
+            report->setRecommendedAction(report, EIA_Allow);
+            return;
         }
     }
 
@@ -250,40 +271,9 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
      * Check the filename against the list of excluded paths.
      */
     checkString = info->filename(info);
-    if ( likely(checkString != NULL) )
+    if ( likely(checkString != NULL) && matchPath(&this->mPaths, talpa_rcu_dereference(this->mPathsMatch), checkString) )
     {
-        checkLen = strlen(checkString);
-        talpa_list_for_each_entry_rcu(obj, &this->mPaths, head)
-        {
-            /* Do not exclude the file if the filename is shorter than our filter. */
-            if ( checkLen < obj->len )
-            {
-                continue;
-            }
-
-            if ( obj->value[obj->len-1] == '/' )
-            {
-                /*
-                 * We have a directory exclusion - so it can match in full (exact) or in part (subdir).
-                 */
-                if ( strncmp(checkString, obj->value, obj->len) == 0 )
-                {
-                    report->setRecommendedAction(report, EIA_Allow);
-                    break;
-                }
-            }
-            else
-            {
-                /*
-                 * Its a normal pathname exclusion - must match in full.
-                 */
-                if ( (checkLen == obj->len) && (strcmp(checkString, obj->value) == 0) )
-                {
-                    report->setRecommendedAction(report, EIA_Allow);
-                    break;
-                }
-            }
-        }
+        report->setRecommendedAction(report, EIA_Allow);
     }
 
     talpa_rcu_read_unlock(&this->mConfigLock);
@@ -294,8 +284,7 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
 static void examineFilesystem(const void* self, IEvaluationReport* report, const IPersonality* userInfo, const IFilesystemInfo* info)
 {
     const char*  checkString = info->type(info);
-    FSEPObject*  obj;
-    unsigned int checkLen;
+    const PathSet* match;
 
     /*
      * Check the filesystem type.
@@ -303,92 +292,26 @@ static void examineFilesystem(const void* self, IEvaluationReport* report, const
 
     talpa_rcu_read_lock(&this->mConfigLock);
 
-    if ( likely(checkString != NULL) )
+    if ( likely(checkString != NULL) && matchString(&this->mMountFilesystems, talpa_rcu_dereference(this->mMountFilesystemsMatch), checkString) )
     {
-        checkLen = strlen(checkString);
-        talpa_list_for_each_entry_rcu(obj, &this->mMountFilesystems, head)
-        {
-            if ( (checkLen == obj->len) && (strcmp(checkString, obj->value) == 0) )
-            {
-                goto allow;
-            }
-        }
+        goto allow;
     }
 
     /*
-     * Check the deviceName against the list of excluded paths.
+     * Check the deviceName and mountPoint against the list of excluded paths.
      */
+    match = talpa_rcu_dereference(this->mMountPathsMatch);
+
     checkString = info->deviceName(info);
-    if ( likely(checkString != NULL) )
+    if ( likely(checkString != NULL) && matchPath(&this->mMountPaths, match, checkString) )
     {
-        checkLen = strlen(checkString);
-        talpa_list_for_each_entry_rcu(obj, &this->mMountPaths, head)
-        {
-            /* Do not exclude the file if the filename is shorter than our filter */
-            if ( checkLen < obj->len )
-            {
-                continue;
-            }
-
-            if ( obj->value[obj->len-1] == '/' )
-            {
-                /*
-                 * We have a directory exclusion - so it can match in full (exact) or in part (subdir).
-                 */
-                if ( strncmp(checkString, obj->value, obj->len) == 0 )
-                {
-                    goto allow;
-                }
-            }
-            else
-            {
-                /*
-                 * Its a normal pathname exclusion - must match in full.
-                 */
-                if ( (checkLen == obj->len) && (strcmp(checkString, obj->value) == 0) )
-                {
-                    goto allow;
-                }
-            }
-        }
+        goto allow;
     }
 
-    /*
-     * Check the mountPoint against the list of excluded paths.
-     */
     checkString = info->mountPoint(info);
-    if ( likely(checkString != NULL) )
+    if ( likely(checkString != NULL) && matchPath(&this->mMountPaths, match, checkString) )
     {
-        checkLen = strlen(checkString);
-        talpa_list_for_each_entry_rcu(obj, &this->mMountPaths, head)
-        {
-            /* Do not exclude the file if the filename is shorter than our filter */
-            if ( checkLen < obj->len )
-            {
-                continue;
-            }
-
-            if ( obj->value[obj->len-1] == '/' )
-            {
-                /*
-                 * We have a directory exclusion - so it can match in full (exact) or in part (subdir).
-                 */
-                if ( strncmp(checkString, obj->value, obj->len) == 0 )
-                {
-                    goto allow;
-                }
-            }
-            else
-            {
-                /*
-                 * Its a normal pathname exclusion - must match in full.
-                 */
-                if ( (checkLen == obj->len) && (strcmp(checkString, obj->value) == 0) )
-                {
-                    goto allow;
-                }
-            }
-        }
+        goto allow;
     }
 
     talpa_rcu_read_unlock(&this->mConfigLock);
@@ -402,6 +325,78 @@ static void examineFilesystem(const void* self, IEvaluationReport* report, const
     return;
 }
 
+/*
+ * Matching. Both helpers must be called with the config lock held for reading.
+ *
+ * The compiled set is used when present. It is absent if the list is empty
+ * or compiling it failed, in which case the list itself is walked.
+ */
+static bool matchString(talpa_list_head* list, const PathSet* match, const char* string)
+{
+    unsigned int len = strlen(string);
+    FSEPObject*  obj;
+
+
+    if ( likely(match != NULL) )
+    {
+        return pathSetFind(match, string, len) != NULL;
+    }
+
+    talpa_list_for_each_entry_rcu(obj, list, head)
+    {
+        if ( (len == obj->len) && (strcmp(string, obj->value) == 0) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool matchPath(talpa_list_head* list, const PathSet* match, const char* path)
+{
+    unsigned int len = strlen(path);
+    FSEPObject*  obj;
+
+
+    if ( likely(match != NULL) )
+    {
+        return pathSetMatch(match, path, len) != NULL;
+    }
+
+    talpa_list_for_each_entry_rcu(obj, list, head)
+    {
+        /* Do not exclude the file if the filename is shorter than our filter. */
+        if ( len < obj->len )
+        {
+            continue;
+        }
+
+        if ( obj->value[obj->len-1] == '/' )
+        {
+            /*
+             * We have a directory exclusion - so it can match in full (exact) or in part (subdir).
+             */
+            if ( strncmp(path, obj->value, obj->len) == 0 )
+            {
+                return true;
+            }
+        }
+        else
+        {
+            /*
+             * Its a normal pathname exclusion - must match in full.
+             */
+            if ( (len == obj->len) && (strcmp(path, obj->value) == 0) )
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 /*
  * configuration list handling & objects
  */
@@ -604,7 +599,79 @@ static bool removeObject(void *self, talpa_list_head* list, const char* value)
     return false;
 }
 
-static void doActionString(void* self, talpa_list_head* list, char** set, const char* value)
+/*
+ * Rebuilds the compiled form of a list after it has changed and swaps it in.
+ * Called with mConfigSerialize held so the list cannot change underneath.
+ */
+static void compileList(void* self, talpa_list_head* list, PathSet** match)
+{
+    unsigned int count = 0;
+    size_t bytes = 0;
+    FSEPObject* obj;
+    PathSet* newset = NULL;
+    PathSet* oldset;
+
+
+    talpa_list_for_each_entry(obj, list, head)
+    {
+        count++;
+        bytes += obj->len;
+    }
+
+    if ( count )
+    {
+        newset = newPathSet(count, bytes);
+        if ( newset )
+        {
+            talpa_list_for_each_entry(obj, list, head)
+            {
+                if ( !pathSetAdd(newset, obj->value, NULL) )
+                {
+                    deletePathSet(newset);
+                    newset = NULL;
+                    break;
+                }
+            }
+        }
+
+        if ( !newset )
+        {
+            warn("Failed to compile %u entries, falling back to list matching!", count);
+        }
+    }
+
+    talpa_rcu_write_lock(&this->mConfigLock);
+    oldset = *match;
+    talpa_rcu_assign_pointer(*match, newset);
+    talpa_rcu_write_unlock(&this->mConfigLock);
+
+    deletePathSetDeferred(oldset);
+
+    return;
+}
+
+/*
+ * Rebuilds the filesystem type bitmap, also with mConfigSerialize held.
+ */
+static void compileTypes(void* self, talpa_list_head* list, talpa_fstype_set_t* ids)
+{
+    FSEPObject* obj;
+    talpa_fstype_set_t newids;
+
+
+    talpa_fstype_set_zero(&newids);
+
+    talpa_list_for_each_entry(obj, list, head)
+    {
+        talpa_fstype_set_add(&newids, talpa_fstype_intern(obj->value));
+    }
+
+    talpa_fstype_set_copy(ids, &newids);
+
+    return;
+}
+
+static void doActionString(void* self, talpa_list_head* list, char** set, PathSet** match, const char* value)
 {
     if ( strlen(value) < 2 )
     {
@@ -619,6 +686,7 @@ static void doActionString(void* self, talpa_list_head* list, char** set, const
     {
         removeObject(this, list, &value[1]);
     }
+    compileList(this, list, match);
     destroyStringSet(this, set);
 
     return;
@@ -824,11 +892,12 @@ static void  setConfig(void* self, const char* name, const char* value)
     }
     else if ( !strcmp(name, CFG_PATHS) )
     {
-        doActionString(this, &this->mPaths, &(this->mPathsSet), value);
+        doActionString(this, &this->mPaths, &(this->mPathsSet), &(this->mPathsMatch), value);
     }
     else if ( !strcmp(name, CFG_FSTYPES) )
     {
-        doActionString(this, &this->mFilesystems, &(this->mFilesystemsSet), value);
+        doActionString(this, &this->mFilesystems, &(this->mFilesystemsSet), &(this->mFilesystemsMatch), value);
+        compileTypes(this, &this->mFilesystems, &this->mFilesystemIds);
     }
     else if ( !strcmp(name, CFG_SPECIALS) )
     {
@@ -836,11 +905,11 @@ static void  setConfig(void* self, const char* name, const char* value)
     }
     else if ( !strcmp(name, CFG_MOUNTPATHS) )
     {
-        doActionString(this, &this->mMountPaths, &(this->mMountPathsSet), value);
+        doActionString(this, &this->mMountPaths, &(this->mMountPathsSet), &(this->mMountPathsMatch), value);
     }
     else if ( !strcmp(name, CFG_MOUNTFSTYPES) )
     {
-        doActionString(this, &this->mMountFilesystems, &(this->mMountFilesystemsSet), value);
+        doActionString(this, &this->mMountFilesystems, &(this->mMountFilesystemsSet), &(this->mMountFilesystemsMatch), value);
     }
 
     talpa_mutex_unlock(&this->mConfigSerialize);
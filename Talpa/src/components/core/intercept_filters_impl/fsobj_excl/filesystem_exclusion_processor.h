@@ -25,6 +25,8 @@
 #include "common/list.h"
 #include "intercept_filters/iintercept_filter.h"
 #include "configurator/iconfigurable.h"
+#include "components/core/path_set_impl/path_set.h"
+#include "platform/fstype.h"
 
 #define FSEXCPROC_CFGDATASIZE       (16)
 #define FSEXCPROC_FSCFGDATASIZE     (128)
@@ -83,6 +85,11 @@ typedef struct tag_FilesystemExclusionProcessor
     char*                       mFilesystemsSet;
     char*                       mMountPathsSet;
     char*                       mMountFilesystemsSet;
+    PathSet*                    mPathsMatch;
+    PathSet*                    mFilesystemsMatch;
+    PathSet*                    mMountPathsMatch;
+    PathSet*                    mMountFilesystemsMatch;
+    talpa_fstype_set_t          mFilesystemIds;
 } FilesystemExclusionProcessor;
 
 /*
@@ -112,12 +112,14 @@ FilesystemInclusionProcessor* newFilesystemInclusionProcessor(void)
         object->mConfig[1].name  = object->mPathConfigData.name;
         object->mConfig[1].value = object->mPathConfigData.value;
         talpa_rw_init(&object->mConfigLock);
+        talpa_lock_stats_name(&object->mConfigLock, "fsobj-incl-config");
     }
     return object;
 }
 
 static void deleteFilesystemInclusionProcessor(struct tag_FilesystemInclusionProcessor* object)
 {
+    talpa_lock_stats_release(&object->mConfigLock);
     talpa_free(object);
     return;
 }
@@ -20,6 +20,7 @@
 #include <linux/version.h>
 #include <linux/kernel.h>
 #include <linux/string.h>
+#include <linux/cache.h>
 
 #define TALPA_SUBSYS "procexcl"
 #include "common/talpa.h"
@@ -95,6 +96,8 @@ static ProcessExclusionProcessor template_ProcessExclusionProcessor =
         true,
         TALPA_RCU_UNLOCKED(talpa_process_exclusion_processor_excluded_lock),
         { },
+        { },
+        { },
         {
             {NULL, NULL, PROCEXCL_CFGDATASIZE, true, true },
             {NULL, NULL, 0, false, false }
@@ -111,6 +114,7 @@ static ProcessExclusionProcessor template_ProcessExclusionProcessor =
 ProcessExclusionProcessor* newProcessExclusionProcessor(void)
 {
     ProcessExclusionProcessor* object;
+    unsigned int i;
 
 
     object = talpa_alloc(sizeof(template_ProcessExclusionProcessor));
@@ -125,6 +129,11 @@ ProcessExclusionProcessor* newProcessExclusionProcessor(void)
         talpa_mutex_init(&object->mConfigSerialize);
         talpa_rcu_lock_init(&object->mExcludedLock);
         TALPA_INIT_LIST_HEAD(&object->mExcluded);
+        for ( i = 0; i < PROCEXCL_BUCKETS; i++ )
+        {
+            TALPA_INIT_LIST_HEAD(&object->mByPid[i]);
+            TALPA_INIT_LIST_HEAD(&object->mByFiles[i]);
+        }
 
         object->mConfig[0].name  = object->mStateConfigData.name;
         object->mConfig[0].value = object->mStateConfigData.value;
@@ -152,22 +161,54 @@ static void deleteProcessExclusionProcessor(ProcessExclusionProcessor* object)
     return;
 }
 
+static inline talpa_list_head* pidBucket(const void* self, pid_t pid)
+{
+    return &this->mByPid[((unsigned long)pid * 2654435761UL) & (PROCEXCL_BUCKETS - 1)];
+}
+
+static inline talpa_list_head* filesBucket(const void* self, const void* files)
+{
+    return &this->mByFiles[((((unsigned long)files) >> L1_CACHE_SHIFT) * 2654435761UL) & (PROCEXCL_BUCKETS - 1)];
+}
+
+/*
+ * Must be called under the excluded list lock.
+ */
+static ProcessExcluded* findProcess(const void* self, pid_t pid, const void* files)
+{
+    ProcessExcluded* excluded;
+
+
+    talpa_list_for_each_entry_rcu(excluded, filesBucket(this, files), filesHead)
+    {
+        if ( excluded->files == files )
+        {
+            return excluded;
+        }
+    }
+
+    talpa_list_for_each_entry_rcu(excluded, pidBucket(this, pid), pidHead)
+    {
+        if ( excluded->processID == pid )
+        {
+            return excluded;
+        }
+    }
+
+    return NULL;
+}
+
 static inline bool checkProcessExcluded(const void* self)
 {
     ProcessExcluded* excluded;
-    pid_t pid = current->tgid;
-    void* files = current->files;
     bool active = false;
 
 
     talpa_rcu_read_lock(&this->mExcludedLock);
-    talpa_list_for_each_entry_rcu(excluded, &this->mExcluded, head)
+    excluded = findProcess(this, current->tgid, current->files);
+    if ( excluded )
     {
-        if ( (excluded->files == files) || (excluded->processID == pid) )
-        {
-            active = excluded->active;
-            break;
-        }
+        active = excluded->active;
     }
     talpa_rcu_read_unlock(&this->mExcludedLock);
 
@@ -215,17 +256,15 @@ static ProcessExcluded* registerProcess(void* self, pid_t pid, pid_t tid, void*
     talpa_rcu_write_lock(&this->mExcludedLock);
 
     /* Check if we already have this process */
-    talpa_list_for_each_entry_rcu(excluded, &this->mExcluded, head)
+    excluded = findProcess(this, pid, files);
+    if ( excluded )
     {
-        if ( (excluded->processID == pid) || (excluded->files == files) )
-        {
-            atomic_inc(&excluded->refcnt);
-            talpa_rcu_write_unlock(&this->mExcludedLock);
-            /* Free this since we don't need it */
-            talpa_free(process);
-            dbg("Process [%u/%u] re-registered", pid, tid);
-            return excluded;
-        }
+        atomic_inc(&excluded->refcnt);
+        talpa_rcu_write_unlock(&this->mExcludedLock);
+        /* Free this since we don't need it */
+        talpa_free(process);
+        dbg("Process [%u/%u] re-registered", pid, tid);
+        return excluded;
     }
 
     /* This is a new process, so lets register it */
@@ -237,6 +276,8 @@ static ProcessExcluded* registerProcess(void* self, pid_t pid, pid_t tid, void*
         process->files = files;
         process->active = false;
         talpa_list_add_tail_rcu(&process->head, &this->mExcluded);
+        talpa_list_add_tail_rcu(&process->pidHead, pidBucket(this, pid));
+        talpa_list_add_tail_rcu(&process->filesHead, filesBucket(this, files));
         dbg("Process [%u/%u] registered", process->processID, process->threadID);
     }
     else
@@ -264,6 +305,8 @@ static void deregisterProcess(void* self, ProcessExcluded* obj)
             if ( excluded == obj )
             {
                 talpa_list_del_rcu(&obj->head);
+                talpa_list_del_rcu(&obj->pidHead);
+                talpa_list_del_rcu(&obj->filesHead);
                 talpa_rcu_write_unlock(&this->mExcludedLock);
                 dbg("Process [%u/%u] deregistered", obj->processID, obj->threadID);
                 talpa_rcu_synchronize();
@@ -31,6 +31,7 @@
 
 
 #define PROCEXCL_CFGDATASIZE      (16)
+#define PROCEXCL_BUCKETS          (64)
 
 typedef struct {
     char    name[PROCEXCL_CFGDATASIZE];
@@ -49,6 +50,8 @@ typedef struct tag_ProcessExclusionProcessor
 
     talpa_rcu_lock_t          mExcludedLock;
     talpa_list_head           mExcluded;
+    talpa_list_head           mByPid[PROCEXCL_BUCKETS];
+    talpa_list_head           mByFiles[PROCEXCL_BUCKETS];
 
     PODConfigurationElement   mConfig[2];
     ProcExclConfigData        mStateConfigData;
@@ -21,6 +21,7 @@
 #include <linux/string.h>
 #include <linux/limits.h>
 #include <linux/sched.h>
+#include <linux/cache.h>
 #include <linux/utsname.h>
 #include <asm/fcntl.h>
 
@@ -36,6 +37,8 @@
 #include "platform/alloc.h"
 #include "platform/vfs_mount.h"
 #include "platform/uaccess.h"
+#include "platform/latency.h"
+#include "platform/trace.h"
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,6,0)
 # define TALPA_RESTRICT_OPEN_DURING_EXIT
@@ -80,6 +83,7 @@ static void setConfig(void* self, const char* name, const char* value);
 static void constructSpecialSet(void* self);
 
 static void deleteVettingController(struct tag_VettingController* object);
+static void deleteRoutingTable(VetCtrlRoutingTable* table);
 
 static void destroyVettingDetails(VettingDetails* details);
 
@@ -188,6 +192,7 @@ static VettingController template_VettingController =
         ATOMIC_INIT(0),
         true,
         NULL,
+        NULL,
 
         {
             { NULL, NULL, VETCTRL_CFGDATASIZE, true, true },
@@ -246,18 +251,23 @@ VettingController* newVettingController(void)
 
         talpa_simple_init(&object->mVettingIDLock);
         talpa_rcu_lock_init(&object->mClientsLock);
-        TALPA_INIT_LIST_HEAD(&object->mClients);
+        for ( group = 0; group < VETCTRL_CLIENT_BUCKETS; group++ )
+        {
+            TALPA_INIT_LIST_HEAD(&object->mClients[group]);
+        }
 
         for ( group = 0; group < VETTING_GROUPS; group++ )
         {
             dbg("group %d (0x%p)", group, &object->mGroups[group]);
             talpa_group_lock_init(&object->mGroups[group].lock);
+            talpa_lock_stats_name_index(&object->mGroups[group].lock, "vetting-group", group);
             atomic_set(&object->mGroups[group].numClients, 0);
             init_waitqueue_head(&object->mGroups[group].clientWaitQueue);
             TALPA_INIT_LIST_HEAD(&object->mGroups[group].intercepted);
         }
 
         talpa_rcu_lock_init(&object->mConfigLock);
+        talpa_lock_stats_name(&object->mConfigLock, "vetting-config");
         talpa_mutex_init(&object->mConfigSerialize);
         TALPA_INIT_LIST_HEAD(&object->mRoutings);
 
@@ -289,6 +299,7 @@ VettingController* newVettingController(void)
 static void deleteVettingController(struct tag_VettingController* object)
 {
     VetCtrlConfigObject *obj, *tmp;
+    unsigned int group;
 
     talpa_rcu_synchronize();
 
@@ -301,40 +312,87 @@ static void deleteVettingController(struct tag_VettingController* object)
     talpa_free(object->mRoutingsSet);
     talpa_rcu_write_unlock(&object->mConfigLock);
 
+    talpa_rcu_barrier();
+    deleteRoutingTable(object->mRoutingTable);
+
+    for ( group = 0; group < VETTING_GROUPS; group++ )
+    {
+        talpa_lock_stats_release(&object->mGroups[group].lock);
+    }
+    talpa_lock_stats_release(&object->mConfigLock);
     talpa_free(object);
 
     return;
 }
 
-static inline VettingGroup* routeRequest(const void* self, const char* path, unsigned int path_len, const char* fstype, unsigned int fstype_len)
+static inline VettingGroup* routeRequest(const void* self, const char* path, unsigned int path_len, unsigned int fstype, const char* fstype_name)
 {
     VettingGroup* group;
     VetCtrlConfigObject* obj;
+    const VetCtrlRoutingTable* table;
+    const PathSetEntry* entry;
     unsigned int groupID = 0;
+    unsigned int best_len = 0;
+    bool fs_routed = false;
 
     /* To which group should this request go? */
     talpa_rcu_read_lock(&this->mConfigLock);
+
+    table = talpa_rcu_dereference(this->mRoutingTable);
+    if ( likely(table != NULL) )
+    {
+        if ( table->paths && likely(path != NULL) )
+        {
+            entry = pathSetMatchPrefix(table->paths, path, path_len);
+            if ( entry )
+            {
+                groupID = (unsigned long)entry->data - 1;
+                goto routed;
+            }
+        }
+
+        if ( likely(fstype != TALPA_FSTYPE_NONE) )
+        {
+            if ( table->fstypes[fstype] )
+            {
+                groupID = table->fstypes[fstype] - 1;
+            }
+        }
+        else if ( table->fsnames && fstype_name )
+        {
+            entry = pathSetFind(table->fsnames, fstype_name, strlen(fstype_name));
+            if ( entry )
+            {
+                groupID = (unsigned long)entry->data - 1;
+            }
+        }
+        goto routed;
+    }
+
+    /* Without a table, which only happens if it could not be allocated,
+     * the list is walked applying the same rules. */
     talpa_list_for_each_entry_rcu(obj, &this->mRoutings, head)
     {
         switch ( obj->type )
         {
             case FILESYSTEM:
-                if ( likely(fstype != NULL) )
+                if ( fs_routed || best_len )
                 {
-                    if ( (fstype_len == obj->len) && !strcmp(fstype, obj->string) )
-                    {
-                        groupID = obj->group;
-                        goto routed;
-                    }
+                    break;
+                }
+                if ( likely(obj->fstype != TALPA_FSTYPE_NONE) ? (obj->fstype == fstype) : (fstype_name && !strcmp(fstype_name, obj->string)) )
+                {
+                    groupID = obj->group;
+                    fs_routed = true;
                 }
                 break;
             case PATH:
                 if ( likely(path != NULL) )
                 {
-                    if ( (path_len >= obj->len) && !strncmp(path, obj->string, obj->len) )
+                    if ( (path_len >= obj->len) && (obj->len > best_len) && !strncmp(path, obj->string, obj->len) )
                     {
                         groupID = obj->group;
-                        goto routed;
+                        best_len = obj->len;
                     }
                 }
                 break;
@@ -395,6 +453,7 @@ static inline void waitVettingResponse(const void* self, VettingGroup* group, Ve
         {
             if ( likely(atomic_read(&details->complete) > 0) )
             {
+                talpa_latency_record(ELS_Wakeup, details->respondedAt);
 #ifdef DEBUG
                 switch ( details->report->recommendedAction(details->report->object) )
                 {
@@ -520,6 +579,7 @@ static inline void waitVettingResponse(const void* self, VettingGroup* group, Ve
             if ( ret == -ETIME )
             {
                 dbg("[intercepted %u-%u-%u] timeout", processParentPID(current), current->tgid, current->pid);
+                trace_talpa_vetting_timeout(details->vettingID, details->fileInfo, details->filesystemInfo, details->threadInfo);
                 details->report->setRecommendedAction(details->report->object, EIA_Timeout);
                 if ( this->mTimeoutDeny )
                 {
@@ -540,13 +600,18 @@ static inline void waitVettingResponse(const void* self, VettingGroup* group, Ve
     return;
 }
 
+static inline talpa_list_head* clientBucket(const void* self, const struct task_struct* process)
+{
+    return &this->mClients[((((unsigned long)process) >> L1_CACHE_SHIFT) * 2654435761UL) & (VETCTRL_CLIENT_BUCKETS - 1)];
+}
+
 static inline bool excludeClient(const void* self)
 {
     VettingClient* client;
     struct task_struct* intercepted = current;
 
     talpa_rcu_read_lock(&this->mClientsLock);
-    talpa_list_for_each_entry_rcu(client, &this->mClients, head)
+    talpa_list_for_each_entry_rcu(client, clientBucket(this, intercepted), head)
     {
         if ( unlikely( client->process == intercepted ) )
         {
@@ -565,10 +630,8 @@ static inline bool excludeClient(const void* self)
 static void examineFile(const void* self, IEvaluationReport* report, const IPersonality* userInfo, const IFileInfo* info, IFile* file)
 {
     const char* filename;
-    const char* fstype;
     unsigned int len;
     unsigned int filename_len = 0;
-    unsigned int fstype_len = 0;
     VettingDetails* details;
     VettingGroup* group;
     IThreadInfo* threadInfo;
@@ -601,13 +664,7 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
     {
         filename_len = strlen(filename);
     }
-    fstype = info->fsType(info);
-    if ( likely(fstype != NULL) )
-    {
-        fstype_len = strlen(fstype);
-    }
-
-    group = routeRequest(this, filename, filename_len, fstype, fstype_len);
+    group = routeRequest(this, filename, filename_len, info->fsTypeId(info), info->fsType(info));
     if ( unlikely(!group) )
     {
         return;
@@ -781,9 +838,16 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
     packet->extOffset = 0;
 
     atomic_set(&details->complete, 0);
+    details->dequeuedAt = details->respondedAt = 0;
 
     /* See did we get the File object? */
-    if ( file == NULL )
+    if ( file == NULL && info->sharedFile(info) != NULL )
+    {
+        /* Only now is the intercepted file worth a reference */
+        file = this->mFilesystemFactory->cloneFile(this->mFilesystemFactory, info->sharedFile(info));
+        dbg("Cloned file object 0x%p", file);
+    }
+    else if ( file == NULL )
     {
         file = this->mFilesystemFactory->newFile(this->mFilesystemFactory);
         dbg("Created file object 0x%p", file);
@@ -927,6 +991,8 @@ static void examineFile(const void* self, IEvaluationReport* report, const IPers
         info->get(info);
 
         /* Insert the details on a list */
+        details->queuedAt = talpa_latency_now();
+        trace_talpa_vetting_enqueue(details->vettingID, details->fileInfo, details->filesystemInfo, details->threadInfo);
         talpa_group_lock(&group->lock);
         talpa_list_add_tail(&details->head, &group->intercepted);
         talpa_group_unlock(&group->lock);
@@ -997,7 +1063,7 @@ static void examineFilesystem(const void* self, IEvaluationReport* report,
         fstype_len = strlen(fstype);
     }
 
-    group = routeRequest(this, path, path_len, fstype, fstype_len);
+    group = routeRequest(this, path, path_len, fstype ? talpa_fstype_find(fstype) : TALPA_FSTYPE_NONE, fstype);
     if ( unlikely(!group) )
     {
         return;
@@ -1132,6 +1198,7 @@ static void examineFilesystem(const void* self, IEvaluationReport* report,
     packet->extOffset = 0;
 
     atomic_set(&details->complete, 0);
+    details->dequeuedAt = details->respondedAt = 0;
 
     /* Get the next vettingId */
     talpa_simple_lock(&this->mVettingIDLock);
@@ -1145,6 +1212,8 @@ static void examineFilesystem(const void* self, IEvaluationReport* report,
     info->get(info);
 
     /* Insert the details on a list */
+    details->queuedAt = talpa_latency_now();
+    trace_talpa_vetting_enqueue(details->vettingID, details->fileInfo, details->filesystemInfo, details->threadInfo);
     talpa_group_lock(&group->lock);
     talpa_list_add_tail(&details->head, &group->intercepted);
     talpa_group_unlock(&group->lock);
@@ -1178,6 +1247,7 @@ static VetCtrlConfigObject* newObject(const void *self, EVetCtrlRoutingType type
         TALPA_INIT_LIST_HEAD(&obj->head);
         obj->type = type;
         obj->group = group;
+        obj->fstype = (type == FILESYSTEM) ? talpa_fstype_intern(string) : TALPA_FSTYPE_NONE;
         obj->len = strlen(string);
         obj->string = talpa_alloc(obj->len + 1);
         if ( !obj->string )
@@ -1360,7 +1430,6 @@ static bool removeObject(const void *self, talpa_list_head* list, const char* va
     {
         talpa_list_del_rcu(&obj->head);
         talpa_rcu_write_unlock(&this->mConfigLock);
-        deleteObject(this, obj);
         switch ( obj->type )
         {
             case FILESYSTEM:
@@ -1370,6 +1439,7 @@ static bool removeObject(const void *self, talpa_list_head* list, const char* va
                 info("Path %s removed from routing table", value);
                 break;
         }
+        deleteObject(this, obj);
         return true;
     }
     talpa_rcu_write_unlock(&this->mConfigLock);
@@ -1377,6 +1447,130 @@ static bool removeObject(const void *self, talpa_list_head* list, const char* va
     return false;
 }
 
+static void deleteRoutingTable(VetCtrlRoutingTable* table)
+{
+    if ( table )
+    {
+        deletePathSet(table->paths);
+        deletePathSet(table->fsnames);
+        talpa_free(table);
+    }
+
+    return;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
+static void deleteRoutingTableRcu(talpa_rcu_head* head)
+{
+    deleteRoutingTable(container_of(head, VetCtrlRoutingTable, rcu));
+}
+#endif
+
+/*
+ * Builds the set of path routes, or of filesystem routes for unregistered
+ * types. Leaves *set NULL if there are no such routes.
+ */
+static bool compileRouteSet(talpa_list_head* list, EVetCtrlRoutingType type, PathSet** set)
+{
+    VetCtrlConfigObject* obj;
+    unsigned int count = 0;
+    size_t bytes = 0;
+
+
+    *set = NULL;
+
+    talpa_list_for_each_entry(obj, list, head)
+    {
+        if ( (obj->type == type) && (obj->fstype == TALPA_FSTYPE_NONE) )
+        {
+            count++;
+            bytes += obj->len;
+        }
+    }
+
+    if ( !count )
+    {
+        return true;
+    }
+
+    *set = newPathSet(count, bytes);
+    if ( !*set )
+    {
+        return false;
+    }
+
+    talpa_list_for_each_entry(obj, list, head)
+    {
+        if ( (obj->type == type) && (obj->fstype == TALPA_FSTYPE_NONE) )
+        {
+            /* Adding a string again keeps the first one, as the list did. */
+            if ( !pathSetAdd(*set, obj->string, (void *)(unsigned long)(obj->group + 1)) )
+            {
+                deletePathSet(*set);
+                *set = NULL;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Rebuilds the routing table after the routing list has changed and swaps
+ * it in. Called with mConfigSerialize held.
+ */
+static void compileRoutes(const void* self)
+{
+    VetCtrlConfigObject* obj;
+    VetCtrlRoutingTable* table;
+    VetCtrlRoutingTable* oldtable;
+
+
+    table = talpa_zalloc(sizeof(VetCtrlRoutingTable));
+    if ( table )
+    {
+        if ( !compileRouteSet(&this->mRoutings, PATH, &table->paths) ||
+             !compileRouteSet(&this->mRoutings, FILESYSTEM, &table->fsnames) )
+        {
+            deleteRoutingTable(table);
+            table = NULL;
+        }
+    }
+
+    if ( table )
+    {
+        talpa_list_for_each_entry(obj, &this->mRoutings, head)
+        {
+            if ( (obj->type == FILESYSTEM) && (obj->fstype != TALPA_FSTYPE_NONE) && !table->fstypes[obj->fstype] )
+            {
+                table->fstypes[obj->fstype] = obj->group + 1;
+            }
+        }
+    }
+    else
+    {
+        warn("Failed to compile the routing table, falling back to list routing!");
+    }
+
+    talpa_rcu_write_lock(&this->mConfigLock);
+    oldtable = this->mRoutingTable;
+    talpa_rcu_assign_pointer(this->mRoutingTable, table);
+    talpa_rcu_write_unlock(&this->mConfigLock);
+
+    if ( oldtable )
+    {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
+        talpa_rcu_call(&oldtable->rcu, deleteRoutingTableRcu);
+#else
+        talpa_rcu_synchronize();
+        deleteRoutingTable(oldtable);
+#endif
+    }
+
+    return;
+}
+
 static void doActionString(const void* self, talpa_list_head* list, char** set, const char* value)
 {
     if ( strlen(value) < 2 )
@@ -1419,6 +1613,11 @@ static void doActionString(const void* self, talpa_list_head* list, char** set,
                         char* res;
 
                         group = simple_strtoul(group_string, &res, 10);
+                        if ( group >= VETTING_GROUPS )
+                        {
+                            err("Routing group %u out of range!", group);
+                            return;
+                        }
                         appendObject(this, list, type, value_string, group);
                         destroyStringSet(this, set);
                         return;
@@ -1621,7 +1820,7 @@ static struct TalpaProtocolHeader* registerClient(void* self, VettingClient* cli
     client->stream->header.type = TALPA_PKT_STREAMDATA;
 
     talpa_rcu_write_lock(&this->mClientsLock);
-    talpa_list_add_tail_rcu(&client->head, &this->mClients);
+    talpa_list_add_tail_rcu(&client->head, clientBucket(this, client->process));
     client->id = ++this->mNextClientID;
     talpa_rcu_write_unlock(&this->mClientsLock);
 
@@ -1971,6 +2170,9 @@ static struct TalpaProtocolHeader* obtainVettingDetails(void* self, VettingClien
 
         if ( likely(job != NULL) )
         {
+            talpa_latency_record(ELS_Queued, job->queuedAt);
+            job->dequeuedAt = talpa_latency_now();
+            trace_talpa_vetting_dequeue(job->vettingID, job->fileInfo, job->filesystemInfo, job->threadInfo);
             /* Set the active packet to point to vetting details */
             job->packet = job->vettingDetails;
             /* Assign the job to this client */
@@ -2098,6 +2300,10 @@ static struct TalpaProtocolHeader* vettingResponse(void* self, VettingClient* cl
             dbg("[%u] Client responded with a unknown response %u!", (unsigned int)client->id, packet->response);
     }
 
+    talpa_latency_record(ELS_Service, job->dequeuedAt);
+    job->respondedAt = talpa_latency_now();
+    trace_talpa_vetting_response(job->vettingID, job->fileInfo, job->filesystemInfo, job->threadInfo, packet->response);
+
     /* Wake up the intercepted process */
     job->report->externallyVetted(job->report);
     atomic_set(&job->complete, 1);
@@ -2662,6 +2868,7 @@ static void  setConfig(void* self, const char* name, const char* value)
     else if ( !strcmp(name, CFG_ROUTING) )
     {
         doActionString(this, &this->mRoutings, &(this->mRoutingsSet), value);
+        compileRoutes(this);
     }
     else if (strcmp(name, CFG_XHACK) == 0)
     {
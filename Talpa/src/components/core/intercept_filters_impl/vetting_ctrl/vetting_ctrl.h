@@ -30,6 +30,8 @@
 #include "configurator/iconfigurable.h"
 #include "filesystem/ifilesystem_factory.h"
 #include "process_and_thread/ithreadandprocess_factory.h"
+#include "platform/fstype.h"
+#include "components/core/path_set_impl/path_set.h"
 
 /*
  * Configuration structures
@@ -44,6 +46,7 @@
 #define VETTING_GROUPS          (8)
 #define VETCTRL_GROUPSDATASIZE  (2*(VETTING_GROUPS*(10+1))+1)
 #define VETCTRL_OPSDATASIZE  (64)
+#define VETCTRL_CLIENT_BUCKETS  (64)
 
 
 typedef struct {
@@ -83,8 +86,23 @@ typedef struct
     char*               string;
     unsigned int        len;
     unsigned int        group;
+    unsigned int        fstype;
 } VetCtrlConfigObject;
 
+/*
+ * Routing table compiled from the routing list, values are group + 1.
+ *
+ * A request goes to the group of the longest path route which is a prefix
+ * of its path. Filesystem routes apply only when no path route does.
+ */
+typedef struct
+{
+    PathSet*            paths;
+    PathSet*            fsnames;    /* Routes for unregistered filesystem types */
+    unsigned int        fstypes[TALPA_FSTYPE_MAX];
+    talpa_rcu_head      rcu;
+} VetCtrlRoutingTable;
+
 
 
 typedef struct tag_VettingController
@@ -98,7 +116,7 @@ typedef struct tag_VettingController
     talpa_simple_lock_t       mVettingIDLock;
     uint32_t                  mNextVettingID;
     talpa_rcu_lock_t          mClientsLock;
-    talpa_list_head           mClients;
+    talpa_list_head           mClients[VETCTRL_CLIENT_BUCKETS]; /* Hashed by client task */
     VettingClientID           mNextClientID;
     VettingGroup              mGroups[VETTING_GROUPS];
     unsigned int              mFOPLookup[6];
@@ -112,6 +130,7 @@ typedef struct tag_VettingController
     atomic_t                  mFSTimeout;
     bool                      mTimeoutDeny;
     char*                     mRoutingsSet;
+    VetCtrlRoutingTable*      mRoutingTable;
 
     PODConfigurationElement   mConfig[10];
     VetCtrlConfigData         mStateConfigData;
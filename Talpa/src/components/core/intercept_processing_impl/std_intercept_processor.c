@@ -17,11 +17,16 @@
  *
  */
 #include <linux/kernel.h>
+#include <linux/version.h>
 
 #include <linux/string.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
+#include <linux/math64.h>
+#endif
 
 #include <asm/errno.h>
 #include <asm/atomic.h>
+#include <asm/div64.h>
 #include <linux/spinlock.h>
 
 #include <common/talpa.h>
@@ -34,6 +39,24 @@
 #include "std_intercept_processor.h"
 
 #include "platform/alloc.h"
+#include "platform/trace.h"
+#include "platform/capture.h"
+#include "platform/verdict.h"
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,26)
+/* Only used for reporting means, where dropping low bits of a huge divisor is fine */
+static inline uint64_t div64_u64(uint64_t dividend, uint64_t divisor)
+{
+    while ( divisor >> 32 )
+    {
+        divisor >>= 1;
+        dividend >>= 1;
+    }
+    do_div(dividend, (uint32_t)divisor);
+
+    return dividend;
+}
+#endif
 
 /*
  * Forward declare implementation methods.
@@ -65,6 +88,13 @@ static void deleteStandardInterceptProcessor(struct tag_StandardInterceptProcess
 #define CFG_VALUE_DISABLED  "disabled"
 #define CFG_ACTION_ENABLE   "enable"
 #define CFG_ACTION_DISABLE  "disable"
+#define CFG_LATENCY         "latency"
+#define CFG_STATS           "filter-stats"
+#define CFG_STATS_SAMPLING  "filter-sampling"
+#define CFG_STATS_DEFAULT_SAMPLING  (64)
+#define CFG_CAPTURE         "capture"
+#define CFG_CAPTURE_LOST    "capture-lost"
+#define CFG_LOCK_STATS      "lock-stats"
 
 /*
  * Template Object.
@@ -101,11 +131,54 @@ static StandardInterceptProcessor template_StandardInterceptProcessor =
         {},
         {},
         ATOMIC_INIT(0),
+        TALPA_MUTEX_INIT,
+        false,
+        CFG_STATS_DEFAULT_SAMPLING,
         {
             {NULL, NULL, STDINTPROC_CFGDATASIZE, false, true },
+            {NULL, NULL, STDINTPROC_CFGDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_LATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_LATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_LATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_LATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_LATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_LATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_LATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_CFGDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_CFGDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_STATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_STATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_STATDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_CFGDATASIZE, true, true },
+            {NULL, NULL, STDINTPROC_CFGDATASIZE, false, true },
+#ifdef TALPA_LOCK_STATS
+            {NULL, NULL, STDINTPROC_STATDATASIZE, true, true },
+#endif
             {NULL, NULL, 0, false, false }
         },
-        { CFG_STATUS, CFG_VALUE_ENABLED }
+        { CFG_STATUS, CFG_VALUE_ENABLED },
+        { CFG_LATENCY, CFG_VALUE_DISABLED },
+        {
+            { "latency-intercept", "" },
+            { "latency-inode", "" },
+            { "latency-fileinfo", "" },
+            { "latency-filters", "" },
+            { "latency-queued", "" },
+            { "latency-service", "" },
+            { "latency-wakeup", "" }
+        },
+        { CFG_STATS, CFG_VALUE_DISABLED },
+        { CFG_STATS_SAMPLING, "64" },
+        {
+            { "filter-stats-evaluation", "" },
+            { "filter-stats-allow", "" },
+            { "filter-stats-deny", "" }
+        },
+        { CFG_CAPTURE, CFG_VALUE_DISABLED },
+        { CFG_CAPTURE_LOST, "0" },
+#ifdef TALPA_LOCK_STATS
+        { CFG_LOCK_STATS, "" }
+#endif
     };
 #define this    ((StandardInterceptProcessor*)self)
 
@@ -116,6 +189,8 @@ static StandardInterceptProcessor template_StandardInterceptProcessor =
 StandardInterceptProcessor* newStandardInterceptProcessor(void)
 {
     StandardInterceptProcessor* object;
+    unsigned int                stage;
+    unsigned int                chain;
 
 
     object = talpa_alloc(sizeof(template_StandardInterceptProcessor));
@@ -123,8 +198,35 @@ StandardInterceptProcessor* newStandardInterceptProcessor(void)
     {
         memcpy(object, &template_StandardInterceptProcessor, sizeof(template_StandardInterceptProcessor));
         object->i_IInterceptProcessor.object = object->i_IConfigurable.object = object;
+
+        talpa_mutex_init(&object->mConfigSerialize);
+
         object->mConfig[0].name  = object->mConfigData.name;
         object->mConfig[0].value = object->mConfigData.value;
+        object->mConfig[1].name  = object->mLatencyConfigData.name;
+        object->mConfig[1].value = object->mLatencyConfigData.value;
+        for ( stage = 0; stage < ELS_Max; stage++ )
+        {
+            object->mConfig[2 + stage].name  = object->mLatencyData[stage].name;
+            object->mConfig[2 + stage].value = object->mLatencyData[stage].value;
+        }
+        object->mConfig[2 + ELS_Max].name  = object->mStatsConfigData.name;
+        object->mConfig[2 + ELS_Max].value = object->mStatsConfigData.value;
+        object->mConfig[3 + ELS_Max].name  = object->mStatsSampleConfigData.name;
+        object->mConfig[3 + ELS_Max].value = object->mStatsSampleConfigData.value;
+        for ( chain = 0; chain < ESC_Max; chain++ )
+        {
+            object->mConfig[4 + ELS_Max + chain].name  = object->mStatsData[chain].name;
+            object->mConfig[4 + ELS_Max + chain].value = object->mStatsData[chain].value;
+        }
+        object->mConfig[4 + ELS_Max + ESC_Max].name  = object->mCaptureConfigData.name;
+        object->mConfig[4 + ELS_Max + ESC_Max].value = object->mCaptureConfigData.value;
+        object->mConfig[5 + ELS_Max + ESC_Max].name  = object->mCaptureLostConfigData.name;
+        object->mConfig[5 + ELS_Max + ESC_Max].value = object->mCaptureLostConfigData.value;
+#ifdef TALPA_LOCK_STATS
+        object->mConfig[6 + ELS_Max + ESC_Max].name  = object->mLockStatsData.name;
+        object->mConfig[6 + ELS_Max + ESC_Max].value = object->mLockStatsData.value;
+#endif
         TALPA_INIT_LIST_HEAD(&object->mEvaluationActions);
         TALPA_INIT_LIST_HEAD(&object->mAllowActions);
         TALPA_INIT_LIST_HEAD(&object->mDenyActions);
@@ -148,6 +250,55 @@ static void deleteStandardInterceptProcessor(struct tag_StandardInterceptProcess
     return;
 }
 
+/*
+ * Filter statistics. Every call is counted while collection is enabled,
+ * but only one in mStatsSampleRate per CPU is timed since reading the
+ * clock costs more than many of the filters themselves.
+ */
+static inline uint64_t filterStart(const void* self, FilterEntry* entry)
+{
+    unsigned int rate;
+
+
+    if ( likely(!this->mStatsEnabled) || unlikely(!entry->hasStats) )
+    {
+        return 0;
+    }
+
+    talpa_pcpu_stats_add(&entry->stats, EFST_Calls, 1);
+
+    rate = this->mStatsSampleRate;
+    if ( rate && ((uint32_t)talpa_pcpu_stats_local(&entry->stats, EFST_Calls) % rate) == 0 )
+    {
+        return talpa_latency_clock();
+    }
+
+    return 0;
+}
+
+static inline void filterDone(const void* self, FilterEntry* entry, EInterceptAction action, uint64_t start)
+{
+    uint64_t now;
+
+
+    if ( likely(!this->mStatsEnabled) || unlikely(!entry->hasStats) )
+    {
+        return;
+    }
+
+    if ( action >= EIA_Restart && action <= EIA_Error )
+    {
+        talpa_pcpu_stats_add(&entry->stats, EFST_Action + action - EIA_Restart, 1);
+    }
+
+    if ( start )
+    {
+        now = talpa_latency_clock();
+        talpa_pcpu_stats_add(&entry->stats, EFST_Timed, 1);
+        talpa_pcpu_stats_add(&entry->stats, EFST_Time, (now > start) ? now - start : 0);
+    }
+}
+
 /*
  * IInterceptProcessor.
  */
@@ -160,6 +311,9 @@ static int examineFileInfo(const void* self, const IFileInfo* info, IFile* file)
     IPersonality*     userInfo;
     EInterceptAction action;
     int retCode;
+    uint64_t start;
+    uint64_t filterStarted;
+    unsigned int filter;
 
     /*
      * Don't examine deleted files on close
@@ -169,6 +323,8 @@ static int examineFileInfo(const void* self, const IFileInfo* info, IFile* file)
         return 0;
     }
 
+    start = talpa_latency_now();
+
     /*
      * Create evaluation report, and obtain the user's personality information.
      */
@@ -194,15 +350,20 @@ static int examineFileInfo(const void* self, const IFileInfo* info, IFile* file)
      */
     start_eval:
     evalReport->i_IEvaluationReport.setRecommendedAction(evalReport, EIA_Next);
+    filter = 0;
     talpa_list_for_each_entry(posptr, &this->mEvaluationActions, list)
     {
+        filter++;
         if ( unlikely(!posptr->filter->examineFile || !posptr->filter->isEnabled(posptr->filter->object)) )
         {
             continue;
         }
 
+        filterStarted = filterStart(this, posptr);
         posptr->filter->examineFile(posptr->filter->object, &evalReport->i_IEvaluationReport, userInfo, info, file);
         action = evalReport->i_IEvaluationReport.recommendedAction(evalReport);
+        filterDone(this, posptr, action, filterStarted);
+        trace_talpa_filter_file(filter, info, action);
 
         if (action == EIA_Next)
         {
@@ -236,7 +397,9 @@ static int examineFileInfo(const void* self, const IFileInfo* info, IFile* file)
             continue;
         }
 
+        filterStarted = filterStart(this, posptr);
         posptr->filter->examineFile(posptr->filter->object, &evalReport->i_IEvaluationReport, userInfo, info, file);
+        filterDone(this, posptr, evalReport->i_IEvaluationReport.recommendedAction(evalReport), filterStarted);
     }
 
     /*
@@ -265,6 +428,8 @@ static int examineFileInfo(const void* self, const IFileInfo* info, IFile* file)
 
     evalReport->delete(evalReport);
 
+    talpa_latency_record(ELS_Filters, start);
+
     switch ( action )
     {
         case EIA_Next:
@@ -287,8 +452,12 @@ static int examineInode(const void* self, const EFilesystemOperation op, const b
 {
     FilterEntry*        posptr;
     EInterceptAction    action;
+    EInterceptAction    result;
     talpa_list_head*    actionList = NULL;
     int                 retCode = 0;
+    uint64_t            start = talpa_latency_now();
+    uint64_t            filterStarted;
+    unsigned int        filter;
 
 
     /*
@@ -296,14 +465,19 @@ static int examineInode(const void* self, const EFilesystemOperation op, const b
      */
      start_eval:
      action = EIA_Next;
+     filter = 0;
      talpa_list_for_each_entry(posptr, &this->mEvaluationActions, list)
      {
+        filter++;
         if ( unlikely( !posptr->filter->examineInode || !posptr->filter->isEnabled(posptr->filter->object) ) )
         {
             continue;
         }
 
+        filterStarted = filterStart(this, posptr);
         action = posptr->filter->examineInode(posptr->filter->object, op, writable, flags, device, inode);
+        filterDone(this, posptr, action, filterStarted);
+        trace_talpa_filter_inode(filter, op, device, inode, action);
 
         if ( action == EIA_Next )
         {
@@ -338,7 +512,10 @@ static int examineInode(const void* self, const EFilesystemOperation op, const b
                 continue;
             }
 
-            if ( posptr->filter->examineInode(posptr->filter->object, op, writable, flags, device, inode) == EIA_Error )
+            filterStarted = filterStart(this, posptr);
+            result = posptr->filter->examineInode(posptr->filter->object, op, writable, flags, device, inode);
+            filterDone(this, posptr, result, filterStarted);
+            if ( result == EIA_Error )
             {
                 break;
             }
@@ -364,6 +541,8 @@ static int examineInode(const void* self, const EFilesystemOperation op, const b
             break;
     }
 
+    talpa_latency_record(ELS_Inode, start);
+
     return retCode;
 }
 
@@ -375,6 +554,7 @@ static int runAllowChain(const void* self, const IFileInfo* info)
     IPersonality*           userInfo;
     EInterceptAction        action;
     int                     retCode;
+    uint64_t                filterStarted;
 
 
     /*
@@ -407,7 +587,9 @@ static int runAllowChain(const void* self, const IFileInfo* info)
             continue;
         }
 
+        filterStarted = filterStart(this, posptr);
         posptr->filter->examineFile(posptr->filter->object, &evalReport->i_IEvaluationReport, userInfo, info, NULL);
+        filterDone(this, posptr, evalReport->i_IEvaluationReport.recommendedAction(evalReport), filterStarted);
 
         if ( unlikely(evalReport->i_IEvaluationReport.recommendedAction(evalReport) == EIA_Error) )
         {
@@ -468,6 +650,7 @@ static int examineFilesystemInfo(const void* self, const IFilesystemInfo* info)
     IPersonality*     userInfo;
     EInterceptAction action;
     int retCode;
+    uint64_t filterStarted;
 
     /*
      * Create evaluation report.
@@ -501,8 +684,10 @@ static int examineFilesystemInfo(const void* self, const IFilesystemInfo* info)
             continue;
         }
 
+        filterStarted = filterStart(this, posptr);
         posptr->filter->examineFilesystem(posptr->filter->object, &evalReport->i_IEvaluationReport, userInfo, info);
         action = evalReport->i_IEvaluationReport.recommendedAction(evalReport);
+        filterDone(this, posptr, action, filterStarted);
 
         if (action == EIA_Next)
         {
@@ -537,7 +722,9 @@ static int examineFilesystemInfo(const void* self, const IFilesystemInfo* info)
             continue;
         }
 
+        filterStarted = filterStart(this, posptr);
         posptr->filter->examineFilesystem(posptr->filter->object, &evalReport->i_IEvaluationReport, userInfo, info);
+        filterDone(this, posptr, evalReport->i_IEvaluationReport.recommendedAction(evalReport), filterStarted);
 
         if ( unlikely(evalReport->i_IEvaluationReport.recommendedAction(evalReport) == EIA_Error) )
         {
@@ -589,7 +776,10 @@ static int examineFilesystemInfo(const void* self, const IFilesystemInfo* info)
     return 0;
 }
 
-static void addEvaluationFilter(void* self, IInterceptFilter* filter)
+/*
+ * A filter is still run if there is no memory for its statistics.
+ */
+static FilterEntry* newFilterEntry(IInterceptFilter* filter)
 {
     FilterEntry*    filterInfo;
 
@@ -598,7 +788,30 @@ static void addEvaluationFilter(void* self, IInterceptFilter* filter)
     if ( filterInfo )
     {
         filterInfo->filter = filter;
+        filterInfo->hasStats = !talpa_pcpu_stats_init(&filterInfo->stats, EFST_Max);
+    }
+    return filterInfo;
+}
+
+static void freeFilterEntry(FilterEntry* filterInfo)
+{
+    if ( filterInfo->hasStats )
+    {
+        talpa_pcpu_stats_destroy(&filterInfo->stats);
+    }
+    talpa_free(filterInfo);
+}
+
+static void addEvaluationFilter(void* self, IInterceptFilter* filter)
+{
+    FilterEntry*    filterInfo;
+
+
+    filterInfo = newFilterEntry(filter);
+    if ( filterInfo )
+    {
         talpa_list_add_tail(&filterInfo->list, &(this->mEvaluationActions));
+        talpa_verdict_invalidate();
     }
     return;
 }
@@ -608,10 +821,9 @@ static void addAllowFilter(void* self, IInterceptFilter* filter)
     FilterEntry*    filterInfo;
 
 
-    filterInfo = talpa_alloc(sizeof(FilterEntry));
+    filterInfo = newFilterEntry(filter);
     if ( filterInfo )
     {
-        filterInfo->filter = filter;
         talpa_list_add_tail(&filterInfo->list, &(this->mAllowActions));
     }
     return;
@@ -622,10 +834,9 @@ static void addDenyFilter(void* self, IInterceptFilter* filter)
     FilterEntry*    filterInfo;
 
 
-    filterInfo = talpa_alloc(sizeof(FilterEntry));
+    filterInfo = newFilterEntry(filter);
     if ( filterInfo )
     {
-        filterInfo->filter = filter;
         talpa_list_add_tail(&filterInfo->list, &(this->mDenyActions));
     }
     return;
@@ -641,7 +852,8 @@ static void removeEvaluationFilter(void* self, const IInterceptFilter* filter)
         if (posptr->filter == filter)
         {
             talpa_list_del(&posptr->list);
-            talpa_free(posptr);
+            freeFilterEntry(posptr);
+            talpa_verdict_invalidate();
             break;
         }
     }
@@ -658,7 +870,7 @@ static void removeAllowFilter(void* self, const IInterceptFilter* filter)
         if (posptr->filter == filter)
         {
             talpa_list_del(&posptr->list);
-            talpa_free(posptr);
+            freeFilterEntry(posptr);
             break;
         }
     }
@@ -675,7 +887,7 @@ static void removeDenyFilter(void* self, const IInterceptFilter* filter)
         if (posptr->filter == filter)
         {
             talpa_list_del(&posptr->list);
-            talpa_free(posptr);
+            freeFilterEntry(posptr);
             break;
         }
     }
@@ -691,8 +903,9 @@ static void resetEvaluationFilters(void* self)
     talpa_list_for_each_safe(posptr, nptr, &this->mEvaluationActions)
     {
         talpa_list_del(posptr);
-        talpa_free(talpa_list_entry(posptr, FilterEntry, list));
+        freeFilterEntry(talpa_list_entry(posptr, FilterEntry, list));
     }
+    talpa_verdict_invalidate();
     return;
 }
 
@@ -705,7 +918,7 @@ static void resetAllowFilters(void* self)
     talpa_list_for_each_safe(posptr, nptr, &this->mAllowActions)
     {
         talpa_list_del(posptr);
-        talpa_free(talpa_list_entry(posptr, FilterEntry, list));
+        freeFilterEntry(talpa_list_entry(posptr, FilterEntry, list));
     }
     return;
 }
@@ -719,7 +932,7 @@ static void resetDenyFilters(void* self)
     talpa_list_for_each_safe(posptr, nptr, &this->mDenyActions)
     {
         talpa_list_del(posptr);
-        talpa_free(talpa_list_entry(posptr, FilterEntry, list));
+        freeFilterEntry(talpa_list_entry(posptr, FilterEntry, list));
     }
     return;
 }
@@ -737,15 +950,136 @@ static const PODConfigurationElement* allConfig(const void* self)
     return this->mConfig;
 }
 
+/*
+ * Formats a stage histogram as a count and mean followed by the
+ * non-empty buckets, each labelled with its lower bound in nanoseconds.
+ */
+static void formatLatency(char* buf, size_t size, ETalpaLatencyStage stage)
+{
+    talpa_latency_hist_t    hist;
+    unsigned long long      count = 0;
+    unsigned long long      mean;
+    unsigned int            b;
+    int                     len;
+
+
+    talpa_latency_read(stage, &hist);
+
+    for ( b = 0; b < TALPA_LATENCY_BUCKETS; b++ )
+    {
+        count += hist.count[b];
+    }
+
+    mean = hist.total;
+    if ( count )
+    {
+        mean = div64_u64(mean, count);
+    }
+
+    len = snprintf(buf, size, "Count: %llu, Mean: %lluns\n", count, mean);
+
+    for ( b = 0; b < TALPA_LATENCY_BUCKETS && len < (int)size; b++ )
+    {
+        if ( hist.count[b] )
+        {
+            len += snprintf(buf + len, size - len, "%llu: %lu\n", b ? 1ULL << b : 0ULL, hist.count[b]);
+        }
+    }
+}
+
+static talpa_list_head* statsChain(const void* self, EStatsChain chain)
+{
+    switch ( chain )
+    {
+        case ESC_Evaluation:
+            return &this->mEvaluationActions;
+        case ESC_Allow:
+            return &this->mAllowActions;
+        default:
+            return &this->mDenyActions;
+    }
+}
+
+/*
+ * Formats one line per filter in a chain, numbered by position like the
+ * tracepoints, with its calls, decisions and mean sampled time.
+ */
+static void formatStats(const void* self, char* buf, size_t size, EStatsChain chain)
+{
+    FilterEntry*        posptr;
+    unsigned int        filter = 0;
+    unsigned long long  mean;
+    unsigned long long  timed;
+    int                 len = 0;
+
+
+    buf[0] = '\0';
+
+    talpa_list_for_each_entry(posptr, statsChain(self, chain), list)
+    {
+        filter++;
+        if ( !posptr->hasStats || len >= (int)size )
+        {
+            continue;
+        }
+
+        mean = talpa_pcpu_stats_sum(&posptr->stats, EFST_Time);
+        timed = talpa_pcpu_stats_sum(&posptr->stats, EFST_Timed);
+        if ( timed )
+        {
+            mean = div64_u64(mean, timed);
+        }
+
+        len += snprintf(buf + len, size - len,
+                        "%u: calls %llu, next %llu, allow %llu, deny %llu, timeout %llu, error %llu, restart %llu, mean %lluns\n",
+                        filter,
+                        (unsigned long long)talpa_pcpu_stats_sum(&posptr->stats, EFST_Calls),
+                        (unsigned long long)talpa_pcpu_stats_sum(&posptr->stats, EFST_Action + EIA_Next - EIA_Restart),
+                        (unsigned long long)talpa_pcpu_stats_sum(&posptr->stats, EFST_Action + EIA_Allow - EIA_Restart),
+                        (unsigned long long)talpa_pcpu_stats_sum(&posptr->stats, EFST_Action + EIA_Deny - EIA_Restart),
+                        (unsigned long long)talpa_pcpu_stats_sum(&posptr->stats, EFST_Action + EIA_Timeout - EIA_Restart),
+                        (unsigned long long)talpa_pcpu_stats_sum(&posptr->stats, EFST_Action + EIA_Error - EIA_Restart),
+                        (unsigned long long)talpa_pcpu_stats_sum(&posptr->stats, EFST_Action + EIA_Restart - EIA_Restart),
+                        mean);
+    }
+}
+
+static void resetStats(const void* self, EStatsChain chain)
+{
+    FilterEntry*        posptr;
+
+
+    talpa_list_for_each_entry(posptr, statsChain(self, chain), list)
+    {
+        if ( posptr->hasStats )
+        {
+            talpa_pcpu_stats_reset(&posptr->stats);
+        }
+    }
+}
+
+static void setSampling(const void* self, const char* string)
+{
+    unsigned int val;
+    char* res;
+
+
+    val = simple_strtoul(string, &res, 10);
+    snprintf(this->mStatsSampleConfigData.value, STDINTPROC_CFGDATASIZE, "%u", val);
+    this->mStatsSampleRate = val;
+}
+
 static const char* config(const void* self, const char* name)
 {
     PODConfigurationElement*    cfgElement;
+    unsigned int                stage;
+    unsigned int                chain;
 
 
     /*
      * Find the named item.
      */
-    for (cfgElement = this->mConfig; cfgElement != NULL; cfgElement++)
+    for (cfgElement = this->mConfig; cfgElement->name != NULL; cfgElement++)
     {
         if (strcmp(name, cfgElement->name) == 0)
         {
@@ -758,6 +1092,39 @@ static const char* config(const void* self, const char* name)
      */
     if ( cfgElement->name )
     {
+        talpa_mutex_lock(&this->mConfigSerialize);
+
+        for ( stage = 0; stage < ELS_Max; stage++ )
+        {
+            if ( cfgElement->value == this->mLatencyData[stage].value )
+            {
+                formatLatency(cfgElement->value, STDINTPROC_LATDATASIZE, (ETalpaLatencyStage)stage);
+                break;
+            }
+        }
+
+        for ( chain = 0; chain < ESC_Max; chain++ )
+        {
+            if ( cfgElement->value == this->mStatsData[chain].value )
+            {
+                formatStats(this, cfgElement->value, STDINTPROC_STATDATASIZE, (EStatsChain)chain);
+                break;
+            }
+        }
+
+        if ( cfgElement->value == this->mCaptureLostConfigData.value )
+        {
+            snprintf(cfgElement->value, STDINTPROC_CFGDATASIZE, "%lu", talpa_capture_lost());
+        }
+#ifdef TALPA_LOCK_STATS
+        else if ( cfgElement->value == this->mLockStatsData.value )
+        {
+            talpa_lock_stats_format(cfgElement->value, STDINTPROC_STATDATASIZE);
+        }
+#endif
+
+        talpa_mutex_unlock(&this->mConfigSerialize);
+
         return cfgElement->value;
     }
     return NULL;
@@ -765,9 +1132,106 @@ static const char* config(const void* self, const char* name)
 
 static void  setConfig(void* self, const char* name, const char* value)
 {
+    PODConfigurationElement*    cfgElement;
+    unsigned int                stage;
+    unsigned int                chain;
+
+
     /*
-     * No configuration items that may be written to!
+     * Find the named item.
      */
+    for (cfgElement = this->mConfig; cfgElement->name != NULL; cfgElement++)
+    {
+        if (strcmp(name, cfgElement->name) == 0)
+        {
+            break;
+        }
+    }
+
+    /*
+     * Cant set that which does not exist!
+     */
+    if ( !cfgElement->name )
+    {
+        return;
+    }
+
+    talpa_mutex_lock(&this->mConfigSerialize);
+
+    if ( !strcmp(name, CFG_LATENCY) )
+    {
+        if ( !strcmp(value, CFG_ACTION_ENABLE) )
+        {
+            talpa_latency_enable(true);
+            strcpy(this->mLatencyConfigData.value, CFG_VALUE_ENABLED);
+        }
+        else if ( !strcmp(value, CFG_ACTION_DISABLE) )
+        {
+            talpa_latency_enable(false);
+            strcpy(this->mLatencyConfigData.value, CFG_VALUE_DISABLED);
+        }
+    }
+    else if ( !strcmp(name, CFG_STATS) )
+    {
+        if ( !strcmp(value, CFG_ACTION_ENABLE) )
+        {
+            this->mStatsEnabled = true;
+            strcpy(this->mStatsConfigData.value, CFG_VALUE_ENABLED);
+        }
+        else if ( !strcmp(value, CFG_ACTION_DISABLE) )
+        {
+            this->mStatsEnabled = false;
+            strcpy(this->mStatsConfigData.value, CFG_VALUE_DISABLED);
+        }
+    }
+    else if ( !strcmp(name, CFG_STATS_SAMPLING) )
+    {
+        setSampling(this, value);
+    }
+    else if ( !strcmp(name, CFG_CAPTURE) )
+    {
+        if ( !strcmp(value, CFG_ACTION_ENABLE) )
+        {
+            if ( !talpa_capture_enable(true) )
+            {
+                strcpy(this->mCaptureConfigData.value, CFG_VALUE_ENABLED);
+            }
+        }
+        else if ( !strcmp(value, CFG_ACTION_DISABLE) )
+        {
+            talpa_capture_enable(false);
+            strcpy(this->mCaptureConfigData.value, CFG_VALUE_DISABLED);
+        }
+    }
+#ifdef TALPA_LOCK_STATS
+    else if ( !strcmp(name, CFG_LOCK_STATS) )
+    {
+        talpa_lock_stats_reset();
+    }
+#endif
+    else
+    {
+        /* Writing anything to a stage or a chain's statistics resets it */
+        for ( stage = 0; stage < ELS_Max; stage++ )
+        {
+            if ( cfgElement->value == this->mLatencyData[stage].value )
+            {
+                talpa_latency_reset((ETalpaLatencyStage)stage);
+                break;
+            }
+        }
+        for ( chain = 0; chain < ESC_Max; chain++ )
+        {
+            if ( cfgElement->value == this->mStatsData[chain].value )
+            {
+                resetStats(this, (EStatsChain)chain);
+                break;
+            }
+        }
+    }
+
+    talpa_mutex_unlock(&this->mConfigSerialize);
+
     return;
 }
 
@@ -24,13 +24,38 @@
 #include "common/list.h"
 #include "intercept_processing/iintercept_processor.h"
 #include "configurator/iconfigurable.h"
+#include "common/locking.h"
+#include "platform/latency.h"
 
 #define STDINTPROC_CFGDATASIZE      (16)
+#define STDINTPROC_LATNAMESIZE      (24)
+#define STDINTPROC_LATDATASIZE      (2048)
+#define STDINTPROC_STATDATASIZE     (2048)
+
+#ifdef TALPA_LOCK_STATS
+#define STDINTPROC_LOCKSTATITEMS    (1)
+#else
+#define STDINTPROC_LOCKSTATITEMS    (0)
+#endif
+
+/*
+ * Per filter statistics, decisions are counted by EInterceptAction.
+ */
+typedef enum
+{
+    EFST_Calls = 0,
+    EFST_Action,
+    EFST_Timed = EFST_Action + EIA_Error - EIA_Restart + 1,
+    EFST_Time,
+    EFST_Max
+} EFilterStat;
 
 typedef struct
 {
     talpa_list_head     list;
     IInterceptFilter*   filter;
+    talpa_pcpu_stats_t  stats;
+    bool                hasStats;
 } FilterEntry;
 
 typedef struct {
@@ -38,6 +63,24 @@ typedef struct {
     char    value[STDINTPROC_CFGDATASIZE];
 } StdIntProcConfigData;
 
+typedef struct {
+    char    name[STDINTPROC_LATNAMESIZE];
+    char    value[STDINTPROC_LATDATASIZE];
+} StdIntProcLatencyData;
+
+typedef struct {
+    char    name[STDINTPROC_LATNAMESIZE];
+    char    value[STDINTPROC_STATDATASIZE];
+} StdIntProcStatsData;
+
+typedef enum
+{
+    ESC_Evaluation = 0,
+    ESC_Allow,
+    ESC_Deny,
+    ESC_Max
+} EStatsChain;
+
 typedef struct tag_StandardInterceptProcessor
 {
     IInterceptProcessor         i_IInterceptProcessor;
@@ -48,8 +91,21 @@ typedef struct tag_StandardInterceptProcessor
     talpa_list_head             mAllowActions;
     talpa_list_head             mDenyActions;
     atomic_t                    mNumConsecutiveTimeouts;
-    PODConfigurationElement     mConfig[2];
+    talpa_mutex_t               mConfigSerialize;
+    bool                        mStatsEnabled;
+    unsigned int                mStatsSampleRate;
+    PODConfigurationElement     mConfig[7 + ELS_Max + ESC_Max + STDINTPROC_LOCKSTATITEMS];
     StdIntProcConfigData        mConfigData;
+    StdIntProcConfigData        mLatencyConfigData;
+    StdIntProcLatencyData       mLatencyData[ELS_Max];
+    StdIntProcConfigData        mStatsConfigData;
+    StdIntProcConfigData        mStatsSampleConfigData;
+    StdIntProcStatsData         mStatsData[ESC_Max];
+    StdIntProcConfigData        mCaptureConfigData;
+    StdIntProcConfigData        mCaptureLostConfigData;
+#ifdef TALPA_LOCK_STATS
+    StdIntProcStatsData         mLockStatsData;
+#endif
 } StandardInterceptProcessor;
 
 /*
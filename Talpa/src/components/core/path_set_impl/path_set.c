@@ -0,0 +1,286 @@
+/*
+ * path_set.c
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/version.h>
+
+#define TALPA_SUBSYS "pathset"
+#include "common/talpa.h"
+#include "path_set.h"
+
+#include "platform/alloc.h"
+
+/* Sets bigger than this are vmalloc'ed, same threshold as the cache uses. */
+#define PATHSET_LARGE_ALLOC     (128*1024)
+#define PATHSET_MIN_BUCKETS     (16)
+
+/* FNV-1a, which can be computed one character at a time while
+ * walking a path. */
+#define PATHSET_HASH_INIT       (2166136261U)
+
+static inline uint32_t hashStep(uint32_t hash, char c)
+{
+    return (hash ^ (unsigned char)c) * 16777619U;
+}
+
+static uint32_t hashString(const char* value, unsigned int len)
+{
+    uint32_t hash = PATHSET_HASH_INIT;
+
+
+    while ( len-- )
+    {
+        hash = hashStep(hash, *value++);
+    }
+
+    return hash;
+}
+
+PathSet* newPathSet(unsigned int count, size_t strbytes)
+{
+    PathSet* set;
+    unsigned int buckets = PATHSET_MIN_BUCKETS;
+    size_t tablebytes;
+    size_t bytes;
+
+
+    /* Keep the load factor at or below one half so probe chains stay short. */
+    while ( buckets < (count * 2) )
+    {
+        buckets <<= 1;
+    }
+
+    tablebytes = buckets * sizeof(PathSetEntry);
+    bytes = sizeof(PathSet) + tablebytes + strbytes + count;
+
+    if ( bytes > PATHSET_LARGE_ALLOC )
+    {
+        set = talpa_large_alloc(bytes);
+    }
+    else
+    {
+        set = talpa_alloc(bytes);
+    }
+
+    if ( !set )
+    {
+        return NULL;
+    }
+
+    memset(set, 0, sizeof(PathSet) + tablebytes);
+    set->mMask = buckets - 1;
+    set->mBytes = bytes;
+    set->mTable = (PathSetEntry *)(set + 1);
+    set->mPool = (char *)(set->mTable + buckets);
+    set->mPoolFree = strbytes + count;
+
+    return set;
+}
+
+void deletePathSet(PathSet* set)
+{
+    if ( !set )
+    {
+        return;
+    }
+
+    if ( set->mBytes > PATHSET_LARGE_ALLOC )
+    {
+        talpa_large_free(set);
+    }
+    else
+    {
+        talpa_free(set);
+    }
+
+    return;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
+static void deletePathSetRcu(talpa_rcu_head* head)
+{
+    deletePathSet(container_of(head, PathSet, mRcu));
+}
+#endif
+
+void deletePathSetDeferred(PathSet* set)
+{
+    if ( !set )
+    {
+        return;
+    }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
+    talpa_rcu_call(&set->mRcu, deletePathSetRcu);
+#else
+    /* vfree() may not be called from RCU callbacks on older kernels. */
+    talpa_rcu_synchronize();
+    deletePathSet(set);
+#endif
+
+    return;
+}
+
+static const PathSetEntry* lookup(const PathSet* set, const char* value, unsigned int len, uint32_t hash)
+{
+    const PathSetEntry* entry;
+    unsigned int index = hash & set->mMask;
+
+
+    for ( entry = &set->mTable[index]; entry->value; entry = &set->mTable[index] )
+    {
+        if ( (entry->hash == hash) && (entry->len == len) && !memcmp(entry->value, value, len) )
+        {
+            return entry;
+        }
+        index = (index + 1) & set->mMask;
+    }
+
+    return NULL;
+}
+
+bool pathSetAdd(PathSet* set, const char* value, void* data)
+{
+    PathSetEntry* entry;
+    unsigned int len = strlen(value);
+    uint32_t hash = hashString(value, len);
+    unsigned int index;
+
+
+    if ( lookup(set, value, len, hash) )
+    {
+        return true;
+    }
+
+    if ( !len || (len >= PATHSET_MAXLEN) )
+    {
+        err("Invalid set member %s!", value);
+        return false;
+    }
+
+    if ( ((set->mCount + 1) * 2 > set->mMask + 1) || (len + 1 > set->mPoolFree) )
+    {
+        err("Set overflow adding %s!", value);
+        return false;
+    }
+
+    index = hash & set->mMask;
+    while ( set->mTable[index].value )
+    {
+        index = (index + 1) & set->mMask;
+    }
+
+    memcpy(set->mPool, value, len + 1);
+    entry = &set->mTable[index];
+    entry->value = set->mPool;
+    entry->len = len;
+    entry->hash = hash;
+    entry->data = data;
+
+    set->mPool += len + 1;
+    set->mPoolFree -= len + 1;
+    set->mCount++;
+    if ( value[len-1] == '/' )
+    {
+        set->mPrefixes++;
+    }
+    if ( len > set->mMaxLen )
+    {
+        set->mMaxLen = len;
+    }
+    __set_bit(len, set->mLengths);
+
+    return true;
+}
+
+const PathSetEntry* pathSetFind(const PathSet* set, const char* value, unsigned int len)
+{
+    if ( (len > set->mMaxLen) || !test_bit(len, set->mLengths) )
+    {
+        return NULL;
+    }
+
+    return lookup(set, value, len, hashString(value, len));
+}
+
+const PathSetEntry* pathSetMatch(const PathSet* set, const char* path, unsigned int len)
+{
+    const PathSetEntry* best = NULL;
+    const PathSetEntry* entry;
+    uint32_t hash = PATHSET_HASH_INIT;
+    unsigned int limit = MIN(len, set->mMaxLen);
+    unsigned int i;
+
+
+    /* Nothing longer than the longest member can match, so the walk
+     * stops there. Every '/' ends a candidate directory prefix. */
+    for ( i = 0; i < limit; i++ )
+    {
+        hash = hashStep(hash, path[i]);
+        if ( (path[i] == '/') && set->mPrefixes && test_bit(i + 1, set->mLengths) )
+        {
+            entry = lookup(set, path, i + 1, hash);
+            if ( entry )
+            {
+                best = entry;
+            }
+        }
+    }
+
+    if ( (len == limit) && test_bit(len, set->mLengths) )
+    {
+        entry = lookup(set, path, len, hash);
+        if ( entry )
+        {
+            best = entry;
+        }
+    }
+
+    return best;
+}
+
+const PathSetEntry* pathSetMatchPrefix(const PathSet* set, const char* path, unsigned int len)
+{
+    const PathSetEntry* best = NULL;
+    const PathSetEntry* entry;
+    uint32_t hash = PATHSET_HASH_INIT;
+    unsigned int limit = MIN(len, set->mMaxLen);
+    unsigned int i;
+
+
+    for ( i = 0; i < limit; i++ )
+    {
+        hash = hashStep(hash, path[i]);
+        if ( test_bit(i + 1, set->mLengths) )
+        {
+            entry = lookup(set, path, i + 1, hash);
+            if ( entry )
+            {
+                best = entry;
+            }
+        }
+    }
+
+    return best;
+}
+
+/*
+ * End of path_set.c
+ */
+
@@ -0,0 +1,109 @@
+/*
+ * path_set.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_PATHSET
+#define H_PATHSET
+
+#include <linux/types.h>
+#include <linux/limits.h>
+#include <linux/bitops.h>
+
+#include "common/bool.h"
+#include "common/list.h"
+
+/*
+ * Immutable hashed set of strings compiled from a configuration list.
+ *
+ * A set is built once (newPathSet() followed by pathSetAdd() for every
+ * member), published with talpa_rcu_assign_pointer() and from then on only
+ * read. Configuration changes build a replacement set and retire the old one
+ * with deletePathSetDeferred(), so lookups need nothing more than an RCU
+ * read lock.
+ *
+ * Members ending in '/' are directory prefixes for pathSetMatch(), all other
+ * members must match in full. Members can be at most PATHSET_MAXLEN - 1
+ * characters long.
+ */
+
+#define PATHSET_MAXLEN  (PATH_MAX)
+
+typedef struct
+{
+    const char*     value;
+    unsigned int    len;
+    uint32_t        hash;
+    void*           data;
+} PathSetEntry;
+
+typedef struct tag_PathSet
+{
+    unsigned int    mMask;
+    unsigned int    mCount;
+    unsigned int    mPrefixes;
+    unsigned int    mMaxLen;
+    size_t          mBytes;
+    size_t          mPoolFree;
+    char*           mPool;
+    PathSetEntry*   mTable;
+    talpa_rcu_head  mRcu;
+    /* Which member lengths exist, so matching only probes where it can hit. */
+    unsigned long   mLengths[PATHSET_MAXLEN / BITS_PER_LONG];
+} PathSet;
+
+/*
+ * Creates an empty set able to hold count members with a total
+ * of strbytes characters (not counting terminators).
+ */
+PathSet* newPathSet(unsigned int count, size_t strbytes);
+void deletePathSet(PathSet* set);
+
+/*
+ * Frees a set which has been unpublished but may still have readers.
+ * Owners must call talpa_rcu_barrier() before they go away.
+ */
+void deletePathSetDeferred(PathSet* set);
+
+/*
+ * Only valid while the set is being built, ie. before it is published.
+ */
+bool pathSetAdd(PathSet* set, const char* value, void* data);
+
+/*
+ * Exact lookup.
+ */
+const PathSetEntry* pathSetFind(const PathSet* set, const char* value, unsigned int len);
+
+/*
+ * Returns the longest member which is either equal to the path or is
+ * a directory prefix of it. Costs one pass over the path plus one probe
+ * per path component, regardless of how many members the set has.
+ */
+const PathSetEntry* pathSetMatch(const PathSet* set, const char* path, unsigned int len);
+
+/*
+ * Returns the longest member which is a plain string prefix of the path,
+ * with no regard for directory boundaries.
+ */
+const PathSetEntry* pathSetMatchPrefix(const PathSet* set, const char* path, unsigned int len);
+
+#endif
+
+/*
+ * End of path_set.h
+ */
+
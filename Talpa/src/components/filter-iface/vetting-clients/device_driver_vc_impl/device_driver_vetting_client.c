@@ -425,7 +425,7 @@ static ssize_t ddvcRead(struct file* file, char __user * buf, size_t len, loff_t
 
     state = (struct DDVC_State*)client->private;
 
-    if ( unlikely(!atomic_read(&state->reading)) )
+    if ( likely(!atomic_read(&state->reading)) )
     {
         struct TalpaProtocolHeader* response;
 
@@ -438,10 +438,34 @@ static ssize_t ddvcRead(struct file* file, char __user * buf, size_t len, loff_t
 
         if ( likely(!ret) )
         {
-            state->stream.buf = state->stream.ptr = (unsigned char *)client->vettingDetails->packet;
-            state->stream.total = state->stream.remain = sizeof(struct TalpaProtocolHeader) + client->vettingDetails->packet->payloadLength;
+            struct TalpaProtocolHeader* details = client->vettingDetails->packet;
+            unsigned int total = sizeof(struct TalpaProtocolHeader) + details->payloadLength;
+
+            /* Whole job fits in the caller's buffer so hand it over in one go,
+               without going through the partial read state. */
+            if ( likely(len >= total) )
+            {
+                if ( likely(!copy_to_user(buf, details, total)) )
+                {
+                    dbg("details 0x%p<%u/%u> read whole, len = %u", client->vettingDetails, client->vettingDetails->vettingID, client->currentVettingID, total);
+                    server->releaseVettingDetails(server->object, client);
+                    return total;
+                }
+
+                /* Keep the job so that it can be read again */
+                dbg("copy_to_user fault!");
+                ret = -EFAULT;
+            }
+
+            state->stream.buf = state->stream.ptr = (unsigned char *)details;
+            state->stream.total = state->stream.remain = total;
             atomic_set(&state->reading, 1);
             dbg("details 0x%p<%u/%u> obtained. buf = 0x%p, len = %u", client->vettingDetails, client->vettingDetails->vettingID, client->currentVettingID, state->stream.buf, state->stream.total);
+
+            if ( unlikely(ret) )
+            {
+                return ret;
+            }
         }
         else if ( ret == -ERESTARTSYS )
         {
@@ -30,6 +30,7 @@
 #include <linux/binfmts.h>
 #include <linux/namei.h>
 #include <linux/security.h>
+#include <linux/hash.h>
 #include <asm/hardirq.h>
 #include <asm/system.h>
 #include <asm/mman.h>
@@ -40,6 +41,10 @@
 #include "platform/talpa_capability.h"
 #include "platforms/linux/alloc.h"
 #include "platforms/linux/glue.h"
+#include "platforms/linux/latency.h"
+#include "platforms/linux/trace.h"
+#include "platforms/linux/verdict.h"
+#include "platforms/linux/baseline.h"
 
 /* define this to use inode_permission hook, undef it to use file_permission */
 #define INODE_PERMISSION
@@ -59,6 +64,7 @@ static const PODConfigurationElement* allConfig(const void* self);
 static const char* config(const void* self, const char* name);
 static void setConfig(void* self, const char* name, const char* value);
 static void deleteLSMInterceptor(struct tag_LSMInterceptor* object);
+static void setCache(struct tag_LSMInterceptor* object, ICache* cache);
 
 static void constructSpecialSet(void* self);
 
@@ -105,6 +111,7 @@ static LSMInterceptor GL_object =
             (void (*)(void*))deleteLSMInterceptor
         },
         deleteLSMInterceptor,
+        setCache,
         false,
         false,
         ATOMIC_INIT(0),
@@ -113,6 +120,7 @@ static LSMInterceptor GL_object =
         0,
         HOOK_DEFAULT,
         NULL,
+        NULL,
         {
             {GL_object.mConfigData.name, GL_object.mConfigData.value, LSM_CFGDATASIZE, true, true },
             {GL_object.mOpsConfigData.name, GL_object.mOpsConfigData.value, LSM_OPSCFGDATASIZE, true, false },
@@ -125,10 +133,148 @@ static LSMInterceptor GL_object =
 
 #define this    ((LSMInterceptor*)self)
 
+/*
+ * Verdict stamps.
+ *
+ * An open or exec which the processor allowed from the inode alone (a
+ * cache hit or an excluded operation) is stamped, so that the next one
+ * on the same inode is decided here without the filter chains or the
+ * cache. The stamps live in small direct mapped tables keyed by the
+ * inode address, not in i_security which belongs to the primary LSM.
+ * A stamp stands while the inode still has the same identity, change
+ * time and size, and no verdict has been invalidated since it was made.
+ *
+ * Execs get a table of their own so that the binaries a system keeps
+ * starting are not pushed out by ordinary opens.
+ */
+static inline LSMVerdictStamp* stampSlot(const void* self, EFilesystemOperation op, const struct inode* inode)
+{
+    if ( op == EFS_Exec )
+    {
+        return &this->mExecStamps[hash_ptr((void*)inode, LSM_EXEC_STAMP_BITS)];
+    }
+
+    return &this->mStamps[hash_ptr((void*)inode, LSM_STAMP_BITS)];
+}
+
+static inline bool stampMatches(const LSMVerdictStamp* stamp, const struct inode* inode)
+{
+    return stamp->inode == inode &&
+           stamp->sb == inode->i_sb &&
+           stamp->ino == inode->i_ino &&
+           stamp->igeneration == inode->i_generation &&
+           stamp->ctime.tv_sec == inode->i_ctime.tv_sec &&
+           stamp->ctime.tv_nsec == inode->i_ctime.tv_nsec &&
+           stamp->size == i_size_read(inode);
+}
+
+static inline bool stampHas(LSMVerdictStamp* stamp, EFilesystemOperation op, const struct inode* inode)
+{
+    unsigned int seq;
+    bool allowed;
+
+
+    do
+    {
+        seq = read_seqbegin(&stamp->lock);
+        allowed = ( stamp->ops & (1 << op) ) &&
+                  stamp->generation == talpa_verdict_current() &&
+                  stampMatches(stamp, inode);
+    } while ( read_seqretry(&stamp->lock, seq) );
+
+    return allowed;
+}
+
+/*
+ * An exec stamp may also carry the open verdict, see stampInode.
+ */
+static inline bool stampAllows(const void* self, EFilesystemOperation op, const struct inode* inode)
+{
+    if ( stampHas(stampSlot(self, op, inode), op, inode) )
+    {
+        return true;
+    }
+
+    return op == EFS_Open && stampHas(stampSlot(self, EFS_Exec, inode), op, inode);
+}
+
+/*
+ * The generation must have been read before the processor was asked,
+ * so that anything invalidated meanwhile leaves the stamp already stale.
+ *
+ * An allow is only stamped when the cache holds the file. Filters may
+ * allow on the open flags or the calling process alone, and such a
+ * verdict must not let a later plain open by someone else go through.
+ * The cache does not depend on either, so a cached exec also carries
+ * the open verdict and scripts or binaries read by their interpreter go
+ * straight through. The cache is asked directly so the probe does not
+ * show up in the processor's statistics or the capture.
+ */
+static void stampInode(const void* self, EFilesystemOperation op, struct inode* inode, unsigned int generation)
+{
+    LSMVerdictStamp* stamp = stampSlot(self, op, inode);
+    unsigned int ops = 1 << op;
+
+
+    if ( !this->mCache || !this->mCache->isEnabled(this->mCache->object) ||
+         this->mCache->find(this->mCache->object, kdev_t_to_nr(inode_dev(inode)), inode->i_ino) <= 0 )
+    {
+        return;
+    }
+
+    if ( op == EFS_Exec )
+    {
+        ops |= 1 << EFS_Open;
+    }
+
+    write_seqlock(&stamp->lock);
+    if ( stamp->generation == generation && stampMatches(stamp, inode) )
+    {
+        stamp->ops |= ops;
+    }
+    else
+    {
+        stamp->inode = inode;
+        stamp->sb = inode->i_sb;
+        stamp->ino = inode->i_ino;
+        stamp->igeneration = inode->i_generation;
+        stamp->ctime = inode->i_ctime;
+        stamp->size = i_size_read(inode);
+        stamp->generation = generation;
+        stamp->ops = ops;
+    }
+    write_sequnlock(&stamp->lock);
+}
+
+static void unstampSlot(LSMVerdictStamp* stamp, const struct inode* inode)
+{
+    if ( stamp->inode != inode )
+    {
+        return;
+    }
+
+    write_seqlock(&stamp->lock);
+    if ( stamp->inode == inode )
+    {
+        stamp->inode = NULL;
+        stamp->ops = 0;
+    }
+    write_sequnlock(&stamp->lock);
+}
+
+static void unstampInode(const void* self, const struct inode* inode)
+{
+    unstampSlot(stampSlot(self, EFS_Open, inode), inode);
+    unstampSlot(stampSlot(self, EFS_Exec, inode), inode);
+}
+
 static inline int examineFile(const void* self, EFilesystemOperation op, struct file* file, bool clonefile)
 {
     int decision = 0;
     IFileInfo *pFInfo;
+    uint64_t start;
+    bool writable;
+    unsigned int generation;
 
 
     /* We can't use a file object without a dentry or inode */
@@ -137,41 +283,65 @@ static inline int examineFile(const void* self, EFilesystemOperation op, struct
         return 0;
     }
 
+    start = talpa_latency_now();
+    trace_talpa_intercept_enter(ETI_LSM, op, kdev_t_to_nr(inode_dev(file->f_dentry->d_inode)), file->f_dentry->d_inode->i_ino);
+
+    writable = flags_to_writable(file->f_flags);
+    if ( op != EFS_Close )
+    {
+        if ( writable )
+        {
+            unstampInode(self, file->f_dentry->d_inode);
+        }
+        else if ( stampAllows(self, op, file->f_dentry->d_inode) )
+        {
+            talpa_latency_record(ELS_Intercept, start);
+            trace_talpa_intercept_exit(ETI_LSM, op, kdev_t_to_nr(inode_dev(file->f_dentry->d_inode)), file->f_dentry->d_inode->i_ino, 0);
+            return 0;
+        }
+    }
+    generation = talpa_verdict_current();
+
     /* First check with the examineInode method */
-    decision = this->mTargetProcessor->examineInode(this->mTargetProcessor, op, flags_to_writable(file->f_flags), file->f_flags, kdev_t_to_nr(inode_dev(file->f_dentry->d_inode)), file->f_dentry->d_inode->i_ino);
+    decision = this->mTargetProcessor->examineInode(this->mTargetProcessor, op, writable, file->f_flags, kdev_t_to_nr(inode_dev(file->f_dentry->d_inode)), file->f_dentry->d_inode->i_ino);
 
     if ( likely(decision != -EAGAIN) )
     {
+        if ( decision == 0 && !writable && op != EFS_Close )
+        {
+            stampInode(self, op, file->f_dentry->d_inode, generation);
+        }
+        talpa_latency_record(ELS_Intercept, start);
+        trace_talpa_intercept_exit(ETI_LSM, op, kdev_t_to_nr(inode_dev(file->f_dentry->d_inode)), file->f_dentry->d_inode->i_ino, decision);
         return decision;
     }
 
     /* Make sure our open and close attempts while examining will be excluded */
     current->flags |= PF_TALPA_INTERNAL;
 
-    pFInfo = this->mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoFromFile(this->mLinuxFilesystemFactory, op, file);
+#ifdef TALPA_SAME_FILE
+    if ( clonefile )
+    {
+        pFInfo = this->mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoSharingFile(this->mLinuxFilesystemFactory, op, file);
+    }
+    else
+#endif
+    {
+        pFInfo = this->mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoFromFile(this->mLinuxFilesystemFactory, op, file);
+    }
 
     if ( likely(pFInfo != NULL) )
     {
-        IFile *pFile = NULL;
-#ifdef TALPA_SAME_FILE
-        if ( clonefile )
-        {
-            pFile = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.cloneFile(GL_object.mLinuxFilesystemFactory, file);
-        }
-#endif
-        decision = this->mTargetProcessor->examineFileInfo(this->mTargetProcessor, pFInfo, pFile);
-#ifdef TALPA_SAME_FILE
-        if ( likely(pFile != NULL) )
-        {
-            pFile->delete(pFile);
-        }
-#endif
+        decision = this->mTargetProcessor->examineFileInfo(this->mTargetProcessor, pFInfo, NULL);
         pFInfo->delete(pFInfo);
     }
 
     /* Restore normal process examination */
     current->flags &= ~PF_TALPA_INTERNAL;
 
+    talpa_latency_record(ELS_Intercept, start);
+    trace_talpa_intercept_exit(ETI_LSM, op, kdev_t_to_nr(inode_dev(file->f_dentry->d_inode)), file->f_dentry->d_inode->i_ino, decision);
+
     return decision;
 }
 
@@ -179,13 +349,36 @@ static inline int examineDirectoryEntry(const void* self, EFilesystemOperation o
 {
     int decision = 0;
     IFileInfo *pFInfo;
+    uint64_t start = talpa_latency_now();
+    bool writable = flags_to_writable(flags);
+    unsigned int generation;
+
 
+    trace_talpa_intercept_enter(ETI_LSM, op, kdev_t_to_nr(inode_dev(dentry->d_inode)), dentry->d_inode->i_ino);
+
+    if ( writable )
+    {
+        unstampInode(self, dentry->d_inode);
+    }
+    else if ( stampAllows(self, op, dentry->d_inode) )
+    {
+        talpa_latency_record(ELS_Intercept, start);
+        trace_talpa_intercept_exit(ETI_LSM, op, kdev_t_to_nr(inode_dev(dentry->d_inode)), dentry->d_inode->i_ino, 0);
+        return 0;
+    }
+    generation = talpa_verdict_current();
 
     /* First check with the examineInode method */
-    decision = this->mTargetProcessor->examineInode(this->mTargetProcessor, op, flags_to_writable(flags), flags, kdev_t_to_nr(inode_dev(dentry->d_inode)), dentry->d_inode->i_ino);
+    decision = this->mTargetProcessor->examineInode(this->mTargetProcessor, op, writable, flags, kdev_t_to_nr(inode_dev(dentry->d_inode)), dentry->d_inode->i_ino);
 
     if ( likely(decision != -EAGAIN) )
     {
+        if ( decision == 0 && !writable )
+        {
+            stampInode(self, op, dentry->d_inode, generation);
+        }
+        talpa_latency_record(ELS_Intercept, start);
+        trace_talpa_intercept_exit(ETI_LSM, op, kdev_t_to_nr(inode_dev(dentry->d_inode)), dentry->d_inode->i_ino, decision);
         return decision;
     }
 
@@ -203,6 +396,9 @@ static inline int examineDirectoryEntry(const void* self, EFilesystemOperation o
     /* Restore normal process examination */
     current->flags &= ~PF_TALPA_INTERNAL;
 
+    talpa_latency_record(ELS_Intercept, start);
+    trace_talpa_intercept_exit(ETI_LSM, op, kdev_t_to_nr(inode_dev(dentry->d_inode)), dentry->d_inode->i_ino, decision);
+
     return decision;
 }
 
@@ -550,15 +746,56 @@ static int talpa_cap_bprm_check_security(struct linux_binprm* bprm)
     return decision;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
+/*
+ * Remember what a file opened for writing looked like, in case it is closed
+ * again unchanged. Every file which gets here also reaches file_free_security,
+ * unlike inode_permission which sees access(2) and opens failing later on as
+ * well, so each baseline taken is released again. Earlier kernels have no
+ * such hook and always scan on close.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,29)
+static int talpa_dentry_open(struct file *file, const struct cred *cred)
+#else
+static int talpa_dentry_open(struct file *file)
+#endif
+{
+    hookEntry();
+
+    if ( flags_to_writable(file->f_flags) && !(current->flags & PF_TALPA_INTERNAL) &&
+         file->f_dentry && file->f_dentry->d_inode )
+    {
+        talpa_baseline_record(file->f_dentry->d_inode, true);
+    }
+
+    hookExitRv(0);
+}
+#endif
+
 static inline void talpa_file_free_security(struct file *file)
 {
+    bool unchanged = false;
+
+
+    /* Do not examine if this is our internal close */
+    if ( current->flags & PF_TALPA_INTERNAL )
+    {
+        return;
+    }
+
+    /* Release the baseline whether or not closes are examined */
+    if ( flags_to_writable(file->f_flags) && file->f_dentry && file->f_dentry->d_inode )
+    {
+        unchanged = talpa_baseline_unchanged(file->f_dentry->d_inode);
+    }
+
     if ( unlikely( !(GL_object.mInterceptMask & HOOK_CLOSE) ) )
     {
         return;
     }
 
-    /* Do not examine if this is our internal close */
-    if ( current->flags & PF_TALPA_INTERNAL )
+    /* Opened for writing but never written, so there is nothing new to look at */
+    if ( unchanged )
     {
         return;
     }
@@ -691,6 +928,9 @@ static struct security_operations interceptor_ops_plain = {
     .file_alloc_security =      talpa_file_alloc_security,
     .file_permission =          talpa_file_permission,
     .file_mmap =                talpa_file_mmap,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
+    .dentry_open =              talpa_dentry_open,
 #endif
     .file_free_security =       talpa_lsm_file_free_security,
     .bprm_check_security =      talpa_lsm_bprm_check_security,
@@ -721,6 +961,9 @@ static struct security_operations interceptor_ops_with_cap = {
     .file_alloc_security =      talpa_file_alloc_security,
     .file_permission =          talpa_file_permission,
     .file_mmap =                talpa_file_mmap,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
+    .dentry_open =              talpa_dentry_open,
 #endif
     .file_free_security =       talpa_lsm_file_free_security,
     .bprm_check_security =      talpa_lsm_bprm_check_security,
@@ -956,6 +1199,9 @@ failed:
 
 LSMInterceptor* newLSMInterceptor(void)
 {
+    unsigned int stamp;
+
+
     talpa_mutex_lock(&GL_object.mSemaphore);
 
     if ( GL_object.mInitialized )
@@ -967,6 +1213,15 @@ LSMInterceptor* newLSMInterceptor(void)
 
     init_waitqueue_head(&GL_object.mUnload);
 
+    for ( stamp = 0; stamp < LSM_STAMPS; stamp++ )
+    {
+        seqlock_init(&GL_object.mStamps[stamp].lock);
+    }
+    for ( stamp = 0; stamp < LSM_EXEC_STAMPS; stamp++ )
+    {
+        seqlock_init(&GL_object.mExecStamps[stamp].lock);
+    }
+
     /* Check if we can register with talpa_capability */
     capability_register = symbol_get(talpa_capability_register);
     capability_unregister = symbol_get(talpa_capability_unregister);
@@ -1225,6 +1480,12 @@ static IInterceptProcessor* interceptProcessor(const void* self)
     return this->mTargetProcessor;
 }
 
+static void setCache(struct tag_LSMInterceptor* object, ICache* cache)
+{
+    object->mCache = cache;
+    return;
+}
+
 /*
  * IConfigurable.
  */
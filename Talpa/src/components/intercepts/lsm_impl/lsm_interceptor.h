@@ -22,6 +22,8 @@
 #include <asm/atomic.h>
 #include <asm/ptrace.h>
 #include <asm/semaphore.h>
+#include <linux/fs.h>
+#include <linux/seqlock.h>
 
 #include "common/bool.h"
 #define TALPA_SUBSYS "lsm"
@@ -29,12 +31,17 @@
 #include "common/locking.h"
 #include "interception/iinterceptor.h"
 #include "intercept_processing/iintercept_processor.h"
+#include "cache/icache.h"
 #include "configurator/iconfigurable.h"
 #include "configurator/pod_configuration_element.h"
 #include "components/services/linux_filesystem_impl/linux_filesystem_factoryimpl.h"
 
 #define LSM_CFGDATASIZE     (16)
 #define LSM_OPSCFGDATASIZE  (64)
+#define LSM_STAMP_BITS      (10)
+#define LSM_STAMPS          (1 << LSM_STAMP_BITS)
+#define LSM_EXEC_STAMP_BITS (8)
+#define LSM_EXEC_STAMPS     (1 << LSM_EXEC_STAMP_BITS)
 
 
 
@@ -48,11 +55,28 @@ typedef struct {
     char    value[LSM_OPSCFGDATASIZE];
 } LSMOpsConfigData;
 
+/*
+ * An inode the processor allowed without looking at the file, along with
+ * what the inode looked like at the time.
+ */
+typedef struct {
+    seqlock_t                   lock;
+    const struct inode*         inode;
+    const struct super_block*   sb;
+    unsigned long               ino;
+    __u32                       igeneration;
+    struct timespec             ctime;
+    loff_t                      size;
+    unsigned int                generation;     /* Verdict generation when allowed */
+    unsigned int                ops;            /* Allowed operations, one bit each */
+} LSMVerdictStamp;
+
 typedef struct tag_LSMInterceptor
 {
     IInterceptor                i_IInterceptor;
     IConfigurable               i_IConfigurable;
     void                        (*delete)(struct tag_LSMInterceptor* object);
+    void                        (*setCache)(struct tag_LSMInterceptor* object, ICache* cache);
 
     bool                        mSecondary;
     bool                        mInitialized;
@@ -62,10 +86,13 @@ typedef struct tag_LSMInterceptor
     unsigned int                mInterceptMask;
     unsigned int                mHookingMask;
     IInterceptProcessor*        mTargetProcessor;
+    ICache*                     mCache;
     PODConfigurationElement     mConfig[3];
     LSMStatusConfigData         mConfigData;
     LSMOpsConfigData            mOpsConfigData;
     LinuxFilesystemFactoryImpl* mLinuxFilesystemFactory;
+    LSMVerdictStamp             mStamps[LSM_STAMPS];
+    LSMVerdictStamp             mExecStamps[LSM_EXEC_STAMPS];
 } LSMInterceptor;
 
 /*
@@ -23,12 +23,16 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/fs.h>
+#include <linux/file.h>
 #include <linux/unistd.h>
 #include <linux/binfmts.h>
 
 #include "syscall_interceptor.h"
 #include "app_ctrl/iportability_app_ctrl.h"
 #include "filesystem/ifile_info.h"
+#include "platforms/linux/glue.h"
+#include "platforms/linux/latency.h"
+#include "platforms/linux/trace.h"
 
 
 /*
@@ -189,7 +193,13 @@ static void deleteSyscallInterceptor(struct tag_SyscallInterceptor* object)
 static inline int examineFile(EFilesystemOperation op, const char __user * filename, int flags, int mode)
 {
     int decision = 0;
-    TALPA_FILENAME_T* tmp = talpa_getname(filename);
+    uint64_t start = talpa_latency_now();
+    TALPA_FILENAME_T* tmp;
+
+
+    trace_talpa_intercept_enter(ETI_Syscall, op, 0, 0);
+
+    tmp = talpa_getname(filename);
 
     if ( !IS_ERR(tmp) )
     {
@@ -203,20 +213,63 @@ static inline int examineFile(EFilesystemOperation op, const char __user * filen
         talpa_putname(tmp);
     }
 
+    talpa_latency_record(ELS_Intercept, start);
+    trace_talpa_intercept_exit(ETI_Syscall, op, 0, 0, decision);
+
     return decision;
 }
 
 static inline int examineFd(EFilesystemOperation op, int fd)
 {
     int decision = 0;
-    IFileInfo *pFInfo = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoFromFd(GL_object.mLinuxFilesystemFactory, op, fd);
+    uint64_t start = talpa_latency_now();
+    IFileInfo *pFInfo;
+    struct file* file;
+    struct inode* inode;
+    uint32_t device = 0;
+    uint32_t ino = 0;
 
-    if ( likely(pFInfo != NULL) )
+
+    /* One reference for both checks, so they can not see different files */
+    file = fget(fd);
+    if ( unlikely(file == NULL) )
     {
-        decision = GL_object.mTargetProcessor->examineFileInfo(GL_object.mTargetProcessor, pFInfo, NULL);
-        pFInfo->delete(pFInfo);
+        return 0;
     }
 
+    if ( unlikely(!file->f_dentry || !file->f_dentry->d_inode) )
+    {
+        fput(file);
+        return 0;
+    }
+
+    inode = talpa_file_key_inode(file);
+    device = kdev_t_to_nr(inode_dev(inode));
+    ino = inode->i_ino;
+
+    trace_talpa_intercept_enter(ETI_Syscall, op, device, ino);
+
+    /* First check with the examineInode method, only resolving the path on a miss */
+    decision = GL_object.mTargetProcessor->examineInode(GL_object.mTargetProcessor, op, flags_to_writable(file->f_flags), file->f_flags, device, ino);
+
+    if ( decision == -EAGAIN )
+    {
+        decision = 0;
+
+        pFInfo = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoFromFile(GL_object.mLinuxFilesystemFactory, op, file);
+
+        if ( likely(pFInfo != NULL) )
+        {
+            decision = GL_object.mTargetProcessor->examineFileInfo(GL_object.mTargetProcessor, pFInfo, NULL);
+            pFInfo->delete(pFInfo);
+        }
+    }
+
+    fput(file);
+
+    talpa_latency_record(ELS_Intercept, start);
+    trace_talpa_intercept_exit(ETI_Syscall, op, device, ino, decision);
+
     return decision;
 }
 
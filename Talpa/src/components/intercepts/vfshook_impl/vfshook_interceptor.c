@@ -67,7 +67,11 @@
 #include "platforms/linux/alloc.h"
 #include "platforms/linux/glue.h"
 #include "platforms/linux/vfs_mount.h"
+#include "platforms/linux/baseline.h"
 #include "platforms/linux/locking.h"
+#include "platforms/linux/latency.h"
+#include "platforms/linux/trace.h"
+#include "platforms/linux/capture.h"
 
 #include "findRegular.h"
 
@@ -88,6 +92,7 @@ static const PODConfigurationElement* allConfig(const void* self);
 static const char* config(const void* self, const char* name);
 static void setConfig(void* self, const char* name, const char* value);
 static void deleteVFSHookInterceptor(struct tag_VFSHookInterceptor* object);
+static void setCache(struct tag_VFSHookInterceptor* object, ICache* cache);
 
 static VFSHookObject* appendObject(void* self, talpa_list_head* list, const char* value, bool protected);
 static VFSHookObject* findObject(const void* self, talpa_list_head* list, const char* value);
@@ -95,6 +100,7 @@ static void freeObject(VFSHookObject* obj);
 static void deleteObject(void *self, VFSHookObject* obj);
 static void constructSpecialSet(void* self);
 static void doActionString(void* self, talpa_list_head* list, char** set, const char* value);
+static void compileFilesystemLists(void* self);
 static void destroyStringSet(void *self, char **set);
 
 static long talpaDummyOpen(unsigned int fd);
@@ -106,6 +112,7 @@ static void talpaPreUmount(char __user * name, int flags, void** ctx);
 static void talpaPostUmount(int err, char __user * name, int flags, void* ctx);
 
 static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMount);
+static int patchMount(struct vfsmount* mnt, unsigned long flags, bool fromMount, bool account);
 
 static bool repatchFilesystem(struct dentry* dentry, bool smbfs, struct patchedFilesystem* patch);
 static int lockAndRepatchFilesystem(struct dentry* dentry, struct patchedFilesystem* patch);
@@ -168,7 +175,9 @@ static VFSHookInterceptor GL_object =
             (void (*)(void*))deleteVFSHookInterceptor
         },
         deleteVFSHookInterceptor,
+        setCache,
         NULL, /* mTargetProcessor */
+        NULL, /* mCache */
         NULL, /* mLinuxFilesystemFactory */
         NULL, /* mLinuxSystemRoot */
         NULL, /* mGoodFilesystemsSet */
@@ -177,16 +186,20 @@ static VFSHookInterceptor GL_object =
         NULL, /* mPatchListSet */
         0, /* mInterceptMask */
         HOOK_DEFAULT, /* mHookingMask */
-        ATOMIC_INIT(0), /* mUseCnt */
-        { }, /* mUnload */
+        TALPA_PCPU_REF_INIT, /* mUseCnt */
         TALPA_STATIC_MUTEX(GL_object.mSemaphore), /* mSemaphore */
         TALPA_RCU_UNLOCKED(talpa_vfshook_interceptor_patch_lock),
         TALPA_LIST_HEAD_INIT(GL_object.mPatches),
+        { 0 }, /* mPatchIndex */
         TALPA_RCU_UNLOCKED(talpa_vfshook_interceptor_list_lock),
         TALPA_LIST_HEAD_INIT(GL_object.mGoodFilesystems),
         TALPA_LIST_HEAD_INIT(GL_object.mSkipFilesystems),
         TALPA_LIST_HEAD_INIT(GL_object.mNoScanFilesystems),
         TALPA_LIST_HEAD_INIT(GL_object.mHookDopsFilesystems),
+        { { 0 } }, /* mGoodFilesystemIds */
+        { { 0 } }, /* mSkipFilesystemIds */
+        { { 0 } }, /* mNoScanFilesystemIds */
+        { { 0 } }, /* mHookDopsFilesystemIds */
         {
             {GL_object.mConfigData.name, GL_object.mConfigData.value, VFSHOOK_CFGDATASIZE, true, true },
             {GL_object.mOpsConfigData.name, GL_object.mOpsConfigData.value, VFSHOOK_OPSCFGDATASIZE, true, false },
@@ -213,42 +226,235 @@ static VFSHookInterceptor GL_object =
             .umount_post = talpaPostUmount,
         },
         false, /* mInitialized */
+        false, /* mLazyPending */
+        false, /* mLazyStop */
     };
 
 #define this    ((VFSHookInterceptor*)self)
 
 
-#define hookEntry() atomic_inc(&GL_object.mUseCnt)
+#define hookEntry() talpa_pcpu_ref_get(&GL_object.mUseCnt)
 
 #define hookExit() \
 { \
-    if ( unlikely( atomic_dec_and_test(&GL_object.mUseCnt) !=  0 ) ) \
-    { \
-        wake_up(&GL_object.mUnload); \
-    } \
+    talpa_pcpu_ref_put(&GL_object.mUseCnt); \
 \
     return; \
 }
 
 #define hookExitRv(ret) \
 { \
-    if ( unlikely( atomic_dec_and_test(&GL_object.mUseCnt) !=  0 ) ) \
-    { \
-        wake_up(&GL_object.mUnload); \
-    } \
+    talpa_pcpu_ref_put(&GL_object.mUseCnt); \
     return ret; \
 }
 
+/* Must be called under the patch read lock. */
 static inline struct patchedFilesystem* getPatch(struct patchedFilesystem* patch)
 {
-    atomic_inc(&patch->refcnt);
+    talpa_pcpu_ref_get(&patch->refcnt);
 
     return patch;
 }
 
 static inline void putPatch(struct patchedFilesystem* patch)
 {
-    atomic_dec(&patch->refcnt);
+    talpa_pcpu_ref_put(&patch->refcnt);
+}
+
+static inline const void* patchOps(const struct patchedFilesystem* patch, unsigned int kind)
+{
+    switch ( kind )
+    {
+        case VFSHOOK_INDEX_FOPS:
+            return patch->f_ops;
+        case VFSHOOK_INDEX_IOPS:
+            return patch->i_ops;
+#ifdef TALPA_HOOK_D_OPS
+        case VFSHOOK_INDEX_DOPS:
+            return patch->d_ops;
+#endif
+#ifdef TALPA_HAS_SMBFS
+        case VFSHOOK_INDEX_SFOPS:
+            return patch->sf_ops;
+#endif
+    }
+
+    return NULL;
+}
+
+static inline unsigned int patchSlot(const void* ops)
+{
+    return (unsigned int)((((unsigned long)ops) >> 4) * 2654435761UL) & (VFSHOOK_INDEX_SLOTS - 1);
+}
+
+static inline bool patchMatches(const struct patchedFilesystem* patch, unsigned int kind, const void* ops, const struct file_system_type* type)
+{
+    return (patchOps(patch, kind) == ops) && (!type || (patch->fstype == type));
+}
+
+/*
+ * Finds the patch owning an operations table, optionally also for a particular
+ * filesystem type. Must be called under the patch read lock.
+ */
+static struct patchedFilesystem* findPatch(unsigned int kind, const void* ops, const struct file_system_type* type)
+{
+    const VFSHookPatchIndex* index = &GL_object.mPatchIndex;
+    struct patchedFilesystem* p;
+    unsigned int seq = index->seq;
+    unsigned int slot = patchSlot(ops);
+    unsigned int i;
+
+
+    smp_rmb();
+
+    for ( i = 0; i < VFSHOOK_INDEX_SLOTS; i++ )
+    {
+        p = talpa_rcu_dereference(index->slots[kind][slot]);
+        if ( !p )
+        {
+            break;
+        }
+        if ( patchMatches(p, kind, ops, type) )
+        {
+            return p;
+        }
+        slot = (slot + 1) & (VFSHOOK_INDEX_SLOTS - 1);
+    }
+
+    smp_rmb();
+
+    if ( likely( !(seq & 1) && (seq == index->seq) && !index->partial ) )
+    {
+        return NULL;
+    }
+
+    /* The index was changing under us or is incomplete. */
+    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    {
+        if ( patchMatches(p, kind, ops, type) )
+        {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Called with the patch write lock held.
+ */
+static void rebuildPatchIndex(void)
+{
+    VFSHookPatchIndex* index = &GL_object.mPatchIndex;
+    struct patchedFilesystem* p;
+    const void* ops;
+    unsigned int count = 0;
+    unsigned int kind;
+    unsigned int slot;
+
+
+    memset(index->slots, 0, sizeof(index->slots));
+    index->partial = false;
+
+    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    {
+        /* Keep the load factor at or below one half. */
+        if ( ++count > (VFSHOOK_INDEX_SLOTS / 2) )
+        {
+            index->partial = true;
+            break;
+        }
+
+        for ( kind = 0; kind < VFSHOOK_INDEX_KINDS; kind++ )
+        {
+            ops = patchOps(p, kind);
+            if ( !ops )
+            {
+                continue;
+            }
+
+            slot = patchSlot(ops);
+            while ( index->slots[kind][slot] )
+            {
+                slot = (slot + 1) & (VFSHOOK_INDEX_SLOTS - 1);
+            }
+            talpa_rcu_assign_pointer(index->slots[kind][slot], p);
+        }
+    }
+}
+
+/*
+ * Patches and their operation pointers are only changed between these two,
+ * which keep the index in step with the patch list.
+ */
+static void lockPatches(void)
+{
+    talpa_rcu_write_lock(&GL_object.mPatchLock);
+    GL_object.mPatchIndex.seq++;
+    smp_wmb();
+}
+
+static void unlockPatches(void)
+{
+    rebuildPatchIndex();
+    smp_wmb();
+    GL_object.mPatchIndex.seq++;
+    talpa_rcu_write_unlock(&GL_object.mPatchLock);
+}
+
+static struct patchedFilesystem* newPatch(void)
+{
+    struct patchedFilesystem* patch;
+
+
+    patch = talpa_alloc(sizeof(struct patchedFilesystem));
+    if ( !patch )
+    {
+        return NULL;
+    }
+
+    memset(patch, 0, sizeof(struct patchedFilesystem));
+    atomic_set(&patch->usecnt, 0);
+    if ( talpa_pcpu_ref_init(&patch->refcnt) )
+    {
+        talpa_free(patch);
+        return NULL;
+    }
+
+    return patch;
+}
+
+static void freePatch(struct patchedFilesystem* patch)
+{
+    talpa_pcpu_ref_destroy(&patch->refcnt);
+    talpa_free(patch);
+}
+
+/*
+ * Called after a patch has been taken off the list and its index slots.
+ * Hooks take references under the read lock, so once a grace period has
+ * passed no new ones can appear and the per-CPU counts can be summed.
+ */
+static void waitForPatch(struct patchedFilesystem* patch)
+{
+    do
+    {
+        talpa_rcu_synchronize();
+        dbg("refcnt for %s = %ld after sync", patch->fstype->name, talpa_pcpu_ref_sum(&patch->refcnt));
+    } while ( talpa_pcpu_ref_sum(&patch->refcnt) != 0 );
+}
+
+/*
+ * Drops a verdict straight from the cache. Used where no new open is being
+ * examined, so that nothing but the clear itself is accounted or captured.
+ */
+static inline void clearCached(const struct file* file, const struct inode* inode)
+{
+    if ( GL_object.mCache )
+    {
+        GL_object.mCache->clear(GL_object.mCache->object, kdev_t_to_nr(inode_dev(inode)), inode->i_ino);
+        talpa_capture(TALPA_CAPTURE_CLEAR, EFS_Open, file->f_flags, kdev_t_to_nr(inode_dev(inode)), inode->i_ino, NULL);
+    }
 }
 
 static int talpaOpen(struct inode *inode, struct file *file)
@@ -263,13 +469,10 @@ static int talpaOpen(struct inode *inode, struct file *file)
 
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    p = findPatch(VFSHOOK_INDEX_FOPS, inode->i_fop, NULL);
+    if ( likely( p != NULL ) )
     {
-        if ( inode->i_fop == p->f_ops )
-        {
-            patch = getPatch(p);
-            break;
-        }
+        patch = getPatch(p);
     }
 
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
@@ -280,10 +483,19 @@ static int talpaOpen(struct inode *inode, struct file *file)
         /* Do not examine if we should not intercept opens and we are already examining one */
         if ( likely( ((GL_object.mInterceptMask & HOOK_OPEN) != 0) && !(current->flags & PF_TALPA_INTERNAL) ) )
         {
+            uint64_t start = talpa_latency_now();
+            struct inode* real;
+
+
             BUG_ON(NULL == file);
 
+            /* Key on the layer the data lives in so overlay mounts of one image share verdicts */
+            real = talpa_file_key_inode(file);
+
+            trace_talpa_intercept_enter(ETI_VFSHook, EFS_Open, kdev_t_to_nr(inode_dev(real)), real->i_ino);
+
             /* First check with the examineInode method */
-            ret = GL_object.mTargetProcessor->examineInode(GL_object.mTargetProcessor, EFS_Open, flags_to_writable(file->f_flags), file->f_flags, kdev_t_to_nr(inode_dev(inode)), inode->i_ino);
+            ret = GL_object.mTargetProcessor->examineInode(GL_object.mTargetProcessor, EFS_Open, flags_to_writable(file->f_flags), file->f_flags, kdev_t_to_nr(inode_dev(real)), real->i_ino);
 
             if ( ret == -EAGAIN )
             {
@@ -313,9 +525,18 @@ static int talpaOpen(struct inode *inode, struct file *file)
                 }
             }
 
+            talpa_latency_record(ELS_Intercept, start);
+            trace_talpa_intercept_exit(ETI_VFSHook, EFS_Open, kdev_t_to_nr(inode_dev(real)), real->i_ino, ret);
+
             if ( likely( (ret == 0) && patch->open ) )
             {
                 ret = patch->open(inode, file);
+
+                /* A file copied up by its open now lives in the upper layer, whose verdict the writer makes stale */
+                if ( ret == 0 && flags_to_writable(file->f_flags) && real != talpa_real_inode(file->f_dentry) )
+                {
+                    clearCached(file, talpa_real_inode(file->f_dentry));
+                }
             }
         }
         else if ( patch->open )
@@ -323,6 +544,12 @@ static int talpaOpen(struct inode *inode, struct file *file)
             ret = patch->open(inode, file);
         }
 
+        /* Remember what it looked like in case it is closed again unchanged */
+        if ( ret == 0 && flags_to_writable(file->f_flags) && !(current->flags & PF_TALPA_INTERNAL) )
+        {
+            talpa_baseline_record(inode, true);
+        }
+
         putPatch(patch);
         patch = NULL;
     }
@@ -339,6 +566,7 @@ static int talpaRelease(struct inode *inode, struct file *file)
     struct patchedFilesystem *p;
     struct patchedFilesystem *patch = NULL;
     int ret = -ESRCH;
+    bool unchanged;
 
     hookEntry();
 
@@ -346,13 +574,10 @@ static int talpaRelease(struct inode *inode, struct file *file)
 
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    p = findPatch(VFSHOOK_INDEX_FOPS, inode->i_fop, NULL);
+    if ( likely( p != NULL ) )
     {
-        if ( inode->i_fop == p->f_ops )
-        {
-            patch = getPatch(p);
-            break;
-        }
+        patch = getPatch(p);
     }
 
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
@@ -370,6 +595,8 @@ static int talpaRelease(struct inode *inode, struct file *file)
 #endif
 
         ret = 0;
+        unchanged = flags_to_writable(file->f_flags) && !(current->flags & PF_TALPA_INTERNAL) && talpa_baseline_unchanged(inode);
+
         /* Do not examine if we should not intercept closes and we are already examining one */
         if (
 #ifdef TALPA_USE_FLUSH_TO_SCAN_CLOSE_ON_EXIT
@@ -382,32 +609,42 @@ static int talpaRelease(struct inode *inode, struct file *file)
             )
         {
             IFileInfo *pFInfo;
+            uint64_t start = talpa_latency_now();
+
+            trace_talpa_intercept_enter(ETI_VFSHook, EFS_Close, kdev_t_to_nr(inode_dev(inode)), inode->i_ino);
 
             /* Make sure our open and close attempts while examining will be excluded */
             current->flags |= PF_TALPA_INTERNAL;
 
-            pFInfo = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoFromFile(GL_object.mLinuxFilesystemFactory, EFS_Close, file);
-
-            /*
-             * pFInfo->filename(pFInfo) is likely to be NULL if the file has already been deleted.
-             * e.g. temp files.
-             *
-             * Deleted files are excluded before we do any actual scanning in the targetProcessor
-             */
-            if ( likely( pFInfo != NULL ) )
+            /* Opened for writing but never written, so there is nothing new to look at */
+            if ( !unchanged )
             {
-                if (pFInfo->filename(pFInfo) == NULL)
+                pFInfo = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoFromFile(GL_object.mLinuxFilesystemFactory, EFS_Close, file);
+
+                /*
+                 * pFInfo->filename(pFInfo) is likely to be NULL if the file has already been deleted.
+                 * e.g. temp files.
+                 *
+                 * Deleted files are excluded before we do any actual scanning in the targetProcessor
+                 */
+                if ( likely( pFInfo != NULL ) )
                 {
-                    dbg("talpaRelease: filename=NULL: fstype=%s",patch->fstype->name);
+                    if (pFInfo->filename(pFInfo) == NULL)
+                    {
+                        dbg("talpaRelease: filename=NULL: fstype=%s",patch->fstype->name);
+                    }
+                    GL_object.mTargetProcessor->examineFileInfo(GL_object.mTargetProcessor, pFInfo, NULL);
+                    pFInfo->delete(pFInfo);
+                }
+                else
+                {
+                    err("talpaRelease: pFInfo=NULL");
                 }
-                GL_object.mTargetProcessor->examineFileInfo(GL_object.mTargetProcessor, pFInfo, NULL);
-                pFInfo->delete(pFInfo);
-            }
-            else
-            {
-                err("talpaRelease: pFInfo=NULL");
             }
 
+            talpa_latency_record(ELS_Intercept, start);
+            trace_talpa_intercept_exit(ETI_VFSHook, EFS_Close, kdev_t_to_nr(inode_dev(inode)), inode->i_ino, 0);
+
             if ( patch->release )
             {
                 ret = patch->release(inode, file);
@@ -449,14 +686,12 @@ static int talpaFlush(struct file *filp, fl_owner_t id)
 
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    p = findPatch(VFSHOOK_INDEX_FOPS, filp->f_op, NULL);
+    if ( likely( p != NULL ) )
     {
-        if ( filp->f_op == p->f_ops )
-        {
-            patch = getPatch(p);
-            break;
-        }
+        patch = getPatch(p);
     }
+
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
 
 
@@ -537,18 +772,15 @@ static int talpaIoctl(struct inode *inode, struct file *filp, unsigned int cmd,
 
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
-    {
   #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
-        if ( filp->f_dentry->d_inode->i_fop == p->sf_ops )
+    p = findPatch(VFSHOOK_INDEX_SFOPS, filp->f_dentry->d_inode->i_fop, NULL);
   #else
-        if ( inode->i_fop == p->sf_ops )
+    p = findPatch(VFSHOOK_INDEX_SFOPS, inode->i_fop, NULL);
   #endif
-        {
-            patch = getPatch(p);
-            dbg("ioctl on %s", patch->fstype->name);
-            break;
-        }
+    if ( likely( p != NULL ) )
+    {
+        patch = getPatch(p);
+        dbg("ioctl on %s", patch->fstype->name);
     }
 
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
@@ -628,32 +860,29 @@ static int talpaInodeCreate(struct inode *inode, struct dentry *dentry, int mode
 
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    p = findPatch(VFSHOOK_INDEX_IOPS, inode->i_op, inode->i_sb->s_type);
+    if ( likely( p != NULL ) )
     {
-        if ( inode->i_op == p->i_ops )
+        patch = getPatch(p);
+        dbg("Found patch for %s", patch->fstype->name);
+    }
+    else
+    {
+        /* Inode operations can be shared with a filesystem we have not patched,
+           in which case we still need the original operation. */
+        p = findPatch(VFSHOOK_INDEX_IOPS, inode->i_op, NULL);
+        if ( p )
         {
-            err = 0;
-            BUG_ON(NULL == p->fstype);
-
-            if ( unlikely( create && ( create != p->create ) ) )
-            {
-                DEBUG_info("WARNING: Mismatched create operations between patches %p != %p for %s", create, p->create, p->fstype->name );
-            }
-            create = p->create;
-
-            /* make sure we find the correct fstype to repatch */
-            if ( strcmp( inode->i_sb->s_type->name, p->fstype->name ) != 0 )
-            {
-                dbg("Ignoring patch for %s, it's not %s", p->fstype->name, inode->i_sb->s_type->name );
-                continue;
-            }
-
-            patch = getPatch(p);
-            dbg("Found patch for %s", patch->fstype->name);
-            break;
+            dbg("Ignoring patch for %s, it's not %s", p->fstype->name, inode->i_sb->s_type->name );
         }
     }
 
+    if ( likely( p != NULL ) )
+    {
+        err = 0;
+        create = p->create;
+    }
+
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
 
     if ( unlikely( err != 0 ) )
@@ -789,33 +1018,29 @@ static struct dentry* talpaInodeLookup(struct inode *inode, struct dentry *dentr
 
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    p = findPatch(VFSHOOK_INDEX_IOPS, inode->i_op, inode->i_sb->s_type);
+    if ( likely( p != NULL ) )
+    {
+        patch = getPatch(p);
+        dbg("Found patch for %s", patch->fstype->name);
+    }
+    else
     {
-        if ( inode->i_op == p->i_ops )
+        /* Inode operations can be shared with a filesystem we have not patched,
+           in which case we still need the original operation. */
+        p = findPatch(VFSHOOK_INDEX_IOPS, inode->i_op, NULL);
+        if ( p )
         {
-            err = NULL;
-            BUG_ON(NULL == p->fstype);
-
-            if ( unlikely( lookup && ( lookup != p->lookup ) ) )
-            {
-                DEBUG_info("WARNING: Mismatched lookup operations between patches %p != %p for %s", lookup, p->lookup, p->fstype->name );
-            }
-
-            lookup = p->lookup;
-
-            /* make sure we find the correct fstype to repatch */
-            if ( strcmp( inode->i_sb->s_type->name, p->fstype->name ) != 0 )
-            {
-                dbg("Ignoring patch for %s, it's not %s", p->fstype->name, inode->i_sb->s_type->name );
-                continue;
-            }
-
-            patch = getPatch(p);
-            dbg("Found patch for %s", patch->fstype->name);
-            break;
+            dbg("Ignoring patch for %s, it's not %s", p->fstype->name, inode->i_sb->s_type->name );
         }
     }
 
+    if ( likely( p != NULL ) )
+    {
+        err = NULL;
+        lookup = p->lookup;
+    }
+
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
 
     if ( unlikely( err != NULL ) )
@@ -1112,34 +1337,26 @@ static int maybeScanDentryRevalidate(int resultCode, struct dentry * dentry, str
     if ( ret == -EAGAIN )
     {
         IFileInfo *pFInfo;
-        IFile *pFile;
 
 
         ret = 0;
-        pFInfo = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoFromFile(GL_object.mLinuxFilesystemFactory, EFS_Open, filp);
+        /* Share the pre-opened file, cloned only if it gets as far as vetting */
+        pFInfo = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.newFileInfoSharingFile(GL_object.mLinuxFilesystemFactory, EFS_Open, filp);
 
-        if (unlikely ( pFInfo->filename(pFInfo) == NULL) )
-        {
-            critical("maybeScanDentryRevalidate - pFInfo filename is NULL");
-        }
-        pFile = GL_object.mLinuxFilesystemFactory->i_IFilesystemFactory.cloneFile(GL_object.mLinuxFilesystemFactory, filp);
-        if ( likely( pFInfo != NULL && pFile != NULL))
+        if ( likely( pFInfo != NULL ) )
         {
+            if (unlikely ( pFInfo->filename(pFInfo) == NULL) )
+            {
+                critical("maybeScanDentryRevalidate - pFInfo filename is NULL");
+            }
             /* Make sure our open and close attempts while examining will be excluded */
             current->flags |= PF_TALPA_INTERNAL;
             /* Examine this file */
-            ret = GL_object.mTargetProcessor->examineFileInfo(GL_object.mTargetProcessor, pFInfo, pFile); /* Share the pre-opened file */
+            ret = GL_object.mTargetProcessor->examineFileInfo(GL_object.mTargetProcessor, pFInfo, NULL);
             /* Restore normal process examination */
             current->flags &= ~PF_TALPA_INTERNAL;
-        }
-        if (likely( pFInfo != NULL))
-        {
             pFInfo->delete(pFInfo);
         }
-        if (likely( pFile != NULL))
-        {
-            pFile->delete(pFile); /* Resets the file to its beginning */
-        }
     }
 
     if (ret != 0)
@@ -1170,13 +1387,10 @@ static int talpaDentryRevalidate(struct dentry * dentry, struct nameidata * nd)
 
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    p = findPatch(VFSHOOK_INDEX_DOPS, dentry->d_op, NULL);
+    if ( likely( p != NULL ) )
     {
-        if ( dentry->d_op == p->d_ops )
-        {
-            patch = getPatch(p);
-            break;
-        }
+        patch = getPatch(p);
     }
 
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
@@ -1265,33 +1479,29 @@ static int talpaAtomicOpen(struct inode* inode, struct dentry* dentry,
     BUG_ON(NULL == inode);
     talpa_rcu_read_lock(&GL_object.mPatchLock);
 
-    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    p = findPatch(VFSHOOK_INDEX_IOPS, inode->i_op, inode->i_sb->s_type);
+    if ( likely( p != NULL ) )
     {
-        if ( inode->i_op == p->i_ops )
+        patch = getPatch(p);
+        dbg("Found patch for %s", patch->fstype->name);
+    }
+    else
+    {
+        /* Inode operations can be shared with a filesystem we have not patched,
+           in which case we still need the original operation. */
+        p = findPatch(VFSHOOK_INDEX_IOPS, inode->i_op, NULL);
+        if ( p )
         {
-            resultCode = 0;
-            BUG_ON(NULL == p->fstype);
-
-            if ( unlikely( atomic_open && ( atomic_open != p->atomic_open ) ) )
-            {
-                DEBUG_info("WARNING: Mismatched atomic_open operations between patches %p != %p for %s", atomic_open, p->atomic_open, p->fstype->name );
-            }
-
-            atomic_open = p->atomic_open;
-
-            /* make sure we find the correct fstype to repatch */
-            if ( strcmp( inode->i_sb->s_type->name, p->fstype->name ) != 0 )
-            {
-                dbg("Ignoring patch for %s, it's not %s", p->fstype->name, inode->i_sb->s_type->name );
-                continue;
-            }
-
-            patch = getPatch(p);
-            dbg("Found patch for %s", patch->fstype->name);
-            break;
+            dbg("Ignoring patch for %s, it's not %s", p->fstype->name, inode->i_sb->s_type->name );
         }
     }
 
+    if ( likely( p != NULL ) )
+    {
+        resultCode = 0;
+        atomic_open = p->atomic_open;
+    }
+
     talpa_rcu_read_unlock(&GL_object.mPatchLock);
 
     if ( unlikely( resultCode != 0 ) )
@@ -1835,7 +2045,7 @@ static int lockAndRepatchFilesystem(struct dentry* dentry, struct patchedFilesys
     }
 
     /* repatchFilesystem needs patch list lock held... */
-    talpa_rcu_write_lock(&GL_object.mPatchLock);
+    lockPatches();
 
     /* re-fetch the patch to ensure that it's still valid */
     ret = -ESRCH;
@@ -1851,7 +2061,7 @@ static int lockAndRepatchFilesystem(struct dentry* dentry, struct patchedFilesys
     if ( unlikely( ret ) )
     {
         warn("Patch went away while repatching %s", patch->fstype->name);
-        talpa_rcu_write_unlock(&GL_object.mPatchLock);
+        unlockPatches();
         talpa_syscallhook_modify_finish();
         return ret;
     }
@@ -1865,7 +2075,7 @@ static int lockAndRepatchFilesystem(struct dentry* dentry, struct patchedFilesys
 
     (void)repatchFilesystem(dentry, smbfs, patch); /* Ref count has already been increased when i_ops were patched */
 
-    talpa_rcu_write_unlock(&GL_object.mPatchLock);
+    unlockPatches();
     talpa_syscallhook_modify_finish();
 
     return ret;
@@ -2190,18 +2400,26 @@ static int restoreFilesystem(struct patchedFilesystem* patch)
     return 0;
 }
 
-static bool onNoScanList(const char *name)
+/*
+ * Filesystem lists are compiled into bitmaps of registered filesystem types.
+ * Types which could not be registered are looked up by name instead.
+ */
+static bool onList(talpa_list_head* list, const talpa_fstype_set_t* ids, unsigned int fstype, const char *name)
 {
     VFSHookObject* obj;
     bool found = false;
 
 
+    if ( likely(fstype != TALPA_FSTYPE_NONE) )
+    {
+        return talpa_fstype_set_test(ids, fstype);
+    }
+
     talpa_rcu_read_lock(&GL_object.mListLock);
-    talpa_list_for_each_entry(obj, &GL_object.mNoScanFilesystems, head)
+    talpa_list_for_each_entry_rcu(obj, list, head)
     {
         if ( !strcmp(name, obj->value) )
         {
-            dbg("%s is on no scan list", name);
             found = true;
             break;
         }
@@ -2211,64 +2429,100 @@ static bool onNoScanList(const char *name)
     return found;
 }
 
+static bool onNoScanList(unsigned int fstype, const char *name)
+{
+    bool found = onList(&GL_object.mNoScanFilesystems, &GL_object.mNoScanFilesystemIds, fstype, name);
+
+
+    if ( found )
+    {
+        dbg("%s is on no scan list", name);
+    }
+
+    return found;
+}
+
 /* global for module param */
 static int no_scan_on_load = 0;
+static int lazy_patch = 0;
 
 static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMount)
+{
+    return patchMount(mnt, flags, fromMount, true);
+}
+
+/*
+ * Patches the filesystem type of a mount if need be and, if accounting,
+ * counts the mount against the patch so it is kept until the last such
+ * mount goes away.
+ */
+static int patchMount(struct vfsmount* mnt, unsigned long flags, bool fromMount, bool account)
 {
     struct patchedFilesystem*   p;
     struct patchedFilesystem*   patch = NULL;
     struct patchedFilesystem*   newpatch;
     struct dentry*              reg;
-    VFSHookObject*              obj;
     int                         ret = -ESRCH;
     bool                        shouldinc;
     bool                        smbfs = false;
     const char*                 fsname = (const char *)mnt->mnt_sb->s_type->name;
+    unsigned int                fstype = talpa_fstype_id(mnt->mnt_sb->s_type);
     bool                        good_fs = false;
     bool                        hook_dops = false;
-    int                         propagationCount;
+    int                         propagationCount = 0;
 
 
     /* We don't want to patch some filesystems, and for some we want
        to output a warning message. */
-    talpa_rcu_read_lock(&GL_object.mListLock);
-    talpa_list_for_each_entry_rcu(obj, &GL_object.mSkipFilesystems, head)
+    if ( onList(&GL_object.mSkipFilesystems, &GL_object.mSkipFilesystemIds, fstype, fsname) )
     {
-        if ( !strcmp(fsname, obj->value) )
-        {
-            dbg("%s is on the skip list, not patching", fsname);
-            talpa_rcu_read_unlock(&GL_object.mListLock);
-            return 0;
-        }
+        dbg("%s is on the skip list, not patching", fsname);
+        return 0;
     }
 
-    talpa_list_for_each_entry_rcu(obj, &GL_object.mGoodFilesystems, head)
+    /* Another mount of a type whose file operations are already patched only
+       needs counting, which touches neither read-only memory nor the index,
+       nor a directory walk for a regular file which would be thrown away.
+       The lock keeps it from racing a deferred unpatch of the same type. */
+    if ( account )
     {
-        if ( !strcmp(fsname, obj->value) )
+        talpa_rcu_write_lock(&GL_object.mPatchLock);
+        talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
         {
-            good_fs = true;
-            break;
+            if ( mnt->mnt_sb->s_type == p->fstype )
+            {
+                patch = p;
+                break;
+            }
+        }
+
+        if ( patch && patch->f_ops && (patch->f_ops->open == talpaOpen) )
+        {
+            if ( !(fromMount && (flags & MS_REMOUNT)) )
+            {
+                atomic_add(countPropagationPoints(mnt), &patch->usecnt);
+                patch->mUnpatchPending = false;
+            }
+            DEBUG_info("%s already patched, usecnt = %d", fsname, atomic_read(&patch->usecnt));
+            talpa_rcu_write_unlock(&GL_object.mPatchLock);
+            destroyStringSet(&GL_object, &GL_object.mPatchListSet);
+            return 0;
         }
+
+        talpa_rcu_write_unlock(&GL_object.mPatchLock);
+        patch = NULL;
     }
 
+    good_fs = onList(&GL_object.mGoodFilesystems, &GL_object.mGoodFilesystemIds, fstype, fsname);
+
 #ifdef TALPA_HOOK_D_OPS
 # ifdef TALPA_ALWAYS_HOOK_DOPS
     hook_dops = true;
 # else
-    talpa_list_for_each_entry_rcu(obj, &GL_object.mHookDopsFilesystems, head)
-    {
-        if ( !strcmp(fsname, obj->value) )
-        {
-            hook_dops = true;
-            break;
-        }
-    }
+    hook_dops = onList(&GL_object.mHookDopsFilesystems, &GL_object.mHookDopsFilesystemIds, fstype, fsname);
 # endif
 #endif  /* TALPA_HOOK_D_OPS */
 
-    talpa_rcu_read_unlock(&GL_object.mListLock);
-
     if (!good_fs)
     {
         info("Patching %s", fsname);
@@ -2280,7 +2534,7 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
 
     /* Allocate patchedFilesystem structure because we
        can't do it while holding a lock. */
-    newpatch = talpa_alloc(sizeof(struct patchedFilesystem));
+    newpatch = newPatch();
     if (!newpatch)
     {
         err("Failed to create newpatch!");
@@ -2289,7 +2543,7 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
 
     /* We do not want to search for files on some filesystems on mount.
      * (and not on talpa load, if no_scan_on_load option is set) */
-    if ( ( fromMount || no_scan_on_load ) && onNoScanList(fsname) )
+    if ( ( fromMount || no_scan_on_load ) && onNoScanList(fstype, fsname) )
     {
         reg = dget(mnt->mnt_root);
 #ifdef TALPA_HAS_SMBFS
@@ -2315,7 +2569,7 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
     if ( ret )
     {
         warn("Failed to process filesystem due to inability to unprotect memory!");
-        talpa_free(newpatch);
+        freePatch(newpatch);
         newpatch = NULL;
         if ( reg )
         {
@@ -2325,7 +2579,7 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
     }
 
     /* Check if we have already patched this filesystem */
-    talpa_rcu_write_lock(&GL_object.mPatchLock);
+    lockPatches();
 
     talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
     {
@@ -2339,16 +2593,13 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
     /* If we found the patch, free the newly allocated one */
     if ( patch )
     {
-        talpa_free(newpatch);
+        freePatch(newpatch);
         newpatch = NULL;
     }
     /* Otherwise set the patch to be the newpatch */
     else
     {
         patch = newpatch;
-        memset(patch, 0, sizeof(struct patchedFilesystem));
-        atomic_set(&patch->usecnt, 0);
-        atomic_set(&patch->refcnt, 1);
         patch->fstype = mnt->mnt_sb->s_type;
         patch->mHookDOps = hook_dops;
         patch->mLookupCreateHooked = false;
@@ -2358,8 +2609,11 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
     ret = prepareFilesystem(mnt, reg, smbfs, patch);
     if ( !ret )
     {
-        propagationCount = countPropagationPoints(mnt);
-        DEBUG_info("  propagation points for mount on %s = %d", fsname, propagationCount);
+        if ( account )
+        {
+            propagationCount = countPropagationPoints(mnt);
+            DEBUG_info("  propagation points for mount on %s = %d", fsname, propagationCount);
+        }
 
         /* Only add it to the list if this is a new patch (not a new
            instance of the existing one) */
@@ -2375,14 +2629,13 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
             ret = patchFilesystem(mnt, reg, smbfs, patch);
             if ( !ret )
             {
-                DEBUG_info("  refcnt for %s = %d", fsname, atomic_read(&patch->refcnt));
                 atomic_add(propagationCount, &patch->usecnt);
             }
             else
             {
                 warn("Failed to process filesystem due to inability to patch! (%d)", ret);
                 talpa_list_del_rcu(&patch->head);
-                talpa_free(newpatch);
+                freePatch(newpatch);
                 newpatch = NULL; patch = NULL;
             }
         }
@@ -2414,12 +2667,12 @@ static int processMount(struct vfsmount* mnt, unsigned long flags, bool fromMoun
         /* Free newly allocated patch if preparing to patch failed */
         if ( patch == newpatch )
         {
-            talpa_free(newpatch);
+            freePatch(newpatch);
             newpatch = NULL; patch = NULL;
         }
     }
 
-    talpa_rcu_write_unlock(&GL_object.mPatchLock);
+    unlockPatches();
 
     talpa_syscallhook_modify_finish();
 
@@ -2971,13 +3224,94 @@ static void talpaPreUmount(char __user * name, int flags, void** ctx)
     return;
 }
 
+/*
+ * Takes off the patches whose last mount went away, unless they were mounted
+ * again meanwhile.
+ */
+static void unpatchUnused(void)
+{
+    struct patchedFilesystem *p;
+    int ret;
+
+
+    /* Unprotect read-only memory outside locks held. */
+    do
+    {
+        ret = talpa_syscallhook_modify_start();
+        if (ret)
+        {
+            info("Waiting for memory unprotection.");
+            __set_current_state(TASK_UNINTERRUPTIBLE);
+            schedule_timeout(HZ);
+        }
+    } while (ret);
+
+nextpatch:
+    lockPatches();
+    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    {
+        if ( p->mUnpatchPending && atomic_read(&p->usecnt) == 0 )
+        {
+            DEBUG_info("usecnt for %s reached zero, unpatching", p->fstype->name);
+            restoreFilesystem(p);
+            talpa_list_del_rcu(&p->head);
+            unlockPatches();
+            /* It is possible that the hook will keep the patch reference
+            for more than one rcu_synchronize call. */
+            waitForPatch(p);
+            freePatch(p);
+            goto nextpatch;
+        }
+        p->mUnpatchPending = false;
+    }
+    unlockPatches();
+
+    talpa_syscallhook_modify_finish();
+
+    /* Free list shown to userspace so it will be regenerated on next read */
+    destroyStringSet(&GL_object, &GL_object.mPatchListSet);
+}
+
+#ifdef TALPA_DEFERRED_UNPATCH
+
+/*
+ * Unpatching is left to a work item a little after the last umount of a
+ * filesystem type. Container hosts mount and unmount the same few types all
+ * the time, so the patch is usually wanted again before then; otherwise all
+ * types which went unused meanwhile are unpatched while memory is unprotected
+ * once.
+ */
+#define VFSHOOK_UNPATCH_DELAY   (HZ)
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+#define talpa_queue_long_delayed_work(work, delay)  queue_delayed_work(system_long_wq, (work), (delay))
+#else
+#define talpa_queue_long_delayed_work(work, delay)  schedule_delayed_work((work), (delay))
+#endif
+
+static void unpatchWork(struct work_struct* work)
+{
+    unpatchUnused();
+}
+
+static void scheduleUnpatch(void)
+{
+    talpa_queue_long_delayed_work(&GL_object.mUnpatchWork, VFSHOOK_UNPATCH_DELAY);
+}
+
+#else /* !TALPA_DEFERRED_UNPATCH */
+
+#define scheduleUnpatch()       unpatchUnused()
+
+#endif /* TALPA_DEFERRED_UNPATCH */
+
 static void talpaPostUmount(int err, char __user * name, int flags, void* ctx)
 {
     IFilesystemInfo *pFSInfo = (IFilesystemInfo *)ctx;
     struct patchedFilesystem *p;
     struct patchedFilesystem *patch = NULL;
-    int ret;
     int propagationCount = 1;
+    bool unused = false;
     TALPA_FILENAME_T* kname;
     
     if ( err || !pFSInfo )
@@ -2994,18 +3328,7 @@ static void talpaPostUmount(int err, char __user * name, int flags, void* ctx)
     propagationCount = pFSInfo->propagationCount(pFSInfo->object);
     DEBUG_info("propagation points for umount on %s = %d", getCStr(kname), propagationCount);
 
-    /* Unprotect read-only memory outside locks held. */
-    do
-    {
-        ret = talpa_syscallhook_modify_start();
-        if (ret)
-        {
-            info("Waiting for memory unprotection.");
-            __set_current_state(TASK_UNINTERRUPTIBLE);
-            schedule_timeout(HZ);
-        }
-    } while (ret);
-
+    /* Only the count changes here, so the index is left alone */
     talpa_rcu_write_lock(&GL_object.mPatchLock);
 
     talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
@@ -3020,60 +3343,193 @@ static void talpaPostUmount(int err, char __user * name, int flags, void* ctx)
 
     pFSInfo->delete(pFSInfo);
 
-    if ( patch )
+    if ( patch && unlikely(GL_object.mLazyPending) )
+    {
+        dbg("%s was unmounted while existing mounts were being counted", getCStr(kname));
+    }
+    else if ( patch )
     {
-        while (patch && propagationCount-- > 0)
+        while ( propagationCount-- > 0 )
         {
             if ( atomic_dec_and_test(&patch->usecnt) )
             {
-                DEBUG_info("usecnt for %s reached zero, unpatching", patch->fstype->name);
-                restoreFilesystem(patch);
-                talpa_list_del_rcu(&patch->head);
-                talpa_rcu_write_unlock(&GL_object.mPatchLock);
-                atomic_dec(&patch->refcnt);
-                /* It is possible that the hook will keep the patch reference
-                for more than one rcu_synchronize call. To be safe, we will
-                keep synchronising until the refcnt drops to zero. */
-                do
-                {
-                    talpa_rcu_synchronize();
-                    dbg("PostUmount: refcnt for %s = %d after sync", patch->fstype->name, atomic_read(&patch->refcnt));
-                } while ( atomic_read(&patch->refcnt) > 0 );
-                talpa_free(patch);
-                patch = NULL;
+                DEBUG_info("usecnt for %s reached zero", patch->fstype->name);
+                patch->mUnpatchPending = true;
+                unused = true;
+                break;
             }
         }
 
-        if (patch != NULL)
-        {
-            DEBUG_info("usecnt for %s = %d", patch->fstype->name, atomic_read(&patch->usecnt));
-            talpa_rcu_write_unlock(&GL_object.mPatchLock);
-        }
-
-        /* Free list shown to userspace so it will be regenerated on next read */
-        destroyStringSet(&GL_object, &GL_object.mPatchListSet);
+        DEBUG_info("usecnt for %s = %d", patch->fstype->name, atomic_read(&patch->usecnt));
     }
     else
     {
         dbg("%s was unmounted, but we hadn't patched it.", getCStr(kname));
-        talpa_rcu_write_unlock(&GL_object.mPatchLock);
     }
 
-    talpa_syscallhook_modify_finish();
+    talpa_rcu_write_unlock(&GL_object.mPatchLock);
+
+    if ( unused )
+    {
+        scheduleUnpatch();
+    }
+    else if ( patch )
+    {
+        /* Free list shown to userspace so it will be regenerated on next read */
+        destroyStringSet(&GL_object, &GL_object.mPatchListSet);
+    }
 
     talpa_putname(kname);
 
     return;
 }
 
-static int walkMountTree(void)
+#define WALK_PASSES     (8)
+
+/*
+ * Walks the whole mount tree, starting over if a mount detached meanwhile
+ * cut the walk short. Mounts seen by an earlier pass are seen again, so
+ * callbacks which count must tolerate counting high. Returns -EAGAIN if no
+ * pass got through.
+ */
+static int walkAllMounts(int (*callback) (struct vfsmount* mnt, unsigned long flags, bool fromMount))
 {
     struct vfsmount *mnt;
+    unsigned int pass = 0;
+    int err;
+
+    do
+    {
+        mnt = GL_object.mLinuxSystemRoot->i_ISystemRoot.mountPoint(GL_object.mLinuxSystemRoot);
+        err = iterateFilesystems(mnt, callback);
+    } while ( err == -EAGAIN && ++pass < WALK_PASSES );
 
-    mnt = GL_object.mLinuxSystemRoot->i_ISystemRoot.mountPoint(GL_object.mLinuxSystemRoot);
-    return iterateFilesystems(mnt, processMount);
+    return err;
 }
 
+static int walkMountTree(void)
+{
+    int err = walkAllMounts(processMount);
+
+    if ( err == -EAGAIN )
+    {
+        warn("Mount tree kept changing, some filesystems may be counted short");
+        err = 0;
+    }
+
+    return err;
+}
+
+#ifdef TALPA_LAZY_PATCHING
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+#define talpa_queue_long_work(work)     queue_work(system_long_wq, (work))
+#else
+#define talpa_queue_long_work(work)     schedule_work(work)
+#endif
+
+/*
+ * Lazy patching.
+ *
+ * With lazy_patch set only the first mount of each filesystem type is looked
+ * at during load, to patch the type; since the patched operations are shared
+ * by every superblock of the type that already covers most of them. Every
+ * mount is then processed as before from a work item, which repatches the
+ * odd superblock with operations of its own and counts the mounts against
+ * their patches.
+ *
+ * Until the work item is done a patch may be counted short, so unmounts do
+ * not uncount. Mounts which come and go meanwhile can leave a patch counted
+ * high, which only keeps it until talpa-vfshook is unloaded. The same goes
+ * for a walk which has to start over, and if none gets through the tree
+ * unmounts are never uncounted.
+ */
+static int patchFirstMount(struct vfsmount* mnt, unsigned long flags, bool fromMount)
+{
+    struct patchedFilesystem*   p;
+    bool                        patched = false;
+
+
+    talpa_rcu_read_lock(&GL_object.mPatchLock);
+    talpa_list_for_each_entry_rcu(p, &GL_object.mPatches, head)
+    {
+        if ( mnt->mnt_sb->s_type == p->fstype )
+        {
+            patched = true;
+            break;
+        }
+    }
+    talpa_rcu_read_unlock(&GL_object.mPatchLock);
+
+    if ( patched )
+    {
+        return 0;
+    }
+
+    return patchMount(mnt, flags, fromMount, false);
+}
+
+static int accountMount(struct vfsmount* mnt, unsigned long flags, bool fromMount)
+{
+    if ( unlikely(GL_object.mLazyStop) )
+    {
+        return -ECANCELED;
+    }
+
+    return processMount(mnt, flags, fromMount);
+}
+
+static void lazyPatchWork(struct work_struct* work)
+{
+    int err;
+
+
+    err = walkAllMounts(accountMount);
+    if ( err == -EAGAIN )
+    {
+        warn("Mount tree kept changing, unmounts will not be counted");
+        return;
+    }
+    if ( err && err != -ECANCELED )
+    {
+        err("Failed to process one of the existing filesystems! (%d)", err);
+    }
+
+    lockPatches();
+    GL_object.mLazyPending = false;
+    unlockPatches();
+
+    dbg("Existing mounts processed");
+}
+
+static int lazyWalkMountTree(void)
+{
+    int err;
+
+    GL_object.mLazyPending = true;
+    GL_object.mLazyStop = false;
+    INIT_WORK(&GL_object.mLazyWork, lazyPatchWork);
+
+    /* Types missed here are still patched by the work item */
+    err = walkAllMounts(patchFirstMount);
+
+    return ( err == -EAGAIN ) ? 0 : err;
+}
+
+static void lazyStop(void)
+{
+    GL_object.mLazyStop = true;
+    cancel_work_sync(&GL_object.mLazyWork);
+}
+
+#else /* !TALPA_LAZY_PATCHING */
+
+#define talpa_queue_long_work(work)     do { } while (0)
+#define lazyWalkMountTree()             walkMountTree()
+#define lazyStop()                      do { } while (0)
+
+#endif /* TALPA_LAZY_PATCHING */
+
 /*
  * Object creation/destruction.
  */
@@ -3086,16 +3542,19 @@ module_param(good_list, charp, 0400);
 module_param(skip_list, charp, 0400);
 module_param(no_scan, charp, 0400);
 module_param(no_scan_on_load, int, 0400);
+module_param(lazy_patch, int, 0400);
 #else
 MODULE_PARM(good_list, "s");
 MODULE_PARM(skip_list, "s");
 MODULE_PARM(no_scan, "s");
 MODULE_PARM(no_scan_on_load, "i");
+MODULE_PARM(lazy_patch, "i");
 #endif
 MODULE_PARM_DESC(good_list, "Comma-delimited list of additions/removals from the list of known good filesystems");
 MODULE_PARM_DESC(skip_list, "Comma-delimited list of additions/removals from the list of ignored filesystems");
 MODULE_PARM_DESC(no_scan, "Comma-delimited list of additions/removals from the list of filesystems which need a workaround on mount");
 MODULE_PARM_DESC(no_scan_on_load, "Set to apply no_scan list at talpa load time, rather than just on new mounts");
+MODULE_PARM_DESC(lazy_patch, "Set to patch each filesystem type once at load and process existing mounts in the background");
 
 static void parseParams(void* self, char *param, talpa_list_head* list, char **set)
 {
@@ -3160,24 +3619,19 @@ static void purgePatches(void* self)
     } while (ret);
 
 nextpatch:
-    talpa_rcu_write_lock(&this->mPatchLock);
+    lockPatches();
     talpa_list_for_each_entry_rcu(p, &this->mPatches, head)
     {
         DEBUG_info("Restoring %s", p->fstype->name);
         restoreFilesystem(p);
         talpa_list_del_rcu(&p->head);
-        talpa_rcu_write_unlock(&this->mPatchLock);
-        atomic_dec(&p->refcnt);
-        do
-        {
-            talpa_rcu_synchronize();
-            DEBUG_info("  refcnt for %s = %d after sync", p->fstype->name, atomic_read(&p->refcnt));
-        } while ( atomic_read(&p->refcnt) > 0 );
-        talpa_free(p);
+        unlockPatches();
+        waitForPatch(p);
+        freePatch(p);
         p = NULL;
         goto nextpatch;
     }
-    talpa_rcu_write_unlock(&this->mPatchLock);
+    unlockPatches();
 
     talpa_syscallhook_modify_finish();
 
@@ -3199,13 +3653,19 @@ VFSHookInterceptor* newVFSHookInterceptor(void)
         return NULL;
     }
 
-    init_waitqueue_head(&GL_object.mUnload);
+    if ( talpa_pcpu_ref_init(&GL_object.mUseCnt) )
+    {
+        talpa_mutex_unlock(&GL_object.mSemaphore);
+        err("Failed to allocate usage counter!");
+        return NULL;
+    }
 
     constructSpecialSet(&GL_object);
     GL_object.mLinuxFilesystemFactory = TALPA_Portability()->filesystemFactory()->object;
     GL_object.mLinuxSystemRoot = TALPA_Portability()->systemRoot()->object;
 
     talpa_rcu_lock_init(&GL_object.mPatchLock);
+    talpa_lock_stats_name(&GL_object.mPatchLock, "vfshook-patch");
     TALPA_INIT_LIST_HEAD(&GL_object.mPatches);
     talpa_rcu_lock_init(&GL_object.mListLock);
     TALPA_INIT_LIST_HEAD(&GL_object.mGoodFilesystems);
@@ -3289,13 +3749,33 @@ VFSHookInterceptor* newVFSHookInterceptor(void)
     parseParams(&GL_object, good_list, &GL_object.mGoodFilesystems, &GL_object.mGoodFilesystemsSet);
     parseParams(&GL_object, skip_list, &GL_object.mSkipFilesystems, &GL_object.mSkipFilesystemsSet);
     parseParams(&GL_object, no_scan, &GL_object.mNoScanFilesystems, &GL_object.mNoScanFilesystemsSet);
+    compileFilesystemLists(&GL_object);
 
     /* Lock kernel so that no (u)mounting can happen between us walking the mount
        tree and hooking into the syscall table */
     talpa_lock_kernel();
 
+#ifdef TALPA_DEFERRED_UNPATCH
+    INIT_DELAYED_WORK(&GL_object.mUnpatchWork, unpatchWork);
+#endif
+
+#ifndef TALPA_LAZY_PATCHING
+    if ( lazy_patch )
+    {
+        warn("Lazy patching is not supported on this kernel");
+        lazy_patch = 0;
+    }
+#endif
+
     /* See which filesystem are already present and patch them */
-    err = walkMountTree();
+    if ( lazy_patch )
+    {
+        err = lazyWalkMountTree();
+    }
+    else
+    {
+        err = walkMountTree();
+    }
     if ( err )
     {
         err("Failed to patch one of the filesystems! (%d)", err);
@@ -3312,6 +3792,11 @@ VFSHookInterceptor* newVFSHookInterceptor(void)
 
     talpa_unlock_kernel();
 
+    if ( lazy_patch )
+    {
+        talpa_queue_long_work(&GL_object.mLazyWork);
+    }
+
     GL_object.mInitialized = true;
 
     talpa_mutex_unlock(&GL_object.mSemaphore);
@@ -3321,6 +3806,7 @@ VFSHookInterceptor* newVFSHookInterceptor(void)
 error:
     talpa_unlock_kernel();
     purgePatches(&GL_object);
+    talpa_pcpu_ref_destroy(&GL_object.mUseCnt);
     /* Free the configuration list objects */
     talpa_list_for_each_entry_safe(obj, tmp, &GL_object.mGoodFilesystems, head)
     {
@@ -3365,9 +3851,7 @@ static void deleteVFSHookInterceptor(struct tag_VFSHookInterceptor* object)
         object->mInterceptMask = 0;
         strcpy(object->mConfigData.value, CFG_VALUE_DISABLED);
 
-        if ( atomic_dec_and_test(&object->mUseCnt) != 0 )
-        {
-        }
+        talpa_pcpu_ref_put(&object->mUseCnt);
         module_put(THIS_MODULE);
     }
 
@@ -3375,10 +3859,26 @@ static void deleteVFSHookInterceptor(struct tag_VFSHookInterceptor* object)
 
     talpa_mutex_unlock(&object->mSemaphore);
 
+    if ( lazy_patch )
+    {
+        lazyStop();
+    }
+
+#ifdef TALPA_DEFERRED_UNPATCH
+    cancel_delayed_work_sync(&object->mUnpatchWork);
+#endif
+
     purgePatches(object);
 
-    /* Now we must wait for all callers to leave our hooks */
-    wait_event(object->mUnload, atomic_read(&object->mUseCnt) == 0);
+    /* Now we must wait for all callers to leave our hooks. Nothing new can
+       enter them once the patches are gone, so the sum can only go down. */
+    while ( talpa_pcpu_ref_sum(&object->mUseCnt) != 0 )
+    {
+        __set_current_state(TASK_UNINTERRUPTIBLE);
+        schedule_timeout(HZ/10);
+    }
+    talpa_pcpu_ref_destroy(&object->mUseCnt);
+    talpa_lock_stats_release(&object->mPatchLock);
 
     object->mLinuxFilesystemFactory = NULL;
     object->mLinuxSystemRoot = NULL;
@@ -3673,6 +4173,40 @@ static bool removeObject(void *self, talpa_list_head* list, const char* value)
     return false;
 }
 
+static void compileList(talpa_list_head* list, talpa_fstype_set_t* ids)
+{
+    VFSHookObject *obj;
+    talpa_fstype_set_t newids;
+
+
+    talpa_fstype_set_zero(&newids);
+
+    talpa_rcu_read_lock(&GL_object.mListLock);
+    talpa_list_for_each_entry_rcu(obj, list, head)
+    {
+        talpa_fstype_set_add(&newids, talpa_fstype_intern(obj->value));
+    }
+    talpa_rcu_read_unlock(&GL_object.mListLock);
+
+    talpa_fstype_set_copy(ids, &newids);
+
+    return;
+}
+
+/*
+ * Rebuilds the filesystem type bitmaps after the lists have changed.
+ * Called with mSemaphore held.
+ */
+static void compileFilesystemLists(void* self)
+{
+    compileList(&this->mGoodFilesystems, &this->mGoodFilesystemIds);
+    compileList(&this->mSkipFilesystems, &this->mSkipFilesystemIds);
+    compileList(&this->mNoScanFilesystems, &this->mNoScanFilesystemIds);
+    compileList(&this->mHookDopsFilesystems, &this->mHookDopsFilesystemIds);
+
+    return;
+}
+
 static void doActionString(void* self, talpa_list_head* list, char** set, const char* value)
 {
     if ( strlen(value) < 2 )
@@ -3790,7 +4324,7 @@ static bool enable(void* self)
     {
         if ( try_module_get(THIS_MODULE) )
         {
-            atomic_inc(&this->mUseCnt);
+            talpa_pcpu_ref_get(&this->mUseCnt);
             this->mInterceptMask = this->mHookingMask;
             strcpy(this->mConfigData.value, CFG_VALUE_ENABLED);
             info("Enabled");
@@ -3811,10 +4345,7 @@ static void disable(void* self)
     {
         this->mInterceptMask = 0;
         strcpy(this->mConfigData.value, CFG_VALUE_DISABLED);
-        if ( atomic_dec_and_test(&this->mUseCnt) != 0 ) /* mUseCnt == 0 */
-        {
-            wake_up(&this->mUnload);
-        }
+        talpa_pcpu_ref_put(&this->mUseCnt);
         module_put(THIS_MODULE);
         info("Disabled");
     }
@@ -3839,6 +4370,12 @@ static IInterceptProcessor* interceptProcessor(const void* self)
     return this->mTargetProcessor;
 }
 
+static void setCache(struct tag_VFSHookInterceptor* object, ICache* cache)
+{
+    object->mCache = cache;
+    return;
+}
+
 /*
  * IConfigurable.
  */
@@ -3976,6 +4513,8 @@ static void  setConfig(void* self, const char* name, const char* value)
         doActionString(this, &this->mNoScanFilesystems, &(this->mNoScanFilesystemsSet), value);
     }
 
+    compileFilesystemLists(this);
+
     talpa_mutex_unlock(&this->mSemaphore);
 
     return;
@@ -22,6 +22,8 @@
 
 #include <asm/atomic.h>
 #include <linux/fs.h>
+#include <linux/version.h>
+#include <linux/workqueue.h>
 
 #include "common/bool.h"
 #define TALPA_SUBSYS "vfshook"
@@ -30,11 +32,13 @@
 #include "common/list.h"
 #include "interception/iinterceptor.h"
 #include "intercept_processing/iintercept_processor.h"
+#include "cache/icache.h"
 #include "configurator/iconfigurable.h"
 #include "configurator/pod_configuration_element.h"
 #include "components/services/linux_filesystem_impl/linux_filesystem_factoryimpl.h"
 #include "components/services/linux_filesystem_impl/linux_systemroot.h"
 #include "platforms/linux/talpa_syscallhook.h"
+#include "platforms/linux/fstype.h"
 
 #define VFSHOOK_CFGDATASIZE     (16)
 #define VFSHOOK_OPSCFGDATASIZE  (64)
@@ -85,11 +89,21 @@ typedef struct
 # define TALPA_USE_FLUSH_TO_SCAN_CLOSE_ON_EXIT
 #endif
 
+/* Needs cancel_work_sync() */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,22)
+# define TALPA_LAZY_PATCHING
+#endif
+
+/* Needs cancel_delayed_work_sync() */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,23)
+# define TALPA_DEFERRED_UNPATCH
+#endif
+
 struct patchedFilesystem
 {
     talpa_list_head         head;
     atomic_t                usecnt; /* How many mountpoints are patched with this record */
-    atomic_t                refcnt; /* How many hook functions (+1 for usecnt > 0) are currently using this patch */
+    talpa_pcpu_ref_t        refcnt; /* How many hook functions are currently using this patch */
     struct file_system_type *fstype;
     struct inode_operations *i_ops;
     struct file_operations  *f_ops;
@@ -142,15 +156,39 @@ struct patchedFilesystem
 #endif
     bool                    mHookDOps;
     bool                    mLookupCreateHooked;
+    bool                    mUnpatchPending; /* usecnt reached zero on umount */
 };
 
+/*
+ * Index from operation tables to the patches which own them, one table per
+ * kind of operations. Slots only hold patch pointers and every hit is checked
+ * against the patch itself, so a stale slot is merely a miss. The index is
+ * rebuilt whenever the patch lock is released after a write; a miss is only
+ * trusted when no rebuild was in progress during the lookup.
+ */
+#define VFSHOOK_INDEX_FOPS      (0)
+#define VFSHOOK_INDEX_IOPS      (1)
+#define VFSHOOK_INDEX_DOPS      (2)
+#define VFSHOOK_INDEX_SFOPS     (3)
+#define VFSHOOK_INDEX_KINDS     (4)
+#define VFSHOOK_INDEX_SLOTS     (64)
+
+typedef struct
+{
+    unsigned int                seq;    /* Odd while the index is being changed */
+    bool                        partial; /* Not every patch fitted */
+    struct patchedFilesystem*   slots[VFSHOOK_INDEX_KINDS][VFSHOOK_INDEX_SLOTS];
+} VFSHookPatchIndex;
+
 typedef struct tag_VFSHookInterceptor
 {
     IInterceptor                    i_IInterceptor;
     IConfigurable                   i_IConfigurable;
     void                            (*delete)(struct tag_VFSHookInterceptor* object);
+    void                            (*setCache)(struct tag_VFSHookInterceptor* object, ICache* cache);
 
     IInterceptProcessor*            mTargetProcessor;
+    ICache*                         mCache;
     LinuxFilesystemFactoryImpl*     mLinuxFilesystemFactory;
     LinuxSystemRoot*                mLinuxSystemRoot;
     char*                           mGoodFilesystemsSet;
@@ -160,16 +198,20 @@ typedef struct tag_VFSHookInterceptor
 
     unsigned int                    mInterceptMask;
     unsigned int                    mHookingMask;
-    atomic_t                        mUseCnt;
-    wait_queue_head_t               mUnload;
+    talpa_pcpu_ref_t                mUseCnt;
     talpa_mutex_t                   mSemaphore;
     talpa_rcu_lock_t                mPatchLock;
     talpa_list_head                 mPatches;
+    VFSHookPatchIndex               mPatchIndex;
     talpa_rcu_lock_t                mListLock;
     talpa_list_head                 mGoodFilesystems;
     talpa_list_head                 mSkipFilesystems;
     talpa_list_head                 mNoScanFilesystems;
     talpa_list_head                 mHookDopsFilesystems;
+    talpa_fstype_set_t              mGoodFilesystemIds;
+    talpa_fstype_set_t              mSkipFilesystemIds;
+    talpa_fstype_set_t              mNoScanFilesystemIds;
+    talpa_fstype_set_t              mHookDopsFilesystemIds;
     PODConfigurationElement         mConfig[7];
     VFSHookStatusConfigData         mConfigData;
     VFSHookOpsConfigData            mOpsConfigData;
@@ -179,6 +221,14 @@ typedef struct tag_VFSHookInterceptor
     VFSHookFSConfigData             mPatchConfigData;
     struct talpa_syscall_operations mSyscallOps;
     bool                            mInitialized;
+    bool                            mLazyPending;   /* Existing mounts not all counted yet */
+    bool                            mLazyStop;
+#ifdef TALPA_LAZY_PATCHING
+    struct work_struct              mLazyWork;
+#endif
+#ifdef TALPA_DEFERRED_UNPATCH
+    struct delayed_work             mUnpatchWork;
+#endif
 } VFSHookInterceptor;
 
 /*
@@ -32,6 +32,7 @@
 #include "configurator/pod_configuration_element.h"
 #include "platforms/linux/alloc.h"
 #include "platforms/linux/uaccess.h"
+#include "platforms/linux/verdict.h"
 
 #include "procfs_configurator.h"
 
@@ -389,6 +390,7 @@ static int ctlHandler(ctl_table* table, int* name, int nlen, void* oldvalue, siz
         }
         cfgValue[len] = 0;
         ((IConfigurable*)table->extra1)->set(((IConfigurable*)table->extra1)->object, table->procname, cfgValue);
+        talpa_verdict_invalidate();
         talpa_large_free(cfgValue);
     }
     return 1;
@@ -454,6 +456,7 @@ static int procHandler(ctl_table* table, int write, struct file* filp, void __us
 
         PPOS += *lenp;
         ((IConfigurable*)table->extra1)->set(((IConfigurable*)table->extra1)->object, table->procname, cfgValue);
+        talpa_verdict_invalidate();
         talpa_large_free(cfgValue);
 
         return 0;
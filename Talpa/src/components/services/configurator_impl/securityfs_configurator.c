@@ -30,6 +30,7 @@
 #include "common/list.h"
 #include "platform/alloc.h"
 #include "platform/uaccess.h"
+#include "platform/verdict.h"
 #include "configurator/pod_configuration_element.h"
 
 #include "securityfs_configurator.h"
@@ -344,6 +345,7 @@ static ssize_t securityfsWrite(struct file *file, const char __user *buf, size_t
     data[len] = 0;
     dbg("setting %s/%s = %s", item->name(item->object), element->name, data);
     item->set(item->object, element->name, data);
+    talpa_verdict_invalidate();
     talpa_large_free(data);
 
     return count;
@@ -31,6 +31,7 @@
 #include "platforms/linux/locking.h"
 #include "platforms/linux/uaccess.h"
 #include "platforms/linux/vfs_mount.h"
+#include "platforms/linux/fstype.h"
 #include "linux_fileinfo.h"
 #include "app_ctrl/iportability_app_ctrl.h"
 
@@ -56,10 +57,12 @@ static uint32_t              deviceMajor          (const void* self);
 static uint32_t              deviceMinor          (const void* self);
 static const char*           deviceName           (const void* self);
 static const char*           fsType               (const void* self);
+static unsigned int          fsTypeId             (const void* self);
 static bool                  fsObjects            (const void* self, void** obj1, void** obj2);
 static bool                  isDeleted            (const void* self);
 static bool                  isNonRootNamespace   (const void* self);
 static bool                  isInProcessNamespace (const void* self);
+static void*                 sharedFile           (const void* self);
 static void deleteLinuxFileInfo(struct tag_LinuxFileInfo* object);
 
 
@@ -82,10 +85,12 @@ static LinuxFileInfo template_LinuxFileInfo =
             deviceMinor,
             deviceName,
             fsType,
+            fsTypeId,
             fsObjects,
             isDeleted,
             isNonRootNamespace,
             isInProcessNamespace,
+            sharedFile,
             NULL,
             (void (*)(const void*))deleteLinuxFileInfo
         },
@@ -105,9 +110,9 @@ static LinuxFileInfo template_LinuxFileInfo =
         0, /* mDeviceMinor */
         NULL, /* mPath */
         NULL, /* mDeviceName */
-        NULL, /* mFSType */
         false, /* mIsNonRootNamespace */
-        true /* mIsInProcessMntNamespace */
+        true, /* mIsInProcessMntNamespace */
+        NULL /* mSharedFile */
     };
 #define this    ((LinuxFileInfo*)self)
 
@@ -125,6 +130,7 @@ LinuxFileInfo* newLinuxFileInfo(EFilesystemOperation operation, const char* file
 #endif
     struct vfsmount *mnt;
     struct dentry *dentry;
+    struct inode* real;
     int rc;
     size_t path_size = 0;
     ISystemRoot* root;
@@ -185,12 +191,13 @@ LinuxFileInfo* newLinuxFileInfo(EFilesystemOperation operation, const char* file
     object->mDentry = dentry;
     object->mVFSMount = mnt;
     object->mMode = dentry->d_inode->i_mode;
-    object->mIno = dentry->d_inode->i_ino;
+    real = talpa_real_inode(dentry);
+    object->mIno = real->i_ino;
 
     object->mWriteCount = (atomic_read(&dentry->d_inode->i_writecount)<=0)?0:atomic_read(&dentry->d_inode->i_writecount);
-    object->mDevice = kdev_t_to_nr(inode_dev(dentry->d_inode));
-    object->mDeviceMajor = MAJOR(inode_dev(dentry->d_inode));
-    object->mDeviceMinor = MINOR(inode_dev(dentry->d_inode));
+    object->mDevice = kdev_t_to_nr(inode_dev(real));
+    object->mDeviceMajor = MAJOR(inode_dev(real));
+    object->mDeviceMinor = MINOR(inode_dev(real));
     /* dbg("newLinuxFileInfo: %s, F:0x%x, M:0x%x, D:0x%x",object->mFilename,object->mFlags,object->mMode,(unsigned int)object->mDevice); */
 
     exit:
@@ -247,12 +254,15 @@ LinuxFileInfo* newLinuxFileInfoFromFd(EFilesystemOperation operation, int fd)
 
             if ( likely(file->f_dentry && file->f_dentry->d_inode) )
             {
+                struct inode* real = talpa_file_key_inode(file);
+
+
                 object->mMode = file->f_dentry->d_inode->i_mode;
-                object->mIno = file->f_dentry->d_inode->i_ino;
+                object->mIno = real->i_ino;
                 object->mInode = file->f_dentry->d_inode;
-                object->mDevice = kdev_t_to_nr(inode_dev(file->f_dentry->d_inode));
-                object->mDeviceMajor = MAJOR(inode_dev(file->f_dentry->d_inode));
-                object->mDeviceMinor = MINOR(inode_dev(file->f_dentry->d_inode));
+                object->mDevice = kdev_t_to_nr(inode_dev(real));
+                object->mDeviceMajor = MAJOR(inode_dev(real));
+                object->mDeviceMinor = MINOR(inode_dev(real));
             }
             else
             {
@@ -279,6 +289,7 @@ LinuxFileInfo* newLinuxFileInfoFromFile(EFilesystemOperation operation, void* fi
     LinuxFileInfo* fi;
     struct file *file;
     struct inode* inode;
+    struct inode* real;
     ISystemRoot* root;
     size_t path_size = 0;
 
@@ -309,6 +320,7 @@ LinuxFileInfo* newLinuxFileInfoFromFile(EFilesystemOperation operation, void* fi
     }
 
     inode = file->f_dentry->d_inode;
+    real = talpa_file_key_inode(file);
     root = TALPA_Portability()->systemRoot();
 
     /* dbg("systemRoot dentry=%p, vfsmnt=%p", root->directoryEntry(root->object), root->mountPoint(root->object)); */
@@ -324,13 +336,13 @@ LinuxFileInfo* newLinuxFileInfoFromFile(EFilesystemOperation operation, void* fi
     fi->mOperation = operation;
     fi->mFlags = file->f_flags;
     fi->mMode = inode->i_mode;
-    fi->mIno = inode->i_ino;
+    fi->mIno = real->i_ino;
     fi->mInode = inode;
     fi->mDentry = file->f_dentry;
     fi->mVFSMount = file->f_vfsmnt;
-    fi->mDevice = kdev_t_to_nr(inode_dev(inode));
-    fi->mDeviceMajor = MAJOR(inode_dev(inode));
-    fi->mDeviceMinor = MINOR(inode_dev(inode));
+    fi->mDevice = kdev_t_to_nr(inode_dev(real));
+    fi->mDeviceMajor = MAJOR(inode_dev(real));
+    fi->mDeviceMinor = MINOR(inode_dev(real));
 
     /* dbg("newLinuxFileInfoFromFile: %s, F:0x%x, M:0x%x, D:0x%x, P:%d",fi->mFilename,fi->mFlags,fi->mMode,(unsigned int)fi->mDevice, current->pid); */
 
@@ -401,11 +413,14 @@ LinuxFileInfo* newLinuxFileInfoFromDirectoryEntry(EFilesystemOperation operation
 
     if ( likely(inode != NULL) )
     {
-        fi->mIno = inode->i_ino;
+        struct inode* real = talpa_real_inode(dentry);
+
+
+        fi->mIno = real->i_ino;
         fi->mInode = inode;
-        fi->mDevice = kdev_t_to_nr(inode_dev(inode));
-        fi->mDeviceMajor = MAJOR(inode_dev(inode));
-        fi->mDeviceMinor = MINOR(inode_dev(inode));
+        fi->mDevice = kdev_t_to_nr(inode_dev(real));
+        fi->mDeviceMajor = MAJOR(inode_dev(real));
+        fi->mDeviceMinor = MINOR(inode_dev(real));
     }
 
     /* dbg("newLinuxFileInfoFromDirectoryEntry: %s, F:0x%x, M:0x%x, D:0x%x",fi->mFilename,fi->mFlags,fi->mMode,(unsigned int)fi->mDevice); */
@@ -457,7 +472,6 @@ static void deleteLinuxFileInfo(struct tag_LinuxFileInfo* object)
     {
         talpa_free_path(object->mPath);
         talpa_free(object->mDeviceName);
-        talpa_free(object->mFSType);
         talpa_free(object);
     }
     return;
@@ -557,28 +571,30 @@ static const char* deviceName(const void* self)
 
 static const char* fsType(const void* self)
 {
-    struct vfsmount* mnt;
+    struct vfsmount* mnt = this->mVFSMount;
 
-    if ( unlikely(this->mFSType != NULL) )
+
+    /* The name belongs to the filesystem type, which cannot go away
+       while the mount is in use. */
+    if ( likely(mnt != NULL) )
     {
-        return this->mFSType;
+        return mnt->mnt_sb->s_type->name;
     }
 
-    mnt = this->mVFSMount;
+    return NULL;
+}
+
+static unsigned int fsTypeId(const void* self)
+{
+    struct vfsmount* mnt = this->mVFSMount;
+
 
     if ( likely(mnt != NULL) )
     {
-        if ( likely(mnt->mnt_sb->s_type->name != NULL) )
-        {
-            this->mFSType = talpa_alloc(strlen(mnt->mnt_sb->s_type->name) + 1);
-            if ( likely(this->mFSType != NULL) )
-            {
-                strcpy(this->mFSType, mnt->mnt_sb->s_type->name);
-            }
-        }
+        return talpa_fstype_id(mnt->mnt_sb->s_type);
     }
 
-    return this->mFSType;
+    return TALPA_FSTYPE_NONE;
 }
 
 static bool fsObjects(const void* self, void** obj1, void** obj2)
@@ -614,6 +630,15 @@ static bool isInProcessNamespace(const void* self)
     return this->mIsInProcessMntNamespace;
 }
 
+/*
+ * The intercepted file, if the stream interface should use it rather than
+ * open a copy. Only valid while the intercept is being processed.
+ */
+static void* sharedFile(const void* self)
+{
+    return this->mSharedFile;
+}
+
 /*
 * End of linux_fileinfo.c
 */
@@ -47,9 +47,9 @@ typedef struct tag_LinuxFileInfo
     uint32_t                    mDeviceMinor;
     char*                       mPath;
     char*                       mDeviceName;
-    char*                       mFSType;
     bool                        mIsNonRootNamespace;
     bool                        mIsInProcessMntNamespace;
+    struct file*                mSharedFile;
 } LinuxFileInfo;
 
 /*
@@ -21,6 +21,8 @@
 #include "linux_fileinfo.h"
 #include "linux_filesysteminfo.h"
 
+#include "platform/latency.h"
+
 /*
  * Forward declare implementation methods.
  */
@@ -29,6 +31,7 @@ static IFile* cloneFile(const void* self, void* fobject);
 static IFileInfo* newFileInfo(const void* self, EFilesystemOperation operation, const char* filename, int flags, int mode);
 static IFileInfo* newFileInfoFromFd(const void* self, EFilesystemOperation operation, int fd);
 static IFileInfo* newFileInfoFromFile(const void* self, EFilesystemOperation operation, void* file);
+static IFileInfo* newFileInfoSharingFile(const void* self, EFilesystemOperation operation, void* file);
 static IFileInfo* newFileInfoFromDirectoryEntry(const void* self, EFilesystemOperation operation, void* dentry, void* mnt, int flags, int mode);
 static IFileInfo* newFileInfoFromInode(const void* self, EFilesystemOperation operation, void* inode, int flags);
 static IFilesystemInfo* newFilesystemInfo(const void* self, EFilesystemOperation operation, const char* dev_name, const char* dir_name, const char* type);
@@ -45,6 +48,7 @@ static LinuxFilesystemFactoryImpl GL_object =
             newFileInfo,
             newFileInfoFromFd,
             newFileInfoFromFile,
+            newFileInfoSharingFile,
             newFileInfoFromDirectoryEntry,
             newFileInfoFromInode,
             newFilesystemInfo,
@@ -93,36 +97,64 @@ static IFile* cloneFile(const void* self, void* fobject)
 static IFileInfo* newFileInfo(const void* self, EFilesystemOperation operation, const char* filename, int flags, int mode)
 {
     LinuxFileInfo*  object;
+    uint64_t        start = talpa_latency_now();
 
 
     object = newLinuxFileInfo(operation, filename, flags, mode);
+    talpa_latency_record(ELS_FileInfo, start);
     return (object != NULL) ? &object->i_IFileInfo : NULL;
 }
 
 static IFileInfo* newFileInfoFromFd(const void* self, EFilesystemOperation operation, int fd)
 {
     LinuxFileInfo*  object;
+    uint64_t        start = talpa_latency_now();
 
 
     object = newLinuxFileInfoFromFd(operation, fd);
+    talpa_latency_record(ELS_FileInfo, start);
     return (object != NULL) ? &object->i_IFileInfo : NULL;
 }
 
 static IFileInfo* newFileInfoFromFile(const void* self, EFilesystemOperation operation, void* file)
 {
     LinuxFileInfo*  fi;
+    uint64_t        start = talpa_latency_now();
+
+
+    fi = newLinuxFileInfoFromFile(operation, file);
+    talpa_latency_record(ELS_FileInfo, start);
+    return (fi != NULL) ? &fi->i_IFileInfo : NULL;
+}
+
+/*
+ * As newFileInfoFromFile, but a vetting stream will share the intercepted
+ * file. It is only cloned once a vetting job actually needs it, so intercepts
+ * decided by the cheaper filters never touch it.
+ */
+static IFileInfo* newFileInfoSharingFile(const void* self, EFilesystemOperation operation, void* file)
+{
+    LinuxFileInfo*  fi;
+    uint64_t        start = talpa_latency_now();
 
 
     fi = newLinuxFileInfoFromFile(operation, file);
+    if ( likely(fi != NULL) )
+    {
+        fi->mSharedFile = file;
+    }
+    talpa_latency_record(ELS_FileInfo, start);
     return (fi != NULL) ? &fi->i_IFileInfo : NULL;
 }
 
 static IFileInfo* newFileInfoFromDirectoryEntry(const void* self, EFilesystemOperation operation, void* dentry, void* mnt, int flags, int mode)
 {
     LinuxFileInfo*  fi;
+    uint64_t        start = talpa_latency_now();
 
 
     fi = newLinuxFileInfoFromDirectoryEntry(operation, dentry, mnt, flags, mode);
+    talpa_latency_record(ELS_FileInfo, start);
     return (fi != NULL) ? &fi->i_IFileInfo : NULL;
 }
 
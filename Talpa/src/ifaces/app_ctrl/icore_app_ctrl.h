@@ -23,12 +23,14 @@
 #include "intercept_processing/iintercept_processor.h"
 #include "vetting_server/ivetting_server.h"
 #include "process_excluder/iprocess_excluder.h"
+#include "cache/icache.h"
 
 typedef struct
 {
     IInterceptProcessor*           (*interceptProcessor)(void);
     IVettingServer*                (*vettingServer)     (void);
     IProcessExcluder*              (*processExcluder)    (void);
+    ICache*                        (*cache)              (void);
 } ICoreApplicationControl;
 
 extern const ICoreApplicationControl* TALPA_Core(void);
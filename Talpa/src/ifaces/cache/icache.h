@@ -24,7 +24,7 @@
 typedef struct
 {
     int     (*find)     (const void* self, const uint32_t keyH, const uint32_t keyL);
-    void    (*add)      (void *self, const char* class, const uint32_t keyH, const uint32_t keyL);
+    bool    (*add)      (void *self, unsigned int fstype, const char* fsname, const uint32_t keyH, const uint32_t keyL);
     void    (*clear)    (void *self, const uint32_t keyH, const uint32_t keyL);
     void    (*purge)    (void *self, const uint32_t keyH);
 
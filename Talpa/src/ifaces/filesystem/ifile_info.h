@@ -40,10 +40,12 @@ typedef struct
     uint32_t              (*deviceMinor)          (const void* self);
     const char*           (*deviceName)           (const void* self);
     const char*           (*fsType)               (const void* self);
+    unsigned int          (*fsTypeId)             (const void* self);
     bool                  (*fsObjects)            (const void* self, void** obj1, void** obj2);
     bool                  (*isDeleted)            (const void* self);
     bool                  (*isNonRootNamespace)   (const void* self);
     bool                  (*isInProcessNamespace) (const void* self);
+    void*                 (*sharedFile)           (const void* self);
     /*
      *  Object supporting this interface instance.
      */
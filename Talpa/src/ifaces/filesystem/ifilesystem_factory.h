@@ -31,6 +31,7 @@ typedef struct
     IFileInfo*            (*newFileInfo)                    (const void* self, EFilesystemOperation operation, const char* filename, int flags, int mode);
     IFileInfo*            (*newFileInfoFromFd)              (const void* self, EFilesystemOperation operation, int fd);
     IFileInfo*            (*newFileInfoFromFile)            (const void* self, EFilesystemOperation operation, void* file);
+    IFileInfo*            (*newFileInfoSharingFile)         (const void* self, EFilesystemOperation operation, void* file);
     IFileInfo*            (*newFileInfoFromDirectoryEntry)  (const void* self, EFilesystemOperation operation, void* dentry, void* mnt, int flags, int mode);
     IFileInfo*            (*newFileInfoFromInode)           (const void* self, EFilesystemOperation operation, void* inode, int flags);
     IFilesystemInfo*      (*newFilesystemInfo)              (const void* self, EFilesystemOperation operation, const char* dev_name, const char* dir_name, const char* type);
@@ -0,0 +1,55 @@
+/*
+ * baseline.h
+ *
+ * TALPA Platform code
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXBASELINE
+#define H_LINUXBASELINE
+
+#include <linux/fs.h>
+
+#include "platforms/linux/bool.h"
+
+/*
+ * Write baselines.
+ *
+ * What a file looked like when it was opened for writing: modification and
+ * change time, size and i_version. When the file is closed the interceptor
+ * can then tell whether it was written at all and skip the close scan if it
+ * was not. Baselines are kept per inode in a small direct mapped table in
+ * the talpa_linux module. A file without a baseline, because it was pushed
+ * out or opened before we were loaded, always counts as modified, as does
+ * every file outside local block device filesystems.
+ */
+
+/*
+ * Takes a baseline for a writable open, counted tells whether i_writecount
+ * already includes this open. A file already open for writing keeps its
+ * earlier baseline.
+ */
+void talpa_baseline_record(struct inode* inode, bool counted);
+
+/*
+ * True if a file being closed after a writable open is exactly as it was
+ * when its baseline was taken. The baseline is released when the last
+ * writer recorded against it closes.
+ */
+bool talpa_baseline_unchanged(struct inode* inode);
+
+#endif /* H_LINUXBASELINE */
+/*
+ * End of baseline.h
+ */
@@ -0,0 +1,73 @@
+/*
+ * capture.h
+ *
+ * TALPA Platform code
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXCAPTURE
+#define H_LINUXCAPTURE
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+
+#include "platforms/linux/bool.h"
+#include "talpa-capture.h"
+
+/*
+ * Intercept capture.
+ *
+ * Cache operations are recorded into per-CPU rings of TalpaCaptureRecord
+ * which are drained by reading the talpa-capture misc device. When a ring
+ * is full new records are dropped and counted rather than overwriting ones
+ * not yet read, so a trace is either complete or known to have gaps.
+ *
+ * The rings and the device live in the talpa_linux module which exports
+ * the rest to the other modules.
+ */
+
+#define TALPA_CAPTURE_RING      (4096)  /* Records per CPU, a power of two */
+
+extern bool talpa_capture_enabled;
+
+void talpa_capture_add(unsigned int event, unsigned int op, int flags, uint32_t device, uint32_t inode, uint32_t pathHash);
+
+/*
+ * Records a cache operation if capture is enabled. The path is only hashed
+ * when it is, and may be NULL.
+ */
+#define talpa_capture(event, op, flags, device, inode, path) \
+do \
+{ \
+    if ( unlikely(talpa_capture_enabled) ) \
+    { \
+        talpa_capture_add((event), (op), (flags), (device), (inode), talpa_capture_hash(path)); \
+    } \
+} while (0)
+
+/*
+ * The rings are allocated the first time capture is enabled and kept until
+ * the module is unloaded, so whatever was captured can still be read after
+ * capture is disabled.
+ */
+int talpa_capture_enable(bool enable);
+unsigned long talpa_capture_lost(void);
+
+int talpa_capture_init(void);
+void talpa_capture_exit(void);
+
+#endif /* H_LINUXCAPTURE */
+/*
+ * End of capture.h
+ */
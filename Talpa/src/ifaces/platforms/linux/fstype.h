@@ -0,0 +1,109 @@
+/*
+ * fstype.h
+ *
+ * TALPA Platform code
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#ifndef H_LINUXFSTYPE
+#define H_LINUXFSTYPE
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/bitops.h>
+
+#include "platforms/linux/bool.h"
+
+/*
+ * Filesystem type registry.
+ *
+ * Every filesystem type name is interned to a small integer ID the first time
+ * it is seen, either from configuration or from a superblock. IDs are never
+ * reused while the registry exists, so configuration can be compiled into
+ * per-ID bitmaps and tested on the intercept path without touching strings.
+ *
+ * The registry lives in the talpa_linux module which exports it to the rest.
+ */
+
+#define TALPA_FSTYPE_NONE       (0)     /* Type which could not be registered */
+#define TALPA_FSTYPE_MAX        (256)
+#define TALPA_FSTYPE_NAMELEN    (32)
+
+typedef struct
+{
+    unsigned long   bits[(TALPA_FSTYPE_MAX + BITS_PER_LONG - 1) / BITS_PER_LONG];
+} talpa_fstype_set_t;
+
+/*
+ * Returns the ID for a filesystem type name, registering it if needed.
+ */
+unsigned int talpa_fstype_intern(const char* name);
+
+/*
+ * Returns the ID for a filesystem type name if it is already registered,
+ * otherwise TALPA_FSTYPE_NONE. Never registers, so it is safe for names
+ * which come from userspace.
+ */
+unsigned int talpa_fstype_find(const char* name);
+
+/*
+ * Returns the ID of a filesystem type. Lock free once the type has been
+ * seen, so it is suitable for the intercept path.
+ */
+unsigned int talpa_fstype_id(struct file_system_type* type);
+
+/*
+ * Returns the name registered for an ID, or NULL.
+ */
+const char* talpa_fstype_name(unsigned int id);
+
+/*
+ * Bitmaps are built privately and then copied over the live one. Readers
+ * take no lock and may briefly see a mix of old and new bits, which is no
+ * different from racing with the configuration change itself.
+ */
+static inline void talpa_fstype_set_zero(talpa_fstype_set_t* set)
+{
+    memset(set, 0, sizeof(*set));
+}
+
+static inline void talpa_fstype_set_add(talpa_fstype_set_t* set, unsigned int id)
+{
+    if ( id != TALPA_FSTYPE_NONE )
+    {
+        __set_bit(id, set->bits);
+    }
+}
+
+static inline bool talpa_fstype_set_test(const talpa_fstype_set_t* set, unsigned int id)
+{
+    return test_bit(id, set->bits) ? true : false;
+}
+
+static inline void talpa_fstype_set_copy(talpa_fstype_set_t* dst, const talpa_fstype_set_t* src)
+{
+    unsigned int i;
+
+
+    for ( i = 0; i < sizeof(dst->bits) / sizeof(dst->bits[0]); i++ )
+    {
+        dst->bits[i] = src->bits[i];
+    }
+}
+
+#endif /* H_LINUXFSTYPE */
+/*
+ * End of fstype.h
+ */
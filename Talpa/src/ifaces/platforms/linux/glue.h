@@ -412,6 +412,34 @@ static inline gid_t __talpa_kgid_val(talpa_kgid_t gid)
 #define f_dentry f_path.dentry
 #endif /* TALPA_FDENTRY_DEFINED */
 
+/*
+ * The inode holding the data a dentry shows. For an overlayfs file which
+ * has not been copied up that is the lower layer inode, shared by every
+ * container started from the same image, so verdicts keyed on it are
+ * shared too. Everywhere else it is simply the dentry's own inode.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,8,0)
+#include <linux/dcache.h>
+#define talpa_real_inode(dentry) d_real_inode(dentry)
+#else
+#define talpa_real_inode(dentry) ((dentry)->d_inode)
+#endif
+
+/*
+ * The inode to key a file's verdicts on. Since 4.19 overlayfs copies a file
+ * up for writing inside its own open method, so until that has run the real
+ * inode of a writable open is still the shared lower one, which writing to
+ * the file must not clear. Such files are keyed on the overlay inode until
+ * they are open.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0)
+#define talpa_file_key_inode(file) \
+    ( ( !((file)->f_mode & FMODE_OPENED) && flags_to_writable((file)->f_flags) ) ? \
+        (file)->f_dentry->d_inode : talpa_real_inode((file)->f_dentry) )
+#else
+#define talpa_file_key_inode(file) talpa_real_inode((file)->f_dentry)
+#endif
+
 void* getUtsNamespace(struct task_struct* process);
 
 #endif /* H_LINUXGLUE */
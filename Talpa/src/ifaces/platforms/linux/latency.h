@@ -0,0 +1,108 @@
+/*
+ * latency.h
+ *
+ * TALPA Platform code
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXLATENCY
+#define H_LINUXLATENCY
+
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/types.h>
+#include <linux/time.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,16)
+#include <linux/ktime.h>
+#endif
+
+#include "platforms/linux/bool.h"
+
+/*
+ * Intercept latency histograms.
+ *
+ * Every stage of an intercept feeds a per-CPU histogram with one bucket per
+ * power of two nanoseconds. Timestamps are only taken while collection is
+ * enabled and a zero start time is never recorded, so intercepts which were
+ * already in flight when collection was switched on are simply skipped.
+ *
+ * The histograms live in the talpa_linux module which exports them to the rest.
+ */
+
+typedef enum
+{
+    ELS_Intercept = 0,  /* Interceptor entry to verdict */
+    ELS_Inode,          /* examineInode filter chains */
+    ELS_FileInfo,       /* IFileInfo construction, mostly path resolution */
+    ELS_Filters,        /* examineFileInfo filter chains, including vetting */
+    ELS_Queued,         /* Queued in the group until a vetting client takes it */
+    ELS_Service,        /* Held by the vetting client until it responds */
+    ELS_Wakeup,         /* Response until the intercepted process runs again */
+    ELS_Max
+} ETalpaLatencyStage;
+
+#define TALPA_LATENCY_BUCKETS   (40)    /* The last one also counts anything longer */
+
+typedef struct
+{
+    unsigned long   count[TALPA_LATENCY_BUCKETS];
+    uint64_t        total;
+} talpa_latency_hist_t;
+
+extern bool talpa_latency_enabled;
+
+static inline uint64_t talpa_latency_clock(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,16)
+    return ktime_to_ns(ktime_get());
+#else
+    struct timeval tv;
+
+
+    do_gettimeofday(&tv);
+
+    return (uint64_t)tv.tv_sec * 1000000000ULL + (uint64_t)tv.tv_usec * 1000ULL;
+#endif
+}
+
+/*
+ * Start time for a stage, zero when collection is disabled.
+ */
+static inline uint64_t talpa_latency_now(void)
+{
+    if ( likely(!talpa_latency_enabled) )
+    {
+        return 0;
+    }
+
+    return talpa_latency_clock();
+}
+
+/*
+ * Records the time from start until now against a stage.
+ */
+void talpa_latency_record(ETalpaLatencyStage stage, uint64_t start);
+
+/*
+ * Sums a stage's histogram over all CPUs.
+ */
+void talpa_latency_read(ETalpaLatencyStage stage, talpa_latency_hist_t* hist);
+
+void talpa_latency_reset(ETalpaLatencyStage stage);
+void talpa_latency_enable(bool enable);
+
+#endif /* H_LINUXLATENCY */
+/*
+ * End of latency.h
+ */
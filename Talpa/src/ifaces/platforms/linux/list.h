@@ -145,6 +145,14 @@ typedef struct rcu_head talpa_rcu_head;
 #define talpa_rcu_init(x)           INIT_RCU_HEAD(x)
 #define talpa_rcu_call(head, func)  call_rcu(head, func)
 
+#ifdef rcu_assign_pointer
+#define talpa_rcu_dereference(p)        rcu_dereference(p)
+#define talpa_rcu_assign_pointer(p, v)  rcu_assign_pointer(p, v)
+#else
+#define talpa_rcu_dereference(p)        ({ typeof(p) _p = (p); smp_read_barrier_depends(); _p; })
+#define talpa_rcu_assign_pointer(p, v)  ({ smp_wmb(); (p) = (v); })
+#endif
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,32))
 #define talpa_rcu_synchronize       synchronize_rcu
 #elif (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,12)) || defined TALPA_HAS_BACKPORTED_RCU
@@ -153,6 +161,12 @@ typedef struct rcu_head talpa_rcu_head;
 #define talpa_rcu_synchronize       synchronize_kernel
 #endif
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,16))
+#define talpa_rcu_barrier           rcu_barrier
+#else
+#define talpa_rcu_barrier           talpa_rcu_synchronize
+#endif
+
 #else /* LINUX_VERSION_CODE < KERNEL_VERSION(2,6,0) */
 
 typedef  unsigned int talpa_rcu_head;
@@ -160,7 +174,12 @@ typedef  unsigned int talpa_rcu_head;
 #define TALPA_RCU_INIT              (0)
 #define talpa_rcu_init(x)           do { } while(0)
 #define talpa_rcu_call(head, func)  func(head)
+
+/* Pointer swaps are done under the write side of talpa_rcu_lock_t here. */
+#define talpa_rcu_dereference(p)        (p)
+#define talpa_rcu_assign_pointer(p, v)  ((p) = (v))
 #define talpa_rcu_synchronize       schedule
+#define talpa_rcu_barrier           schedule
 
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0) */
 
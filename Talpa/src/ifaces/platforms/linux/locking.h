@@ -46,6 +46,20 @@
 #include <linux/smp_lock.h>
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33)
+#include <linux/errno.h>
+#include <linux/percpu.h>
+#else
+#include <asm/atomic.h>
+#include <linux/slab.h>
+#endif
+#include <linux/string.h>
+#ifdef TALPA_LOCK_STATS
+#include <linux/list.h>
+
+#include "platforms/linux/latency.h"
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,16) || defined TALPA_HAS_MUTEXES
 
 typedef struct mutex talpa_mutex_t;
@@ -76,25 +90,31 @@ typedef struct semaphore talpa_mutex_t;
 
 #endif
 
-typedef spinlock_t talpa_simple_lock_t;
-
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,25)
-#define TALPA_SIMPLE_UNLOCKED(lockname)   __SPIN_LOCK_UNLOCKED(lockname)
+#define TALPA_RAW_SPIN_UNLOCKED(lockname)   __SPIN_LOCK_UNLOCKED(lockname)
 #else
-#define TALPA_SIMPLE_UNLOCKED(lockname)   SPIN_LOCK_UNLOCKED
+#define TALPA_RAW_SPIN_UNLOCKED(lockname)   SPIN_LOCK_UNLOCKED
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33)
+#define TALPA_RAW_RW_UNLOCKED(lockname)     __RW_LOCK_UNLOCKED(lockname)
+#else
+#define TALPA_RAW_RW_UNLOCKED(lockname)     RW_LOCK_UNLOCKED
+#endif
+
+#ifndef TALPA_LOCK_STATS
+
+typedef spinlock_t talpa_simple_lock_t;
+
+#define TALPA_SIMPLE_UNLOCKED(lockname)   TALPA_RAW_SPIN_UNLOCKED(lockname)
+
 #define talpa_simple_init       spin_lock_init
 #define talpa_simple_lock       spin_lock
 #define talpa_simple_unlock     spin_unlock
 
 typedef rwlock_t talpa_rw_lock_t;
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33)
-#define TALPA_RW_UNLOCKED(lockname)   __RW_LOCK_UNLOCKED(lockname)
-#else
-#define TALPA_RW_UNLOCKED(lockname)   RW_LOCK_UNLOCKED
-#endif
+#define TALPA_RW_UNLOCKED(lockname)   TALPA_RAW_RW_UNLOCKED(lockname)
 
 #define talpa_rw_init       rwlock_init
 #define talpa_read_lock     read_lock
@@ -126,6 +146,112 @@ typedef rwlock_t talpa_rcu_lock_t;
 
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0) */
 
+/* Naming a lock only matters when it is instrumented */
+#define talpa_lock_stats_name(l, name)                  do { } while (0)
+#define talpa_lock_stats_name_index(l, name, index)     do { } while (0)
+#define talpa_lock_stats_release(l)                     do { } while (0)
+
+#else /* TALPA_LOCK_STATS */
+
+/*
+ * Instrumented locks. A lock which has been given a name counts how often
+ * it is taken, how often it had to be waited for and for how long, see
+ * struct talpa_lock_stats below. Unnamed locks only pay for a test of the
+ * stats pointer. The RCU read side is not a lock and is not counted.
+ */
+struct talpa_lock_stats;
+
+typedef struct
+{
+    spinlock_t                  raw;
+    struct talpa_lock_stats*    stats;
+} talpa_simple_lock_t;
+
+#define TALPA_SIMPLE_UNLOCKED(lockname)   { TALPA_RAW_SPIN_UNLOCKED(lockname), NULL }
+
+#define talpa_simple_init(l)    do { spin_lock_init(&(l)->raw); (l)->stats = NULL; } while (0)
+#define talpa_simple_lock(l)    talpa_lock_stats_acquire(l, spin_trylock, spin_lock, ELKS_Acquired)
+#define talpa_simple_unlock(l)  spin_unlock(&(l)->raw)
+
+typedef struct
+{
+    rwlock_t                    raw;
+    struct talpa_lock_stats*    stats;
+} talpa_rw_lock_t;
+
+#define TALPA_RW_UNLOCKED(lockname)   { TALPA_RAW_RW_UNLOCKED(lockname), NULL }
+
+#define talpa_rw_init(l)        do { rwlock_init(&(l)->raw); (l)->stats = NULL; } while (0)
+#define talpa_read_lock(l)      talpa_lock_stats_acquire(l, read_trylock, read_lock, ELKS_ReadAcquired)
+#define talpa_read_unlock(l)    read_unlock(&(l)->raw)
+#define talpa_write_lock(l)     talpa_lock_stats_acquire(l, write_trylock, write_lock, ELKS_Acquired)
+#define talpa_write_unlock(l)   write_unlock(&(l)->raw)
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
+
+typedef talpa_simple_lock_t talpa_rcu_lock_t;
+
+#define TALPA_RCU_UNLOCKED(lockname)      TALPA_SIMPLE_UNLOCKED(lockname)
+#define talpa_rcu_lock_init         talpa_simple_init
+#define talpa_rcu_read_lock(l)      rcu_read_lock()
+#define talpa_rcu_read_unlock(l)    rcu_read_unlock()
+#define talpa_rcu_write_lock        talpa_simple_lock
+#define talpa_rcu_write_unlock      talpa_simple_unlock
+
+#else /* LINUX_VERSION_CODE < KERNEL_VERSION(2,6,0) */
+
+typedef talpa_rw_lock_t talpa_rcu_lock_t;
+
+#define TALPA_RCU_UNLOCKED(lockname)      TALPA_RW_UNLOCKED(lockname)
+#define talpa_rcu_lock_init     talpa_rw_init
+#define talpa_rcu_read_lock     talpa_read_lock
+#define talpa_rcu_read_unlock   talpa_read_unlock
+#define talpa_rcu_write_lock    talpa_write_lock
+#define talpa_rcu_write_unlock  talpa_write_unlock
+
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0) */
+
+/*
+ * Takes the raw lock, trying first so that only acquisitions which had to
+ * wait are timed.
+ */
+#define talpa_lock_stats_acquire(l, trylock, lock, side) \
+do \
+{ \
+    struct talpa_lock_stats* __stats = (l)->stats; \
+    uint64_t __start; \
+    if ( likely(!__stats) ) \
+    { \
+        lock(&(l)->raw); \
+    } \
+    else if ( trylock(&(l)->raw) ) \
+    { \
+        talpa_pcpu_stats_add(&__stats->counters, (side), 1); \
+    } \
+    else \
+    { \
+        __start = talpa_latency_clock(); \
+        lock(&(l)->raw); \
+        talpa_lock_stats_waited(__stats, (side), __start); \
+    } \
+} while (0)
+
+/*
+ * Names are copied so may be built on the stack. A lock which could not be
+ * registered carries on uncounted. Locks must be released before they are
+ * freed.
+ */
+#define talpa_lock_stats_name(l, name)                  ((l)->stats = talpa_lock_stats_create((name), -1))
+#define talpa_lock_stats_name_index(l, name, index)     ((l)->stats = talpa_lock_stats_create((name), (index)))
+#define talpa_lock_stats_release(l) \
+do \
+{ \
+    talpa_lock_stats_delete((l)->stats); \
+    (l)->stats = NULL; \
+} while (0)
+
+#endif /* TALPA_LOCK_STATS */
+
 /* BKL wrapper */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,39)
 #define talpa_lock_kernel       lock_kernel
@@ -136,6 +262,227 @@ typedef rwlock_t talpa_rcu_lock_t;
 #define talpa_unlock_kernel     smp_mb
 #endif
 
+/*
+ * Reference count for objects used on hot paths. Gets and puts only touch
+ * the local CPU's counter, so the count is only meaningful as a sum once
+ * no new references can be taken, for example after the object has been
+ * unpublished and an RCU grace period has passed. A reference may be put
+ * on a different CPU from where it was taken.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33)
+
+typedef struct
+{
+    long __percpu*  count;
+} talpa_pcpu_ref_t;
+
+#define TALPA_PCPU_REF_INIT     { NULL }
+
+static inline int talpa_pcpu_ref_init(talpa_pcpu_ref_t* ref)
+{
+    ref->count = alloc_percpu(long);
+
+    return ref->count ? 0 : -ENOMEM;
+}
+
+static inline void talpa_pcpu_ref_destroy(talpa_pcpu_ref_t* ref)
+{
+    free_percpu(ref->count);
+    ref->count = NULL;
+}
+
+#define talpa_pcpu_ref_get(ref)     this_cpu_inc(*(ref)->count)
+#define talpa_pcpu_ref_put(ref)     this_cpu_dec(*(ref)->count)
+
+static inline long talpa_pcpu_ref_sum(const talpa_pcpu_ref_t* ref)
+{
+    long sum = 0;
+    int cpu;
+
+
+    for_each_possible_cpu(cpu)
+    {
+        sum += *per_cpu_ptr(ref->count, cpu);
+    }
+
+    return sum;
+}
+
+#else /* LINUX_VERSION_CODE < KERNEL_VERSION(2,6,33) */
+
+typedef struct
+{
+    atomic_t        count;
+} talpa_pcpu_ref_t;
+
+#define TALPA_PCPU_REF_INIT     { ATOMIC_INIT(0) }
+
+static inline int talpa_pcpu_ref_init(talpa_pcpu_ref_t* ref)
+{
+    atomic_set(&ref->count, 0);
+
+    return 0;
+}
+
+#define talpa_pcpu_ref_destroy(ref) do { } while (0)
+#define talpa_pcpu_ref_get(ref)     atomic_inc(&(ref)->count)
+#define talpa_pcpu_ref_put(ref)     atomic_dec(&(ref)->count)
+#define talpa_pcpu_ref_sum(ref)     ((long)atomic_read(&(ref)->count))
+
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33) */
+
+/*
+ * A block of statistics counters. Updates only touch the local CPU's copy
+ * and are not ordered against reads or resets, so sums are approximate
+ * while updates are in flight.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33)
+
+typedef struct
+{
+    uint64_t __percpu*  count;
+    unsigned int        num;
+} talpa_pcpu_stats_t;
+
+static inline int talpa_pcpu_stats_init(talpa_pcpu_stats_t* stats, unsigned int num)
+{
+    stats->count = __alloc_percpu(num * sizeof(uint64_t), __alignof__(uint64_t));
+    stats->num = num;
+
+    return stats->count ? 0 : -ENOMEM;
+}
+
+static inline void talpa_pcpu_stats_destroy(talpa_pcpu_stats_t* stats)
+{
+    free_percpu(stats->count);
+    stats->count = NULL;
+}
+
+#define talpa_pcpu_stats_add(stats, idx, val)   this_cpu_add((stats)->count[idx], (val))
+#define talpa_pcpu_stats_local(stats, idx)      this_cpu_read((stats)->count[idx])
+
+static inline uint64_t talpa_pcpu_stats_sum(const talpa_pcpu_stats_t* stats, unsigned int idx)
+{
+    uint64_t sum = 0;
+    int cpu;
+
+
+    for_each_possible_cpu(cpu)
+    {
+        sum += per_cpu_ptr(stats->count, cpu)[idx];
+    }
+
+    return sum;
+}
+
+static inline void talpa_pcpu_stats_reset(talpa_pcpu_stats_t* stats)
+{
+    int cpu;
+
+
+    for_each_possible_cpu(cpu)
+    {
+        memset(per_cpu_ptr(stats->count, cpu), 0, stats->num * sizeof(uint64_t));
+    }
+}
+
+#else /* LINUX_VERSION_CODE < KERNEL_VERSION(2,6,33) */
+
+/* Shared counters behind a spinlock, these kernels are not where performance matters */
+typedef struct
+{
+    uint64_t*           count;
+    unsigned int        num;
+    spinlock_t          lock;
+} talpa_pcpu_stats_t;
+
+static inline int talpa_pcpu_stats_init(talpa_pcpu_stats_t* stats, unsigned int num)
+{
+    stats->count = kmalloc(num * sizeof(uint64_t), GFP_KERNEL);
+    stats->num = num;
+    spin_lock_init(&stats->lock);
+    if ( !stats->count )
+    {
+        return -ENOMEM;
+    }
+    memset(stats->count, 0, num * sizeof(uint64_t));
+
+    return 0;
+}
+
+static inline void talpa_pcpu_stats_destroy(talpa_pcpu_stats_t* stats)
+{
+    kfree(stats->count);
+    stats->count = NULL;
+}
+
+static inline void talpa_pcpu_stats_add(talpa_pcpu_stats_t* stats, unsigned int idx, uint64_t val)
+{
+    unsigned long flags;
+
+
+    spin_lock_irqsave(&stats->lock, flags);
+    stats->count[idx] += val;
+    spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+#define talpa_pcpu_stats_local(stats, idx)      ((stats)->count[idx])
+#define talpa_pcpu_stats_sum(stats, idx)        ((stats)->count[idx])
+
+static inline void talpa_pcpu_stats_reset(talpa_pcpu_stats_t* stats)
+{
+    unsigned long flags;
+
+
+    spin_lock_irqsave(&stats->lock, flags);
+    memset(stats->count, 0, stats->num * sizeof(uint64_t));
+    spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+#endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33) */
+
+#ifdef TALPA_LOCK_STATS
+
+/*
+ * Per lock counters, registered with the talpa_linux module which reports
+ * them all together. Acquisitions of the write side of a read-write lock
+ * are counted as exclusive ones.
+ */
+typedef enum
+{
+    ELKS_Acquired = 0,
+    ELKS_Contended,
+    ELKS_Wait,
+    ELKS_ReadAcquired,
+    ELKS_ReadContended,
+    ELKS_ReadWait,
+    ELKS_Max
+} ETalpaLockStat;
+
+#define TALPA_LOCK_STATS_NAMESIZE   (32)
+
+struct talpa_lock_stats
+{
+    struct list_head    head;
+    char                name[TALPA_LOCK_STATS_NAMESIZE];
+    talpa_pcpu_stats_t  counters;
+};
+
+struct talpa_lock_stats* talpa_lock_stats_create(const char* name, int index);
+void talpa_lock_stats_delete(struct talpa_lock_stats* stats);
+void talpa_lock_stats_format(char* buf, size_t size);
+void talpa_lock_stats_reset(void);
+
+/* Side is ELKS_Acquired or ELKS_ReadAcquired */
+static inline void talpa_lock_stats_waited(struct talpa_lock_stats* stats, unsigned int side, uint64_t start)
+{
+    talpa_pcpu_stats_add(&stats->counters, side, 1);
+    talpa_pcpu_stats_add(&stats->counters, side + ELKS_Contended, 1);
+    talpa_pcpu_stats_add(&stats->counters, side + ELKS_Wait, talpa_latency_clock() - start);
+}
+
+#endif /* TALPA_LOCK_STATS */
+
 /**
  * What sort of lock is required for proc->fs->lock ?
  */
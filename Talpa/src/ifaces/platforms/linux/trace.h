@@ -0,0 +1,378 @@
+/*
+ * trace.h
+ *
+ * TALPA Platform code
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Tracepoints for the intercept and vetting lifecycle.
+ *
+ * They are created in the talpa_linux module, which exports them to the
+ * rest, and show up under events/talpa for ftrace and perf. Kernels without
+ * tracepoint support, and builds defining TALPA_NO_TRACEPOINTS, get empty
+ * inline stubs instead.
+ *
+ * This header is read more than once when the tracepoints are created, so
+ * everything which must only be seen once lives in the first section.
+ */
+
+#ifndef H_LINUXTRACE_TYPES
+#define H_LINUXTRACE_TYPES
+
+#include <linux/version.h>
+#include <linux/types.h>
+#include <linux/sched.h>
+
+#include "filesystem/efilesystem_operation.h"
+#include "filesystem/ifile_info.h"
+#include "filesystem/ifilesystem_info.h"
+#include "process_and_thread/ithreadinfo.h"
+#include "intercept_filters/eintercept_action.h"
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,33) && defined(CONFIG_TRACEPOINTS) && !defined(TALPA_NO_TRACEPOINTS)
+  #define TALPA_HAS_TRACEPOINTS
+#endif
+
+typedef enum
+{
+    ETI_VFSHook = 1,
+    ETI_LSM,
+    ETI_Syscall
+} ETalpaTraceInterceptor;
+
+#endif /* H_LINUXTRACE_TYPES */
+
+
+#ifdef TALPA_HAS_TRACEPOINTS
+
+#if !defined(H_LINUXTRACE) || defined(TRACE_HEADER_MULTI_READ)
+#define H_LINUXTRACE
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM talpa
+
+#include <linux/tracepoint.h>
+
+#define talpa_trace_interceptor(i) __print_symbolic(i, \
+        { ETI_VFSHook,  "vfshook" }, \
+        { ETI_LSM,      "lsm" }, \
+        { ETI_Syscall,  "syscall" })
+
+#define talpa_trace_op(o) __print_symbolic(o, \
+        { 0,            "none" }, \
+        { EFS_Open,     "open" }, \
+        { EFS_Close,    "close" }, \
+        { EFS_Exec,     "exec" }, \
+        { EFS_Mount,    "mount" }, \
+        { EFS_Umount,   "umount" })
+
+#define talpa_trace_action(a) __print_symbolic(a, \
+        { EIA_Restart,  "restart" }, \
+        { EIA_Next,     "next" }, \
+        { EIA_Allow,    "allow" }, \
+        { EIA_Deny,     "deny" }, \
+        { EIA_Timeout,  "timeout" }, \
+        { EIA_Error,    "error" })
+
+/*
+ * Interceptors. The syscall interceptor works on names and descriptors, so
+ * it has no device or inode to report.
+ */
+TRACE_EVENT(talpa_intercept_enter,
+
+    TP_PROTO(ETalpaTraceInterceptor interceptor, EFilesystemOperation op, uint64_t device, unsigned long inode),
+
+    TP_ARGS(interceptor, op, device, inode),
+
+    TP_STRUCT__entry(
+        __field(int,            interceptor)
+        __field(int,            op)
+        __field(uint64_t,       device)
+        __field(unsigned long,  inode)
+        __field(pid_t,          pid)
+    ),
+
+    TP_fast_assign(
+        __entry->interceptor    = interceptor;
+        __entry->op             = op;
+        __entry->device         = device;
+        __entry->inode          = inode;
+        __entry->pid            = current->tgid;
+    ),
+
+    TP_printk("%s op=%s dev=%#llx ino=%lu pid=%d",
+        talpa_trace_interceptor(__entry->interceptor), talpa_trace_op(__entry->op),
+        (unsigned long long)__entry->device, __entry->inode, __entry->pid)
+);
+
+TRACE_EVENT(talpa_intercept_exit,
+
+    TP_PROTO(ETalpaTraceInterceptor interceptor, EFilesystemOperation op, uint64_t device, unsigned long inode, int ret),
+
+    TP_ARGS(interceptor, op, device, inode, ret),
+
+    TP_STRUCT__entry(
+        __field(int,            interceptor)
+        __field(int,            op)
+        __field(uint64_t,       device)
+        __field(unsigned long,  inode)
+        __field(pid_t,          pid)
+        __field(int,            ret)
+    ),
+
+    TP_fast_assign(
+        __entry->interceptor    = interceptor;
+        __entry->op             = op;
+        __entry->device         = device;
+        __entry->inode          = inode;
+        __entry->pid            = current->tgid;
+        __entry->ret            = ret;
+    ),
+
+    TP_printk("%s op=%s dev=%#llx ino=%lu pid=%d ret=%d",
+        talpa_trace_interceptor(__entry->interceptor), talpa_trace_op(__entry->op),
+        (unsigned long long)__entry->device, __entry->inode, __entry->pid, __entry->ret)
+);
+
+/*
+ * Cache. Entries are keyed on device and inode only.
+ */
+DECLARE_EVENT_CLASS(talpa_cache_entry,
+
+    TP_PROTO(uint32_t device, uint32_t inode),
+
+    TP_ARGS(device, inode),
+
+    TP_STRUCT__entry(
+        __field(uint32_t,   device)
+        __field(uint32_t,   inode)
+        __field(pid_t,      pid)
+    ),
+
+    TP_fast_assign(
+        __entry->device = device;
+        __entry->inode  = inode;
+        __entry->pid    = current->tgid;
+    ),
+
+    TP_printk("dev=%#x ino=%u pid=%d", __entry->device, __entry->inode, __entry->pid)
+);
+
+DEFINE_EVENT(talpa_cache_entry, talpa_cache_hit,
+    TP_PROTO(uint32_t device, uint32_t inode),
+    TP_ARGS(device, inode));
+
+DEFINE_EVENT(talpa_cache_entry, talpa_cache_miss,
+    TP_PROTO(uint32_t device, uint32_t inode),
+    TP_ARGS(device, inode));
+
+DEFINE_EVENT(talpa_cache_entry, talpa_cache_add,
+    TP_PROTO(uint32_t device, uint32_t inode),
+    TP_ARGS(device, inode));
+
+DEFINE_EVENT(talpa_cache_entry, talpa_cache_clear,
+    TP_PROTO(uint32_t device, uint32_t inode),
+    TP_ARGS(device, inode));
+
+TRACE_EVENT(talpa_cache_purge,
+
+    TP_PROTO(uint32_t device),
+
+    TP_ARGS(device),
+
+    TP_STRUCT__entry(
+        __field(uint32_t,   device)
+        __field(pid_t,      pid)
+    ),
+
+    TP_fast_assign(
+        __entry->device = device;
+        __entry->pid    = current->tgid;
+    ),
+
+    TP_printk("dev=%#x pid=%d", __entry->device, __entry->pid)
+);
+
+/*
+ * Evaluation chain decisions, one per filter consulted. Filters are
+ * identified by their position in the chain.
+ */
+TRACE_EVENT(talpa_filter_inode,
+
+    TP_PROTO(unsigned int filter, EFilesystemOperation op, uint32_t device, uint32_t inode, EInterceptAction action),
+
+    TP_ARGS(filter, op, device, inode, action),
+
+    TP_STRUCT__entry(
+        __field(unsigned int,   filter)
+        __field(int,            op)
+        __field(uint64_t,       device)
+        __field(unsigned long,  inode)
+        __field(pid_t,          pid)
+        __field(int,            action)
+    ),
+
+    TP_fast_assign(
+        __entry->filter = filter;
+        __entry->op     = op;
+        __entry->device = device;
+        __entry->inode  = inode;
+        __entry->pid    = current->tgid;
+        __entry->action = action;
+    ),
+
+    TP_printk("filter=%u op=%s dev=%#llx ino=%lu pid=%d action=%s",
+        __entry->filter, talpa_trace_op(__entry->op),
+        (unsigned long long)__entry->device, __entry->inode, __entry->pid, talpa_trace_action(__entry->action))
+);
+
+TRACE_EVENT(talpa_filter_file,
+
+    TP_PROTO(unsigned int filter, const IFileInfo* info, EInterceptAction action),
+
+    TP_ARGS(filter, info, action),
+
+    TP_STRUCT__entry(
+        __field(unsigned int,   filter)
+        __field(int,            op)
+        __field(uint64_t,       device)
+        __field(unsigned long,  inode)
+        __field(pid_t,          pid)
+        __field(int,            action)
+    ),
+
+    TP_fast_assign(
+        __entry->filter = filter;
+        __entry->op     = info->operation(info);
+        __entry->device = info->device(info);
+        __entry->inode  = info->inode(info);
+        __entry->pid    = current->tgid;
+        __entry->action = action;
+    ),
+
+    TP_printk("filter=%u op=%s dev=%#llx ino=%lu pid=%d action=%s",
+        __entry->filter, talpa_trace_op(__entry->op),
+        (unsigned long long)__entry->device, __entry->inode, __entry->pid, talpa_trace_action(__entry->action))
+);
+
+/*
+ * Vetting jobs. The pid is always the intercepted process, whichever
+ * side of the exchange the event fires on. Filesystem jobs have no inode.
+ */
+DECLARE_EVENT_CLASS(talpa_vetting_job,
+
+    TP_PROTO(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo),
+
+    TP_ARGS(vettingID, fileInfo, fsInfo, threadInfo),
+
+    TP_STRUCT__entry(
+        __field(uint32_t,       id)
+        __field(int,            op)
+        __field(uint64_t,       device)
+        __field(unsigned long,  inode)
+        __field(pid_t,          pid)
+    ),
+
+    TP_fast_assign(
+        __entry->id     = vettingID;
+        __entry->op     = fileInfo ? fileInfo->operation(fileInfo) : (fsInfo ? fsInfo->operation(fsInfo) : 0);
+        __entry->device = fileInfo ? fileInfo->device(fileInfo) : (fsInfo ? fsInfo->device(fsInfo) : 0);
+        __entry->inode  = fileInfo ? fileInfo->inode(fileInfo) : 0;
+        __entry->pid    = threadInfo ? threadInfo->processId(threadInfo) : 0;
+    ),
+
+    TP_printk("id=%u op=%s dev=%#llx ino=%lu pid=%d",
+        __entry->id, talpa_trace_op(__entry->op),
+        (unsigned long long)__entry->device, __entry->inode, __entry->pid)
+);
+
+DEFINE_EVENT(talpa_vetting_job, talpa_vetting_enqueue,
+    TP_PROTO(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo),
+    TP_ARGS(vettingID, fileInfo, fsInfo, threadInfo));
+
+DEFINE_EVENT(talpa_vetting_job, talpa_vetting_dequeue,
+    TP_PROTO(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo),
+    TP_ARGS(vettingID, fileInfo, fsInfo, threadInfo));
+
+DEFINE_EVENT(talpa_vetting_job, talpa_vetting_timeout,
+    TP_PROTO(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo),
+    TP_ARGS(vettingID, fileInfo, fsInfo, threadInfo));
+
+TRACE_EVENT(talpa_vetting_response,
+
+    TP_PROTO(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo, unsigned int response),
+
+    TP_ARGS(vettingID, fileInfo, fsInfo, threadInfo, response),
+
+    TP_STRUCT__entry(
+        __field(uint32_t,       id)
+        __field(int,            op)
+        __field(uint64_t,       device)
+        __field(unsigned long,  inode)
+        __field(pid_t,          pid)
+        __field(unsigned int,   response)
+    ),
+
+    TP_fast_assign(
+        __entry->id         = vettingID;
+        __entry->op         = fileInfo ? fileInfo->operation(fileInfo) : (fsInfo ? fsInfo->operation(fsInfo) : 0);
+        __entry->device     = fileInfo ? fileInfo->device(fileInfo) : (fsInfo ? fsInfo->device(fsInfo) : 0);
+        __entry->inode      = fileInfo ? fileInfo->inode(fileInfo) : 0;
+        __entry->pid        = threadInfo ? threadInfo->processId(threadInfo) : 0;
+        __entry->response   = response;
+    ),
+
+    TP_printk("id=%u op=%s dev=%#llx ino=%lu pid=%d response=%u",
+        __entry->id, talpa_trace_op(__entry->op),
+        (unsigned long long)__entry->device, __entry->inode, __entry->pid, __entry->response)
+);
+
+#endif /* H_LINUXTRACE */
+
+/* The symlinked platform directory keeps "linux" out of the path, which
+   would otherwise be expanded as a macro when the path is stringified. */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH platform
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+#include <trace/define_trace.h>
+
+#else /* !TALPA_HAS_TRACEPOINTS */
+
+#ifndef H_LINUXTRACE
+#define H_LINUXTRACE
+
+static inline void trace_talpa_intercept_enter(ETalpaTraceInterceptor interceptor, EFilesystemOperation op, uint64_t device, unsigned long inode) { }
+static inline void trace_talpa_intercept_exit(ETalpaTraceInterceptor interceptor, EFilesystemOperation op, uint64_t device, unsigned long inode, int ret) { }
+static inline void trace_talpa_cache_hit(uint32_t device, uint32_t inode) { }
+static inline void trace_talpa_cache_miss(uint32_t device, uint32_t inode) { }
+static inline void trace_talpa_cache_add(uint32_t device, uint32_t inode) { }
+static inline void trace_talpa_cache_clear(uint32_t device, uint32_t inode) { }
+static inline void trace_talpa_cache_purge(uint32_t device) { }
+static inline void trace_talpa_filter_inode(unsigned int filter, EFilesystemOperation op, uint32_t device, uint32_t inode, EInterceptAction action) { }
+static inline void trace_talpa_filter_file(unsigned int filter, const IFileInfo* info, EInterceptAction action) { }
+static inline void trace_talpa_vetting_enqueue(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo) { }
+static inline void trace_talpa_vetting_dequeue(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo) { }
+static inline void trace_talpa_vetting_timeout(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo) { }
+static inline void trace_talpa_vetting_response(uint32_t vettingID, const IFileInfo* fileInfo, const IFilesystemInfo* fsInfo, const IThreadInfo* threadInfo, unsigned int response) { }
+
+#endif /* H_LINUXTRACE */
+
+#endif /* TALPA_HAS_TRACEPOINTS */
+
+/*
+ * End of trace.h
+ */
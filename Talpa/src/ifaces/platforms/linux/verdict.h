@@ -0,0 +1,51 @@
+/*
+ * verdict.h
+ *
+ * TALPA Platform code
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXVERDICT
+#define H_LINUXVERDICT
+
+#include <asm/atomic.h>
+
+/*
+ * Verdict generation.
+ *
+ * Interceptors may remember an inode verdict next to the inode itself so
+ * that later opens need not ask the processor again. Anything other than
+ * a change to the file which could turn such a verdict around, like a
+ * cache entry going away or a configuration write, advances the
+ * generation and every remembered verdict goes stale with it.
+ *
+ * The counter lives in the talpa_linux module which exports it to the rest.
+ */
+
+extern atomic_t talpa_verdict_generation;
+
+static inline unsigned int talpa_verdict_current(void)
+{
+    return (unsigned int)atomic_read(&talpa_verdict_generation);
+}
+
+static inline void talpa_verdict_invalidate(void)
+{
+    atomic_inc(&talpa_verdict_generation);
+}
+
+#endif /* H_LINUXVERDICT */
+/*
+ * End of verdict.h
+ */
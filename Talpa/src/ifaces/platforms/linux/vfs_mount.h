@@ -43,6 +43,10 @@ int countPropagationPoints(struct vfsmount* mnt);
 
 struct vfsmount* getParent(struct vfsmount* mnt);
 
+/*
+ * Calls back for every mount under root. Returns -EAGAIN if the walk was cut
+ * short by a mount being detached while it was being walked.
+ */
 int iterateFilesystems(struct vfsmount* root, int (*callback) (struct vfsmount* mnt, unsigned long flags, bool fromMount));
 
 /**
@@ -33,6 +33,8 @@
 typedef struct
 {
     talpa_list_head head;
+    talpa_list_head pidHead;    /* Lookup by process ID */
+    talpa_list_head filesHead;  /* Lookup by files_struct */
     atomic_t        refcnt;
     pid_t           processID;
     pid_t           threadID;
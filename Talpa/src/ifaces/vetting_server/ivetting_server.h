@@ -83,6 +83,11 @@ typedef struct
     atomic_t                            reopen;
     struct talpa_completion             reopenCompletion;
     bool                                externalOperation;
+
+    /* Latency collection, zero when not being timed */
+    uint64_t                            queuedAt;
+    uint64_t                            dequeuedAt;
+    uint64_t                            respondedAt;
 } VettingDetails;
 
 typedef struct
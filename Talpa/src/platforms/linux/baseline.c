@@ -0,0 +1,208 @@
+/*
+* baseline.c
+*
+* TALPA Filesystem Interceptor
+*
+* Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+*
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License Version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*
+*/
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/hash.h>
+#include <linux/time.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+#include <linux/iversion.h>
+#endif
+
+#include "platforms/linux/locking.h"
+#include "platforms/linux/baseline.h"
+
+#define BASELINE_BITS   (10)
+#define BASELINES       (1 << BASELINE_BITS)
+
+struct baseline
+{
+    const struct inode*         inode;
+    const struct super_block*   sb;
+    unsigned long               ino;
+    long long                   mtime;
+    long                        mtimeNsec;
+    long long                   ctime;
+    long                        ctimeNsec;
+    loff_t                      size;
+    u64                         version;
+    unsigned int                writers;
+    bool                        reliable;
+};
+
+static struct baseline GL_baselines[BASELINES];
+static talpa_simple_lock_t GL_baselineLock = TALPA_SIMPLE_UNLOCKED(GL_baselineLock);
+
+
+static inline u64 inodeVersion(const struct inode* inode)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+    return inode_peek_iversion(inode);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,24)
+    return inode->i_version;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * A write lands a timestamp no earlier than the one the filesystem would
+ * give right now. If the inode already carries that one, a write during
+ * the open could leave the times exactly as they are, so such a baseline
+ * proves nothing.
+ */
+static bool changedJustNow(struct inode* inode)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)
+    typeof(current_time(inode)) now = current_time(inode);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,11)
+    struct timespec now = current_fs_time(inode->i_sb);
+#else
+    struct timespec now = CURRENT_TIME;
+#endif
+
+
+    return ( inode->i_mtime.tv_sec == now.tv_sec && inode->i_mtime.tv_nsec == now.tv_nsec ) ||
+           ( inode->i_ctime.tv_sec == now.tv_sec && inode->i_ctime.tv_nsec == now.tv_nsec );
+}
+
+/*
+ * Shared writable mappings do not always bring the times up to date
+ * before the file is closed.
+ */
+static inline bool writablyMapped(struct inode* inode)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
+    return inode->i_mapping && mapping_writably_mapped(inode->i_mapping);
+#else
+    return true;
+#endif
+}
+
+/*
+ * Only filesystems on a local block device are trusted to have brought the
+ * times and size in memory up to date by the time a written file is closed.
+ * Network and FUSE filesystems may only invalidate their attributes, or
+ * write around the page cache, and keep looking unchanged. FUSE over a
+ * block device is still FUSE, hence the subtype check.
+ */
+static inline bool trusted(const struct inode* inode)
+{
+    int flags = inode->i_sb->s_type->fs_flags;
+
+
+#ifdef FS_HAS_SUBTYPE
+    if ( flags & FS_HAS_SUBTYPE )
+    {
+        return false;
+    }
+#endif
+
+    return ( flags & FS_REQUIRES_DEV ) ? true : false;
+}
+
+static inline bool sameInode(const struct baseline* base, const struct inode* inode)
+{
+    return base->inode == inode && base->sb == inode->i_sb && base->ino == inode->i_ino;
+}
+
+static inline bool sameContent(const struct baseline* base, const struct inode* inode)
+{
+    return base->mtime == inode->i_mtime.tv_sec &&
+           base->mtimeNsec == inode->i_mtime.tv_nsec &&
+           base->ctime == inode->i_ctime.tv_sec &&
+           base->ctimeNsec == inode->i_ctime.tv_nsec &&
+           base->size == i_size_read(inode) &&
+           base->version == inodeVersion(inode);
+}
+
+void talpa_baseline_record(struct inode* inode, bool counted)
+{
+    struct baseline* base = &GL_baselines[hash_ptr(inode, BASELINE_BITS)];
+    int others = atomic_read(&inode->i_writecount) - ( counted ? 1 : 0 );
+    bool reliable;
+
+
+    if ( !trusted(inode) )
+    {
+        return;
+    }
+
+    /*
+     * Whoever already has it open for writing may have written without
+     * a baseline of their own, because theirs was pushed out or they
+     * opened before we were loaded.
+     */
+    reliable = others <= 0 && !changedJustNow(inode);
+
+    talpa_simple_lock(&GL_baselineLock);
+
+    if ( sameInode(base, inode) )
+    {
+        base->writers++;
+    }
+    else
+    {
+        base->inode = inode;
+        base->sb = inode->i_sb;
+        base->ino = inode->i_ino;
+        base->mtime = inode->i_mtime.tv_sec;
+        base->mtimeNsec = inode->i_mtime.tv_nsec;
+        base->ctime = inode->i_ctime.tv_sec;
+        base->ctimeNsec = inode->i_ctime.tv_nsec;
+        base->size = i_size_read(inode);
+        base->version = inodeVersion(inode);
+        base->writers = 1;
+        base->reliable = reliable;
+    }
+
+    talpa_simple_unlock(&GL_baselineLock);
+}
+
+bool talpa_baseline_unchanged(struct inode* inode)
+{
+    struct baseline* base = &GL_baselines[hash_ptr(inode, BASELINE_BITS)];
+    bool unchanged = false;
+
+
+    if ( !trusted(inode) )
+    {
+        return false;
+    }
+
+    talpa_simple_lock(&GL_baselineLock);
+
+    if ( sameInode(base, inode) )
+    {
+        unchanged = base->reliable && sameContent(base, inode) && !writablyMapped(inode);
+        if ( --base->writers == 0 )
+        {
+            base->inode = NULL;
+        }
+    }
+
+    talpa_simple_unlock(&GL_baselineLock);
+
+    return unchanged;
+}
+
+/*
+ * End of baseline.c
+ */
@@ -0,0 +1,330 @@
+/*
+* capture.c
+*
+* TALPA Filesystem Interceptor
+*
+* Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+*
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License Version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*
+*/
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+#include <linux/delay.h>
+#include <linux/sched.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)
+#include <linux/sched/signal.h>
+#endif
+#include <linux/spinlock.h>
+#include <linux/capability.h>
+
+#define TALPA_SUBSYS "capture"
+#include "common/talpa.h"
+#include "platform/alloc.h"
+#include "platform/uaccess.h"
+#include "platforms/linux/latency.h"
+#include "platforms/linux/capture.h"
+
+#define CAPTURE_NAME        "talpa-capture"
+#define CAPTURE_POLL_MS     (100)
+#define CAPTURE_CHUNK       (128)   /* Records copied out per CPU and lock hold */
+
+struct captureCpu
+{
+    spinlock_t                  lock;
+    struct TalpaCaptureRecord*  ring;
+    unsigned int                head;   /* Free running, next to be written */
+    unsigned int                tail;   /* Free running, next to be read */
+    unsigned long               lost;
+};
+
+bool talpa_capture_enabled;
+
+static DEFINE_PER_CPU(struct captureCpu, GL_capture);
+static TALPA_DEFINE_MUTEX(GL_captureSerialize);
+static bool GL_captureReady;
+
+static int captureOpen(struct inode* inode, struct file* file);
+static int captureClose(struct inode* inode, struct file* file);
+static ssize_t captureRead(struct file* file, char __user * buf, size_t len, loff_t* ppos);
+
+static struct file_operations capture_fops =
+{
+    .owner =          THIS_MODULE,
+    .open =           captureOpen,
+    .release =        captureClose,
+    .read =           captureRead
+};
+
+static struct miscdevice capture_dev =
+{
+    MISC_DYNAMIC_MINOR,
+    CAPTURE_NAME,
+    &capture_fops
+};
+
+
+void talpa_capture_add(unsigned int event, unsigned int op, int flags, uint32_t device, uint32_t inode, uint32_t pathHash)
+{
+    struct captureCpu* cpu;
+    struct TalpaCaptureRecord* rec;
+
+
+    cpu = &get_cpu_var(GL_capture);
+    spin_lock(&cpu->lock);
+
+    if ( unlikely(!cpu->ring) )
+    {
+        goto out;
+    }
+
+    if ( unlikely(cpu->head - cpu->tail >= TALPA_CAPTURE_RING) )
+    {
+        cpu->lost++;
+        goto out;
+    }
+
+    rec = &cpu->ring[cpu->head & (TALPA_CAPTURE_RING - 1)];
+    rec->timestamp = talpa_latency_clock();
+    rec->device = device;
+    rec->inode = inode;
+    rec->pid = current->tgid;
+    rec->flags = flags;
+    rec->pathHash = pathHash;
+    rec->operation = op;
+    rec->event = event;
+    rec->reserved = 0;
+    cpu->head++;
+
+out:
+    spin_unlock(&cpu->lock);
+    put_cpu_var(GL_capture);
+}
+
+int talpa_capture_enable(bool enable)
+{
+    struct captureCpu* cpu;
+    struct TalpaCaptureRecord* ring;
+    unsigned int i;
+
+
+    talpa_mutex_lock(&GL_captureSerialize);
+
+    /* Nothing to read the records with */
+    if ( !GL_captureReady )
+    {
+        talpa_mutex_unlock(&GL_captureSerialize);
+        return -ENODEV;
+    }
+
+    for_each_possible_cpu(i)
+    {
+        cpu = &per_cpu(GL_capture, i);
+        if ( !enable || cpu->ring )
+        {
+            continue;
+        }
+
+        ring = talpa_large_alloc(TALPA_CAPTURE_RING * sizeof(struct TalpaCaptureRecord));
+        if ( !ring )
+        {
+            err("Failed to allocate the capture ring!");
+            talpa_mutex_unlock(&GL_captureSerialize);
+            return -ENOMEM;
+        }
+
+        spin_lock(&cpu->lock);
+        cpu->ring = ring;
+        cpu->head = cpu->tail = 0;
+        spin_unlock(&cpu->lock);
+    }
+
+    talpa_capture_enabled = enable;
+
+    talpa_mutex_unlock(&GL_captureSerialize);
+
+    return 0;
+}
+
+unsigned long talpa_capture_lost(void)
+{
+    unsigned long lost = 0;
+    unsigned int i;
+
+
+    for_each_possible_cpu(i)
+    {
+        lost += per_cpu(GL_capture, i).lost;
+    }
+
+    return lost;
+}
+
+/*
+ * Copies out what is waiting on one CPU, no more than fits into the bounce buffer.
+ */
+static unsigned int drain(struct captureCpu* cpu, struct TalpaCaptureRecord* out, unsigned int max)
+{
+    unsigned int count;
+    unsigned int i;
+
+
+    spin_lock(&cpu->lock);
+
+    count = cpu->ring ? cpu->head - cpu->tail : 0;
+    if ( count > max )
+    {
+        count = max;
+    }
+
+    for ( i = 0; i < count; i++ )
+    {
+        out[i] = cpu->ring[(cpu->tail + i) & (TALPA_CAPTURE_RING - 1)];
+    }
+    cpu->tail += count;
+
+    spin_unlock(&cpu->lock);
+
+    return count;
+}
+
+static int captureOpen(struct inode* inode, struct file* file)
+{
+    if ( !capable(CAP_SYS_ADMIN) )
+    {
+        return -EACCES;
+    }
+
+    return 0;
+}
+
+static int captureClose(struct inode* inode, struct file* file)
+{
+    return 0;
+}
+
+/*
+ * Returns as many whole records as are waiting and fit, waiting for some
+ * to arrive unless the device was opened non-blocking.
+ */
+static ssize_t captureRead(struct file* file, char __user * buf, size_t len, loff_t* ppos)
+{
+    struct TalpaCaptureRecord* bounce;
+    size_t max = len / sizeof(struct TalpaCaptureRecord);
+    size_t copied = 0;
+    unsigned int count;
+    unsigned int i;
+
+
+    if ( !max )
+    {
+        return -EINVAL;
+    }
+
+    bounce = talpa_alloc(CAPTURE_CHUNK * sizeof(struct TalpaCaptureRecord));
+    if ( !bounce )
+    {
+        return -ENOMEM;
+    }
+
+    for (;;)
+    {
+        for_each_possible_cpu(i)
+        {
+            do
+            {
+                count = drain(&per_cpu(GL_capture, i), bounce, min_t(size_t, max - copied, CAPTURE_CHUNK));
+                if ( count && copy_to_user(buf + copied * sizeof(struct TalpaCaptureRecord), bounce, count * sizeof(struct TalpaCaptureRecord)) )
+                {
+                    talpa_free(bounce);
+                    return -EFAULT;
+                }
+                copied += count;
+            } while ( count && copied < max );
+
+            if ( copied == max )
+            {
+                break;
+            }
+        }
+
+        if ( copied || (file->f_flags & O_NONBLOCK) )
+        {
+            break;
+        }
+
+        msleep_interruptible(CAPTURE_POLL_MS);
+        if ( signal_pending(current) )
+        {
+            talpa_free(bounce);
+            return -ERESTARTSYS;
+        }
+    }
+
+    talpa_free(bounce);
+
+    return copied ? copied * sizeof(struct TalpaCaptureRecord) : -EAGAIN;
+}
+
+int talpa_capture_init(void)
+{
+    unsigned int i;
+    int ret;
+
+
+    for_each_possible_cpu(i)
+    {
+        spin_lock_init(&per_cpu(GL_capture, i).lock);
+    }
+
+    ret = misc_register(&capture_dev);
+    if ( ret )
+    {
+        err("Failed to register capture device!");
+        return ret;
+    }
+
+    GL_captureReady = true;
+
+    return 0;
+}
+
+void talpa_capture_exit(void)
+{
+    unsigned int i;
+
+
+    talpa_capture_enabled = false;
+
+    if ( !GL_captureReady )
+    {
+        return;
+    }
+
+    misc_deregister(&capture_dev);
+    GL_captureReady = false;
+
+    for_each_possible_cpu(i)
+    {
+        talpa_large_free(per_cpu(GL_capture, i).ring);
+        per_cpu(GL_capture, i).ring = NULL;
+    }
+}
+
+/*
+ * End of capture.c
+ */
@@ -0,0 +1,223 @@
+/*
+* fstype.c
+*
+* TALPA Filesystem Interceptor
+*
+* Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+*
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License Version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*
+*/
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/string.h>
+#include <linux/fs.h>
+
+#include "platforms/linux/fstype.h"
+#include "platforms/linux/locking.h"
+#include "platforms/linux/log.h"
+
+/*
+ * Map from struct file_system_type to ID. Slots are filled under the
+ * registry lock and readers do not lock at all.
+ *
+ * A type structure can go away with its module and something else can
+ * later live at the same address, so a slot also records the name pointer
+ * it was created for and only matches while that is still the same.
+ *
+ * A type is only looked for in a few slots from its home slot. When they
+ * are all taken the home slot is reused, so types from reloaded modules
+ * push out the stale ones instead of leaving later types on the locked
+ * path for good. A reader checks the slot still holds its type after
+ * reading the ID, and goes the locked way if it was reused meanwhile.
+ */
+#define FSTYPE_SLOTS    (2 * TALPA_FSTYPE_MAX)
+#define FSTYPE_PROBES   (8)
+
+struct fstypeSlot
+{
+    struct file_system_type*    type;
+    const char*                 name;
+    unsigned int                id;
+};
+
+static talpa_simple_lock_t  GL_fstype_lock = TALPA_SIMPLE_UNLOCKED(GL_fstype_lock);
+static unsigned int         GL_fstype_count = 1;    /* ID zero is TALPA_FSTYPE_NONE */
+static char                 GL_fstype_names[TALPA_FSTYPE_MAX][TALPA_FSTYPE_NAMELEN];
+static struct fstypeSlot    GL_fstype_slots[FSTYPE_SLOTS];
+
+
+static inline unsigned int slotIndex(const struct file_system_type* type)
+{
+    return (unsigned int)((((unsigned long)type) >> 4) * 2654435761UL) & (FSTYPE_SLOTS - 1);
+}
+
+/*
+ * Called with the registry lock held.
+ */
+static unsigned int internLocked(const char* name)
+{
+    unsigned int id;
+
+
+    if ( strlen(name) >= TALPA_FSTYPE_NAMELEN )
+    {
+        return TALPA_FSTYPE_NONE;
+    }
+
+    for ( id = 1; id < GL_fstype_count; id++ )
+    {
+        if ( !strcmp(GL_fstype_names[id], name) )
+        {
+            return id;
+        }
+    }
+
+    if ( GL_fstype_count >= TALPA_FSTYPE_MAX )
+    {
+        return TALPA_FSTYPE_NONE;
+    }
+
+    strcpy(GL_fstype_names[id], name);
+    smp_wmb();
+    GL_fstype_count++;
+
+    return id;
+}
+
+unsigned int talpa_fstype_intern(const char* name)
+{
+    unsigned int id;
+
+
+    talpa_simple_lock(&GL_fstype_lock);
+    id = internLocked(name);
+    talpa_simple_unlock(&GL_fstype_lock);
+
+    if ( id == TALPA_FSTYPE_NONE )
+    {
+        warn("Cannot register filesystem type %s", name);
+    }
+
+    return id;
+}
+
+unsigned int talpa_fstype_find(const char* name)
+{
+    unsigned int count = GL_fstype_count;
+    unsigned int id;
+
+
+    smp_rmb();
+
+    for ( id = 1; id < count; id++ )
+    {
+        if ( !strcmp(GL_fstype_names[id], name) )
+        {
+            return id;
+        }
+    }
+
+    return TALPA_FSTYPE_NONE;
+}
+
+static unsigned int addType(struct file_system_type* type)
+{
+    struct fstypeSlot* slot;
+    unsigned int index = slotIndex(type);
+    unsigned int id;
+    unsigned int i;
+
+
+    talpa_simple_lock(&GL_fstype_lock);
+
+    id = internLocked(type->name);
+
+    for ( i = 0; i < FSTYPE_PROBES; i++ )
+    {
+        slot = &GL_fstype_slots[(index + i) & (FSTYPE_SLOTS - 1)];
+        if ( (slot->type == type) && (slot->name == type->name) )
+        {
+            talpa_simple_unlock(&GL_fstype_lock);
+            return id;
+        }
+        /* An empty slot, or an older type which lived at this address */
+        if ( !slot->type || (slot->type == type) )
+        {
+            break;
+        }
+    }
+
+    if ( i == FSTYPE_PROBES )
+    {
+        slot = &GL_fstype_slots[index];
+    }
+
+    slot->type = NULL;
+    smp_wmb();
+    slot->name = type->name;
+    slot->id = id;
+    smp_wmb();
+    slot->type = type;
+
+    talpa_simple_unlock(&GL_fstype_lock);
+
+    return id;
+}
+
+unsigned int talpa_fstype_id(struct file_system_type* type)
+{
+    const struct fstypeSlot* slot;
+    const struct file_system_type* stype;
+    unsigned int index = slotIndex(type);
+    unsigned int id;
+    unsigned int i;
+
+
+    for ( i = 0; i < FSTYPE_PROBES; i++ )
+    {
+        slot = &GL_fstype_slots[(index + i) & (FSTYPE_SLOTS - 1)];
+        stype = slot->type;
+        if ( !stype )
+        {
+            break;
+        }
+        smp_rmb();
+        if ( (stype == type) && (slot->name == type->name) )
+        {
+            id = slot->id;
+            smp_rmb();
+            if ( likely(slot->type == stype) )
+            {
+                return id;
+            }
+            break;
+        }
+    }
+
+    return addType(type);
+}
+
+const char* talpa_fstype_name(unsigned int id)
+{
+    if ( (id == TALPA_FSTYPE_NONE) || (id >= GL_fstype_count) )
+    {
+        return NULL;
+    }
+
+    smp_rmb();
+
+    return GL_fstype_names[id];
+}
+
+/*
+* End of fstype.c
+*/
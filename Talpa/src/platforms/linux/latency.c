@@ -0,0 +1,122 @@
+/*
+* latency.c
+*
+* TALPA Filesystem Interceptor
+*
+* Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+*
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License Version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*
+*/
+#include <linux/kernel.h>
+#include <linux/version.h>
+#include <linux/string.h>
+#include <linux/bitops.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+
+#include "platforms/linux/latency.h"
+
+struct latencyCpu
+{
+    talpa_latency_hist_t    stage[ELS_Max];
+};
+
+bool talpa_latency_enabled;
+
+static DEFINE_PER_CPU(struct latencyCpu, GL_latency);
+
+
+static inline unsigned int bucket(uint64_t ns)
+{
+    unsigned int b;
+
+
+    if ( ns >> 32 )
+    {
+        b = 31 + fls((uint32_t)(ns >> 32));
+    }
+    else if ( ns )
+    {
+        b = fls((uint32_t)ns) - 1;
+    }
+    else
+    {
+        b = 0;
+    }
+
+    return (b < TALPA_LATENCY_BUCKETS) ? b : TALPA_LATENCY_BUCKETS - 1;
+}
+
+void talpa_latency_record(ETalpaLatencyStage stage, uint64_t start)
+{
+    talpa_latency_hist_t* hist;
+    uint64_t now;
+    uint64_t ns;
+
+
+    if ( !start )
+    {
+        return;
+    }
+
+    now = talpa_latency_clock();
+    ns = (now > start) ? now - start : 0;
+
+    hist = &get_cpu_var(GL_latency).stage[stage];
+    hist->count[bucket(ns)]++;
+    hist->total += ns;
+    put_cpu_var(GL_latency);
+}
+
+void talpa_latency_read(ETalpaLatencyStage stage, talpa_latency_hist_t* hist)
+{
+    const talpa_latency_hist_t* cpuhist;
+    unsigned int cpu;
+    unsigned int b;
+
+
+    memset(hist, 0, sizeof(*hist));
+
+    for_each_possible_cpu(cpu)
+    {
+        cpuhist = &per_cpu(GL_latency, cpu).stage[stage];
+        for ( b = 0; b < TALPA_LATENCY_BUCKETS; b++ )
+        {
+            hist->count[b] += cpuhist->count[b];
+        }
+        hist->total += cpuhist->total;
+    }
+}
+
+/*
+ * Not synchronised with recording, so a few concurrent samples may
+ * survive a reset or be lost with it.
+ */
+void talpa_latency_reset(ETalpaLatencyStage stage)
+{
+    unsigned int cpu;
+
+
+    for_each_possible_cpu(cpu)
+    {
+        memset(&per_cpu(GL_latency, cpu).stage[stage], 0, sizeof(talpa_latency_hist_t));
+    }
+}
+
+void talpa_latency_enable(bool enable)
+{
+    talpa_latency_enabled = enable;
+}
+
+/*
+ * End of latency.c
+ */
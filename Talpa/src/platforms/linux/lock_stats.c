@@ -0,0 +1,139 @@
+/*
+* lock_stats.c
+*
+* TALPA Filesystem Interceptor
+*
+* Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+*
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License Version 2 as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*
+*/
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#define TALPA_SUBSYS "lockstats"
+#include "common/talpa.h"
+#include "platform/alloc.h"
+#include "platform/list.h"
+#include "platform/locking.h"
+
+#ifdef TALPA_LOCK_STATS
+
+/*
+ * Every named lock, in the order they were named.
+ */
+static talpa_list_head GL_lockStats = TALPA_LIST_HEAD_INIT(GL_lockStats);
+static TALPA_DEFINE_MUTEX(GL_lockStatsSerialize);
+
+
+struct talpa_lock_stats* talpa_lock_stats_create(const char* name, int index)
+{
+    struct talpa_lock_stats* stats;
+
+
+    stats = talpa_zalloc(sizeof(struct talpa_lock_stats));
+    if ( !stats )
+    {
+        return NULL;
+    }
+
+    if ( talpa_pcpu_stats_init(&stats->counters, ELKS_Max) )
+    {
+        talpa_free(stats);
+        return NULL;
+    }
+
+    if ( index < 0 )
+    {
+        snprintf(stats->name, sizeof(stats->name), "%s", name);
+    }
+    else
+    {
+        snprintf(stats->name, sizeof(stats->name), "%s-%d", name, index);
+    }
+
+    talpa_mutex_lock(&GL_lockStatsSerialize);
+    talpa_list_add_tail(&stats->head, &GL_lockStats);
+    talpa_mutex_unlock(&GL_lockStatsSerialize);
+
+    return stats;
+}
+
+void talpa_lock_stats_delete(struct talpa_lock_stats* stats)
+{
+    if ( !stats )
+    {
+        return;
+    }
+
+    talpa_mutex_lock(&GL_lockStatsSerialize);
+    talpa_list_del(&stats->head);
+    talpa_mutex_unlock(&GL_lockStatsSerialize);
+
+    talpa_pcpu_stats_destroy(&stats->counters);
+    talpa_free(stats);
+}
+
+/*
+ * One line per lock with its exclusive and shared acquisitions, how many
+ * of them had to wait and the total wait in nanoseconds. Locks without a
+ * shared side show zeroes for it.
+ */
+void talpa_lock_stats_format(char* buf, size_t size)
+{
+    struct talpa_lock_stats* stats;
+    int len;
+
+
+    len = snprintf(buf, size, "lock acquired contended wait-ns read-acquired read-contended read-wait-ns\n");
+
+    talpa_mutex_lock(&GL_lockStatsSerialize);
+
+    talpa_list_for_each_entry(stats, &GL_lockStats, head)
+    {
+        if ( len >= (int)size )
+        {
+            break;
+        }
+
+        len += snprintf(buf + len, size - len, "%s %llu %llu %llu %llu %llu %llu\n",
+                        stats->name,
+                        (unsigned long long)talpa_pcpu_stats_sum(&stats->counters, ELKS_Acquired),
+                        (unsigned long long)talpa_pcpu_stats_sum(&stats->counters, ELKS_Contended),
+                        (unsigned long long)talpa_pcpu_stats_sum(&stats->counters, ELKS_Wait),
+                        (unsigned long long)talpa_pcpu_stats_sum(&stats->counters, ELKS_ReadAcquired),
+                        (unsigned long long)talpa_pcpu_stats_sum(&stats->counters, ELKS_ReadContended),
+                        (unsigned long long)talpa_pcpu_stats_sum(&stats->counters, ELKS_ReadWait));
+    }
+
+    talpa_mutex_unlock(&GL_lockStatsSerialize);
+}
+
+void talpa_lock_stats_reset(void)
+{
+    struct talpa_lock_stats* stats;
+
+
+    talpa_mutex_lock(&GL_lockStatsSerialize);
+
+    talpa_list_for_each_entry(stats, &GL_lockStats, head)
+    {
+        talpa_pcpu_stats_reset(&stats->counters);
+    }
+
+    talpa_mutex_unlock(&GL_lockStatsSerialize);
+}
+
+#endif /* TALPA_LOCK_STATS */
+
+/*
+ * End of lock_stats.c
+ */
@@ -17,6 +17,7 @@
 *
 */
 #include <linux/version.h>
+#include <linux/errno.h>
 #include "platforms/linux/vfs_mount.h"
 #include "platforms/linux/log.h"
 #include "platforms/linux/glue.h"
@@ -248,7 +249,7 @@ struct dentry *getVfsMountPoint(struct vfsmount* mnt)
 
 int iterateFilesystems(struct vfsmount* root, int (*callback) (struct vfsmount* mnt, unsigned long flags, bool fromMount))
 {
-    talpa_mount_struct *mnt, *nextmnt, *prevmnt;
+    talpa_mount_struct *mnt, *nextmnt, *prevmnt, *top;
     struct list_head *nexthead = NULL;
     int ret;
     unsigned m_seq = 1;
@@ -260,6 +261,16 @@ int iterateFilesystems(struct vfsmount* root, int (*callback) (struct vfsmount*
     }
 
     mnt = real_mount(root);
+
+    /* Remember where the walk should end, see below */
+    talpa_vfsmount_lock(&m_seq);
+    top = mnt;
+    while ( top != top->mnt_parent )
+    {
+        top = top->mnt_parent;
+    }
+    talpa_vfsmount_unlock(&m_seq);
+
     talpa_mntget(mnt); /* Take extra reference count for the loop */
     do
     {
@@ -296,9 +307,14 @@ int iterateFilesystems(struct vfsmount* root, int (*callback) (struct vfsmount*
                 nextmnt = nextmnt->mnt_parent;
             }
 
-            /* Abort if we are at the root */
+            /* Abort if we are at the root. A mount detached under us also
+             * looks like one, and the rest of the tree was never reached. */
             if ( nextmnt == nextmnt->mnt_parent )
             {
+                if ( nextmnt != top )
+                {
+                    ret = -EAGAIN;
+                }
                 talpa_vfsmount_unlock(&m_seq); /* unlocks dcache_lock on 2.4 */
                 talpa_mntput(mnt);
                 break;
@@ -0,0 +1,106 @@
+/*
+ * bench-hist.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_BENCHHIST
+#define H_BENCHHIST
+
+#include <time.h>
+
+/* Log-linear latency histogram: 16 sub-buckets per power of two, which
+   keeps any reported percentile within about 6% of the real value. */
+#define HIST_SUB_BITS   (4)
+#define HIST_SUB        (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS    ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+static inline unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline unsigned int hist_bucket(unsigned long long ns)
+{
+    unsigned int e;
+
+
+    if ( ns < HIST_SUB )
+    {
+        return ns;
+    }
+
+    e = 63 - __builtin_clzll(ns);
+
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + ((ns >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+static inline unsigned long long hist_upper(unsigned int bucket)
+{
+    unsigned int e;
+    unsigned int sub;
+
+
+    if ( bucket < HIST_SUB )
+    {
+        return bucket;
+    }
+
+    e = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+    sub = bucket % HIST_SUB;
+
+    return ((unsigned long long)(HIST_SUB + sub + 1) << (e - HIST_SUB_BITS)) - 1;
+}
+
+/* Upper bound of the bucket holding quantile q, capped at the largest sample */
+static inline unsigned long long hist_percentile(const unsigned long long* hist, unsigned long long count, unsigned long long max, double q)
+{
+    unsigned long long target = (unsigned long long)(q * count + 0.5);
+    unsigned long long seen = 0;
+    unsigned int b;
+
+
+    if ( !count )
+    {
+        return 0;
+    }
+
+    if ( !target )
+    {
+        target = 1;
+    }
+
+    for ( b = 0; b < HIST_BUCKETS; b++ )
+    {
+        seen += hist[b];
+        if ( seen >= target )
+        {
+            return hist_upper(b) < max ? hist_upper(b) : max;
+        }
+    }
+
+    return max;
+}
+
+#endif
+
+/*
+ * End of bench-hist.h
+ */
@@ -20,6 +20,20 @@ rmmod="/sbin/rmmod"
 
 openclose="./open-bench"
 
+# WORKLOAD (open, write, exec, mmap or stat) and FILES (working set size)
+# switch to intercept-bench, which also reports latency percentiles.
+if [ -n "$WORKLOAD" -o -n "$FILES" ]; then
+    openclose="./intercept-bench -w${WORKLOAD:-open} -n${FILES:-0}"
+fi
+
+# Mean service time in microseconds, and distribution, of the mock daemon
+if [ -z $SERVICE ]; then
+    service=100
+else
+    service=$SERVICE
+fi
+service_dist=${SERVICE_DIST:-exp}
+
 nr_cpus=`grep "processor" /proc/cpuinfo | wc -l | tr -d " \t"`
 
 
@@ -41,14 +55,18 @@ else
     nr_runs=$RUNS
 fi
 
-if grep "Linux version 2.6." /proc/version >/dev/null; then
-    kernel=2.6
-    ko=ko
-    interceptors="vfshook lsm"
-else
+if grep "Linux version 2.4." /proc/version >/dev/null; then
     kernel=2.4
     ko=o
     interceptors="vfshook syscall"
+else
+    kernel=`uname -r | cut -d '.' -f 1-2`
+    ko=ko
+    interceptors="vfshook lsm"
+fi
+
+if [ -n "$INTERCEPTORS" ]; then
+    interceptors=$INTERCEPTORS
 fi
 
 function find_talpa_config
@@ -213,6 +231,7 @@ function kill_vetting_clients()
 {
     killall -INT vc 2>/dev/null
     killall -INT vc-scan 2>/dev/null
+    killall -INT vc-bench 2>/dev/null
 }
 
 function vetting_test()
@@ -237,38 +256,43 @@ function vetting_test()
             "scan")
                 extra=", scanning enabled"
                 vc=./vc-scan
+                ;;
+            "mock")
+                extra=", mock daemon ${service}us $service_dist"
+                vc="./vc-bench -s$service -d$service_dist"
+                ;;
         esac
     fi
 
     let spawn=1
-    run_vetting_clients $vc $spawn
+    run_vetting_clients "$vc" $spawn
     open_close_test "$spawn vetting client$extra"
     kill_vetting_clients
 
     if [ $nr_cpus -gt 2 ]; then
         let spawn=($nr_cpus)/2
-        run_vetting_clients $vc $spawn
+        run_vetting_clients "$vc" $spawn
         open_close_test "$spawn vetting clients$extra"
         kill_vetting_clients
     fi
 
     if [ $nr_cpus -gt 1 ]; then
         let spawn=$nr_cpus
-        run_vetting_clients $vc $spawn
+        run_vetting_clients "$vc" $spawn
         open_close_test "$spawn vetting clients$extra"
         kill_vetting_clients
     fi
 
     let spawn=($nr_cpus)*2
     if [ $spawn -ge 2 ]; then
-        run_vetting_clients $vc $spawn
+        run_vetting_clients "$vc" $spawn
         open_close_test "$spawn vetting clients$extra"
         kill_vetting_clients
     fi
 
     let spawn=($nr_cpus)*4
     if [ $spawn -ge 4 ]; then
-        run_vetting_clients $vc $spawn
+        run_vetting_clients "$vc" $spawn
         open_close_test "$spawn vetting clients$extra"
         kill_vetting_clients
     fi
@@ -277,6 +301,7 @@ function vetting_test()
 echo "System CPUs: $nr_cpus"
 echo "Kernel detected: $kernel"
 echo "Open loops: $open_loops"
+echo "Benchmark: $openclose"
 echo "Test runs: $nr_runs"
 
 talpa_unload
@@ -313,6 +338,8 @@ for interceptor in $interceptors; do
 
     vetting_test "cache"
 
+    vetting_test "mock"
+
     talpa_conf_filters status disable
     open_close_test "Filters disabled"
 
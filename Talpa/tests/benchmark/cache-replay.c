@@ -0,0 +1,478 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Cache replay
+ *
+ * Runs a capture trace, as read from /dev/talpa-capture or written by
+ * core-bench -T, against other cache geometries and replacement policies
+ * and reports the hit rates they would have had:
+ *
+ *  rr      the cache itself (cache.c), a table per device grown on
+ *          demand up to the total, which replaces round robin
+ *  lru     one table shared by all devices, least recently used slot
+ *          of the set
+ *  random  one shared table, any slot of the set
+ *
+ * The simulated policies use the probe sequence cacheFirst() and
+ * cacheStride() describe, and every geometry is passed through the cache's
+ * own "params" handling so the sizes reported are the ones it would really
+ * use.
+ *
+ * A lookup which missed here but hit when captured is assumed to be
+ * vetted, allowed and added straight away, as it was when first cached.
+ *
+ *  -p<entries>[,<prime>[,<set>]]   geometry to try, may be repeated
+ *                                  (default: the current default, a
+ *                                  quarter, four times, and 4-way)
+ *  -e<policy>                      policy to try, may be repeated
+ *                                  (default all three)
+ */
+
+#include <linux/kernel.h>
+
+#include "common/talpa.h"
+#include "platform/fstype.h"
+#include "components/core/cache_impl/cache.h"
+#include "talpa-capture.h"
+
+
+#define MAX_GEOMETRIES  (16)
+#define FSTYPE          "replay"
+
+enum policy
+{
+    P_RR = 0,
+    P_LRU,
+    P_RANDOM,
+    P_MAX
+};
+
+static const char* policy_names[] = { "rr", "lru", "random" };
+
+struct slot
+{
+    int32_t             device;
+    int32_t             inode;
+    unsigned long long  used;
+};
+
+/*
+ * A single table for all devices, as cache.c used to have, with a different
+ * way of choosing what to replace when all of a set is in use.
+ */
+struct sim
+{
+    enum policy         policy;
+    int                 entries;
+    int                 prime;
+    int                 set;
+    struct slot*        slots;
+    unsigned long long  clock;
+    unsigned int        seed;
+};
+
+struct result
+{
+    unsigned long long  lookups;
+    unsigned long long  hits;
+    unsigned long long  adds;
+};
+
+static int sim_find(struct sim* s, uint32_t keyH, uint32_t keyL)
+{
+    int index = cacheFirst(keyH, keyL, s->entries);
+    int modulo = cacheStride(keyH, keyL, s->prime);
+    int pass;
+
+
+    for ( pass = 0; pass < s->set; pass++ )
+    {
+        if ( (s->slots[index].device == (int32_t)keyH) && (s->slots[index].inode == (int32_t)keyL) )
+        {
+            s->slots[index].used = ++s->clock;
+            return 1;
+        }
+        index = ( index + modulo ) % s->entries;
+    }
+
+    return 0;
+}
+
+static void sim_add(struct sim* s, uint32_t keyH, uint32_t keyL)
+{
+    int first = cacheFirst(keyH, keyL, s->entries);
+    int modulo = cacheStride(keyH, keyL, s->prime);
+    int index = first;
+    int victim = first;
+    int pass;
+
+
+    for ( pass = 0; pass < s->set; pass++ )
+    {
+        if ( (s->slots[index].device == -1) && (s->slots[index].inode == 0) )
+        {
+            victim = index;
+            break;
+        }
+        else if ( (s->slots[index].device == (int32_t)keyH) && (s->slots[index].inode == (int32_t)keyL) )
+        {
+            return;
+        }
+        if ( s->slots[index].used < s->slots[victim].used )
+        {
+            victim = index;
+        }
+        index = ( index + modulo ) % s->entries;
+    }
+
+    if ( (pass == s->set) && (s->policy == P_RANDOM) )
+    {
+        victim = ( first + ( rand_r(&s->seed) % s->set ) * modulo ) % s->entries;
+    }
+
+    s->slots[victim].device = keyH;
+    s->slots[victim].inode = keyL;
+    s->slots[victim].used = ++s->clock;
+}
+
+static void sim_clear(struct sim* s, uint32_t keyH, uint32_t keyL)
+{
+    int index = cacheFirst(keyH, keyL, s->entries);
+    int modulo = cacheStride(keyH, keyL, s->prime);
+    int pass;
+
+
+    for ( pass = 0; pass < s->set; pass++ )
+    {
+        if ( (s->slots[index].device == (int32_t)keyH) && (s->slots[index].inode == (int32_t)keyL) )
+        {
+            s->slots[index].device = -1;
+            s->slots[index].inode = 0;
+            return;
+        }
+        index = ( index + modulo ) % s->entries;
+    }
+}
+
+static void sim_purge(struct sim* s, uint32_t keyH)
+{
+    int i;
+
+
+    for ( i = 0; i < s->entries; i++ )
+    {
+        if ( s->slots[i].device == (int32_t)keyH )
+        {
+            s->slots[i].device = -1;
+            s->slots[i].inode = 0;
+        }
+    }
+}
+
+static void replay_add(const struct TalpaCaptureRecord* rec, ICache* cache, struct sim* s, struct result* r, unsigned int fstype)
+{
+    r->adds++;
+    if ( cache )
+    {
+        cache->add(cache->object, fstype, FSTYPE, rec->device, rec->inode);
+    }
+    else
+    {
+        sim_add(s, rec->device, rec->inode);
+    }
+}
+
+/*
+ * Replays the trace against either the real cache or a simulated one.
+ */
+static void replay(const struct TalpaCaptureRecord* trace, size_t count, ICache* cache, struct sim* s, struct result* r)
+{
+    unsigned int fstype = talpa_fstype_intern(FSTYPE);
+    const struct TalpaCaptureRecord* rec;
+    int hit;
+    size_t i;
+
+
+    memset(r, 0, sizeof(*r));
+
+    for ( i = 0; i < count; i++ )
+    {
+        rec = &trace[i];
+        switch ( rec->event )
+        {
+            case TALPA_CAPTURE_HIT:
+            case TALPA_CAPTURE_MISS:
+                hit = cache ? cache->find(cache->object, rec->device, rec->inode) > 0 : sim_find(s, rec->device, rec->inode);
+                r->lookups++;
+                if ( hit )
+                {
+                    r->hits++;
+                    break;
+                }
+                if ( rec->event == TALPA_CAPTURE_HIT )
+                {
+                    /* It would have been vetted and cached */
+                    replay_add(rec, cache, s, r, fstype);
+                }
+                break;
+            case TALPA_CAPTURE_ADD:
+                replay_add(rec, cache, s, r, fstype);
+                break;
+            case TALPA_CAPTURE_CLEAR:
+                if ( cache )
+                {
+                    cache->clear(cache->object, rec->device, rec->inode);
+                }
+                else
+                {
+                    sim_clear(s, rec->device, rec->inode);
+                }
+                break;
+            case TALPA_CAPTURE_PURGE:
+                if ( cache )
+                {
+                    cache->purge(cache->object, rec->device);
+                }
+                else
+                {
+                    sim_purge(s, rec->device);
+                }
+                break;
+        }
+    }
+}
+
+static void set(IConfigurable* cfg, const char* name, const char* value)
+{
+    char buf[64];
+
+
+    snprintf(buf, sizeof(buf), "%s", value);
+    cfg->set(cfg->object, name, buf);
+}
+
+static int compare(const void* a, const void* b)
+{
+    const struct TalpaCaptureRecord* ra = (const struct TalpaCaptureRecord*)a;
+    const struct TalpaCaptureRecord* rb = (const struct TalpaCaptureRecord*)b;
+
+
+    return (ra->timestamp > rb->timestamp) - (ra->timestamp < rb->timestamp);
+}
+
+static struct TalpaCaptureRecord* load(const char* name, size_t* count)
+{
+    struct TalpaCaptureRecord* trace = NULL;
+    size_t size = 0;
+    size_t n = 0;
+    FILE* f;
+
+
+    f = fopen(name, "r");
+    if ( !f )
+    {
+        return NULL;
+    }
+
+    for (;;)
+    {
+        if ( n == size )
+        {
+            size = size ? size * 2 : 65536;
+            trace = (struct TalpaCaptureRecord *)realloc(trace, size * sizeof(*trace));
+            if ( !trace )
+            {
+                fclose(f);
+                return NULL;
+            }
+        }
+        if ( fread(&trace[n], sizeof(*trace), 1, f) != 1 )
+        {
+            break;
+        }
+        n++;
+    }
+
+    fclose(f);
+
+    /* Per-CPU rings come out in batches, put them back in order */
+    qsort(trace, n, sizeof(*trace), compare);
+    *count = n;
+
+    return trace;
+}
+
+int main(int argc, char *argv[])
+{
+    const char* geometries[MAX_GEOMETRIES];
+    unsigned int nr_geometries = 0;
+    int policies[P_MAX] = { 0 };
+    int any_policy = 0;
+    const char* file = NULL;
+    struct TalpaCaptureRecord* trace;
+    size_t count = 0;
+    unsigned long long hits = 0;
+    unsigned long long lookups = 0;
+    Cache* cache;
+    IConfigurable* cfg;
+    struct sim s;
+    struct result r;
+    char params[CACHE_PARAMSCFGDATASIZE];
+    char *arg;
+    unsigned int pos = 1;
+    unsigned int g;
+    unsigned int p;
+    size_t i;
+
+
+    for ( ; argc > 1 ; pos++, argc-- )
+    {
+        arg = argv[pos];
+        if ( !strncmp(arg, "-p", 2) && (nr_geometries < MAX_GEOMETRIES) )
+        {
+            geometries[nr_geometries++] = arg + 2;
+        }
+        else if ( !strncmp(arg, "-e", 2) )
+        {
+            for ( p = 0; p < P_MAX; p++ )
+            {
+                if ( !strcmp(arg + 2, policy_names[p]) )
+                {
+                    policies[p] = any_policy = 1;
+                    break;
+                }
+            }
+            if ( p == P_MAX )
+            {
+                fprintf(stderr, "Unknown policy %s!\n", arg + 2);
+                return 1;
+            }
+        }
+        else
+        {
+            file = arg;
+        }
+    }
+
+    if ( !file )
+    {
+        fprintf(stderr, "Usage: %s [-p<entries>[,<prime>[,<set>]]]... [-e<rr|lru|random>]... <trace>\n", argv[0]);
+        return 1;
+    }
+
+    if ( !nr_geometries )
+    {
+        geometries[nr_geometries++] = "24989,12491,2";
+        geometries[nr_geometries++] = "6247,0,2";
+        geometries[nr_geometries++] = "99991,0,2";
+        geometries[nr_geometries++] = "24989,0,4";
+    }
+
+    if ( !any_policy )
+    {
+        for ( p = 0; p < P_MAX; p++ )
+        {
+            policies[p] = 1;
+        }
+    }
+
+    trace = load(file, &count);
+    if ( !trace )
+    {
+        fprintf(stderr, "Failed to read %s!\n", file);
+        return 1;
+    }
+
+    for ( i = 0; i < count; i++ )
+    {
+        if ( (trace[i].event == TALPA_CAPTURE_HIT) || (trace[i].event == TALPA_CAPTURE_MISS) )
+        {
+            lookups++;
+            hits += trace[i].event == TALPA_CAPTURE_HIT;
+        }
+    }
+
+    printf("%zu records, %llu lookups, captured hit rate %.2f%%\n", count, lookups,
+           lookups ? 100.0 * hits / lookups : 0.0);
+
+    talpa_uspace_loglevel = 3;
+
+    cache = newCache();
+    if ( !cache )
+    {
+        return 1;
+    }
+    cfg = &cache->i_IConfigurable;
+    set(cfg, "fstypes", "+" FSTYPE);
+
+    for ( g = 0; g < nr_geometries; g++ )
+    {
+        /* Let the cache work out what it would really use */
+        set(cfg, "status", "disable");
+        set(cfg, "params", geometries[g]);
+        snprintf(params, sizeof(params), "%s", cfg->get(cfg->object, "params"));
+        set(cfg, "status", "enable");
+
+        for ( p = 0; p < P_MAX; p++ )
+        {
+            if ( !policies[p] )
+            {
+                continue;
+            }
+
+            if ( p == P_RR )
+            {
+                /* Enabling empties it */
+                set(cfg, "status", "disable");
+                set(cfg, "status", "enable");
+                replay(trace, count, &cache->i_ICache, NULL, &r);
+            }
+            else
+            {
+                memset(&s, 0, sizeof(s));
+                s.policy = (enum policy)p;
+                s.seed = 1;
+                if ( sscanf(params, "%d,%d,%d", &s.entries, &s.prime, &s.set) != 3 )
+                {
+                    continue;
+                }
+                s.slots = (struct slot *)calloc(s.entries, sizeof(struct slot));
+                if ( !s.slots )
+                {
+                    return 1;
+                }
+                for ( i = 0; i < (size_t)s.entries; i++ )
+                {
+                    s.slots[i].device = -1;
+                }
+                replay(trace, count, NULL, &s, &r);
+                free(s.slots);
+            }
+
+            printf("%s %s: %llu lookups, hit rate %.2f%%, %llu adds\n", params, policy_names[p],
+                   r.lookups, r.lookups ? 100.0 * r.hits / r.lookups : 0.0, r.adds);
+        }
+    }
+
+    cache->delete(cache);
+    free(trace);
+
+    return 0;
+}
@@ -0,0 +1,509 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Core benchmark
+ *
+ * Drives the core components built as an ordinary program (see userspace/)
+ * so that the cache and the filter chain can be measured and profiled
+ * without a kernel. Intercepting threads run against a working set of
+ * made up files on one device; vetting clients, if any, are threads in
+ * the same process allowing everything.
+ *
+ *  -w<workload>    cache (find, add on miss), inode (examineInode) or
+ *                  file (examineFileInfo) (default file)
+ *  -n<files>       working set size (default 1000)
+ *  -r              pick working set files at random instead of in turn
+ *  -l<loops>       operations per thread
+ *  -t<threads>     number of intercepting threads
+ *  -c<clients>     number of vetting client threads (default 1)
+ *  -C              leave the cache disabled
+ *  -s              collect and print the processor's per filter statistics, and
+ *                  the lock statistics when built with TALPA_LOCK_STATS
+ *  -T<file>        capture the cache operations into file, see cache-replay
+ *  -j              print a JSON summary instead of text
+ */
+
+#include <pthread.h>
+
+#include <linux/kernel.h>
+
+#include "common/talpa.h"
+#include "platform/fstype.h"
+#include "talpa_uspace.h"
+#include "bench-hist.h"
+
+
+enum workload
+{
+    W_CACHE,
+    W_INODE,
+    W_FILE
+};
+
+static const char* workload_names[] = { "cache", "inode", "file" };
+
+#define DEVICE          (0x800001)
+#define FSTYPE          "ext4"
+
+struct result
+{
+    pthread_t           thread;
+    unsigned int        seed;
+    double              wall;
+    unsigned long long  count;
+    unsigned long long  errors;
+    unsigned long long  sum;
+    unsigned long long  min;
+    unsigned long long  max;
+    unsigned long long  hist[HIST_BUCKETS];
+};
+
+static enum workload    workload = W_FILE;
+static unsigned int     nr = 1000;
+static int              random_order;
+static unsigned int     loops = 1000000;
+static int              stopping;
+
+static unsigned long long percentile(const struct result* r, double q)
+{
+    return hist_percentile(r->hist, r->count, r->max, q);
+}
+
+static int run_op(unsigned int file)
+{
+    IInterceptProcessor* processor = talpa_uspace_processor();
+    ICache* cache = talpa_uspace_cache();
+    IFileInfo* info;
+    char name[64];
+    int ret;
+
+
+    switch ( workload )
+    {
+        case W_CACHE:
+            if ( !cache->find(cache->object, DEVICE, file + 1) )
+            {
+                cache->add(cache->object, talpa_fstype_intern(FSTYPE), FSTYPE, DEVICE, file + 1);
+            }
+            return 0;
+        case W_INODE:
+            ret = processor->examineInode(processor->object, EFS_Open, false, O_RDONLY, DEVICE, file + 1);
+            /* No verdict from the fast path is not a failure */
+            return (ret == -EAGAIN) ? 0 : ret;
+        case W_FILE:
+            snprintf(name, sizeof(name), "/bench/file-%u", file);
+            info = talpa_uspace_fileinfo(EFS_Open, name, O_RDONLY, DEVICE, file + 1, FSTYPE);
+            if ( !info )
+            {
+                return -ENOMEM;
+            }
+            ret = processor->examineFileInfo(processor->object, info, NULL);
+            info->delete(info);
+            return ret;
+    }
+
+    return 0;
+}
+
+static void* run(void* data)
+{
+    struct result* r = (struct result *)data;
+    unsigned long long start, lat, begin;
+    unsigned int next = 0;
+    unsigned int file;
+    unsigned int i;
+
+
+    r->min = ~0ULL;
+    begin = now_ns();
+
+    for ( i = 0; i < loops; i++ )
+    {
+        if ( random_order )
+        {
+            file = rand_r(&r->seed) % nr;
+        }
+        else
+        {
+            file = next;
+            if ( ++next == nr )
+            {
+                next = 0;
+            }
+        }
+
+        start = now_ns();
+        if ( run_op(file) < 0 )
+        {
+            r->errors++;
+            continue;
+        }
+        lat = now_ns() - start;
+
+        r->count++;
+        r->sum += lat;
+        r->hist[hist_bucket(lat)]++;
+        if ( lat < r->min )
+        {
+            r->min = lat;
+        }
+        if ( lat > r->max )
+        {
+            r->max = lat;
+        }
+    }
+
+    r->wall = (double)(now_ns() - begin) / 1000000000.0;
+
+    return NULL;
+}
+
+/*
+ * A vetting client allowing everything, the way talpa_vcdevice drives
+ * the vetting server for a daemon reading and writing its device.
+ */
+static void* client(void* data)
+{
+    IVettingServer* vs = talpa_uspace_vetting_server();
+    VettingClient* client;
+    struct TalpaPacket_Register reg;
+    struct TalpaPacket_SetWaitTimeout tmo;
+    struct TalpaPacket_Deregister dereg;
+    struct TalpaPacket_VettingResponse resp;
+    struct TalpaProtocolHeader* pkt;
+    uint32_t vettingID;
+
+
+    client = vs->initializeClient(vs->object);
+    if ( !client )
+    {
+        return NULL;
+    }
+
+    reg.header.type = TALPA_PKT_REG;
+    reg.header.version = TALPA_PROTOCOL_VERSION;
+    reg.header.payloadLength = sizeof(reg) - sizeof(reg.header);
+    reg.group = 0;
+    vs->registerClient(vs->object, client, &reg);
+
+    tmo.header.type = TALPA_PKT_SETVETTIMEOUT;
+    tmo.header.version = TALPA_PROTOCOL_VERSION;
+    tmo.header.payloadLength = sizeof(tmo) - sizeof(tmo.header);
+    tmo.timeout_ms = 100;
+    vs->setWaitTimeout(vs->object, client, &tmo);
+
+    __atomic_store_n((int *)data, 1, __ATOMIC_RELEASE);
+
+    while ( !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE) )
+    {
+        pkt = vs->obtainVettingDetails(vs->object, client);
+        if ( pkt->type != TALPA_PKT_FILEDETAIL )
+        {
+            continue;
+        }
+        vettingID = ((struct TalpaPacket_VettingDetails *)pkt)->vettingID;
+        vs->releaseVettingDetails(vs->object, client);
+
+        resp.header.type = TALPA_PKT_VETRESPONSE;
+        resp.header.version = TALPA_PROTOCOL_VERSION;
+        resp.header.payloadLength = sizeof(resp) - sizeof(resp.header);
+        resp.vettingID = vettingID;
+        resp.response = TALPA_ALLOW;
+        resp.errorCode = 0;
+        vs->vettingResponse(vs->object, client, &resp);
+    }
+
+    dereg.header.type = TALPA_PKT_DEREG;
+    dereg.header.version = TALPA_PROTOCOL_VERSION;
+    dereg.header.payloadLength = 0;
+    vs->deregisterClient(vs->object, client, &dereg);
+    vs->destroyClient(vs->object, client);
+
+    return NULL;
+}
+
+static void merge(struct result* total, const struct result* r)
+{
+    unsigned int b;
+
+
+    total->count += r->count;
+    total->errors += r->errors;
+    total->sum += r->sum;
+    if ( r->count && (r->min < total->min) )
+    {
+        total->min = r->min;
+    }
+    if ( r->max > total->max )
+    {
+        total->max = r->max;
+    }
+    for ( b = 0; b < HIST_BUCKETS; b++ )
+    {
+        total->hist[b] += r->hist[b];
+    }
+    if ( r->wall > total->wall )
+    {
+        total->wall = r->wall;
+    }
+}
+
+static void print_json(const struct result* results, const struct result* total, unsigned int threads, unsigned int clients, bool cached)
+{
+    unsigned int i;
+    unsigned int b;
+    int first = 1;
+
+
+    printf("{\n");
+    printf("  \"workload\": \"%s\",\n", workload_names[workload]);
+    printf("  \"files\": %u,\n", nr);
+    printf("  \"order\": \"%s\",\n", random_order ? "random" : "sequential");
+    printf("  \"loops\": %u,\n", loops);
+    printf("  \"threads\": %u,\n", threads);
+    printf("  \"clients\": %u,\n", clients);
+    printf("  \"cache\": %s,\n", cached ? "true" : "false");
+    printf("  \"runs\": [");
+    for ( i = 0; i < threads; i++ )
+    {
+        printf("%s{ \"wall\": %.3f, \"ops\": %llu, \"errors\": %llu }",
+               i ? ", " : "", results[i].wall, results[i].count, results[i].errors);
+    }
+    printf("],\n");
+    printf("  \"ops_per_sec\": %.1f,\n", total->wall > 0 ? (double)total->count / total->wall : 0.0);
+    printf("  \"latency_ns\": { \"min\": %llu, \"mean\": %llu, \"p50\": %llu, \"p99\": %llu, \"p99.9\": %llu, \"max\": %llu },\n",
+           total->count ? total->min : 0ULL, total->count ? total->sum / total->count : 0ULL,
+           percentile(total, 0.5), percentile(total, 0.99), percentile(total, 0.999), total->max);
+    printf("  \"histogram\": [");
+    for ( b = 0; b < HIST_BUCKETS; b++ )
+    {
+        if ( total->hist[b] )
+        {
+            printf("%s[%llu, %llu]", first ? "" : ", ", hist_upper(b), total->hist[b]);
+            first = 0;
+        }
+    }
+    printf("]\n");
+    printf("}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int threads = 1;
+    unsigned int clients = 1;
+    bool cached = true;
+    int json = 0;
+    int stats = 0;
+    const char* capture = NULL;
+    const char* locks;
+    char *arg;
+    unsigned int pos = 1;
+    pthread_t* clientThreads;
+    int* clientReady;
+    struct result* results;
+    struct result total;
+    IConfigurable* cache;
+    IConfigurable* processor;
+    unsigned int i;
+
+
+    for ( ; argc > 1 ; pos++, argc-- )
+    {
+        arg = argv[pos];
+        if ( !strncmp(arg, "-w", 2) )
+        {
+            arg += 2;
+            for ( i = 0; i < sizeof(workload_names) / sizeof(workload_names[0]); i++ )
+            {
+                if ( !strcmp(arg, workload_names[i]) )
+                {
+                    break;
+                }
+            }
+            if ( i == sizeof(workload_names) / sizeof(workload_names[0]) )
+            {
+                fprintf(stderr, "Unknown workload %s!\n", arg);
+                return 1;
+            }
+            workload = (enum workload)i;
+        }
+        else if ( !strncmp(arg, "-n", 2) )
+        {
+            nr = atoi(arg + 2);
+        }
+        else if ( !strcmp(arg, "-r") )
+        {
+            random_order = 1;
+        }
+        else if ( !strcmp(arg, "-C") )
+        {
+            cached = false;
+        }
+        else if ( !strncmp(arg, "-T", 2) )
+        {
+            capture = arg + 2;
+        }
+        else if ( !strcmp(arg, "-s") )
+        {
+            stats = 1;
+        }
+        else if ( !strcmp(arg, "-j") )
+        {
+            json = 1;
+        }
+        else if ( !strncmp(arg, "-l", 2) )
+        {
+            loops = atol(arg + 2);
+        }
+        else if ( !strncmp(arg, "-t", 2) )
+        {
+            threads = atoi(arg + 2);
+        }
+        else if ( !strncmp(arg, "-c", 2) )
+        {
+            clients = atoi(arg + 2);
+        }
+    }
+
+    if ( !nr || !threads )
+    {
+        fprintf(stderr, "Need at least one file and one thread!\n");
+        return 1;
+    }
+
+    if ( talpa_uspace_init() )
+    {
+        return 1;
+    }
+
+    cache = talpa_uspace_configurable("Cache");
+    if ( cache && cached )
+    {
+        cache->set(cache->object, "fstypes", "+" FSTYPE);
+        cache->set(cache->object, "status", "enable");
+    }
+
+    processor = talpa_uspace_configurable("StandardInterceptProcessor");
+    if ( processor && stats )
+    {
+        processor->set(processor->object, "filter-stats", "enable");
+    }
+
+    if ( processor && capture )
+    {
+        talpa_uspace_capture_file = fopen(capture, "w");
+        if ( !talpa_uspace_capture_file )
+        {
+            fprintf(stderr, "Failed to open %s!\n", capture);
+            return 1;
+        }
+        processor->set(processor->object, "capture", "enable");
+    }
+
+    results = (struct result *)calloc(threads, sizeof(struct result));
+    clientThreads = (pthread_t *)calloc(clients + 1, sizeof(pthread_t));
+    clientReady = (int *)calloc(clients + 1, sizeof(int));
+    if ( !results || !clientThreads || !clientReady )
+    {
+        return 1;
+    }
+
+    for ( i = 0; i < clients; i++ )
+    {
+        if ( pthread_create(&clientThreads[i], NULL, client, &clientReady[i]) )
+        {
+            fprintf(stderr, "Failed to start vetting client!\n");
+            return 1;
+        }
+        while ( !__atomic_load_n(&clientReady[i], __ATOMIC_ACQUIRE) )
+        {
+            sched_yield();
+        }
+    }
+
+    for ( i = 0; i < threads; i++ )
+    {
+        results[i].seed = i + 1;
+        if ( pthread_create(&results[i].thread, NULL, run, &results[i]) )
+        {
+            fprintf(stderr, "Failed to start thread!\n");
+            return 1;
+        }
+    }
+
+    for ( i = 0; i < threads; i++ )
+    {
+        pthread_join(results[i].thread, NULL);
+        if ( !json )
+        {
+            printf("%.3f-[%llu ops]\n", results[i].wall, results[i].count);
+        }
+    }
+
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    for ( i = 0; i < clients; i++ )
+    {
+        pthread_join(clientThreads[i], NULL);
+    }
+
+    memset(&total, 0, sizeof(total));
+    total.min = ~0ULL;
+    for ( i = 0; i < threads; i++ )
+    {
+        merge(&total, &results[i]);
+    }
+
+    if ( json )
+    {
+        print_json(results, &total, threads, clients, cached);
+    }
+    else
+    {
+        printf("%s: %.1f ops/s, mean %lluns, p50 %lluns, p99 %lluns, p99.9 %lluns, max %lluns, errors %llu\n",
+               workload_names[workload], total.wall > 0 ? (double)total.count / total.wall : 0.0,
+               total.count ? total.sum / total.count : 0ULL, percentile(&total, 0.5), percentile(&total, 0.99),
+               percentile(&total, 0.999), total.max, total.errors);
+    }
+
+    if ( processor && stats && !json )
+    {
+        printf("Evaluation filters:\n%s", processor->get(processor->object, "filter-stats-evaluation"));
+        printf("Allow filters:\n%s", processor->get(processor->object, "filter-stats-allow"));
+        printf("Deny filters:\n%s", processor->get(processor->object, "filter-stats-deny"));
+        locks = processor->get(processor->object, "lock-stats");
+        if ( locks )
+        {
+            printf("Locks:\n%s", locks);
+        }
+    }
+
+    talpa_uspace_exit();
+
+    if ( talpa_uspace_capture_file )
+    {
+        fclose(talpa_uspace_capture_file);
+    }
+
+    free(clientReady);
+    free(clientThreads);
+    free(results);
+
+    return 0;
+}
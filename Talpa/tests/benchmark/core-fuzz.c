@@ -0,0 +1,338 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Core fuzzer
+ *
+ * Interprets a byte string as a sequence of cache operations, configuration
+ * changes and intercepts against the core components built as an ordinary
+ * program (see userspace/), checking what must hold after each step:
+ *
+ *  - an entry added to the cache for a cached filesystem is found,
+ *  - nothing on a device is found right after purging the device.
+ *
+ * Paths, filesystem names and configuration strings come from a small
+ * alphabet so that prefixes and duplicates are common. Built with
+ * -DTALPA_LIBFUZZER this provides LLVMFuzzerTestOneInput, otherwise it
+ * feeds itself pseudo random input:
+ *
+ *  -s<seed>        first seed (default 1)
+ *  -i<runs>        number of inputs to try (default 1000)
+ *  -b<bytes>       input size (default 4096)
+ */
+
+#include <linux/kernel.h>
+
+#include "common/talpa.h"
+#include "platform/fstype.h"
+#include "talpa_uspace.h"
+
+
+#define FSTYPE          "ext4"
+#define MAX_STRING      (48)
+#define MAX_ENTRIES     (1 << 16)
+
+struct input
+{
+    const uint8_t*  data;
+    size_t          size;
+};
+
+static int initialized;
+
+static unsigned int next_byte(struct input* in)
+{
+    unsigned int byte;
+
+
+    if ( !in->size )
+    {
+        return 0;
+    }
+
+    byte = *in->data++;
+    in->size--;
+
+    return byte;
+}
+
+static uint32_t next_u32(struct input* in)
+{
+    uint32_t value;
+
+
+    value = next_byte(in);
+    value |= next_byte(in) << 8;
+
+    return value;
+}
+
+static void next_string(struct input* in, char* buf, const char* alphabet, const char* prefix)
+{
+    unsigned int len = strlen(prefix);
+    unsigned int n = next_byte(in) % (MAX_STRING - len);
+    unsigned int alen = strlen(alphabet);
+
+
+    strcpy(buf, prefix);
+    while ( n-- )
+    {
+        buf[len++] = alphabet[next_byte(in) % alen];
+    }
+    buf[len] = 0;
+}
+
+static void next_path(struct input* in, char* buf)
+{
+    next_string(in, buf, "/ab.-", "/");
+}
+
+static void next_fstype(struct input* in, char* buf)
+{
+    static const char* names[] = { "ext3", "xfs", "nfs", "proc", "tmpfs", "fuse.sshfs" };
+    unsigned int pick = next_byte(in);
+
+
+    /* The one the cache invariants rely on is never removed */
+    if ( pick < 200 )
+    {
+        strcpy(buf, names[pick % (sizeof(names) / sizeof(names[0]))]);
+    }
+    else
+    {
+        next_string(in, buf, "abcx.", "");
+    }
+}
+
+static void failed(const char* what, uint32_t device, uint32_t inode)
+{
+    fprintf(stderr, "Invariant broken: %s (device %u, inode %u)\n", what, device, inode);
+    abort();
+}
+
+static void set(IConfigurable* cfg, const char* name, const char* value)
+{
+    char buf[MAX_STRING + 16];
+
+
+    /* Components may parse the value in place, as they do with what the configurator hands them */
+    snprintf(buf, sizeof(buf), "%s", value);
+    cfg->set(cfg->object, name, buf);
+}
+
+static void run_input(const uint8_t* data, size_t size)
+{
+    struct input in = { data, size };
+    IInterceptProcessor* processor = talpa_uspace_processor();
+    ICache* cache = talpa_uspace_cache();
+    IConfigurable* cacheCfg = talpa_uspace_configurable("Cache");
+    IConfigurable* exclCfg = talpa_uspace_configurable("FilesystemExclusionProcessor");
+    IConfigurable* inclCfg = talpa_uspace_configurable("FilesystemInclusionProcessor");
+    IConfigurable* vetCfg = talpa_uspace_configurable("VettingController");
+    IFileInfo* info;
+    char str[MAX_STRING];
+    char str2[MAX_STRING + 16];
+    uint32_t device;
+    uint32_t inode;
+    unsigned int fstype = talpa_fstype_intern(FSTYPE);
+    bool enabled = true;
+
+
+    set(cacheCfg, "status", "enable");
+
+    while ( in.size )
+    {
+        device = next_byte(&in) % 4 + 1;
+        inode = next_u32(&in);
+
+        switch ( next_byte(&in) % 12 )
+        {
+            case 0:
+            case 1:
+                if ( cache->add(cache->object, fstype, FSTYPE, device, inode) && !cache->find(cache->object, device, inode) )
+                {
+                    failed("added entry not found", device, inode);
+                }
+                break;
+            case 2:
+                cache->find(cache->object, device, inode);
+                break;
+            case 3:
+                cache->clear(cache->object, device, inode);
+                break;
+            case 4:
+                cache->purge(cache->object, device);
+                if ( cache->find(cache->object, device, inode) )
+                {
+                    failed("entry found after purge", device, inode);
+                }
+                break;
+            case 5:
+                /* Resizing is only allowed while disabled */
+                set(cacheCfg, "status", "disable");
+                snprintf(str, sizeof(str), "%u,%u,%u", next_u32(&in) % MAX_ENTRIES, next_u32(&in), next_byte(&in) % 64);
+                set(cacheCfg, "params", str);
+                set(cacheCfg, "status", "enable");
+                break;
+            case 6:
+                next_fstype(&in, str);
+                snprintf(str2, sizeof(str2), "%c%s", (next_byte(&in) & 1) ? '+' : '-', str);
+                set(cacheCfg, "fstypes", str2);
+                break;
+            case 7:
+                next_path(&in, str);
+                snprintf(str2, sizeof(str2), "%c%s", (next_byte(&in) & 1) ? '+' : '-', str);
+                set(exclCfg, (next_byte(&in) & 1) ? "paths" : "mount-paths", str2);
+                break;
+            case 8:
+                next_fstype(&in, str);
+                snprintf(str2, sizeof(str2), "%c%s", (next_byte(&in) & 1) ? '+' : '-', str);
+                set(exclCfg, (next_byte(&in) & 1) ? "fstypes" : "mount-fstypes", str2);
+                break;
+            case 9:
+                if ( next_byte(&in) & 1 )
+                {
+                    next_path(&in, str);
+                    snprintf(str2, sizeof(str2), "+path:%s:%u", str, next_byte(&in) % 10);
+                }
+                else
+                {
+                    next_fstype(&in, str);
+                    snprintf(str2, sizeof(str2), "%cfs:%s:%u", (next_byte(&in) & 1) ? '+' : '-', str, next_byte(&in) % 10);
+                }
+                set(vetCfg, "routing", str2);
+                break;
+            case 10:
+                next_path(&in, str);
+                if ( next_byte(&in) & 1 )
+                {
+                    set(inclCfg, "include-path", str);
+                }
+                enabled = !enabled;
+                set(inclCfg, "status", enabled ? "enable" : "disable");
+                break;
+            case 11:
+                next_path(&in, str);
+                next_fstype(&in, str2);
+                info = talpa_uspace_fileinfo(EFS_Open + next_byte(&in) % 3, str, (next_byte(&in) & 1) ? O_RDWR : O_RDONLY,
+                                             device, inode, (next_byte(&in) & 1) ? FSTYPE : str2);
+                if ( info )
+                {
+                    processor->examineFileInfo(processor->object, info, NULL);
+                    info->delete(info);
+                }
+                processor->examineInode(processor->object, EFS_Open, false, O_RDONLY, device, inode);
+                break;
+        }
+    }
+}
+
+static void init(void)
+{
+    IConfigurable* cacheCfg;
+
+
+    if ( initialized )
+    {
+        return;
+    }
+
+    /* Configuration errors are expected, only keep the serious ones */
+    talpa_uspace_loglevel = 2;
+
+    if ( talpa_uspace_init() )
+    {
+        abort();
+    }
+
+    cacheCfg = talpa_uspace_configurable("Cache");
+    set(cacheCfg, "fstypes", "+" FSTYPE);
+
+    initialized = 1;
+}
+
+#ifdef TALPA_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    init();
+    run_input(data, size);
+
+    return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+    unsigned int seed = 1;
+    unsigned int runs = 1000;
+    unsigned int bytes = 4096;
+    uint8_t* data;
+    char *arg;
+    unsigned int pos = 1;
+    unsigned int i, j;
+
+
+    for ( ; argc > 1 ; pos++, argc-- )
+    {
+        arg = argv[pos];
+        if ( !strncmp(arg, "-s", 2) )
+        {
+            seed = atoi(arg + 2);
+        }
+        else if ( !strncmp(arg, "-i", 2) )
+        {
+            runs = atoi(arg + 2);
+        }
+        else if ( !strncmp(arg, "-b", 2) )
+        {
+            bytes = atoi(arg + 2);
+        }
+    }
+
+    data = (uint8_t *)malloc(bytes);
+    if ( !data )
+    {
+        return 1;
+    }
+
+    init();
+
+    for ( i = 0; i < runs; i++, seed++ )
+    {
+        unsigned int state = seed;
+
+
+        for ( j = 0; j < bytes; j++ )
+        {
+            data[j] = rand_r(&state);
+        }
+        run_input(data, bytes);
+    }
+
+    printf("%u inputs of %u bytes, seeds %u to %u\n", runs, bytes, seed - runs, seed - 1);
+
+    talpa_uspace_exit();
+    free(data);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,534 @@
+/*
+ * TALPA test program
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Intercept benchmark
+ *
+ * Like open-bench, but with a choice of workloads, a working set of many
+ * files to control the cache hit ratio and per-operation latency
+ * percentiles. Each process prints the same wall-[user/sys] line as
+ * open-bench so bench.sh and graph.pl can drive either.
+ *
+ *  -w<workload>    open, write, exec, mmap or stat (default open)
+ *  -f<file>        file to operate on, or to populate the working set from
+ *  -n<files>       working set size, 0 operates on -f directly (default 0,
+ *                  the write workload always works on a copy)
+ *  -d<dir>         where to create the working set (default /tmp/tlp-bench)
+ *  -r              pick working set files at random instead of in turn
+ *  -l<loops>       operations per process
+ *  -o<procs>       number of processes
+ *  -j              print a JSON summary instead of text
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/times.h>
+
+#include "bench-hist.h"
+
+
+enum workload
+{
+    W_OPEN,
+    W_WRITE,
+    W_EXEC,
+    W_MMAP,
+    W_STAT
+};
+
+static const char* workload_names[] = { "open", "write", "exec", "mmap", "stat" };
+
+struct result
+{
+    double              wall;
+    double              user;
+    double              sys;
+    unsigned long long  count;
+    unsigned long long  errors;
+    unsigned long long  sum;
+    unsigned long long  min;
+    unsigned long long  max;
+    unsigned long long  hist[HIST_BUCKETS];
+};
+
+static unsigned long long percentile(const struct result* r, double q)
+{
+    return hist_percentile(r->hist, r->count, r->max, q);
+}
+
+static int copy_file(const char* from, const char* to)
+{
+    char buf[65536];
+    ssize_t len;
+    int in, out;
+    int rc = 0;
+
+
+    in = open(from, O_RDONLY);
+    if ( in < 0 )
+    {
+        return -1;
+    }
+
+    out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    if ( out < 0 )
+    {
+        close(in);
+        return -1;
+    }
+
+    while ( (len = read(in, buf, sizeof(buf))) > 0 )
+    {
+        if ( write(out, buf, len) != len )
+        {
+            rc = -1;
+            break;
+        }
+    }
+
+    if ( len < 0 )
+    {
+        rc = -1;
+    }
+
+    close(in);
+    close(out);
+
+    return rc;
+}
+
+static char** make_working_set(const char* dir, const char* file, unsigned int nr)
+{
+    char** files;
+    unsigned int i;
+
+
+    files = (char **)calloc(nr, sizeof(char *));
+    if ( !files )
+    {
+        return NULL;
+    }
+
+    mkdir(dir, 0755);
+
+    for ( i = 0; i < nr; i++ )
+    {
+        files[i] = (char *)malloc(PATH_MAX);
+        if ( !files[i] )
+        {
+            return NULL;
+        }
+        snprintf(files[i], PATH_MAX, "%s/file-%u", dir, i);
+        if ( copy_file(file, files[i]) < 0 )
+        {
+            fprintf(stderr, "Failed to create %s (%d)!\n", files[i], errno);
+            return NULL;
+        }
+    }
+
+    return files;
+}
+
+static void remove_working_set(const char* dir, char** files, unsigned int nr)
+{
+    unsigned int i;
+
+
+    for ( i = 0; i < nr; i++ )
+    {
+        unlink(files[i]);
+    }
+
+    rmdir(dir);
+}
+
+static int run_op(enum workload workload, const char* file)
+{
+    struct stat st;
+    void* map;
+    pid_t pid;
+    int status;
+    int fd;
+    char byte;
+    char* const argv[] = { (char *)file, NULL };
+    char* const envp[] = { NULL };
+
+
+    switch ( workload )
+    {
+        case W_OPEN:
+            fd = open(file, O_RDONLY);
+            if ( fd < 0 )
+            {
+                return -1;
+            }
+            close(fd);
+            break;
+        case W_WRITE:
+            /* Rewrite the first byte so that close sees a modified file */
+            fd = open(file, O_RDWR);
+            if ( fd < 0 )
+            {
+                return -1;
+            }
+            if ( (pread(fd, &byte, 1, 0) != 1) || (pwrite(fd, &byte, 1, 0) != 1) )
+            {
+                close(fd);
+                return -1;
+            }
+            close(fd);
+            break;
+        case W_EXEC:
+            pid = fork();
+            if ( pid == 0 )
+            {
+                execve(file, argv, envp);
+                _exit(127);
+            }
+            else if ( pid < 0 )
+            {
+                return -1;
+            }
+            if ( (waitpid(pid, &status, 0) < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) == 127) )
+            {
+                return -1;
+            }
+            break;
+        case W_MMAP:
+            fd = open(file, O_RDONLY);
+            if ( fd < 0 )
+            {
+                return -1;
+            }
+            map = mmap(NULL, 4096, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+            if ( map == MAP_FAILED )
+            {
+                close(fd);
+                return -1;
+            }
+            munmap(map, 4096);
+            close(fd);
+            break;
+        case W_STAT:
+            if ( stat(file, &st) < 0 )
+            {
+                return -1;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+static void run(struct result* r, enum workload workload, char** files, unsigned int nr, int random_order, unsigned int loops, long cps)
+{
+    struct tms times1, times2;
+    struct timeval tv1, tv2;
+    unsigned long long start, lat;
+    unsigned int seed = getpid();
+    unsigned int next = 0;
+    const char* file;
+
+
+    r->min = ~0ULL;
+
+    gettimeofday(&tv1, NULL);
+    times(&times1);
+
+    while ( loops-- )
+    {
+        if ( random_order )
+        {
+            file = files[rand_r(&seed) % nr];
+        }
+        else
+        {
+            file = files[next];
+            if ( ++next == nr )
+            {
+                next = 0;
+            }
+        }
+
+        start = now_ns();
+        if ( run_op(workload, file) < 0 )
+        {
+            r->errors++;
+            continue;
+        }
+        lat = now_ns() - start;
+
+        r->count++;
+        r->sum += lat;
+        r->hist[hist_bucket(lat)]++;
+        if ( lat < r->min )
+        {
+            r->min = lat;
+        }
+        if ( lat > r->max )
+        {
+            r->max = lat;
+        }
+    }
+
+    times(&times2);
+    gettimeofday(&tv2, NULL);
+
+    r->user = (double)(times2.tms_utime - times1.tms_utime) / (double)cps;
+    r->sys = (double)(times2.tms_stime - times1.tms_stime) / (double)cps;
+    r->wall = (double)(tv2.tv_sec - tv1.tv_sec) + (double)(tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+}
+
+static void merge(struct result* total, const struct result* r)
+{
+    unsigned int b;
+
+
+    total->count += r->count;
+    total->errors += r->errors;
+    total->sum += r->sum;
+    if ( r->count && (r->min < total->min) )
+    {
+        total->min = r->min;
+    }
+    if ( r->max > total->max )
+    {
+        total->max = r->max;
+    }
+    for ( b = 0; b < HIST_BUCKETS; b++ )
+    {
+        total->hist[b] += r->hist[b];
+    }
+    if ( r->wall > total->wall )
+    {
+        total->wall = r->wall;
+    }
+    total->user += r->user;
+    total->sys += r->sys;
+}
+
+static void print_json(const struct result* results, const struct result* total, unsigned int procs,
+                       enum workload workload, unsigned int nr, int random_order, unsigned int loops)
+{
+    unsigned int i;
+    unsigned int b;
+    int first = 1;
+
+
+    printf("{\n");
+    printf("  \"workload\": \"%s\",\n", workload_names[workload]);
+    printf("  \"files\": %u,\n", nr);
+    printf("  \"order\": \"%s\",\n", random_order ? "random" : "sequential");
+    printf("  \"loops\": %u,\n", loops);
+    printf("  \"processes\": %u,\n", procs);
+    printf("  \"runs\": [");
+    for ( i = 0; i < procs; i++ )
+    {
+        printf("%s{ \"wall\": %.3f, \"user\": %.3f, \"sys\": %.3f, \"ops\": %llu, \"errors\": %llu }",
+               i ? ", " : "", results[i].wall, results[i].user, results[i].sys, results[i].count, results[i].errors);
+    }
+    printf("],\n");
+    printf("  \"ops_per_sec\": %.1f,\n", total->wall > 0 ? (double)total->count / total->wall : 0.0);
+    printf("  \"latency_ns\": { \"min\": %llu, \"mean\": %llu, \"p50\": %llu, \"p99\": %llu, \"p99.9\": %llu, \"max\": %llu },\n",
+           total->count ? total->min : 0ULL, total->count ? total->sum / total->count : 0ULL,
+           percentile(total, 0.5), percentile(total, 0.99), percentile(total, 0.999), total->max);
+    printf("  \"histogram\": [");
+    for ( b = 0; b < HIST_BUCKETS; b++ )
+    {
+        if ( total->hist[b] )
+        {
+            printf("%s[%llu, %llu]", first ? "" : ", ", hist_upper(b), total->hist[b]);
+            first = 0;
+        }
+    }
+    printf("]\n");
+    printf("}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    enum workload workload = W_OPEN;
+    char *file = NULL;
+    char *dir = "/tmp/tlp-bench";
+    char **files;
+    unsigned int nr = 0;
+    int random_order = 0;
+    int json = 0;
+    unsigned int loops = 1000000;
+    int forks = 1;
+    char *arg;
+    unsigned int pos = 1;
+    long cps;
+    int children = 0;
+    pid_t child;
+    struct timespec ts;
+    struct result* results;
+    struct result total;
+    unsigned int i;
+
+
+    cps = sysconf(_SC_CLK_TCK);
+
+    for ( ; argc > 1 ; pos++, argc-- )
+    {
+        arg = argv[pos];
+        if ( !strncmp(arg, "-w", 2) )
+        {
+            arg += 2;
+            for ( i = 0; i < sizeof(workload_names) / sizeof(workload_names[0]); i++ )
+            {
+                if ( !strcmp(arg, workload_names[i]) )
+                {
+                    break;
+                }
+            }
+            if ( i == sizeof(workload_names) / sizeof(workload_names[0]) )
+            {
+                fprintf(stderr, "Unknown workload %s!\n", arg);
+                return 1;
+            }
+            workload = (enum workload)i;
+        }
+        else if ( !strncmp(arg, "-f", 2) )
+        {
+            file = arg + 2;
+        }
+        else if ( !strncmp(arg, "-n", 2) )
+        {
+            nr = atoi(arg + 2);
+        }
+        else if ( !strncmp(arg, "-d", 2) )
+        {
+            dir = arg + 2;
+        }
+        else if ( !strcmp(arg, "-r") )
+        {
+            random_order = 1;
+        }
+        else if ( !strcmp(arg, "-j") )
+        {
+            json = 1;
+        }
+        else if ( !strncmp(arg, "-l", 2) )
+        {
+            loops = atol(arg + 2);
+        }
+        else if ( !strncmp(arg, "-o", 2) )
+        {
+            forks = atoi(arg + 2);
+        }
+    }
+
+    if ( !file )
+    {
+        file = (workload == W_EXEC) ? "/bin/true" : "/bin/ls";
+    }
+
+    /* Never write to the original */
+    if ( (workload == W_WRITE) && !nr )
+    {
+        nr = 1;
+    }
+
+    if ( nr )
+    {
+        files = make_working_set(dir, file, nr);
+        if ( !files )
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        files = &file;
+        nr = 1;
+    }
+
+    results = (struct result *)mmap(NULL, forks * sizeof(struct result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if ( results == MAP_FAILED )
+    {
+        return 1;
+    }
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = 200000000;
+
+    for ( i = 0; i < (unsigned int)forks; i++ )
+    {
+        child = fork();
+
+        if ( child == 0 )
+        {
+            nanosleep(&ts, NULL);
+            run(&results[i], workload, files, nr, random_order, loops, cps);
+
+            if ( !json )
+            {
+                printf("%.3f-[%.3f/%.3f]\n", results[i].wall, results[i].user, results[i].sys);
+            }
+
+            return 0;
+        }
+        else if ( child > 0 )
+        {
+            children++;
+        }
+    }
+
+    while ( children-- )
+    {
+        wait(NULL);
+    }
+
+    memset(&total, 0, sizeof(total));
+    total.min = ~0ULL;
+    for ( i = 0; i < (unsigned int)forks; i++ )
+    {
+        merge(&total, &results[i]);
+    }
+
+    if ( json )
+    {
+        print_json(results, &total, forks, workload, files == &file ? 0 : nr, random_order, loops);
+    }
+    else
+    {
+        printf("latency %s: p50 %lluns, p99 %lluns, p99.9 %lluns, max %lluns, errors %llu\n",
+               workload_names[workload], percentile(&total, 0.5), percentile(&total, 0.99),
+               percentile(&total, 0.999), total.max, total.errors);
+    }
+
+    if ( files != &file )
+    {
+        remove_working_set(dir, files, nr);
+    }
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * core.c
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * The core put together the way talpa_core does it, minus the module
+ * plumbing. Configuration is reached directly through talpa_uspace_configurable()
+ * instead of via a configurator.
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#define TALPA_SUBSYS "uspace"
+#include "common/talpa.h"
+#include "components/core/intercept_processing_impl/std_intercept_processor.h"
+#include "components/core/intercept_filters_impl/syslog/syslog_filter.h"
+#include "components/core/intercept_filters_impl/deny_syslog/deny_syslog.h"
+#include "components/core/intercept_filters_impl/allow_syslog/allow_syslog.h"
+#include "components/core/intercept_filters_impl/fsobj_incl/filesystem_inclusion_processor.h"
+#include "components/core/intercept_filters_impl/fsobj_excl/filesystem_exclusion_processor.h"
+#include "components/core/intercept_filters_impl/operation_excl/operation_excl.h"
+#include "components/core/intercept_filters_impl/vetting_ctrl/vetting_ctrl.h"
+#include "components/core/intercept_filters_impl/proc_excl/process_exclusion.h"
+#include "components/core/intercept_filters_impl/degraded_mode/degraded_mode.h"
+#include "components/core/cache_impl/cache.h"
+#include "components/core/intercept_filters_impl/cache/cache_eval.h"
+#include "components/core/intercept_filters_impl/cache/cache_allow.h"
+#include "components/core/intercept_filters_impl/cache/cache_deny.h"
+
+#include "talpa_uspace.h"
+
+static StandardInterceptProcessor*      mProcessor;
+static SyslogFilter*                    mDebugSyslog;
+static DenySyslogFilter*                mDenySyslog;
+static AllowSyslogFilter*               mAllowSyslog;
+static FilesystemInclusionProcessor*    mInclusion;
+static FilesystemExclusionProcessor*    mExclusion;
+static OperationExclusionProcessor*     mOpExcl;
+static ProcessExclusionProcessor*       mProcExcl;
+static DegradedModeProcessor*           mDegrMode;
+static VettingController*               mVetCtrl;
+static Cache*                           mCache;
+static CacheEval*                       mCacheEval;
+static CacheAllow*                      mCacheAllow;
+static CacheDeny*                       mCacheDeny;
+
+static IConfigurable*                   mConfigurables[12];
+
+
+IInterceptProcessor* talpa_uspace_processor(void)
+{
+    return &mProcessor->i_IInterceptProcessor;
+}
+
+IVettingServer* talpa_uspace_vetting_server(void)
+{
+    return &mVetCtrl->i_IVettingServer;
+}
+
+ICache* talpa_uspace_cache(void)
+{
+    return &mCache->i_ICache;
+}
+
+IConfigurable* talpa_uspace_configurable(const char* name)
+{
+    unsigned int i;
+
+
+    for ( i = 0; i < sizeof(mConfigurables) / sizeof(mConfigurables[0]) && mConfigurables[i]; i++ )
+    {
+        if ( !strcmp(mConfigurables[i]->name(mConfigurables[i]->object), name) )
+        {
+            return mConfigurables[i];
+        }
+    }
+
+    return NULL;
+}
+
+#define DELETE_IF_SET(obj) \
+if ( obj ) \
+{ \
+    obj->delete(obj); \
+    obj = NULL; \
+}
+
+static void deleteGlobals(void)
+{
+    memset(mConfigurables, 0, sizeof(mConfigurables));
+
+    DELETE_IF_SET(mDegrMode);
+    DELETE_IF_SET(mProcExcl);
+    DELETE_IF_SET(mVetCtrl);
+    DELETE_IF_SET(mOpExcl);
+    DELETE_IF_SET(mCacheEval);
+    DELETE_IF_SET(mCacheAllow);
+    DELETE_IF_SET(mCacheDeny);
+    DELETE_IF_SET(mCache);
+    DELETE_IF_SET(mExclusion);
+    DELETE_IF_SET(mInclusion);
+    DELETE_IF_SET(mDebugSyslog);
+    DELETE_IF_SET(mDenySyslog);
+    DELETE_IF_SET(mAllowSyslog);
+    DELETE_IF_SET(mProcessor);
+}
+
+#define CREATE_OR_FAIL(obj, creator) \
+{ \
+    obj = creator; \
+    if ( !obj ) \
+    { \
+        err("Failed to create %s!", #obj); \
+        goto failed; \
+    } \
+}
+
+int talpa_uspace_init(void)
+{
+    unsigned int i = 0;
+
+
+    CREATE_OR_FAIL(mProcessor, newStandardInterceptProcessor());
+    CREATE_OR_FAIL(mVetCtrl, newVettingController());
+    CREATE_OR_FAIL(mInclusion, newFilesystemInclusionProcessor());
+    CREATE_OR_FAIL(mExclusion, newFilesystemExclusionProcessor());
+    CREATE_OR_FAIL(mDebugSyslog, newSyslogFilter("DebugSyslog"));
+    CREATE_OR_FAIL(mDenySyslog, newDenySyslogFilter("DenySyslog"));
+    CREATE_OR_FAIL(mAllowSyslog, newAllowSyslogFilter("AllowSyslog"));
+    CREATE_OR_FAIL(mOpExcl, newOperationExclusionProcessor());
+    CREATE_OR_FAIL(mCache, newCache());
+    CREATE_OR_FAIL(mCacheEval, newCacheEval(&mCache->i_ICache));
+    CREATE_OR_FAIL(mCacheAllow, newCacheAllow(&mCache->i_ICache));
+    CREATE_OR_FAIL(mCacheDeny, newCacheDeny(&mCache->i_ICache));
+    CREATE_OR_FAIL(mProcExcl, newProcessExclusionProcessor());
+    CREATE_OR_FAIL(mDegrMode, newDegradedModeProcessor());
+
+    mExclusion->i_IConfigurable.set(mExclusion, "fstypes", "+proc");
+    mExclusion->i_IConfigurable.set(mExclusion, "mount-fstypes", "+proc");
+    mExclusion->i_IConfigurable.set(mExclusion, "fstypes", "+sysfs");
+    mExclusion->i_IConfigurable.set(mExclusion, "mount-fstypes", "+sysfs");
+
+    mConfigurables[i++] = &mProcessor->i_IConfigurable;
+    mConfigurables[i++] = &mDegrMode->i_IConfigurable;
+    mConfigurables[i++] = &mProcExcl->i_IConfigurable;
+    mConfigurables[i++] = &mVetCtrl->i_IConfigurable;
+    mConfigurables[i++] = &mInclusion->i_IConfigurable;
+    mConfigurables[i++] = &mExclusion->i_IConfigurable;
+    mConfigurables[i++] = &mOpExcl->i_IConfigurable;
+    mConfigurables[i++] = &mDebugSyslog->i_IConfigurable;
+    mConfigurables[i++] = &mDenySyslog->i_IConfigurable;
+    mConfigurables[i++] = &mAllowSyslog->i_IConfigurable;
+    mConfigurables[i++] = &mCache->i_IConfigurable;
+
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mOpExcl->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mInclusion->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mExclusion->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mCacheEval->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mDebugSyslog->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mProcExcl->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mDegrMode->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addEvaluationFilter(mProcessor, &mVetCtrl->i_IInterceptFilter);
+
+    mProcessor->i_IInterceptProcessor.addAllowFilter(mProcessor, &mCacheAllow->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addAllowFilter(mProcessor, &mAllowSyslog->i_IInterceptFilter);
+
+    mProcessor->i_IInterceptProcessor.addDenyFilter(mProcessor, &mCacheDeny->i_IInterceptFilter);
+    mProcessor->i_IInterceptProcessor.addDenyFilter(mProcessor, &mDenySyslog->i_IInterceptFilter);
+
+    return 0;
+
+    failed:
+    deleteGlobals();
+
+    return -ENOMEM;
+}
+
+void talpa_uspace_exit(void)
+{
+    if ( mProcessor )
+    {
+        mProcessor->i_IInterceptProcessor.resetEvaluationFilters(mProcessor);
+        mProcessor->i_IInterceptProcessor.resetAllowFilters(mProcessor);
+        mProcessor->i_IInterceptProcessor.resetDenyFilters(mProcessor);
+    }
+
+    deleteGlobals();
+}
+
+/*
+ * End of core.c
+ */
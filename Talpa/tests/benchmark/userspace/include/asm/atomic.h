@@ -0,0 +1,67 @@
+/*
+ * atomic.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_USPACE_ATOMIC
+#define H_USPACE_ATOMIC
+
+/*
+ * Kernel atomics over the compiler builtins. As in the kernel, plain reads
+ * and sets are unordered and read-modify-write operations are full barriers.
+ */
+
+typedef struct
+{
+    int counter;
+} atomic_t;
+
+#define ATOMIC_INIT(i)          { (i) }
+
+#define atomic_read(v)          __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_set(v, i)        __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+
+#define atomic_add(i, v)        ((void)__atomic_add_fetch(&(v)->counter, (i), __ATOMIC_SEQ_CST))
+#define atomic_sub(i, v)        ((void)__atomic_sub_fetch(&(v)->counter, (i), __ATOMIC_SEQ_CST))
+#define atomic_inc(v)           atomic_add(1, v)
+#define atomic_dec(v)           atomic_sub(1, v)
+
+#define atomic_add_return(i, v) __atomic_add_fetch(&(v)->counter, (i), __ATOMIC_SEQ_CST)
+#define atomic_sub_return(i, v) __atomic_sub_fetch(&(v)->counter, (i), __ATOMIC_SEQ_CST)
+#define atomic_inc_return(v)    atomic_add_return(1, v)
+#define atomic_dec_return(v)    atomic_sub_return(1, v)
+
+#define atomic_inc_and_test(v)  (atomic_inc_return(v) == 0)
+#define atomic_dec_and_test(v)  (atomic_dec_return(v) == 0)
+
+static inline int atomic_cmpxchg(atomic_t* v, int old, int new)
+{
+    __atomic_compare_exchange_n(&v->counter, &old, new, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+    return old;
+}
+
+#define atomic_xchg(v, i)       __atomic_exchange_n(&(v)->counter, (i), __ATOMIC_SEQ_CST)
+
+#define smp_mb()                __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_rmb()               __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb()               __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#endif
+
+/*
+ * End of atomic.h
+ */
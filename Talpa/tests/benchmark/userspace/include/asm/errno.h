@@ -0,0 +1,34 @@
+/*
+ * errno.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_USPACE_ASMERRNO
+#define H_USPACE_ASMERRNO
+
+/* System headers include this one too */
+#include_next <asm/errno.h>
+
+#include <errno.h>
+
+/* Kernel internal, never seen by userspace */
+#define ERESTARTSYS     (512)
+
+#endif
+
+/*
+ * End of errno.h
+ */
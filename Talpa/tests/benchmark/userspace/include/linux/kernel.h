@@ -0,0 +1,76 @@
+/*
+ * kernel.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_USPACE_KERNEL
+#define H_USPACE_KERNEL
+
+/*
+ * Stand-in for the handful of kernel headers the core components include
+ * directly. Everything else the components need comes from the platform
+ * headers, which are either used as they are or replaced next door.
+ */
+
+/* System headers include this one too */
+#include_next <linux/kernel.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <errno.h>
+
+#include <linux/types.h>
+#include <linux/version.h>
+
+#define KERN_EMERG      "\0010"
+#define KERN_ALERT      "\0011"
+#define KERN_CRIT       "\0012"
+#define KERN_ERR        "\0013"
+#define KERN_WARNING    "\0014"
+#define KERN_NOTICE     "\0015"
+#define KERN_INFO       "\0016"
+#define KERN_DEBUG      "\0017"
+
+/* Messages above this level are dropped, the default keeps warnings and worse */
+extern int talpa_uspace_loglevel;
+
+int printk(const char* fmt, ...) __attribute__ ((format (printf, 1, 2)));
+
+#ifndef likely
+#define likely(x)       __builtin_expect(!!(x), 1)
+#endif
+
+#ifndef unlikely
+#define unlikely(x)     __builtin_expect(!!(x), 0)
+#endif
+
+#define simple_strtoul  strtoul
+#define simple_strtol   strtol
+
+#ifndef container_of
+#define container_of(ptr, type, member) ({                      \
+        const typeof( ((type *)0)->member ) *__mptr = (ptr);    \
+        (type *)( (char *)__mptr - offsetof(type,member) );})
+#endif
+
+#endif
+
+/*
+ * End of kernel.h
+ */
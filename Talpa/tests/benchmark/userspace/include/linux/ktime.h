@@ -0,0 +1,44 @@
+/*
+ * ktime.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_USPACE_KTIME
+#define H_USPACE_KTIME
+
+#include <time.h>
+
+#include <linux/types.h>
+
+typedef int64_t ktime_t;
+
+static inline ktime_t ktime_get(void)
+{
+    struct timespec ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ktime_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#define ktime_to_ns(kt)     ((int64_t)(kt))
+
+#endif
+
+/*
+ * End of ktime.h
+ */
@@ -0,0 +1,58 @@
+/*
+ * sched.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_USPACE_SCHED
+#define H_USPACE_SCHED
+
+#include <sched.h>
+
+#include <linux/kernel.h>
+
+/*
+ * Every thread is a task. Components only look at identities and flags,
+ * and only ever through current or pointers obtained from it.
+ */
+#define TASK_COMM_LEN   (16)
+#define PF_EXITING      (0x00000004)
+
+struct files_struct;
+
+struct task_struct
+{
+    pid_t               pid;
+    pid_t               tgid;
+    unsigned int        flags;
+    uid_t               uid;
+    uid_t               euid;
+    uid_t               fsuid;
+    gid_t               gid;
+    gid_t               egid;
+    char                comm[TASK_COMM_LEN];
+    struct files_struct* files;
+    struct task_struct* parent;
+};
+
+struct task_struct* talpa_uspace_current(void);
+
+#define current     (talpa_uspace_current())
+
+#endif
+
+/*
+ * End of sched.h
+ */
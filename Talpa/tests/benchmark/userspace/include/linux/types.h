@@ -0,0 +1,35 @@
+/*
+ * types.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_USPACE_TYPES
+#define H_USPACE_TYPES
+
+/* System headers include this one too, and it brings the __u32 style types */
+#include_next <linux/types.h>
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <stdint.h>
+
+#define __user
+
+#endif
+
+/*
+ * End of types.h
+ */
@@ -0,0 +1,31 @@
+/*
+ * version.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_USPACE_VERSION
+#define H_USPACE_VERSION
+
+#define KERNEL_VERSION(a,b,c)   (((a) << 16) + ((b) << 8) + (c))
+
+/* Recent enough that the platform headers pick their modern branches */
+#define LINUX_VERSION_CODE      KERNEL_VERSION(5,4,0)
+
+#endif
+
+/*
+ * End of version.h
+ */
@@ -0,0 +1,90 @@
+/*
+ * alloc.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_ALLOC
+#define H_ALLOC
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform/compiler.h"
+
+#ifndef PAGE_SIZE
+#define PAGE_SIZE   (4096UL)
+#endif
+
+
+static inline void *talpa_alloc(size_t bytes)
+{
+    return malloc(bytes);
+}
+
+static inline void *talpa_zalloc(size_t bytes)
+{
+    return calloc(1, bytes);
+}
+
+static inline void talpa_free(void *ptr)
+{
+    free(ptr);
+}
+
+static inline void *talpa_large_alloc(size_t bytes)
+{
+    return malloc(bytes);
+}
+
+static inline void talpa_large_free(void *ptr)
+{
+    free(ptr);
+}
+
+static inline char *talpa_alloc_path_order(unsigned int order, size_t *size)
+{
+    *size = PAGE_SIZE<<order;
+
+    return (char *)malloc(*size);
+}
+
+static inline void talpa_free_path_order(char *buf, unsigned int order)
+{
+    (void)order;
+    free(buf);
+}
+
+static inline char *talpa_alloc_path(size_t *size)
+{
+    *size = PAGE_SIZE;
+
+    return (char *)malloc(PAGE_SIZE);
+}
+
+static inline char *talpa_alloc_path_atomic(size_t *size)
+{
+    return talpa_alloc_path(size);
+}
+
+static inline void talpa_free_path(char *buf)
+{
+    free(buf);
+}
+
+#endif
+/*
+ * End of alloc.h
+ */
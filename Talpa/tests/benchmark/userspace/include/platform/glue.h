@@ -0,0 +1,73 @@
+/*
+ * glue.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXGLUE
+#define H_LINUXGLUE
+
+/*
+ * Only the helpers which make sense without a VFS. Anything needing
+ * dentries or mounts is left out so that components depending on
+ * them fail to build here rather than quietly doing something else.
+ */
+
+#include <fcntl.h>
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/sched.h>
+
+#include "platforms/linux/bool.h"
+#include "platform/compiler.h"
+
+#define HZ                      (1000)
+#define jiffies                 (talpa_uspace_jiffies())
+#define jiffies_to_msecs(x)     (x)
+#define msecs_to_jiffies(x)     (x)
+
+unsigned long talpa_uspace_jiffies(void);
+
+#define processParentPID(task) task->parent->pid
+
+#define current_uid()   (current->uid)
+#define current_euid()  (current->euid)
+#define current_gid()   (current->gid)
+#define current_egid()  (current->egid)
+#define current_fsuid() (current->fsuid)
+
+#define flags_to_writable(f)   ((f)&(O_WRONLY|O_RDWR|O_APPEND|O_CREAT|O_TRUNC)?true:false)
+
+typedef uid_t talpa_kuid_t;
+typedef gid_t talpa_kgid_t;
+
+static inline uid_t __talpa_kuid_val(talpa_kuid_t uid)
+{
+        return uid;
+}
+
+static inline gid_t __talpa_kgid_val(talpa_kgid_t gid)
+{
+        return gid;
+}
+
+#define TALPA_KUIDT_INIT(value) ((talpa_kuid_t) value )
+#define TALPA_KGIDT_INIT(value) ((talpa_kgid_t) value )
+
+#endif /* H_LINUXGLUE */
+/*
+ * End of glue.h
+ */
@@ -0,0 +1,162 @@
+/*
+ * list.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXLIST
+#define H_LINUXLIST
+
+#include <linux/kernel.h>
+
+/*
+ * Doubly linked lists with the same layout and semantics as the kernel's,
+ * plus RCU over the userspace implementation in platform.c. Readers cost a
+ * thread local store and a fence, so read side heavy code benchmarks much
+ * as it runs in the kernel. Callbacks run synchronously after a grace
+ * period, so there is nothing for talpa_rcu_barrier() to wait for.
+ */
+
+typedef struct talpa_list_head
+{
+    struct talpa_list_head* next;
+    struct talpa_list_head* prev;
+} talpa_list_head;
+
+#define TALPA_LIST_POISON1  ((talpa_list_head *)0x100)
+#define TALPA_LIST_POISON2  ((talpa_list_head *)0x200)
+
+#define TALPA_LIST_HEAD_INIT(name)  { &(name), &(name) }
+
+static inline void TALPA_INIT_LIST_HEAD(talpa_list_head* list)
+{
+    list->next = list;
+    list->prev = list;
+}
+
+static inline void __talpa_list_add(talpa_list_head* entry, talpa_list_head* prev, talpa_list_head* next)
+{
+    next->prev = entry;
+    entry->next = next;
+    entry->prev = prev;
+    prev->next = entry;
+}
+
+static inline void __talpa_list_add_rcu(talpa_list_head* entry, talpa_list_head* prev, talpa_list_head* next)
+{
+    entry->next = next;
+    entry->prev = prev;
+    __atomic_store_n(&prev->next, entry, __ATOMIC_RELEASE);
+    next->prev = entry;
+}
+
+static inline void __talpa_list_del(talpa_list_head* prev, talpa_list_head* next)
+{
+    next->prev = prev;
+    __atomic_store_n(&prev->next, next, __ATOMIC_RELEASE);
+}
+
+#define talpa_list_add(entry, head)         __talpa_list_add((entry), (head), (head)->next)
+#define talpa_list_add_tail(entry, head)    __talpa_list_add((entry), (head)->prev, (head))
+#define talpa_list_add_rcu(entry, head)     __talpa_list_add_rcu((entry), (head), (head)->next)
+#define talpa_list_add_tail_rcu(entry, head) __talpa_list_add_rcu((entry), (head)->prev, (head))
+
+static inline void talpa_list_del(talpa_list_head* entry)
+{
+    __talpa_list_del(entry->prev, entry->next);
+    entry->next = TALPA_LIST_POISON1;
+    entry->prev = TALPA_LIST_POISON2;
+}
+
+/* Readers may still be walking through the entry, so next is left alone */
+static inline void talpa_list_del_rcu(talpa_list_head* entry)
+{
+    __talpa_list_del(entry->prev, entry->next);
+    entry->prev = TALPA_LIST_POISON2;
+}
+
+static inline void talpa_list_move(talpa_list_head* entry, talpa_list_head* head)
+{
+    __talpa_list_del(entry->prev, entry->next);
+    talpa_list_add(entry, head);
+}
+
+static inline int talpa_list_empty(const talpa_list_head* head)
+{
+    return __atomic_load_n(&head->next, __ATOMIC_RELAXED) == head;
+}
+
+#define talpa_list_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define talpa_list_for_each(pos, head) \
+    for (pos = (head)->next; pos != (head); pos = pos->next)
+
+#define talpa_list_for_each_safe(pos, n, head) \
+    for (pos = (head)->next, n = pos->next; pos != (head); \
+        pos = n, n = pos->next)
+
+#define talpa_list_for_each_entry(pos, head, member) \
+    for (pos = talpa_list_entry((head)->next, typeof(*pos), member); \
+         &pos->member != (head); \
+         pos = talpa_list_entry(pos->member.next, typeof(*pos), member))
+
+#define talpa_list_for_each_entry_safe(pos, n, head, member) \
+    for (pos = talpa_list_entry((head)->next, typeof(*pos), member), \
+        n = talpa_list_entry(pos->member.next, typeof(*pos), member); \
+         &pos->member != (head); \
+         pos = n, n = talpa_list_entry(n->member.next, typeof(*n), member))
+
+#define __talpa_rcu_next(p)     __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+#define talpa_list_for_each_rcu(pos, head) \
+    for (pos = __talpa_rcu_next((head)->next); pos != (head); pos = __talpa_rcu_next(pos->next))
+
+#define talpa_list_for_each_safe_rcu(pos, n, head) \
+    for (pos = __talpa_rcu_next((head)->next), n = __talpa_rcu_next(pos->next); pos != (head); \
+        pos = n, n = __talpa_rcu_next(pos->next))
+
+#define talpa_list_for_each_entry_rcu(pos, head, member) \
+    for (pos = talpa_list_entry(__talpa_rcu_next((head)->next), typeof(*pos), member); \
+         &pos->member != (head); \
+         pos = talpa_list_entry(__talpa_rcu_next(pos->member.next), typeof(*pos), member))
+
+#define talpa_list_for_each_continue_rcu(pos, head) \
+    for ((pos) = __talpa_rcu_next((pos)->next); (pos) != (head); (pos) = __talpa_rcu_next((pos)->next))
+
+
+typedef struct talpa_rcu_head
+{
+    struct talpa_rcu_head*  next;
+    void                    (*func)(struct talpa_rcu_head* head);
+} talpa_rcu_head;
+
+void talpa_uspace_rcu_read_lock(void);
+void talpa_uspace_rcu_read_unlock(void);
+void talpa_uspace_rcu_synchronize(void);
+
+#define TALPA_RCU_INIT              { NULL, NULL }
+#define talpa_rcu_init(x)           do { } while(0)
+#define talpa_rcu_call(head, func)  do { talpa_uspace_rcu_synchronize(); (func)(head); } while(0)
+
+#define talpa_rcu_dereference(p)        __atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define talpa_rcu_assign_pointer(p, v)  __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define talpa_rcu_synchronize           talpa_uspace_rcu_synchronize
+#define talpa_rcu_barrier()             do { } while(0)
+
+#endif
+
+/*
+ * End of list.h
+ */
@@ -0,0 +1,253 @@
+/*
+ * locking.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXLOCKING
+#define H_LINUXLOCKING
+
+/*
+ * The talpa_* lock wrappers over pthreads. Spinlocks become mutexes since
+ * userspace threads can be preempted while holding them, and the RCU read
+ * side is the one from list.h.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <linux/kernel.h>
+#include <asm/atomic.h>
+
+#include "platform/list.h"
+#ifdef TALPA_LOCK_STATS
+#include "platform/latency.h"
+#endif
+
+typedef pthread_mutex_t talpa_mutex_t;
+
+#define TALPA_DEFINE_MUTEX(x)   pthread_mutex_t x = PTHREAD_MUTEX_INITIALIZER
+#define TALPA_MUTEX_INIT        PTHREAD_MUTEX_INITIALIZER
+#define TALPA_STATIC_MUTEX(x)   PTHREAD_MUTEX_INITIALIZER
+#define talpa_mutex_init(m)     pthread_mutex_init((m), NULL)
+#define talpa_mutex_lock        pthread_mutex_lock
+#define talpa_mutex_unlock      pthread_mutex_unlock
+
+#ifndef TALPA_LOCK_STATS
+
+typedef pthread_mutex_t talpa_simple_lock_t;
+
+#define TALPA_SIMPLE_UNLOCKED(lockname)   PTHREAD_MUTEX_INITIALIZER
+
+#define talpa_simple_init(l)    pthread_mutex_init((l), NULL)
+#define talpa_simple_lock       pthread_mutex_lock
+#define talpa_simple_unlock     pthread_mutex_unlock
+
+typedef pthread_rwlock_t talpa_rw_lock_t;
+
+#define TALPA_RW_UNLOCKED(lockname)   PTHREAD_RWLOCK_INITIALIZER
+
+#define talpa_rw_init(l)    pthread_rwlock_init((l), NULL)
+#define talpa_read_lock     pthread_rwlock_rdlock
+#define talpa_read_unlock   pthread_rwlock_unlock
+#define talpa_write_lock    pthread_rwlock_wrlock
+#define talpa_write_unlock  pthread_rwlock_unlock
+
+typedef pthread_mutex_t talpa_rcu_lock_t;
+
+#define TALPA_RCU_UNLOCKED(lockname)      PTHREAD_MUTEX_INITIALIZER
+#define talpa_rcu_lock_init(l)      pthread_mutex_init((l), NULL)
+#define talpa_rcu_read_lock(l)      talpa_uspace_rcu_read_lock()
+#define talpa_rcu_read_unlock(l)    talpa_uspace_rcu_read_unlock()
+#define talpa_rcu_write_lock        pthread_mutex_lock
+#define talpa_rcu_write_unlock      pthread_mutex_unlock
+
+#define talpa_lock_stats_name(l, name)                  do { } while (0)
+#define talpa_lock_stats_name_index(l, name, index)     do { } while (0)
+#define talpa_lock_stats_release(l)                     do { } while (0)
+
+#else /* TALPA_LOCK_STATS */
+
+struct talpa_lock_stats;
+
+typedef struct
+{
+    pthread_mutex_t             raw;
+    struct talpa_lock_stats*    stats;
+} talpa_simple_lock_t;
+
+#define TALPA_SIMPLE_UNLOCKED(lockname)   { PTHREAD_MUTEX_INITIALIZER, NULL }
+
+#define __talpa_mutex_trylock(m)    (pthread_mutex_trylock(m) == 0)
+#define __talpa_rdlock_trylock(m)   (pthread_rwlock_tryrdlock(m) == 0)
+#define __talpa_wrlock_trylock(m)   (pthread_rwlock_trywrlock(m) == 0)
+
+#define talpa_simple_init(l)    do { pthread_mutex_init(&(l)->raw, NULL); (l)->stats = NULL; } while (0)
+#define talpa_simple_lock(l)    talpa_lock_stats_acquire(l, __talpa_mutex_trylock, pthread_mutex_lock, ELKS_Acquired)
+#define talpa_simple_unlock(l)  pthread_mutex_unlock(&(l)->raw)
+
+typedef struct
+{
+    pthread_rwlock_t            raw;
+    struct talpa_lock_stats*    stats;
+} talpa_rw_lock_t;
+
+#define TALPA_RW_UNLOCKED(lockname)   { PTHREAD_RWLOCK_INITIALIZER, NULL }
+
+#define talpa_rw_init(l)        do { pthread_rwlock_init(&(l)->raw, NULL); (l)->stats = NULL; } while (0)
+#define talpa_read_lock(l)      talpa_lock_stats_acquire(l, __talpa_rdlock_trylock, pthread_rwlock_rdlock, ELKS_ReadAcquired)
+#define talpa_read_unlock(l)    pthread_rwlock_unlock(&(l)->raw)
+#define talpa_write_lock(l)     talpa_lock_stats_acquire(l, __talpa_wrlock_trylock, pthread_rwlock_wrlock, ELKS_Acquired)
+#define talpa_write_unlock(l)   pthread_rwlock_unlock(&(l)->raw)
+
+typedef talpa_simple_lock_t talpa_rcu_lock_t;
+
+#define TALPA_RCU_UNLOCKED(lockname)      TALPA_SIMPLE_UNLOCKED(lockname)
+#define talpa_rcu_lock_init         talpa_simple_init
+#define talpa_rcu_read_lock(l)      talpa_uspace_rcu_read_lock()
+#define talpa_rcu_read_unlock(l)    talpa_uspace_rcu_read_unlock()
+#define talpa_rcu_write_lock        talpa_simple_lock
+#define talpa_rcu_write_unlock      talpa_simple_unlock
+
+#define talpa_lock_stats_acquire(l, trylock, lock, side) \
+do \
+{ \
+    struct talpa_lock_stats* __stats = (l)->stats; \
+    uint64_t __start; \
+    if ( likely(!__stats) ) \
+    { \
+        lock(&(l)->raw); \
+    } \
+    else if ( trylock(&(l)->raw) ) \
+    { \
+        talpa_pcpu_stats_add(&__stats->counters, (side), 1); \
+    } \
+    else \
+    { \
+        __start = talpa_latency_clock(); \
+        lock(&(l)->raw); \
+        talpa_lock_stats_waited(__stats, (side), __start); \
+    } \
+} while (0)
+
+#define talpa_lock_stats_name(l, name)                  ((l)->stats = talpa_lock_stats_create((name), -1))
+#define talpa_lock_stats_name_index(l, name, index)     ((l)->stats = talpa_lock_stats_create((name), (index)))
+#define talpa_lock_stats_release(l) \
+do \
+{ \
+    talpa_lock_stats_delete((l)->stats); \
+    (l)->stats = NULL; \
+} while (0)
+
+#endif /* TALPA_LOCK_STATS */
+
+#define talpa_lock_kernel       smp_mb
+#define talpa_unlock_kernel     smp_mb
+
+typedef struct
+{
+    atomic_t        count;
+} talpa_pcpu_ref_t;
+
+#define TALPA_PCPU_REF_INIT     { ATOMIC_INIT(0) }
+
+static inline int talpa_pcpu_ref_init(talpa_pcpu_ref_t* ref)
+{
+    atomic_set(&ref->count, 0);
+
+    return 0;
+}
+
+#define talpa_pcpu_ref_destroy(ref) do { } while (0)
+#define talpa_pcpu_ref_get(ref)     atomic_inc(&(ref)->count)
+#define talpa_pcpu_ref_put(ref)     atomic_dec(&(ref)->count)
+#define talpa_pcpu_ref_sum(ref)     ((long)atomic_read(&(ref)->count))
+
+typedef struct
+{
+    uint64_t*       count;
+    unsigned int    num;
+} talpa_pcpu_stats_t;
+
+static inline int talpa_pcpu_stats_init(talpa_pcpu_stats_t* stats, unsigned int num)
+{
+    stats->count = (uint64_t *)calloc(num, sizeof(uint64_t));
+    stats->num = num;
+
+    return stats->count ? 0 : -ENOMEM;
+}
+
+static inline void talpa_pcpu_stats_destroy(talpa_pcpu_stats_t* stats)
+{
+    free(stats->count);
+    stats->count = NULL;
+}
+
+#define talpa_pcpu_stats_add(stats, idx, val)   __atomic_add_fetch(&(stats)->count[idx], (val), __ATOMIC_RELAXED)
+#define talpa_pcpu_stats_local(stats, idx)      __atomic_load_n(&(stats)->count[idx], __ATOMIC_RELAXED)
+#define talpa_pcpu_stats_sum                    talpa_pcpu_stats_local
+
+static inline void talpa_pcpu_stats_reset(talpa_pcpu_stats_t* stats)
+{
+    unsigned int i;
+
+
+    for ( i = 0; i < stats->num; i++ )
+    {
+        __atomic_store_n(&stats->count[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+#ifdef TALPA_LOCK_STATS
+
+typedef enum
+{
+    ELKS_Acquired = 0,
+    ELKS_Contended,
+    ELKS_Wait,
+    ELKS_ReadAcquired,
+    ELKS_ReadContended,
+    ELKS_ReadWait,
+    ELKS_Max
+} ETalpaLockStat;
+
+#define TALPA_LOCK_STATS_NAMESIZE   (32)
+
+struct talpa_lock_stats
+{
+    talpa_list_head     head;
+    char                name[TALPA_LOCK_STATS_NAMESIZE];
+    talpa_pcpu_stats_t  counters;
+};
+
+struct talpa_lock_stats* talpa_lock_stats_create(const char* name, int index);
+void talpa_lock_stats_delete(struct talpa_lock_stats* stats);
+void talpa_lock_stats_format(char* buf, size_t size);
+void talpa_lock_stats_reset(void);
+
+static inline void talpa_lock_stats_waited(struct talpa_lock_stats* stats, unsigned int side, uint64_t start)
+{
+    talpa_pcpu_stats_add(&stats->counters, side, 1);
+    talpa_pcpu_stats_add(&stats->counters, side + ELKS_Contended, 1);
+    talpa_pcpu_stats_add(&stats->counters, side + ELKS_Wait, talpa_latency_clock() - start);
+}
+
+#endif /* TALPA_LOCK_STATS */
+
+#endif
+
+/*
+ * End of locking.h
+ */
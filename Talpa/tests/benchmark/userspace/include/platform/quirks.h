@@ -0,0 +1,33 @@
+/*
+ * quirks.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXQUIRKS
+#define H_LINUXQUIRKS
+
+#include "common/bool.h"
+
+/* The X server workaround is never needed without signals and timers */
+static inline void talpa_quirk_vc_sleep_init(bool* status) { };
+static inline void talpa_quirk_vc_pre_sleep(bool* status, unsigned int timeout_ms) { };
+static inline void talpa_quirk_vc_post_sleep(bool* status) { };
+
+#endif
+
+/*
+ * End of quirks.h
+ */
@@ -0,0 +1,45 @@
+/*
+ * uaccess.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXUACCESS
+#define H_LINUXUACCESS
+
+#include <string.h>
+
+#include <linux/types.h>
+
+/* User and kernel memory are the same thing here */
+static inline unsigned long copy_to_user(void __user* to, const void* from, unsigned long n)
+{
+    memcpy(to, from, n);
+
+    return 0;
+}
+
+static inline unsigned long copy_from_user(void* to, const void __user* from, unsigned long n)
+{
+    memcpy(to, from, n);
+
+    return 0;
+}
+
+#endif
+
+/*
+ * End of uaccess.h
+ */
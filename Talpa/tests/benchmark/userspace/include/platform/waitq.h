@@ -0,0 +1,162 @@
+/*
+ * waitq.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_LINUXWAITQ
+#define H_LINUXWAITQ
+
+/*
+ * Wait queues as a mutex and condition variable. Conditions are checked
+ * under the mutex and wake_up() takes it, so a waker which changes the
+ * condition before calling wake_up() cannot be missed. Exclusive waits
+ * wake everybody, who then recheck, and nothing here is interruptible.
+ * Timeouts are in jiffies, which are milliseconds here.
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include <linux/kernel.h>
+#include <asm/atomic.h>
+
+#define time_diff(start, end) \
+({ \
+    unsigned long diff; \
+\
+    if ( end >= start ) { \
+        diff = end - start; \
+    } else { \
+        diff = end + (~0UL - start); \
+    } \
+\
+    diff; \
+})
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+} wait_queue_head_t;
+
+static inline void init_waitqueue_head(wait_queue_head_t* wq)
+{
+    pthread_condattr_t attr;
+
+
+    pthread_mutex_init(&wq->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wq->cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static inline void wake_up(wait_queue_head_t* wq)
+{
+    pthread_mutex_lock(&wq->lock);
+    pthread_cond_broadcast(&wq->cond);
+    pthread_mutex_unlock(&wq->lock);
+}
+
+#define wake_up_interruptible   wake_up
+#define wake_up_all             wake_up
+
+static inline void __talpa_wait_deadline(struct timespec* until, unsigned long ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, until);
+    until->tv_sec += ms / 1000;
+    until->tv_nsec += (ms % 1000) * 1000000L;
+    if ( until->tv_nsec >= 1000000000L )
+    {
+        until->tv_sec++;
+        until->tv_nsec -= 1000000000L;
+    }
+}
+
+#define talpa_wait_event_timeout(wq, condition, timeout) \
+({ \
+    long __ret = 0; \
+    struct timespec __until; \
+\
+    __talpa_wait_deadline(&__until, (timeout)); \
+    pthread_mutex_lock(&(wq).lock); \
+    while ( !(condition) ) { \
+        if ( pthread_cond_timedwait(&(wq).cond, &(wq).lock, &__until) == ETIMEDOUT ) { \
+            __ret = (condition) ? 0 : -ETIME; \
+            break; \
+        } \
+    } \
+    pthread_mutex_unlock(&(wq).lock); \
+    __ret; \
+})
+
+#define talpa_wait_event(wq, condition) \
+({ \
+    pthread_mutex_lock(&(wq).lock); \
+    while ( !(condition) ) { \
+        pthread_cond_wait(&(wq).cond, &(wq).lock); \
+    } \
+    pthread_mutex_unlock(&(wq).lock); \
+    0L; \
+})
+
+#define talpa_wait_event_killable_timeout                   talpa_wait_event_timeout
+#define talpa_wait_event_interruptible_timeout              talpa_wait_event_timeout
+#define talpa_wait_event_interruptible_exclusive_timeout    talpa_wait_event_timeout
+#define talpa_wait_event_interruptible_exclusive            talpa_wait_event
+
+struct talpa_completion
+{
+    atomic_t            complete;
+    wait_queue_head_t   wait;
+};
+
+static inline void talpa_init_completion(struct talpa_completion *c)
+{
+    atomic_set(&c->complete, 0);
+    init_waitqueue_head(&c->wait);
+}
+
+static inline int talpa_wait_for_completion(struct talpa_completion *c)
+{
+    talpa_wait_event(c->wait, atomic_read(&c->complete));
+    atomic_dec(&c->complete);
+
+    return 0;
+}
+
+static inline long talpa_wait_for_completion_timeout(struct talpa_completion *c, unsigned long timeout)
+{
+    if ( talpa_wait_event_timeout(c->wait, atomic_read(&c->complete), timeout) < 0 )
+    {
+        return 0;
+    }
+    atomic_dec(&c->complete);
+
+    return 1;
+}
+
+static inline void talpa_complete(struct talpa_completion *c)
+{
+    atomic_inc(&c->complete);
+    wake_up(&c->wait);
+}
+
+#endif
+
+/*
+ * End of waitq.h
+ */
@@ -0,0 +1,472 @@
+/*
+ * platform.c
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Userspace implementations of what talpa_linux exports to the core:
+ * logging, tasks, RCU, the filesystem type registry, latency histograms,
+ * capture and the verdict generation.
+ */
+
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+#include <linux/utsname.h>
+
+#include "platform/list.h"
+#include "platform/locking.h"
+#include "platform/log.h"
+#include "platform/fstype.h"
+#include "platform/latency.h"
+#include "platform/capture.h"
+#include "platform/verdict.h"
+
+
+/*
+ * Logging
+ */
+int talpa_uspace_loglevel = 4;
+
+int printk(const char* fmt, ...)
+{
+    va_list ap;
+    int level = 4;
+    int ret;
+
+
+    if ( (fmt[0] == '\001') && (fmt[1] >= '0') && (fmt[1] <= '7') )
+    {
+        level = fmt[1] - '0';
+        fmt += 2;
+    }
+
+    if ( level > talpa_uspace_loglevel )
+    {
+        return 0;
+    }
+
+    va_start(ap, fmt);
+    ret = vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    return ret;
+}
+
+/*
+ * Tasks
+ *
+ * Each thread gets a task filled in from its own identity the first time it
+ * looks at current. Threads of one process share the files pointer, as they
+ * would share a file table in the kernel.
+ */
+static struct task_struct GL_parent;
+static pthread_once_t GL_parent_once = PTHREAD_ONCE_INIT;
+static __thread struct task_struct GL_task;
+static __thread bool GL_task_valid;
+
+static void parentInit(void)
+{
+    GL_parent.pid = getppid();
+    GL_parent.tgid = GL_parent.pid;
+}
+
+struct task_struct* talpa_uspace_current(void)
+{
+    if ( unlikely(!GL_task_valid) )
+    {
+        pthread_once(&GL_parent_once, parentInit);
+
+        GL_task.pid = syscall(SYS_gettid);
+        GL_task.tgid = getpid();
+        GL_task.uid = getuid();
+        GL_task.euid = geteuid();
+        GL_task.fsuid = GL_task.euid;
+        GL_task.gid = getgid();
+        GL_task.egid = getegid();
+        snprintf(GL_task.comm, sizeof(GL_task.comm), "uspace-%d", GL_task.pid);
+        GL_task.files = (struct files_struct *)&GL_parent;
+        GL_task.parent = &GL_parent;
+        GL_task_valid = true;
+    }
+
+    return &GL_task;
+}
+
+unsigned long talpa_uspace_jiffies(void)
+{
+    struct timespec now;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static struct new_utsname GL_uts;
+static pthread_once_t GL_uts_once = PTHREAD_ONCE_INIT;
+
+static void utsInit(void)
+{
+    gethostname(GL_uts.nodename, sizeof(GL_uts.nodename) - 1);
+}
+
+struct new_utsname* utsname(void)
+{
+    pthread_once(&GL_uts_once, utsInit);
+
+    return &GL_uts;
+}
+
+/*
+ * RCU
+ *
+ * Each reading thread publishes the grace period it entered its outermost
+ * read side section in, or zero when outside. A grace period starts a new
+ * one and waits for every thread still showing an older one, which means
+ * all of them have been outside a read side section at some point since.
+ * Threads register on first use and are forgotten when they exit.
+ */
+struct rcuReader
+{
+    unsigned long       period;
+    unsigned int        nesting;
+    struct rcuReader*   next;
+};
+
+static pthread_mutex_t      GL_rcu_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long        GL_rcu_period = 1;
+static struct rcuReader*    GL_rcu_readers;
+static pthread_key_t        GL_rcu_key;
+static pthread_once_t       GL_rcu_once = PTHREAD_ONCE_INIT;
+static __thread struct rcuReader* GL_rcu_self;
+
+
+static void rcuForget(void* data)
+{
+    struct rcuReader* reader = (struct rcuReader *)data;
+    struct rcuReader** pos;
+
+
+    pthread_mutex_lock(&GL_rcu_lock);
+    for ( pos = &GL_rcu_readers; *pos; pos = &(*pos)->next )
+    {
+        if ( *pos == reader )
+        {
+            *pos = reader->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&GL_rcu_lock);
+
+    free(reader);
+}
+
+static void rcuInit(void)
+{
+    pthread_key_create(&GL_rcu_key, rcuForget);
+}
+
+static struct rcuReader* rcuRegister(void)
+{
+    struct rcuReader* reader;
+
+
+    pthread_once(&GL_rcu_once, rcuInit);
+
+    reader = calloc(1, sizeof(struct rcuReader));
+    if ( !reader )
+    {
+        abort();
+    }
+
+    pthread_mutex_lock(&GL_rcu_lock);
+    reader->next = GL_rcu_readers;
+    GL_rcu_readers = reader;
+    pthread_mutex_unlock(&GL_rcu_lock);
+
+    pthread_setspecific(GL_rcu_key, reader);
+    GL_rcu_self = reader;
+
+    return reader;
+}
+
+void talpa_uspace_rcu_read_lock(void)
+{
+    struct rcuReader* reader = GL_rcu_self;
+
+
+    if ( unlikely(!reader) )
+    {
+        reader = rcuRegister();
+    }
+
+    if ( reader->nesting++ == 0 )
+    {
+        __atomic_store_n(&reader->period, __atomic_load_n(&GL_rcu_period, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+void talpa_uspace_rcu_read_unlock(void)
+{
+    struct rcuReader* reader = GL_rcu_self;
+
+
+    if ( --reader->nesting == 0 )
+    {
+        __atomic_store_n(&reader->period, 0, __ATOMIC_RELEASE);
+    }
+}
+
+void talpa_uspace_rcu_synchronize(void)
+{
+    struct rcuReader* reader;
+    unsigned long period;
+    unsigned long seen;
+
+
+    pthread_mutex_lock(&GL_rcu_lock);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    period = __atomic_add_fetch(&GL_rcu_period, 1, __ATOMIC_SEQ_CST);
+
+    for ( reader = GL_rcu_readers; reader; reader = reader->next )
+    {
+        for ( ;; )
+        {
+            seen = __atomic_load_n(&reader->period, __ATOMIC_ACQUIRE);
+            if ( !seen || (seen == period) )
+            {
+                break;
+            }
+            sched_yield();
+        }
+    }
+
+    pthread_mutex_unlock(&GL_rcu_lock);
+}
+
+/*
+ * Filesystem type registry, by name only as there are no superblocks here.
+ */
+static pthread_mutex_t  GL_fstype_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int     GL_fstype_count = 1;    /* ID zero is TALPA_FSTYPE_NONE */
+static char             GL_fstype_names[TALPA_FSTYPE_MAX][TALPA_FSTYPE_NAMELEN];
+
+unsigned int talpa_fstype_intern(const char* name)
+{
+    unsigned int id;
+
+
+    if ( strlen(name) >= TALPA_FSTYPE_NAMELEN )
+    {
+        return TALPA_FSTYPE_NONE;
+    }
+
+    pthread_mutex_lock(&GL_fstype_lock);
+
+    for ( id = 1; id < GL_fstype_count; id++ )
+    {
+        if ( !strcmp(GL_fstype_names[id], name) )
+        {
+            break;
+        }
+    }
+
+    if ( id == GL_fstype_count )
+    {
+        if ( GL_fstype_count < TALPA_FSTYPE_MAX )
+        {
+            strcpy(GL_fstype_names[id], name);
+            __atomic_store_n(&GL_fstype_count, GL_fstype_count + 1, __ATOMIC_RELEASE);
+        }
+        else
+        {
+            id = TALPA_FSTYPE_NONE;
+        }
+    }
+
+    pthread_mutex_unlock(&GL_fstype_lock);
+
+    return id;
+}
+
+unsigned int talpa_fstype_find(const char* name)
+{
+    unsigned int count = __atomic_load_n(&GL_fstype_count, __ATOMIC_ACQUIRE);
+    unsigned int id;
+
+
+    for ( id = 1; id < count; id++ )
+    {
+        if ( !strcmp(GL_fstype_names[id], name) )
+        {
+            return id;
+        }
+    }
+
+    return TALPA_FSTYPE_NONE;
+}
+
+const char* talpa_fstype_name(unsigned int id)
+{
+    if ( (id == TALPA_FSTYPE_NONE) || (id >= __atomic_load_n(&GL_fstype_count, __ATOMIC_ACQUIRE)) )
+    {
+        return NULL;
+    }
+
+    return GL_fstype_names[id];
+}
+
+/*
+ * Latency histograms, shared by all threads.
+ */
+bool talpa_latency_enabled;
+
+static talpa_latency_hist_t GL_latency[ELS_Max];
+
+static inline unsigned int bucket(uint64_t ns)
+{
+    unsigned int b = ns ? 63 - __builtin_clzll(ns) : 0;
+
+
+    return (b < TALPA_LATENCY_BUCKETS) ? b : TALPA_LATENCY_BUCKETS - 1;
+}
+
+void talpa_latency_record(ETalpaLatencyStage stage, uint64_t start)
+{
+    uint64_t now;
+    uint64_t ns;
+
+
+    if ( !start )
+    {
+        return;
+    }
+
+    now = talpa_latency_clock();
+    ns = (now > start) ? now - start : 0;
+
+    __atomic_add_fetch(&GL_latency[stage].count[bucket(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&GL_latency[stage].total, ns, __ATOMIC_RELAXED);
+}
+
+void talpa_latency_read(ETalpaLatencyStage stage, talpa_latency_hist_t* hist)
+{
+    unsigned int b;
+
+
+    for ( b = 0; b < TALPA_LATENCY_BUCKETS; b++ )
+    {
+        hist->count[b] = __atomic_load_n(&GL_latency[stage].count[b], __ATOMIC_RELAXED);
+    }
+    hist->total = __atomic_load_n(&GL_latency[stage].total, __ATOMIC_RELAXED);
+}
+
+void talpa_latency_reset(ETalpaLatencyStage stage)
+{
+    memset(&GL_latency[stage], 0, sizeof(talpa_latency_hist_t));
+}
+
+void talpa_latency_enable(bool enable)
+{
+    talpa_latency_enabled = enable;
+}
+
+/*
+ * Verdict generation
+ */
+atomic_t talpa_verdict_generation = ATOMIC_INIT(0);
+
+/*
+ * Capture, written straight to talpa_uspace_capture_file in the order
+ * the records are made.
+ */
+bool talpa_capture_enabled;
+FILE* talpa_uspace_capture_file;
+
+static pthread_mutex_t GL_capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long GL_capture_lost;
+
+void talpa_capture_add(unsigned int event, unsigned int op, int flags, uint32_t device, uint32_t inode, uint32_t pathHash)
+{
+    struct TalpaCaptureRecord rec;
+
+
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp = talpa_latency_clock();
+    rec.device = device;
+    rec.inode = inode;
+    rec.pid = getpid();
+    rec.flags = flags;
+    rec.pathHash = pathHash;
+    rec.operation = op;
+    rec.event = event;
+
+    pthread_mutex_lock(&GL_capture_lock);
+    if ( !talpa_uspace_capture_file || fwrite(&rec, sizeof(rec), 1, talpa_uspace_capture_file) != 1 )
+    {
+        GL_capture_lost++;
+    }
+    pthread_mutex_unlock(&GL_capture_lock);
+}
+
+int talpa_capture_enable(bool enable)
+{
+    if ( enable && !talpa_uspace_capture_file )
+    {
+        return -ENODEV;
+    }
+
+    talpa_capture_enabled = enable;
+
+    return 0;
+}
+
+unsigned long talpa_capture_lost(void)
+{
+    unsigned long lost;
+
+
+    pthread_mutex_lock(&GL_capture_lock);
+    lost = GL_capture_lost;
+    pthread_mutex_unlock(&GL_capture_lock);
+
+    return lost;
+}
+
+int talpa_capture_init(void)
+{
+    return 0;
+}
+
+void talpa_capture_exit(void)
+{
+    talpa_capture_enabled = false;
+}
+
+/*
+ * End of platform.c
+ */
@@ -0,0 +1,783 @@
+/*
+ * services.c
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Stand-ins for the portability services which talpa_linux provides to
+ * the core. Personalities are the real ones, everything touching the VFS
+ * or the process is replaced by objects holding whatever they were given.
+ */
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+#include <linux/stat.h>
+
+#define TALPA_SUBSYS "uspace"
+#include "common/talpa.h"
+#include "platform/fstype.h"
+
+#include "components/services/linux_personality_impl/linux_personality_factoryimpl.h"
+
+#include "app_ctrl/iportability_app_ctrl.h"
+
+#include "talpa_uspace.h"
+
+loff_t talpa_uspace_file_length = 4096;
+
+
+/*
+ * IFileInfo
+ */
+typedef struct tag_UspaceFileInfo
+{
+    IFileInfo               i_IFileInfo;
+    void                    (*delete)(struct tag_UspaceFileInfo* object);
+    atomic_t                mRefCnt;
+    EFilesystemOperation    mOperation;
+    char*                   mFilename;
+    unsigned int            mFlags;
+    unsigned int            mMode;
+    unsigned long           mInode;
+    uint64_t                mDevice;
+    unsigned int            mFSTypeId;
+    char*                   mFSType;
+} UspaceFileInfo;
+
+static void fileInfoGet(const void* self);
+static EFilesystemOperation fileInfoOperation(const void* self);
+static const char* fileInfoFilename(const void* self);
+static unsigned int fileInfoFlags(const void* self);
+static unsigned int fileInfoMode(const void* self);
+static unsigned long fileInfoInode(const void* self);
+static bool fileInfoIsWritable(const void* self);
+static unsigned int fileInfoIsWritableAnywhere(const void* self);
+static uint64_t fileInfoDevice(const void* self);
+static uint32_t fileInfoDeviceMajor(const void* self);
+static uint32_t fileInfoDeviceMinor(const void* self);
+static const char* fileInfoDeviceName(const void* self);
+static const char* fileInfoFSType(const void* self);
+static unsigned int fileInfoFSTypeId(const void* self);
+static bool fileInfoFSObjects(const void* self, void** obj1, void** obj2);
+static bool fileInfoNo(const void* self);
+static bool fileInfoYes(const void* self);
+static void* fileInfoSharedFile(const void* self);
+static void deleteUspaceFileInfo(struct tag_UspaceFileInfo* object);
+
+static UspaceFileInfo template_UspaceFileInfo =
+    {
+        {
+            fileInfoGet,
+            fileInfoOperation,
+            fileInfoFilename,
+            fileInfoFlags,
+            fileInfoMode,
+            fileInfoInode,
+            fileInfoIsWritable,
+            fileInfoIsWritableAnywhere,
+            fileInfoDevice,
+            fileInfoDeviceMajor,
+            fileInfoDeviceMinor,
+            fileInfoDeviceName,
+            fileInfoFSType,
+            fileInfoFSTypeId,
+            fileInfoFSObjects,
+            fileInfoNo,
+            fileInfoNo,
+            fileInfoYes,
+            fileInfoSharedFile,
+            NULL,
+            (void (*)(const void*))deleteUspaceFileInfo
+        },
+        deleteUspaceFileInfo,
+        ATOMIC_INIT(1),
+        0,
+        NULL,
+        0,
+        S_IFREG | 0644,
+        0,
+        0,
+        TALPA_FSTYPE_NONE,
+        NULL
+    };
+#define this    ((UspaceFileInfo*)self)
+
+static UspaceFileInfo* newUspaceFileInfo(EFilesystemOperation operation, const char* filename, int flags, uint64_t device, unsigned long inode, const char* fstype)
+{
+    UspaceFileInfo* object;
+
+
+    object = talpa_alloc(sizeof(template_UspaceFileInfo));
+    if ( unlikely(object == NULL) )
+    {
+        return NULL;
+    }
+
+    memcpy(object, &template_UspaceFileInfo, sizeof(template_UspaceFileInfo));
+    object->i_IFileInfo.object = object;
+    object->mOperation = operation;
+    object->mFlags = flags;
+    object->mDevice = device;
+    object->mInode = inode;
+
+    if ( filename )
+    {
+        object->mFilename = talpa_alloc(strlen(filename) + 1);
+        if ( unlikely(object->mFilename == NULL) )
+        {
+            goto error;
+        }
+        strcpy(object->mFilename, filename);
+    }
+
+    if ( fstype )
+    {
+        object->mFSType = talpa_alloc(strlen(fstype) + 1);
+        if ( unlikely(object->mFSType == NULL) )
+        {
+            goto error;
+        }
+        strcpy(object->mFSType, fstype);
+        object->mFSTypeId = talpa_fstype_intern(fstype);
+    }
+
+    return object;
+
+    error:
+    talpa_free(object->mFilename);
+    talpa_free(object);
+
+    return NULL;
+}
+
+static void deleteUspaceFileInfo(struct tag_UspaceFileInfo* object)
+{
+    if ( atomic_dec_and_test(&object->mRefCnt) )
+    {
+        talpa_free(object->mFilename);
+        talpa_free(object->mFSType);
+        talpa_free(object);
+    }
+    return;
+}
+
+IFileInfo* talpa_uspace_fileinfo(EFilesystemOperation operation, const char* filename, int flags, uint64_t device, unsigned long inode, const char* fstype)
+{
+    UspaceFileInfo* object;
+
+
+    object = newUspaceFileInfo(operation, filename, flags, device, inode, fstype);
+
+    return object ? &object->i_IFileInfo : NULL;
+}
+
+static void fileInfoGet(const void* self)
+{
+    atomic_inc(&this->mRefCnt);
+    return;
+}
+
+static EFilesystemOperation fileInfoOperation(const void* self)
+{
+    return this->mOperation;
+}
+
+static const char* fileInfoFilename(const void* self)
+{
+    return this->mFilename;
+}
+
+static unsigned int fileInfoFlags(const void* self)
+{
+    return this->mFlags;
+}
+
+static unsigned int fileInfoMode(const void* self)
+{
+    return this->mMode;
+}
+
+static unsigned long fileInfoInode(const void* self)
+{
+    return this->mInode;
+}
+
+static bool fileInfoIsWritable(const void* self)
+{
+    return flags_to_writable(this->mFlags);
+}
+
+static unsigned int fileInfoIsWritableAnywhere(const void* self)
+{
+    return flags_to_writable(this->mFlags) ? 1 : 0;
+}
+
+static uint64_t fileInfoDevice(const void* self)
+{
+    return this->mDevice;
+}
+
+static uint32_t fileInfoDeviceMajor(const void* self)
+{
+    return this->mDevice >> 20;
+}
+
+static uint32_t fileInfoDeviceMinor(const void* self)
+{
+    return this->mDevice & ((1U << 20) - 1);
+}
+
+static const char* fileInfoDeviceName(const void* self)
+{
+    return NULL;
+}
+
+static const char* fileInfoFSType(const void* self)
+{
+    return this->mFSType;
+}
+
+static unsigned int fileInfoFSTypeId(const void* self)
+{
+    return this->mFSTypeId;
+}
+
+static bool fileInfoFSObjects(const void* self, void** obj1, void** obj2)
+{
+    return false;
+}
+
+static bool fileInfoNo(const void* self)
+{
+    return false;
+}
+
+static bool fileInfoYes(const void* self)
+{
+    return true;
+}
+
+static void* fileInfoSharedFile(const void* self)
+{
+    return NULL;
+}
+#undef this
+
+
+/*
+ * IFile
+ *
+ * Opening by name always works and the contents read back as zeroes.
+ */
+typedef struct tag_UspaceFile
+{
+    IFile                   i_IFile;
+    void                    (*delete)(struct tag_UspaceFile* object);
+    atomic_t                mRefCnt;
+    bool                    mOpen;
+    bool                    mWritable;
+    loff_t                  mLength;
+    loff_t                  mPosition;
+} UspaceFile;
+
+static void fileGet(void* self);
+static int fileOpen(void* self, const char* filename, unsigned int flags, bool check_permissions);
+static int fileOpenDentry(void* self, void* object1, void* object2, unsigned int flags, bool check_permissions);
+static int fileOpenExec(void* self, const char* filename);
+static bool fileIsOpen(const void* self);
+static bool fileIsWritable(const void* self);
+static int fileClose(void* self);
+static loff_t fileLength(const void* self);
+static loff_t fileSeek(void* self, loff_t offset, int whence);
+static ssize_t fileRead(void* self, void* data, size_t count);
+static ssize_t fileWrite(void* self, const void* data, size_t count);
+static int fileUnlink(void* self);
+static int fileTruncate(void* self, loff_t length);
+static void deleteUspaceFile(struct tag_UspaceFile* object);
+
+static UspaceFile template_UspaceFile =
+    {
+        {
+            fileGet,
+            fileOpen,
+            fileOpenDentry,
+            fileOpenExec,
+            fileIsOpen,
+            fileIsWritable,
+            fileClose,
+            fileLength,
+            fileSeek,
+            fileRead,
+            fileWrite,
+            fileUnlink,
+            fileTruncate,
+            NULL,
+            (void (*)(void*))deleteUspaceFile
+        },
+        deleteUspaceFile,
+        ATOMIC_INIT(1),
+        false,
+        false,
+        0,
+        0
+    };
+#define this    ((UspaceFile*)self)
+
+static UspaceFile* newUspaceFile(void)
+{
+    UspaceFile* object;
+
+
+    object = talpa_alloc(sizeof(template_UspaceFile));
+    if ( likely(object != NULL) )
+    {
+        memcpy(object, &template_UspaceFile, sizeof(template_UspaceFile));
+        object->i_IFile.object = object;
+    }
+
+    return object;
+}
+
+static void deleteUspaceFile(struct tag_UspaceFile* object)
+{
+    if ( atomic_dec_and_test(&object->mRefCnt) )
+    {
+        talpa_free(object);
+    }
+    return;
+}
+
+static void fileGet(void* self)
+{
+    atomic_inc(&this->mRefCnt);
+    return;
+}
+
+static int fileOpen(void* self, const char* filename, unsigned int flags, bool check_permissions)
+{
+    if ( this->mOpen )
+    {
+        return -EBUSY;
+    }
+
+    this->mOpen = true;
+    this->mWritable = flags_to_writable(flags);
+    this->mLength = talpa_uspace_file_length;
+    this->mPosition = 0;
+
+    return 0;
+}
+
+static int fileOpenDentry(void* self, void* object1, void* object2, unsigned int flags, bool check_permissions)
+{
+    return -EINVAL;
+}
+
+static int fileOpenExec(void* self, const char* filename)
+{
+    return fileOpen(self, filename, O_RDONLY, false);
+}
+
+static bool fileIsOpen(const void* self)
+{
+    return this->mOpen;
+}
+
+static bool fileIsWritable(const void* self)
+{
+    return this->mWritable;
+}
+
+static int fileClose(void* self)
+{
+    if ( !this->mOpen )
+    {
+        return -EBADF;
+    }
+
+    this->mOpen = false;
+
+    return 0;
+}
+
+static loff_t fileLength(const void* self)
+{
+    return this->mOpen ? this->mLength : -EBADF;
+}
+
+static loff_t fileSeek(void* self, loff_t offset, int whence)
+{
+    loff_t pos;
+
+
+    if ( !this->mOpen )
+    {
+        return -EBADF;
+    }
+
+    switch ( whence )
+    {
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = this->mPosition + offset;
+            break;
+        case SEEK_END:
+            pos = this->mLength + offset;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    if ( pos < 0 )
+    {
+        return -EINVAL;
+    }
+
+    this->mPosition = pos;
+
+    return pos;
+}
+
+static ssize_t fileRead(void* self, void* data, size_t count)
+{
+    loff_t left;
+
+
+    if ( !this->mOpen )
+    {
+        return -EBADF;
+    }
+
+    left = this->mLength - this->mPosition;
+    if ( left <= 0 )
+    {
+        return 0;
+    }
+    if ( (loff_t)count > left )
+    {
+        count = left;
+    }
+
+    memset(data, 0, count);
+    this->mPosition += count;
+
+    return count;
+}
+
+static ssize_t fileWrite(void* self, const void* data, size_t count)
+{
+    if ( !this->mOpen || !this->mWritable )
+    {
+        return -EBADF;
+    }
+
+    this->mPosition += count;
+    if ( this->mPosition > this->mLength )
+    {
+        this->mLength = this->mPosition;
+    }
+
+    return count;
+}
+
+static int fileUnlink(void* self)
+{
+    return this->mOpen ? 0 : -EBADF;
+}
+
+static int fileTruncate(void* self, loff_t length)
+{
+    if ( !this->mOpen || !this->mWritable )
+    {
+        return -EBADF;
+    }
+
+    this->mLength = length;
+
+    return 0;
+}
+#undef this
+
+
+/*
+ * IFilesystemFactory
+ */
+static IFile* newFile(const void* self)
+{
+    UspaceFile* object = newUspaceFile();
+
+
+    return object ? &object->i_IFile : NULL;
+}
+
+static IFile* cloneFile(const void* self, void* fobject)
+{
+    return NULL;
+}
+
+static IFileInfo* newFileInfo(const void* self, EFilesystemOperation operation, const char* filename, int flags, int mode)
+{
+    return talpa_uspace_fileinfo(operation, filename, flags, 0, 0, NULL);
+}
+
+static IFileInfo* newFileInfoFromFd(const void* self, EFilesystemOperation operation, int fd)
+{
+    return NULL;
+}
+
+static IFileInfo* newFileInfoFromFile(const void* self, EFilesystemOperation operation, void* file)
+{
+    return NULL;
+}
+
+static IFileInfo* newFileInfoFromDirectoryEntry(const void* self, EFilesystemOperation operation, void* dentry, void* mnt, int flags, int mode)
+{
+    return NULL;
+}
+
+static IFileInfo* newFileInfoFromInode(const void* self, EFilesystemOperation operation, void* inode, int flags)
+{
+    return NULL;
+}
+
+static IFilesystemInfo* newFilesystemInfo(const void* self, EFilesystemOperation operation, const char* dev_name, const char* dir_name, const char* type)
+{
+    return NULL;
+}
+
+static void deleteFactory(const void* self)
+{
+    return;
+}
+
+static IFilesystemFactory GL_filesystemFactory =
+    {
+        newFile,
+        cloneFile,
+        newFileInfo,
+        newFileInfoFromFd,
+        newFileInfoFromFile,
+        newFileInfoFromFile,
+        newFileInfoFromDirectoryEntry,
+        newFileInfoFromInode,
+        newFilesystemInfo,
+        &GL_filesystemFactory,
+        deleteFactory
+    };
+
+
+/*
+ * IThreadInfo
+ *
+ * Identity comes from current, there is no environment or terminal and
+ * everybody shares the system root.
+ */
+typedef struct tag_UspaceThreadInfo
+{
+    IThreadInfo             i_IThreadInfo;
+    void                    (*delete)(struct tag_UspaceThreadInfo* object);
+    atomic_t                mRefCnt;
+    pid_t                   mPID;
+    pid_t                   mTID;
+} UspaceThreadInfo;
+
+static void threadInfoGet(const void* self);
+static pid_t threadInfoProcessId(const void* self);
+static pid_t threadInfoThreadId(const void* self);
+static unsigned long threadInfoEnvironmentSize(const void* self);
+static const unsigned char* threadInfoEnvironment(const void* self);
+static unsigned long threadInfoControllingTTY(const void* self);
+static const char* threadInfoRootDir(const void* self);
+static void* threadInfoUtsNamespace(const void* self);
+static void deleteUspaceThreadInfo(struct tag_UspaceThreadInfo* object);
+
+static UspaceThreadInfo template_UspaceThreadInfo =
+    {
+        {
+            threadInfoGet,
+            threadInfoProcessId,
+            threadInfoThreadId,
+            threadInfoEnvironmentSize,
+            threadInfoEnvironment,
+            threadInfoControllingTTY,
+            threadInfoRootDir,
+            threadInfoUtsNamespace,
+            NULL,
+            (void (*)(const void*))deleteUspaceThreadInfo
+        },
+        deleteUspaceThreadInfo,
+        ATOMIC_INIT(1),
+        0,
+        0
+    };
+#define this    ((UspaceThreadInfo*)self)
+
+static UspaceThreadInfo* newUspaceThreadInfo(void)
+{
+    UspaceThreadInfo* object;
+
+
+    object = talpa_alloc(sizeof(template_UspaceThreadInfo));
+    if ( likely(object != NULL) )
+    {
+        memcpy(object, &template_UspaceThreadInfo, sizeof(template_UspaceThreadInfo));
+        object->i_IThreadInfo.object = object;
+        object->mPID = current->tgid;
+        object->mTID = current->pid;
+    }
+
+    return object;
+}
+
+static void deleteUspaceThreadInfo(struct tag_UspaceThreadInfo* object)
+{
+    if ( atomic_dec_and_test(&object->mRefCnt) )
+    {
+        talpa_free(object);
+    }
+    return;
+}
+
+static void threadInfoGet(const void* self)
+{
+    atomic_inc(&this->mRefCnt);
+    return;
+}
+
+static pid_t threadInfoProcessId(const void* self)
+{
+    return this->mPID;
+}
+
+static pid_t threadInfoThreadId(const void* self)
+{
+    return this->mTID;
+}
+
+static unsigned long threadInfoEnvironmentSize(const void* self)
+{
+    return 0;
+}
+
+static const unsigned char* threadInfoEnvironment(const void* self)
+{
+    return NULL;
+}
+
+static unsigned long threadInfoControllingTTY(const void* self)
+{
+    return 0;
+}
+
+static const char* threadInfoRootDir(const void* self)
+{
+    return NULL;
+}
+
+static void* threadInfoUtsNamespace(const void* self)
+{
+    return NULL;
+}
+#undef this
+
+static IThreadInfo* newThreadInfo(const void* self)
+{
+    UspaceThreadInfo* object = newUspaceThreadInfo();
+
+
+    return object ? &object->i_IThreadInfo : NULL;
+}
+
+static IThreadAndProcessFactory GL_threadFactory =
+    {
+        newThreadInfo,
+        &GL_threadFactory,
+        deleteFactory
+    };
+
+
+/*
+ * ISystemRoot
+ */
+static void* systemRootNothing(const void* self)
+{
+    return NULL;
+}
+
+static void deleteSystemRoot(void* self)
+{
+    return;
+}
+
+static ISystemRoot GL_systemRoot =
+    {
+        systemRootNothing,
+        systemRootNothing,
+        systemRootNothing,
+        &GL_systemRoot,
+        deleteSystemRoot
+    };
+
+
+/*
+ * IPortabilityApplicationControl
+ */
+static IConfigurator* configurator(void)
+{
+    return NULL;
+}
+
+static ISystemRoot* systemRoot(void)
+{
+    return &GL_systemRoot;
+}
+
+static IFilesystemFactory* filesystemFactory(void)
+{
+    return &GL_filesystemFactory;
+}
+
+static IPersonalityFactory* personalityFactory(void)
+{
+    return &(newLinuxPersonalityFactoryImpl()->i_IPersonalityFactory);
+}
+
+static IThreadAndProcessFactory* threadandprocessFactory(void)
+{
+    return &GL_threadFactory;
+}
+
+static IPortabilityApplicationControl GL_talpa_uspace =
+    {
+        configurator,
+        systemRoot,
+        filesystemFactory,
+        personalityFactory,
+        threadandprocessFactory
+    };
+
+const IPortabilityApplicationControl* TALPA_Portability(void)
+{
+    return &GL_talpa_uspace;
+}
+
+/*
+ * End of services.c
+ */
@@ -0,0 +1,66 @@
+/*
+ * talpa_uspace.h
+ *
+ * TALPA Filesystem Interceptor
+ *
+ * Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+ *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the
+ * GNU General Public License Version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program; if not,
+ * write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+#ifndef H_TALPAUSPACE
+#define H_TALPAUSPACE
+
+/*
+ * The core components built as an ordinary program. The intercept
+ * processor is put together with the same filter chain as talpa_core,
+ * and the portability services are simple in-memory stand-ins: files
+ * have whatever identity the caller gives them and read back as zeroes.
+ */
+
+#include "cache/icache.h"
+#include "configurator/iconfigurable.h"
+#include "filesystem/ifile_info.h"
+#include "intercept_processing/iintercept_processor.h"
+#include "vetting_server/ivetting_server.h"
+
+/*
+ * Core, as assembled by talpa_core.
+ */
+int                     talpa_uspace_init(void);
+void                    talpa_uspace_exit(void);
+
+IInterceptProcessor*    talpa_uspace_processor(void);
+IVettingServer*         talpa_uspace_vetting_server(void);
+ICache*                 talpa_uspace_cache(void);
+IConfigurable*          talpa_uspace_configurable(const char* name);
+
+/*
+ * Services.
+ */
+IFileInfo*              talpa_uspace_fileinfo(EFilesystemOperation operation, const char* filename, int flags,
+                                              uint64_t device, unsigned long inode, const char* fstype);
+
+/* Size of every file opened through the stand-in IFile */
+extern loff_t           talpa_uspace_file_length;
+
+/*
+ * Platform.
+ */
+
+/* Where capture records go, capture can only be enabled once this is set */
+extern FILE*            talpa_uspace_capture_file;
+
+#endif
+
+/*
+ * End of talpa_uspace.h
+ */
@@ -0,0 +1,52 @@
+#! /bin/bash
+#
+# TALPA test script
+#
+# Copyright (C) 2004-2011 Sophos Limited, Oxford, England.
+#
+# This program is free software; you can redistribute it and/or modify it under the terms of the
+# GNU General Public License Version 2 as published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+# even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with this program; if not,
+# write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+#
+
+. ${srcdir}/functions.sh
+
+. ${srcdir}/tlp-cleanup.sh
+
+get_mount_fs /
+
+mkdir -p /tmp/tlp-test/dir250/sub /tmp/tlp-test/dir251
+touch /tmp/tlp-test/dir250/sub/file /tmp/tlp-test/file250 /tmp/tlp-test/file251 /tmp/tlp-test/file250x
+
+tlp_insmod modules/tlp-exclusion.${ko}
+
+excl=${talpafs}/intercept-filters/FilesystemExclusionProcessor/paths
+
+# Enough entries that matching has to go through the compiled set
+for i in `seq 1 500`
+do
+    echo -n "+/tmp/tlp-test/dir$i/" >${excl}
+    echo -n "+/tmp/tlp-test/file$i" >${excl}
+done
+
+./chk_fsexclusion  /tmp/tlp-test/dir250/sub/file ${_mount_fs} 3 || exit 1
+./chk_fsexclusion  /tmp/tlp-test/file250 ${_mount_fs} 3 || exit 1
+./chk_fsexclusion  /tmp/tlp-test/file250x ${_mount_fs} 2 || exit 1
+./chk_fsexclusion  /tmp/tlp-test/dir251 ${_mount_fs} 2 || exit 1
+
+# Removal must take effect for both kinds of entry
+echo -n "-/tmp/tlp-test/dir250/" >${excl}
+echo -n "-/tmp/tlp-test/file250" >${excl}
+./chk_fsexclusion  /tmp/tlp-test/dir250/sub/file ${_mount_fs} 2 || exit 1
+./chk_fsexclusion  /tmp/tlp-test/file250 ${_mount_fs} 2 || exit 1
+./chk_fsexclusion  /tmp/tlp-test/file251 ${_mount_fs} 3 || exit 1
+
+rm -rf /tmp/tlp-test
+
+exit 0
@@ -0,0 +1,26 @@
+#! /bin/bash
+#
+# TALPA test script
+#
+# Copyright (C) 2004-2019 Sophos Limited, Oxford, England.
+#
+# This program is free software; you can redistribute it and/or modify it under the terms of the
+# GNU General Public License Version 2 as published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+# even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along with this program; if not,
+# write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+#
+
+
+. ${srcdir}/talpa-init.sh
+# The most specific path route wins, regardless of the order routes were added in.
+echo +path:/tmp/:2 >${talpafs}/intercept-filters/VettingController/routing
+echo +path:/tmp/tlp-test/:1 >${talpafs}/intercept-filters/VettingController/routing
+echo +path:/tmp/tlp-test/file-other:2 >${talpafs}/intercept-filters/VettingController/routing
+./chk_vettingctrl3 1 /tmp/tlp-test/file
+
+exit $?
@@ -7,6 +7,8 @@ tlpPersonalityOBJS       =  $(tlpPersonalitySOURCES:.c=.o)
 tlpFileInfoSOURCES    =  tlp_fileinfo.c \
                          src/platforms/linux/glue.c \
                          src/platforms/linux/vfs_mount.c \
+                         src/platforms/linux/fstype.c \
+                         src/platforms/linux/latency.c \
                          src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                          src/components/services/linux_filesystem_impl/linux_systemroot.c
 
@@ -23,6 +25,8 @@ tlpFilesystemInfoOBJS       =  $(tlpFilesystemInfoSOURCES:.c=.o)
 tlpSyslogSOURCES    =  tlp_syslog.c \
                      src/platforms/linux/glue.c \
                      src/platforms/linux/vfs_mount.c \
+                     src/platforms/linux/fstype.c \
+                     src/platforms/linux/latency.c \
                      src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                      src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                      src/components/services/linux_filesystem_impl/linux_systemroot.c \
@@ -33,16 +37,19 @@ tlpSyslogSOURCES    =  tlp_syslog.c \
 tlpSyslogOBJS       =  $(tlpSyslogSOURCES:.c=.o)
 
 tlpProcfsSOURCES    =  tlp_procfs.c \
+                     src/platforms/linux/verdict.c \
                      src/components/services/configurator_impl/procfs_configurator.c
 
 tlpProcfsOBJS       =  $(tlpProcfsSOURCES:.c=.o)
 
 tlpSecurityfsSOURCES    =  tlp_securityfs.c \
+                          src/platforms/linux/verdict.c \
                           src/components/services/configurator_impl/securityfs_configurator.c
 
 tlpSecurityfsOBJS       =  $(tlpSecurityfsSOURCES:.c=.o)
 
 tlpDualfsSOURCES    =  tlp_dualfs.c \
+                       src/platforms/linux/verdict.c \
                        src/components/services/configurator_impl/dualfs_configurator.c \
                        src/components/services/configurator_impl/procfs_configurator.c \
                        src/components/services/configurator_impl/securityfs_configurator.c
@@ -51,7 +58,12 @@ tlpDualfsOBJS       =  $(tlpDualfsSOURCES:.c=.o)
 
 tlpStdInterceptorSOURCES    =  tlp_stdinterceptor.c \
                              src/platforms/linux/glue.c \
+                             src/platforms/linux/verdict.c \
                              src/platforms/linux/vfs_mount.c \
+                             src/platforms/linux/fstype.c \
+                             src/platforms/linux/latency.c \
+                             src/platforms/linux/lock_stats.c \
+                             src/platforms/linux/capture.c \
                              src/components/services/linux_filesystem_impl/linux_file.c \
                              src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                              src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
@@ -67,6 +79,9 @@ tlpStdInterceptorOBJS       =  $(tlpStdInterceptorSOURCES:.c=.o)
 tlpInclusionSOURCES    =  tlp_inclusion.c \
                         src/platforms/linux/glue.c \
                         src/platforms/linux/vfs_mount.c \
+                        src/platforms/linux/fstype.c \
+                        src/platforms/linux/latency.c \
+                        src/platforms/linux/lock_stats.c \
                         src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                         src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                         src/components/services/linux_filesystem_impl/linux_systemroot.c \
@@ -79,6 +94,8 @@ tlpInclusionOBJS       =  $(tlpInclusionSOURCES:.c=.o)
 tlpOpExclSOURCES    =  tlp_opexcl.c \
                      src/platforms/linux/glue.c \
                      src/platforms/linux/vfs_mount.c \
+                     src/platforms/linux/fstype.c \
+                     src/platforms/linux/latency.c \
                      src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                      src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                      src/components/services/linux_filesystem_impl/linux_systemroot.c \
@@ -90,7 +107,10 @@ tlpOpExclOBJS       =  $(tlpOpExclSOURCES:.c=.o)
 
 tlpAllowSyslogSOURCES   =  tlp_allowsyslog.c \
                          src/platforms/linux/glue.c \
+                         src/platforms/linux/verdict.c \
                          src/platforms/linux/vfs_mount.c \
+                         src/platforms/linux/fstype.c \
+                         src/platforms/linux/latency.c \
                          src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                          src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                          src/components/services/linux_filesystem_impl/linux_systemroot.c \
@@ -103,7 +123,10 @@ tlpAllowSyslogOBJS      =  $(tlpAllowSyslogSOURCES:.c=.o)
 
 tlpDenySyslogSOURCES    =  tlp_denysyslog.c \
                          src/platforms/linux/glue.c \
+                         src/platforms/linux/verdict.c \
                          src/platforms/linux/vfs_mount.c \
+                         src/platforms/linux/fstype.c \
+                         src/platforms/linux/latency.c \
                          src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                          src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                          src/components/services/linux_filesystem_impl/linux_systemroot.c \
@@ -124,13 +147,18 @@ tlpThreadInfoOBJS       =  $(tlpThreadInfoSOURCES:.c=.o)
 
 tlpExclusionSOURCES    =  tlp_exclusion.c \
                         src/platforms/linux/glue.c \
+                        src/platforms/linux/verdict.c \
                         src/platforms/linux/vfs_mount.c \
+                        src/platforms/linux/fstype.c \
+                        src/platforms/linux/latency.c \
+                        src/platforms/linux/lock_stats.c \
                         src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                         src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                         src/components/services/linux_filesystem_impl/linux_systemroot.c \
                         src/components/services/linux_personality_impl/linux_personality.c \
                         src/components/core/intercept_processing_impl/evaluation_report_impl.c \
                         src/components/core/intercept_filters_impl/fsobj_excl/filesystem_exclusion_processor.c \
+                        src/components/core/path_set_impl/path_set.c \
                         src/components/services/configurator_impl/procfs_configurator.c
 
 tlpExclusionOBJS       =  $(tlpExclusionSOURCES:.c=.o)
@@ -142,7 +170,11 @@ tlpDDVCOBJS       =  $(tlpDDVCSOURCES:.c=.o)
 
 tlpCacheObjSOURCES    =  tlp_cacheobj.c \
                        src/platforms/linux/glue.c \
+                       src/platforms/linux/verdict.c \
                        src/platforms/linux/vfs_mount.c \
+                       src/platforms/linux/fstype.c \
+                       src/platforms/linux/latency.c \
+                       src/platforms/linux/lock_stats.c \
                        src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                        src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                        src/components/services/linux_filesystem_impl/linux_systemroot.c \
@@ -155,7 +187,12 @@ tlpCacheObjOBJS       =  $(tlpCacheObjSOURCES:.c=.o)
 
 tlpCacheSOURCES    =  tlp_cache.c \
                     src/platforms/linux/glue.c \
+                    src/platforms/linux/verdict.c \
                     src/platforms/linux/vfs_mount.c \
+                    src/platforms/linux/fstype.c \
+                    src/platforms/linux/latency.c \
+                    src/platforms/linux/lock_stats.c \
+                    src/platforms/linux/capture.c \
                     src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                     src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                     src/components/services/linux_filesystem_impl/linux_systemroot.c \
@@ -171,7 +208,10 @@ tlpCacheOBJS       =  $(tlpCacheSOURCES:.c=.o)
 
 tlpDegrModeSOURCES    =  tlp_degrmode.c \
                        src/platforms/linux/glue.c \
+                       src/platforms/linux/verdict.c \
                        src/platforms/linux/vfs_mount.c \
+                       src/platforms/linux/fstype.c \
+                       src/platforms/linux/latency.c \
                        src/components/services/linux_filesystem_impl/linux_fileinfo.c \
                        src/components/services/linux_filesystem_impl/linux_filesysteminfo.c \
                        src/components/services/linux_filesystem_impl/linux_systemroot.c \
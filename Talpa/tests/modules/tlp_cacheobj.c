@@ -101,7 +101,7 @@ int talpa_ioctl(struct inode *inode, struct file *file, unsigned int cmd, unsign
             ret = copy_from_user(&co, (void *)parm, sizeof(struct talpa_cacheobj));
             if ( !ret )
             {
-                cache->i_ICache.add(cache, co.class, co.keyH, co.keyL);
+                cache->i_ICache.add(cache, talpa_fstype_intern(co.class), co.class, co.keyH, co.keyL);
             }
             else
             {